@@ -0,0 +1,99 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020 - 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include <iostream>
+#include <cxxopts.hpp>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "ScriptReplayHarness.h"
+
+// Replays traffic captured by terminal (BS_SCRIPT_CAPTURE_FILE env variable)
+// into AQ or AutoRFQ script and prints JSON report with quotes sent and timings
+int main(int argc, char** argv) {
+   QCoreApplication app(argc, argv);
+
+   auto logger = spdlog::stdout_color_mt("stdout logger");
+
+   bool help{};
+   bool verbose{};
+   std::string captureFile;
+   std::string aqScript;
+   std::string rfqScript;
+   std::string reportFile;
+
+   cxxopts::Options options("BlockSettle script replay", "Offline backtest of AQ and AutoRFQ scripts");
+   options.add_options()
+      ("h,help", "Print help"
+         , cxxopts::value<bool>(help))
+      ("capture", "Captured script traffic file"
+         , cxxopts::value<std::string>(captureFile))
+      ("aq", "Autoquoting script (QML) or strategy library"
+         , cxxopts::value<std::string>(aqScript))
+      ("rfq", "AutoRFQ script (QML)"
+         , cxxopts::value<std::string>(rfqScript))
+      ("report", "Write report to file (default stdout)"
+         , cxxopts::value<std::string>(reportFile))
+      ("verbose", "Log script output"
+         , cxxopts::value<bool>(verbose))
+   ;
+
+   try {
+      options.parse(argc, argv);
+   }
+   catch (const std::exception& e) {
+      SPDLOG_LOGGER_CRITICAL(logger, "parsing args failed: {}", e.what());
+      return EXIT_FAILURE;
+   }
+
+   if (help) {
+      std::cout << options.help() << std::endl;
+      return EXIT_SUCCESS;
+   }
+
+   if (captureFile.empty() || (aqScript.empty() == rfqScript.empty())) {
+      SPDLOG_LOGGER_CRITICAL(logger, "please set capture file and either AQ or RFQ script");
+      return EXIT_FAILURE;
+   }
+
+   logger->set_level(verbose ? spdlog::level::debug : spdlog::level::warn);
+
+   bs::ScriptReplayHarness harness(logger);
+   QString error;
+   if (!harness.loadEvents(QString::fromStdString(captureFile), error)) {
+      SPDLOG_LOGGER_CRITICAL(logger, "can't load capture: {}", error.toStdString());
+      return EXIT_FAILURE;
+   }
+
+   const bool result = aqScript.empty()
+      ? harness.runRFQ(QString::fromStdString(rfqScript), error)
+      : harness.runAQ(QString::fromStdString(aqScript), error);
+   if (!result) {
+      SPDLOG_LOGGER_CRITICAL(logger, "can't run script: {}", error.toStdString());
+      return EXIT_FAILURE;
+   }
+
+   const auto report = QJsonDocument(harness.report()).toJson();
+   if (reportFile.empty()) {
+      std::cout << report.toStdString() << std::endl;
+      return EXIT_SUCCESS;
+   }
+
+   QFile file(QString::fromStdString(reportFile));
+   if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+      SPDLOG_LOGGER_CRITICAL(logger, "can't write report to {}", reportFile);
+      return EXIT_FAILURE;
+   }
+   file.write(report);
+   return EXIT_SUCCESS;
+}
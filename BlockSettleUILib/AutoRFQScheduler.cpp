@@ -0,0 +1,131 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "AutoRFQScheduler.h"
+
+#include <algorithm>
+#include <QTimer>
+#include <spdlog/spdlog.h>
+
+AutoRFQScheduler::AutoRFQScheduler(const std::shared_ptr<spdlog::logger> &logger
+   , QObject *parent)
+   : QObject(parent)
+   , logger_(logger)
+   , timer_(new QTimer(this))
+{
+   timer_->setSingleShot(true);
+   connect(timer_, &QTimer::timeout, this, &AutoRFQScheduler::onTimer);
+}
+
+AutoRFQScheduler::~AutoRFQScheduler() = default;
+
+void AutoRFQScheduler::setRateLimit(int maxPerSec, int burst)
+{
+   if (maxPerSec <= 0) {
+      interval_ = {};
+      burstTolerance_ = {};
+   }
+   else {
+      interval_ = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / maxPerSec;
+      burstTolerance_ = interval_ * std::max(burst - 1, 0);
+   }
+   theoreticalArrival_ = {};
+   schedule();
+}
+
+void AutoRFQScheduler::submit(const std::string &id, const QString &symbol
+   , double amount, bool buy)
+{
+   const auto now = Clock::now();
+   auto due = now;
+   if (interval_ != Clock::duration::zero()) {
+      due = std::max(now, theoreticalArrival_ - burstTolerance_);
+      theoreticalArrival_ = std::max(theoreticalArrival_, due) + interval_;
+   }
+
+   const Submission submission{ due, id, symbol, amount, buy };
+   if ((due <= now) && queue_.empty()) {
+      send(submission);
+      return;
+   }
+
+   throttled_++;
+   SPDLOG_LOGGER_DEBUG(logger_, "RFQ {} is throttled, {} in queue", id, queue_.size() + 1);
+   queue_.push_back(submission);
+   schedule();
+}
+
+bool AutoRFQScheduler::cancel(const std::string &id)
+{
+   const auto it = std::find_if(queue_.begin(), queue_.end(), [&id](const Submission &s) {
+      return (s.id == id);
+   });
+   if (it == queue_.end()) {
+      active_.erase(id);
+      return false;
+   }
+   queue_.erase(it);
+   schedule();
+   return true;
+}
+
+void AutoRFQScheduler::finished(const std::string &id)
+{
+   cancel(id);
+}
+
+void AutoRFQScheduler::clear()
+{
+   queue_.clear();
+   active_.clear();
+   timer_->stop();
+}
+
+AutoRFQScheduler::Stats AutoRFQScheduler::stats() const
+{
+   Stats result;
+   result.active = static_cast<int>(active_.size());
+   result.pending = static_cast<int>(queue_.size());
+   result.throttled = throttled_;
+   return result;
+}
+
+void AutoRFQScheduler::send(const Submission &submission)
+{
+   active_.insert(submission.id);
+   emit sendRFQ(submission.id, submission.symbol, submission.amount, submission.buy);
+}
+
+void AutoRFQScheduler::onTimer()
+{
+   const auto now = Clock::now();
+   const bool unlimited = (interval_ == Clock::duration::zero());
+   while (!queue_.empty() && (unlimited || (queue_.front().due <= now))) {
+      const auto submission = std::move(queue_.front());
+      queue_.pop_front();
+      send(submission);
+   }
+   schedule();
+}
+
+void AutoRFQScheduler::schedule()
+{
+   if (queue_.empty()) {
+      timer_->stop();
+      return;
+   }
+   if (interval_ == Clock::duration::zero()) {
+      timer_->start(0);    // limit was lifted - flush the queue
+      return;
+   }
+   const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+      queue_.front().due - Clock::now());
+   timer_->start(static_cast<int>(std::max<int64_t>(delay.count(), 0)));
+}
@@ -0,0 +1,88 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef AUTO_RFQ_SCHEDULER_H
+#define AUTO_RFQ_SCHEDULER_H
+
+#include <QObject>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
+namespace spdlog {
+   class logger;
+}
+class QTimer;
+
+//! Single point where RFQs created by AutoRFQ scripts go out to RFQ ticket.
+//! Submissions are rate-limited (GCRA: maxPerSec with allowed burst), those
+//! exceeding the limit wait in a queue served by one timer. Due times are
+//! assigned in submission order, so the queue is always sorted by them.
+class AutoRFQScheduler : public QObject
+{
+   Q_OBJECT
+public:
+   struct Stats
+   {
+      int      active{ 0 };      // sent to ticket and not finished yet
+      int      pending{ 0 };     // waiting in rate limiter queue
+      uint64_t throttled{ 0 };   // total number of submissions delayed by limiter
+   };
+
+   AutoRFQScheduler(const std::shared_ptr<spdlog::logger> &, QObject *parent = nullptr);
+   ~AutoRFQScheduler() override;
+
+   // maxPerSec <= 0 disables rate limiting
+   void setRateLimit(int maxPerSec, int burst);
+
+   void submit(const std::string &id, const QString &symbol, double amount, bool buy);
+   // Returns false if RFQ was already sent to ticket
+   bool cancel(const std::string &id);
+   // RFQ is accepted, expired or cancelled
+   void finished(const std::string &id);
+   void clear();
+
+   Stats stats() const;
+
+signals:
+   void sendRFQ(const std::string &id, const QString &symbol, double amount, bool buy);
+
+private:
+   using Clock = std::chrono::steady_clock;
+
+   struct Submission
+   {
+      Clock::time_point due;
+      std::string id;
+      QString     symbol;
+      double      amount;
+      bool        buy;
+   };
+
+   void send(const Submission &);
+   void onTimer();
+   void schedule();
+
+private:
+   std::shared_ptr<spdlog::logger>  logger_;
+   QTimer   *timer_;
+
+   Clock::duration   interval_{};
+   Clock::duration   burstTolerance_{};
+   Clock::time_point theoreticalArrival_{};
+
+   std::deque<Submission>           queue_;
+   std::unordered_set<std::string>  active_;
+   uint64_t throttled_{ 0 };
+};
+
+#endif // AUTO_RFQ_SCHEDULER_H
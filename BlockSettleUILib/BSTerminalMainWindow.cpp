@@ -14,6 +14,7 @@
 #include <QCloseEvent>
 #include <QGuiApplication>
 #include <QIcon>
+#include <QInputDialog>
 #include <QShortcut>
 #include <QStringList>
 #include <QSystemTrayIcon>
@@ -27,6 +28,7 @@
 #include "AssetManager.h"
 #include "AuthAddressDialog.h"
 #include "AuthAddressManager.h"
+#include "AuthAddressVerificationCache.h"
 #include "AutheIDClient.h"
 #include "AutoSignQuoteProvider.h"
 #include "Bip15xDataConnection.h"
@@ -44,6 +46,7 @@
 #include "CreateTransactionDialogAdvanced.h"
 #include "CreateTransactionDialogSimple.h"
 #include "DialogManager.h"
+#include "FeeEstimateCache.h"
 #include "FutureValue.h"
 #include "HeadlessContainer.h"
 #include "ImportKeyBox.h"
@@ -63,6 +66,7 @@
 #include "QuoteProvider.h"
 #include "RequestReplyCommand.h"
 #include "RetryingDataConnection.h"
+#include "ScriptTraffic.h"
 #include "SelectWalletDialog.h"
 #include "Settings/ConfigDialog.h"
 #include "SignersProvider.h"
@@ -151,6 +155,9 @@ BSTerminalMainWindow::BSTerminalMainWindow(const std::shared_ptr<ApplicationSett
    initArmory();
    initCcClient();
 
+   bs::AuthAddressVerificationCache::createInstance(logMgr_->logger(), armory_);
+   bs::FeeEstimateCache::createInstance(logMgr_->logger(), armory_);
+
    walletsMgr_ = std::make_shared<bs::sync::WalletsManager>(logMgr_->logger(), applicationSettings_, armory_, trackerClient_);
 
    if (!applicationSettings_->get<bool>(ApplicationSettings::initialized)) {
@@ -306,6 +313,8 @@ BSTerminalMainWindow::~BSTerminalMainWindow()
    applicationSettings_->SaveSettings();
 
    NotificationCenter::destroyInstance();
+   bs::AuthAddressVerificationCache::destroyInstance();
+   bs::FeeEstimateCache::destroyInstance();
    if (signContainer_) {
       signContainer_->Stop();
       signContainer_.reset();
@@ -706,6 +715,7 @@ void BSTerminalMainWindow::updateControlEnabledState()
 
       action_send_->setEnabled(txCreationEnabled);
       ui_->actionOpenURI->setEnabled(txCreationEnabled);
+      ui_->actionConsolidateUtxos->setEnabled(txCreationEnabled);
    }
    // Do not allow login until wallets synced (we need to check if user has primary wallet or not).
    // Should be OK for both local and remote signer.
@@ -1319,6 +1329,64 @@ void BSTerminalMainWindow::onSend()
    DisplayCreateTransactionDialog(dlg);
 }
 
+void BSTerminalMainWindow::onConsolidateUtxos()
+{
+   auto wallet = ui_->widgetWallets->getSelectedHdWallet();
+   if (!wallet) {
+      wallet = walletsMgr_->getPrimaryWallet();
+   }
+   if (!wallet) {
+      return;
+   }
+
+   // Fee ceiling and budget are asked every time, last values are offered by default
+   const auto title = tr("UTXO Consolidation");
+   bool isOk = false;
+   const double maxFeePerByte = QInputDialog::getDouble(this, title
+      , tr("Maximum network fee rate (sat/byte):"), consolidationMaxFeePerByte_, 1, 1000, 1, &isOk);
+   if (!isOk) {
+      return;
+   }
+   const double maxTotalFee = QInputDialog::getDouble(this, title
+      , tr("Total fee budget (BTC):"), consolidationMaxTotalFee_, 0.00000001, 1, 8, &isOk);
+   if (!isOk) {
+      return;
+   }
+   consolidationMaxFeePerByte_ = maxFeePerByte;
+   consolidationMaxTotalFee_ = maxTotalFee;
+
+   bs::UtxoConsolidationPlanner::Params params;
+   params.maxFeePerByte = static_cast<float>(maxFeePerByte);
+   params.maxTotalFee = bs::XBTAmount(maxTotalFee).GetValue();
+
+   auto cbPlan = [this, title, walletName = QString::fromStdString(wallet->name())]
+      (bs::UtxoConsolidationPlanner::Result &&result)
+   {
+      if (result.error == bs::UtxoConsolidationPlanner::Error::FeeUnavailable) {
+         showInfo(title, tr("Network fee estimate is unavailable, please try again later"));
+         return;
+      }
+      if (result.error != bs::UtxoConsolidationPlanner::Error::None) {
+         showInfo(title, tr("UTXOs of %1 are not loaded yet").arg(walletName));
+         return;
+      }
+      if (result.feeTooHigh) {
+         showInfo(title, tr("Network fee is too high to consolidate UTXOs of %1 now").arg(walletName));
+         return;
+      }
+      if (result.plans.empty()) {
+         showInfo(title, tr("UTXOs of %1 need no consolidation").arg(walletName));
+         return;
+      }
+      // One TX at a time: the next one is planned from the UTXO set updated by this one
+      auto dlg = CreateTransactionDialogAdvanced::CreateForConsolidation(armory_, walletsMgr_
+         , utxoReservationMgr_, signContainer_, logMgr_->logger("ui"), applicationSettings_
+         , result.plans.front(), this);
+      DisplayCreateTransactionDialog(dlg);
+   };
+   utxoReservationMgr_->planXbtConsolidation(wallet->walletId(), params, std::move(cbPlan));
+}
+
 void BSTerminalMainWindow::setupMenu()
 {
    // menu role erquired for OSX only, to place it to first menu item
@@ -1351,6 +1419,7 @@ void BSTerminalMainWindow::setupMenu()
 
    connect(ui_->actionCreateNewWallet, &QAction::triggered, this, [ww = ui_->widgetWallets]{ ww->onNewWallet(); });
    connect(ui_->actionOpenURI, &QAction::triggered, this, [this]{ openURIDialog(); });
+   connect(ui_->actionConsolidateUtxos, &QAction::triggered, this, &BSTerminalMainWindow::onConsolidateUtxos);
    connect(ui_->actionAuthenticationAddresses, &QAction::triggered, this, &BSTerminalMainWindow::openAuthManagerDialog);
    connect(ui_->actionSettings, &QAction::triggered, this, [=]() { openConfigDialog(); });
    connect(ui_->actionAccountInformation, &QAction::triggered, this, &BSTerminalMainWindow::openAccountInfoDialog);
@@ -1957,8 +2026,23 @@ void BSTerminalMainWindow::InitWidgets()
    quoteProvider->ConnectToCelerClient(celerConnection_);
 
    const auto &logger = logMgr_->logger();
+
+   // Capture of script traffic for offline replay (BlockSettleScriptReplay)
+   const auto captureFile = QString::fromLocal8Bit(qgetenv("BS_SCRIPT_CAPTURE_FILE"));
+   if (!captureFile.isEmpty()) {
+      new bs::ScriptTrafficRecorder(logger, captureFile, quoteProvider, mdCallbacks_
+         , assetManager_, this);
+   }
+
+   // AQ engine sharding: number of script engines and how requests are spread
+   bool shardCountOk = false;
+   const int shardCount = qEnvironmentVariableIntValue("BS_AQ_SHARDS", &shardCountOk);
+   const auto shardKey = (qgetenv("BS_AQ_SHARD_KEY").toLower() == "product")
+      ? AQScriptHandler::ShardKey::Product : AQScriptHandler::ShardKey::Security;
    const auto aqScriptRunner = new AQScriptRunner(quoteProvider, signContainer_
-      , mdCallbacks_, assetManager_, logger);
+      , mdCallbacks_, assetManager_, logger
+      , (shardCountOk && (shardCount > 1)) ? static_cast<size_t>(shardCount) : 1
+      , shardKey);
    if (!applicationSettings_->get<std::string>(ApplicationSettings::ExtConnName).empty()
       && !applicationSettings_->get<std::string>(ApplicationSettings::ExtConnHost).empty()
       && !applicationSettings_->get<std::string>(ApplicationSettings::ExtConnPort).empty()
@@ -232,6 +232,7 @@ private slots:
 
    void onSend();
    void onGenerateAddress();
+   void onConsolidateUtxos();
 
    void openAuthManagerDialog();
    void openConfigDialog(bool showInNetworkPage = false);
@@ -318,6 +319,9 @@ private:
    bool walletsSynched_ = false;
    bool isArmoryReady_ = false;
 
+   double consolidationMaxFeePerByte_ = 10;     // sat/byte
+   double consolidationMaxTotalFee_ = 0.001;    // BTC
+
    SignContainer::ConnectionError lastSignerError_{};
 
    bs::network::BIP15xNewKeyCb   cbApproveChat_{ nullptr };
@@ -0,0 +1,248 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "CandleAggregator.h"
+
+#include <algorithm>
+
+#include <QDateTime>
+
+#include "market_data_history.pb.h"
+
+using namespace bs;
+using namespace Blocksettle::Communication::MarketDataHistory;
+
+namespace {
+   const uint64_t kHour = 3600000;
+}
+
+CandleAggregator::CandleAggregator(size_t maxCandles)
+   : maxCandles_(std::max(maxCandles, size_t(1)))
+{}
+
+const std::vector<int> &CandleAggregator::intervals()
+{
+   static const std::vector<int> result = {
+      Interval::OneHour,
+      Interval::SixHours,
+      Interval::TwelveHours,
+      Interval::TwentyFourHours,
+      Interval::OneWeek,
+      Interval::OneMonth,
+      Interval::SixMonths,
+      Interval::OneYear,
+   };
+   return result;
+}
+
+uint64_t CandleAggregator::candleStart(uint64_t timestamp, int interval)
+{
+   const auto now = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(timestamp), Qt::UTC);
+   auto result = now;
+   switch (static_cast<Interval>(interval)) {
+   case Interval::OneYear:
+      result.setTime(QTime(0, 0));
+      result.setDate(QDate(now.date().year(), 1, 1));
+      break;
+   case Interval::SixMonths:
+      result.setTime(QTime(0, 0));
+      result.setDate(QDate(now.date().year(), now.date().month() <= 6 ? 1 : 7, 1));
+      break;
+   case Interval::OneMonth:
+      result.setTime(QTime(0, 0));
+      result.setDate(QDate(now.date().year(), now.date().month(), 1));
+      break;
+   case Interval::OneWeek:
+      result.setTime(QTime(0, 0));
+      result.setDate(now.date().addDays(1 - now.date().dayOfWeek())); //1 - Monday, 7 - Sunday
+      break;
+   case Interval::TwentyFourHours:
+      result.setTime(QTime(0, 0));
+      break;
+   case Interval::TwelveHours:
+      result.setTime(QTime(now.time().hour() - now.time().hour() % 12, 0));
+      break;
+   case Interval::SixHours:
+      result.setTime(QTime(now.time().hour() - now.time().hour() % 6, 0));
+      break;
+   case Interval::OneHour:
+   default:
+      result.setTime(QTime(now.time().hour(), 0));
+      break;
+   }
+   return static_cast<uint64_t>(result.toMSecsSinceEpoch());
+}
+
+uint64_t CandleAggregator::nextCandleStart(uint64_t candleStart, int interval)
+{
+   const auto start = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(candleStart), Qt::UTC);
+   switch (static_cast<Interval>(interval)) {
+   case Interval::OneYear:
+      return static_cast<uint64_t>(start.addYears(1).toMSecsSinceEpoch());
+   case Interval::SixMonths:
+      return static_cast<uint64_t>(start.addMonths(6).toMSecsSinceEpoch());
+   case Interval::OneMonth:
+      return static_cast<uint64_t>(start.addMonths(1).toMSecsSinceEpoch());
+   case Interval::OneWeek:
+      return candleStart + kHour * 168;
+   case Interval::TwentyFourHours:
+      return candleStart + kHour * 24;
+   case Interval::TwelveHours:
+      return candleStart + kHour * 12;
+   case Interval::SixHours:
+      return candleStart + kHour * 6;
+   case Interval::OneHour:
+   default:
+      return candleStart + kHour;
+   }
+}
+
+void CandleAggregator::addTrade(const std::string &product, uint64_t timestamp
+   , double price, double amount)
+{
+   auto &productSeries = series_[product];
+   for (const auto interval : intervals()) {
+      addTrade(productSeries[interval], interval, timestamp, price, amount);
+   }
+}
+
+void CandleAggregator::addTrade(Series &series, int interval, uint64_t timestamp
+   , double price, double amount)
+{
+   const auto start = candleStart(timestamp, interval);
+   auto &candles = series.candles;
+
+   // Trades come in time order almost always, so only the last candle is touched
+   if (candles.empty() || (candles.back().timestamp < start)) {
+      candles.push_back({ start, price, price, price, price, amount });
+      trim(series);
+      return;
+   }
+
+   auto it = candles.end() - 1;
+   if (it->timestamp != start) {
+      it = std::lower_bound(candles.begin(), candles.end(), start
+         , [](const Candle &candle, uint64_t stamp) { return candle.timestamp < stamp; });
+      if ((it == candles.end()) || (it->timestamp != start)) {
+         if (it == candles.begin()) {
+            return;  // older than everything kept
+         }
+         candles.insert(it, { start, price, price, price, price, amount });
+         trim(series);
+         return;
+      }
+      // Late trade: don't change close of already closed candle
+      it->high = std::max(it->high, price);
+      it->low = std::min(it->low, price);
+      it->volume += amount;
+      return;
+   }
+
+   it->high = std::max(it->high, price);
+   it->low = std::min(it->low, price);
+   it->close = price;
+   it->volume += amount;
+}
+
+void CandleAggregator::addHistory(const std::string &product, int interval
+   , const std::vector<Candle> &history)
+{
+   auto &series = series_[product][interval];
+   series.seeded = true;
+   if (history.empty()) {
+      return;
+   }
+
+   std::map<uint64_t, Candle> merged;
+   for (const auto &candle : series.candles) {
+      merged[candle.timestamp] = candle;
+   }
+
+   uint64_t newestServerStamp = 0;
+   for (const auto &candle : history) {
+      newestServerStamp = std::max(newestServerStamp, candle.timestamp);
+   }
+
+   for (const auto &candle : history) {
+      const auto it = merged.find(candle.timestamp);
+      if ((it == merged.end()) || (candle.timestamp != newestServerStamp)) {
+         merged[candle.timestamp] = candle;
+         continue;
+      }
+      // Open candle: server knows about trades before we started aggregating,
+      // local one could already have newer trades.
+      auto &local = it->second;
+      local.open = candle.open;
+      local.high = std::max(local.high, candle.high);
+      local.low = std::min(local.low, candle.low);
+      local.volume = std::max(local.volume, candle.volume);
+   }
+
+   series.candles.clear();
+   for (const auto &candle : merged) {
+      series.candles.push_back(candle.second);
+   }
+   trim(series);
+}
+
+bool CandleAggregator::isSeeded(const std::string &product, int interval) const
+{
+   const auto itProduct = series_.find(product);
+   if (itProduct == series_.end()) {
+      return false;
+   }
+   const auto itSeries = itProduct->second.find(interval);
+   return (itSeries != itProduct->second.end()) && itSeries->second.seeded
+      && !itSeries->second.candles.empty();
+}
+
+std::vector<CandleAggregator::Candle> CandleAggregator::candles(const std::string &product
+   , int interval) const
+{
+   std::vector<Candle> result;
+   const auto itProduct = series_.find(product);
+   if (itProduct == series_.end()) {
+      return result;
+   }
+   const auto itSeries = itProduct->second.find(interval);
+   if (itSeries == itProduct->second.end()) {
+      return result;
+   }
+
+   result.reserve(itSeries->second.candles.size());
+   for (const auto &candle : itSeries->second.candles) {
+      if (!result.empty()) {
+         const auto prevClose = result.back().close;
+         auto stamp = nextCandleStart(result.back().timestamp, interval);
+         while (stamp < candle.timestamp) {
+            result.push_back({ stamp, prevClose, prevClose, prevClose, prevClose, 0 });
+            stamp = nextCandleStart(stamp, interval);
+         }
+      }
+      result.push_back(candle);
+   }
+
+   if (result.size() > maxCandles_) {
+      result.erase(result.begin(), result.end() - maxCandles_);
+   }
+   return result;
+}
+
+void CandleAggregator::clear()
+{
+   series_.clear();
+}
+
+void CandleAggregator::trim(Series &series)
+{
+   while (series.candles.size() > maxCandles_) {
+      series.candles.pop_front();
+   }
+}
@@ -0,0 +1,80 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef CANDLE_AGGREGATOR_H
+#define CANDLE_AGGREGATOR_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bs {
+
+   // Folds live trades into OHLC candles for all chart intervals at once, so
+   // the chart could switch to already seen interval without waiting for MDHS.
+   // Interval values are MarketDataHistory::Interval, timestamps are in ms (UTC).
+   // Series becomes usable for display only after it was seeded with server
+   // history, live trades keep it up to date afterwards.
+   // Not thread-safe (expected to be used from GUI thread only).
+   class CandleAggregator
+   {
+   public:
+      struct Candle
+      {
+         uint64_t timestamp{};   // candle start
+         double open{};
+         double high{};
+         double low{};
+         double close{};
+         double volume{};
+      };
+
+      explicit CandleAggregator(size_t maxCandles = 1500);
+
+      static const std::vector<int> &intervals();
+
+      // Start of candle which contains timestamp (calendar aware for week and longer)
+      static uint64_t candleStart(uint64_t timestamp, int interval);
+      static uint64_t nextCandleStart(uint64_t candleStart, int interval);
+
+      void addTrade(const std::string &product, uint64_t timestamp, double price, double amount);
+
+      // Merges server candles (any order) into the series and marks it seeded.
+      // Server values win for closed candles. For the newest (still open)
+      // candle locally aggregated trades are merged on top of server values.
+      void addHistory(const std::string &product, int interval, const std::vector<Candle> &);
+
+      bool isSeeded(const std::string &product, int interval) const;
+
+      // Ascending candles, periods without trades are filled with flat candles
+      std::vector<Candle> candles(const std::string &product, int interval) const;
+
+      void clear();
+
+   private:
+      struct Series
+      {
+         std::deque<Candle>   candles;
+         bool                 seeded{ false };
+      };
+
+      void addTrade(Series &, int interval, uint64_t timestamp, double price, double amount);
+      void trim(Series &);
+
+   private:
+      const size_t   maxCandles_;
+      std::unordered_map<std::string, std::map<int, Series>>   series_;
+   };
+
+}  // namespace bs
+
+#endif // CANDLE_AGGREGATOR_H
@@ -0,0 +1,155 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "CandleLodPyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace bs;
+
+CandleLodPyramid::CandleLodPyramid(size_t maxLevels)
+   : maxLevels_(std::max(maxLevels, size_t(1)))
+{}
+
+void CandleLodPyramid::build(std::vector<Candle> &&candles, double width)
+{
+   levels_.clear();
+   width_ = width;
+   levels_.push_back(std::move(candles));
+   if (width_ <= 0) {
+      return;
+   }
+
+   while ((levels_.size() < maxLevels_) && (levels_.back().size() > 1)) {
+      levels_.push_back(mergeLevel(levels_.back(), levels_.size()));
+   }
+}
+
+bool CandleLodPyramid::update(const Candle &candle)
+{
+   if (levels_.empty() || (width_ <= 0)) {
+      return false;
+   }
+   auto &base = levels_.front();
+   const auto it = std::lower_bound(base.begin(), base.end(), candle.key
+      , [](const Candle &c, double key) { return c.key < key; });
+   if ((it != base.end()) && (it->key == candle.key)) {
+      *it = candle;
+   }
+   else if (it == base.end()) {
+      base.push_back(candle);
+   }
+   else {
+      return false;
+   }
+
+   for (size_t level = 1; level < levels_.size(); ++level) {
+      const auto bucketWidth = width(level);
+      const auto bucket = std::floor(candle.key / bucketWidth);
+      const auto members = bucketRange(levels_[level - 1], bucket, bucketWidth);
+      const auto merged = merge(members.first, members.second);
+
+      auto &current = levels_[level];
+      const auto range = bucketRange(current, bucket, bucketWidth);
+      if (range.first != range.second) {
+         current[range.first - current.cbegin()] = merged;
+      }
+      else {
+         current.insert(current.begin() + (range.first - current.cbegin()), merged);
+      }
+   }
+   while ((levels_.size() < maxLevels_) && (levels_.back().size() > 1)) {
+      levels_.push_back(mergeLevel(levels_.back(), levels_.size()));
+   }
+   return true;
+}
+
+const CandleLodPyramid::Candle *CandleLodPyramid::bucket(size_t level, double key) const
+{
+   if (level >= levels_.size()) {
+      return nullptr;
+   }
+   const auto bucketWidth = width(level);
+   const auto range = bucketRange(levels_[level], std::floor(key / bucketWidth), bucketWidth);
+   return (range.first != range.second) ? &*range.first : nullptr;
+}
+
+CandleLodPyramid::Candle CandleLodPyramid::merge(std::vector<Candle>::const_iterator begin
+   , std::vector<Candle>::const_iterator end)
+{
+   Candle merged = *begin;
+   for (auto it = begin + 1; it != end; ++it) {
+      merged.high = std::max(merged.high, it->high);
+      merged.low = std::min(merged.low, it->low);
+      merged.close = it->close;
+      merged.volume += it->volume;
+   }
+   // Merged candle is centered at its members for drawing
+   merged.key = (begin->key + (end - 1)->key) / 2;
+   return merged;
+}
+
+std::vector<CandleLodPyramid::Candle> CandleLodPyramid::mergeLevel(const std::vector<Candle> &prev
+   , size_t level) const
+{
+   const auto bucketWidth = width(level);
+   std::vector<Candle> next;
+   next.reserve(prev.size() / 2 + 1);
+   auto begin = prev.cbegin();
+   while (begin != prev.cend()) {
+      const auto bucket = std::floor(begin->key / bucketWidth);
+      auto end = begin + 1;
+      while ((end != prev.cend()) && (std::floor(end->key / bucketWidth) == bucket)) {
+         ++end;
+      }
+      next.push_back(merge(begin, end));
+      begin = end;
+   }
+   return next;
+}
+
+std::pair<std::vector<CandleLodPyramid::Candle>::const_iterator, std::vector<CandleLodPyramid::Candle>::const_iterator>
+   CandleLodPyramid::bucketRange(const std::vector<Candle> &candles, double bucket, double bucketWidth)
+{
+   const auto first = std::partition_point(candles.cbegin(), candles.cend(), [bucket, bucketWidth](const Candle &c) {
+      return std::floor(c.key / bucketWidth) < bucket;
+   });
+   const auto last = std::partition_point(first, candles.cend(), [bucket, bucketWidth](const Candle &c) {
+      return std::floor(c.key / bucketWidth) == bucket;
+   });
+   return { first, last };
+}
+
+void CandleLodPyramid::clear()
+{
+   levels_.clear();
+}
+
+const std::vector<CandleLodPyramid::Candle> &CandleLodPyramid::level(size_t index) const
+{
+   static const std::vector<Candle> empty;
+   return (index < levels_.size()) ? levels_[index] : empty;
+}
+
+double CandleLodPyramid::width(size_t level) const
+{
+   return std::ldexp(width_, static_cast<int>(level));
+}
+
+size_t CandleLodPyramid::levelFor(double pixelsPerCandle, double minPixels) const
+{
+   size_t result = 0;
+   while ((result + 1 < levels_.size()) && (pixelsPerCandle < minPixels)) {
+      pixelsPerCandle *= 2;
+      ++result;
+   }
+   return result;
+}
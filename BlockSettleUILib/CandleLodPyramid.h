@@ -0,0 +1,78 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef CANDLE_LOD_PYRAMID_H
+#define CANDLE_LOD_PYRAMID_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace bs {
+
+   // Level-of-detail levels for candle chart. Level 0 holds original candles,
+   // every next level merges candles of the previous one in buckets twice as
+   // wide (OHLC merged, volume summed). Buckets are aligned to key, so they
+   // are stable when older candles are loaded.
+   // Chart shows the level matching current pixel density, so drawing cost
+   // doesn't depend on the amount of loaded history.
+   class CandleLodPyramid
+   {
+   public:
+      struct Candle
+      {
+         double key;       // candle start (seconds) for level 0
+         double open;
+         double high;
+         double low;
+         double close;
+         double volume;
+      };
+
+      explicit CandleLodPyramid(size_t maxLevels = 16);
+
+      // Candles should be sorted by key, width is the width of one candle in key units
+      void build(std::vector<Candle> &&candles, double width);
+      void clear();
+
+      // Sets level 0 candle with the same key (adds it if there is no such one)
+      // and merged buckets containing it in O(levels * log n). Returns false if
+      // pyramid is not built yet or candle is not the last one and is new -
+      // such inserts move buckets, so full build is needed then.
+      bool update(const Candle &);
+
+      size_t levels() const { return levels_.size(); }
+      const std::vector<Candle> &level(size_t) const;
+      // Width of a bucket of the level in key units
+      double width(size_t level) const;
+
+      // The finest level at which one bucket is not narrower than minPixels,
+      // pixelsPerCandle is the on-screen width of level 0 candle
+      size_t levelFor(double pixelsPerCandle, double minPixels) const;
+
+      // Bucket of the level containing level 0 candle with the key, nullptr if none
+      const Candle *bucket(size_t level, double key) const;
+
+   private:
+      static Candle merge(std::vector<Candle>::const_iterator begin
+         , std::vector<Candle>::const_iterator end);
+      std::vector<Candle> mergeLevel(const std::vector<Candle> &, size_t level) const;
+      // Range of candles of the level which fall into the bucket of given width
+      static std::pair<std::vector<Candle>::const_iterator, std::vector<Candle>::const_iterator>
+         bucketRange(const std::vector<Candle> &, double bucket, double bucketWidth);
+
+      const size_t   maxLevels_;
+      double         width_{};
+      std::vector<std::vector<Candle>> levels_;
+   };
+
+}  // namespace bs
+
+#endif // CANDLE_LOD_PYRAMID_H
@@ -10,6 +10,7 @@
 */
 #include "ChartWidget.h"
 
+#include <cmath>
 #include <spdlog/logger.h>
 
 #include "ApplicationSettings.h"
@@ -123,6 +124,7 @@ void ChartWidget::init(const std::shared_ptr<ApplicationSettings>& appSettings
    mdProvider_ = mdProvider;
    mdhsClient_ = std::make_shared<MdhsClient>(connectionManager, logger, mdhsHost, mdhsPort);
    logger_ = logger;
+   ohlcProcessor_ = new OhlcHistoryProcessor(logger, this);
 
    connect(mdhsClient_.get(), &MdhsClient::DataReceived, this, &ChartWidget::OnDataReceived);
 
@@ -261,23 +263,57 @@ void ChartWidget::UpdateChart(const int& interval)
    if (!candlesticksChart_ || !volumeChart_) {
       return;
    }
-   candlesticksChart_->data()->clear();
-   volumeChart_->data()->clear();
+   ClearDataPoints();
    qreal width = 0.8 * IntervalWidth(interval) / 1000;
    candlesticksChart_->setWidth(width);
    volumeChart_->setWidth(width);
+   lodLevel_ = -1;
+   if (ShowCachedCandles(product.toStdString(), interval)) {
+      return;
+   }
    OhlcRequest ohlcRequest;
    ohlcRequest.set_product(product.toStdString());
    ohlcRequest.set_interval(static_cast<Interval>(interval));
    ohlcRequest.set_count(requestLimit);
    ohlcRequest.set_lesser_then(-1);
 
+   pendingOhlcRequests_.push_back({ dataGeneration_, false, 0 });
+
    MarketDataHistoryRequest request;
    request.set_request_type(MarketDataHistoryMessageType::OhlcHistoryType);
    request.set_request(ohlcRequest.SerializeAsString());
    mdhsClient_->SendRequest(request);
 }
 
+// Shows candles aggregated locally if the interval was already loaded from mdhs
+bool ChartWidget::ShowCachedCandles(const std::string& product, int interval)
+{
+   if (!candleAggregator_.isSeeded(product, interval)) {
+      return false;
+   }
+   const auto itFirstStamp = firstTimestampsInDb_.find({ product, interval });
+   if (itFirstStamp == firstTimestampsInDb_.end()) {
+      return false;
+   }
+   const auto candles = candleAggregator_.candles(product, interval);
+   if (candles.empty()) {
+      return false;
+   }
+
+   for (const auto& candle : candles) {
+      AddDataPoint(candle.open, candle.high, candle.low, candle.close, candle.timestamp, candle.volume);
+   }
+
+   const auto& newest = candles.back();
+   lastHigh_ = newest.high;
+   lastLow_ = newest.low;
+   lastClose_ = newest.close;
+
+   firstTimestampInDb_ = itFirstStamp->second;
+   UpdatePlot(interval, FillUpToCurrentCandle(interval, newest.timestamp));
+   return true;
+}
+
 void ChartWidget::OnDataReceived(const std::string& data)
 {
    if (data.empty()) {
@@ -360,95 +396,67 @@ void ChartWidget::ProcessProductsListResponse(const std::string& data)
 
 void ChartWidget::ProcessOhlcHistoryResponse(const std::string& data)
 {
-   if (data.empty()) {
-      logger_->error("Empty data received from mdhs.");
+   // mdhs replies in request order
+   if (pendingOhlcRequests_.empty()) {
       return;
    }
+   const auto generation = pendingOhlcRequests_.front().generation;
+   pendingOhlcRequests_.pop_front();
+   if (generation != dataGeneration_) {
+      return;  // requested before chart was reloaded
+   }
+   const quint64 loadedFrom = candles_->isEmpty() ? 0 : candles_->constBegin()->key * 1000;
+   ohlcProcessor_->process(data, loadedFrom, [this, generation](const OhlcHistoryProcessor::Result& result)
+   {
+      if (generation != dataGeneration_) {
+         return;  // chart was reloaded meanwhile
+      }
+      ApplyOhlcHistory(result);
+   });
+}
 
-   OhlcResponse response;
-   if (!response.ParseFromString(data)) {
-      logger_->error("can't parse response from mdhs: {}", data);
+void ChartWidget::ApplyOhlcHistory(const OhlcHistoryProcessor::Result& result)
+{
+   if (!result.valid) {
       return;
    }
 
-   bool firstPortion = candlesticksChart_->data()->size() == 0;
-
    auto product = getCurrentProductName();
    auto interval = dateRange_.checkedId();
 
-   if (product != QString::fromStdString(response.product()) || interval != response.interval())
+   if (product != QString::fromStdString(result.product) || interval != result.interval)
       return;
 
-   quint64 maxTimestamp = 0;
+   candleAggregator_.addHistory(result.product, interval, result.history);
 
-   for (int i = 0; i < response.candles_size(); i++) {
-      auto candle = response.candles(i);
-      maxTimestamp = qMax(maxTimestamp, static_cast<quint64>(candle.timestamp()));
-
-      bool isLast = (i == 0);
-      if (candle.timestamp() >= lastCandle_.timestamp() 
-         || lastCandle_.timestamp() - candle.timestamp() < IntervalWidth( interval, 1, QDateTime::fromMSecsSinceEpoch(candle.timestamp(), Qt::TimeSpec::UTC))) {
-         if (lastCandle_.timestamp() != 0) {
-            logger_->error("Invalid distance between candles from mdhs. The last timestamp: {}  new timestamp: {}",
-                           lastCandle_.timestamp(), candle.timestamp());
-         }
-      }
-      else {
-         if (lastCandle_.timestamp() - candle.timestamp() != IntervalWidth(
-            interval, 1, QDateTime::fromMSecsSinceEpoch(candle.timestamp(), Qt::TimeSpec::UTC)) && candlesticksChart_->data()->size()) {
-            for (int j = 0; j < (lastCandle_.timestamp() - candle.timestamp()) / IntervalWidth(
-                    interval, 1, QDateTime::fromMSecsSinceEpoch(candle.timestamp(), Qt::TimeSpec::UTC)) - 1; j++) {
-               AddDataPoint(candle.close(), candle.close(), candle.close(), candle.close(),
-                            lastCandle_.timestamp() - IntervalWidth(interval) * (j + 1), 0);
-            }
-         }
-      }
-
-      lastCandle_ = candle;
-
-      AddDataPoint(candle.open(), candle.high(), candle.low(), candle.close(), candle.timestamp(), candle.volume());
-#if 0
-      qDebug("Added: %s, open: %f, high: %f, low: %f, close: %f, volume: %f"
-             , QDateTime::fromMSecsSinceEpoch(candle.timestamp(), Qt::TimeSpec::UTC)
-               .toUTC().toString(Qt::ISODateWithMs).toStdString().c_str()
-             , candle.open()
-             , candle.high()
-             , candle.low()
-             , candle.close()
-             , candle.volume());
-#endif
-      if (firstPortion && isLast) {
-         lastHigh_ = candle.high();
-         lastLow_ = candle.low();
-         lastClose_ = candle.close();
-      }
+   const bool firstPortion = candles_->isEmpty();
+   if (firstPortion) {
+      candles_ = result.candles;
+      volumes_ = result.volumes;
+      lodLevel_ = -1;   // plottables still refer to previous containers
+   }
+   else {
+      // older candles, could overlap if several requests were in flight
+      result.candles->removeAfter(candles_->constBegin()->key - 0.5);
+      result.volumes->removeAfter(volumes_->constBegin()->key - 0.5);
+      candles_->add(*result.candles);
+      volumes_->add(*result.volumes);
    }
+   rangeTreesDirty_ = true;
+   lodDirty_ = true;
 
    if (firstPortion) {
-      if (!qFuzzyIsNull(currentTimestamp_)) {
-         newestCandleTimestamp_ = GetCandleTimestamp(currentTimestamp_, static_cast<Interval>(interval));
-      }
-      else {
-         logger_->warn("Data from mdhs came before MD update, or MD send wrong current timestamp");
-         newestCandleTimestamp_ = GetCandleTimestamp(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch(),
-                                                     static_cast<Interval>(interval));
-      }
-      if (!response.candles_size()) {
-         AddDataPoint(0, 0, 0, 0, newestCandleTimestamp_, 0);
-         maxTimestamp = newestCandleTimestamp_;
-      }
-      else {
-         if (newestCandleTimestamp_ > maxTimestamp) {
-            auto lastCandle = *(candlesticksChart_->data()->at(candlesticksChart_->data()->size() - 1));
-            for (quint64 i = 0; i < (newestCandleTimestamp_ - maxTimestamp) / IntervalWidth(interval); i++) {
-               AddDataPoint(lastCandle.close, lastCandle.close, lastCandle.close, lastCandle.close,
-                            newestCandleTimestamp_ - IntervalWidth(interval) * i, 0);
-            }
-            maxTimestamp = newestCandleTimestamp_;
-         }
+      quint64 maxTimestamp = 0;
+      if (!result.history.empty()) {
+         const auto& newest = result.history.back();
+         lastHigh_ = newest.high;
+         lastLow_ = newest.low;
+         lastClose_ = newest.close;
+         maxTimestamp = newest.timestamp;
       }
-      firstTimestampInDb_ = response.first_stamp_in_db() / 1000;
-      UpdatePlot(interval, maxTimestamp);
+      firstTimestampInDb_ = result.firstStampInDb / 1000;
+      firstTimestampsInDb_[{ result.product, interval }] = firstTimestampInDb_;
+      UpdatePlot(interval, FillUpToCurrentCandle(interval, maxTimestamp));
    }
    else {
       LoadAdditionalPoints(volumeAxisRect_->axis(QCPAxis::atBottom)->range());
@@ -457,6 +465,32 @@ void ChartWidget::ProcessOhlcHistoryResponse(const std::string& data)
    }
 }
 
+// Adds empty candles after the last loaded one up to the current time
+quint64 ChartWidget::FillUpToCurrentCandle(int interval, quint64 maxTimestamp)
+{
+   if (!qFuzzyIsNull(currentTimestamp_)) {
+      newestCandleTimestamp_ = GetCandleTimestamp(currentTimestamp_, static_cast<Interval>(interval));
+   }
+   else {
+      logger_->warn("Data from mdhs came before MD update, or MD send wrong current timestamp");
+      newestCandleTimestamp_ = GetCandleTimestamp(QDateTime::currentDateTimeUtc().toMSecsSinceEpoch(),
+                                                  static_cast<Interval>(interval));
+   }
+   if (candles_->isEmpty()) {
+      AddDataPoint(0, 0, 0, 0, newestCandleTimestamp_, 0);
+      return newestCandleTimestamp_;
+   }
+   if (newestCandleTimestamp_ > maxTimestamp) {
+      auto lastCandle = *(candles_->at(candles_->size() - 1));
+      for (quint64 i = 0; i < (newestCandleTimestamp_ - maxTimestamp) / IntervalWidth(interval); i++) {
+         AddDataPoint(lastCandle.close, lastCandle.close, lastCandle.close, lastCandle.close,
+                      newestCandleTimestamp_ - IntervalWidth(interval) * i, 0);
+      }
+      return newestCandleTimestamp_;
+   }
+   return maxTimestamp;
+}
+
 void ChartWidget::ProcessEodResponse(const std::string& data)
 {
    eodRequestSent_ = false;
@@ -465,13 +499,14 @@ void ChartWidget::ProcessEodResponse(const std::string& data)
    if (getCurrentProductName().toStdString() != eodPrice.product()) {
       return;
    }
-   if (candlesticksChart_->data()->size() < 2) {
+   if (candles_->size() < 2) {
       return;
    }
    auto delta = dateRange_.checkedId() >= Interval::TwentyFourHours ? 2 : 1; //should we update last or pre-last candle
-   auto lastCandle = candlesticksChart_->data()->end() - delta;
+   auto lastCandle = candles_->end() - delta;
    lastCandle->high = qMax(lastCandle->high, eodPrice.price());
    lastCandle->low = qMin(lastCandle->low, eodPrice.price());
+   OnDataPointUpdated(candles_->size() - delta);
    if (!qFuzzyCompare(lastCandle->close, eodPrice.price())) {
       lastCandle->close = eodPrice.price();
       UpdateOHLCInfo(IntervalWidth(dateRange_.checkedId()) / 1000,
@@ -489,11 +524,11 @@ double ChartWidget::CountOffsetFromRightBorder()
 
 void ChartWidget::CheckToAddNewCandle(qint64 stamp)
 {
-   if (stamp <= newestCandleTimestamp_ + IntervalWidth(dateRange_.checkedId()) || !volumeChart_->data()->size()) {
+   if (stamp <= newestCandleTimestamp_ + IntervalWidth(dateRange_.checkedId()) || !volumes_->size()) {
       return;
    }
    auto candleStamp = GetCandleTimestamp(stamp, static_cast<Interval>(dateRange_.checkedId()));
-   auto lastCandle = *(candlesticksChart_->data()->at(candlesticksChart_->data()->size() - 1));
+   auto lastCandle = *(candles_->at(candles_->size() - 1));
    for (quint64 i = 0; i < (candleStamp - newestCandleTimestamp_) / IntervalWidth(dateRange_.checkedId()); i++) {
       AddDataPoint(lastCandle.close, lastCandle.close, lastCandle.close, lastCandle.close,
                    candleStamp - IntervalWidth(dateRange_.checkedId()) * i, 0);
@@ -526,7 +561,7 @@ void ChartWidget::DrawCrossfire(QMouseEvent* event)
 
 void ChartWidget::UpdatePrintFlag()
 {
-   if (candlesticksChart_->data()->isEmpty()) {
+   if (candles_->isEmpty()) {
       lastPrintFlag_->setVisible(false);
       return;
    }
@@ -558,28 +593,45 @@ void ChartWidget::UpdatePlot(const int& interval, const qint64& timestamp)
    UpdatePrintFlag();
 }
 
-bool ChartWidget::needLoadNewData(const QCPRange& range, const QSharedPointer<QCPFinancialDataContainer> data) const
-{
-   return data->size() &&
-      (range.lower - data->constBegin()->key < IntervalWidth(dateRange_.checkedId()) / 1000 * loadDistance)
-      && firstTimestampInDb_ + IntervalWidth(OneHour) < data->constBegin()->key;
-}
-
+// Requests older candles in advance while loaded (or requested) history doesn't
+// cover lookahead to the left of the visible range
 void ChartWidget::LoadAdditionalPoints(const QCPRange& range)
 {
-   const auto data = candlesticksChart_->data();
-   if (needLoadNewData(range, data)) {
-      if (qFuzzyCompare(prevRequestStamp, data->constBegin()->key)) {
+   if (candles_->isEmpty()) {
+      return;
+   }
+   const double width = IntervalWidth(dateRange_.checkedId()) / 1000;
+   const double wantedFrom = range.lower - width * prefetchLookahead;
+
+   size_t inFlight = 0;
+   double frontier = candles_->constBegin()->key;
+   for (const auto &pending : pendingOhlcRequests_) {
+      if (pending.scrollBack && (pending.generation == dataGeneration_)) {
+         ++inFlight;
+         frontier = qMin(frontier, pending.oldestKey);
+      }
+   }
+
+   for (; inFlight < maxPendingOhlcRequests; ++inFlight) {
+      if (frontier <= wantedFrom || frontier <= firstTimestampInDb_) {
          return;
       }
+      const auto lesserThan = static_cast<qint64>(frontier * 1000);
+      if (!requestedOhlcStamps_.insert(lesserThan).second) {
+         return;  // already requested (or there is nothing older)
+      }
+
       OhlcRequest ohlcRequest;
       auto product = getCurrentProductName();
       ohlcRequest.set_product(product.toStdString());
       ohlcRequest.set_interval(static_cast<Interval>(dateRange_.checkedId()));
       ohlcRequest.set_count(requestLimit);
-      ohlcRequest.set_lesser_then(data->constBegin()->key * 1000);
+      ohlcRequest.set_lesser_then(lesserThan);
 
-      prevRequestStamp = data->constBegin()->key;
+      // response covers at least requestLimit intervals, next request could overlap it
+      // but never leaves a hole (overlapping candles are dropped on merge)
+      frontier -= width * requestLimit;
+      pendingOhlcRequests_.push_back({ dataGeneration_, true, frontier });
 
       MarketDataHistoryRequest request;
       request.set_request_type(MarketDataHistoryMessageType::OhlcHistoryType);
@@ -626,14 +678,161 @@ void ChartWidget::AddChildItem(QStandardItemModel* model, const QString& text)
 }
 
 void ChartWidget::AddDataPoint(const qreal& open, const qreal& high, const qreal& low, const qreal& close,
-                               const qreal& timestamp, const qreal& volume) const
+                               const qreal& timestamp, const qreal& volume)
+{
+   const double key = timestamp / 1000;
+   const bool isLast = candles_->isEmpty() || ((candles_->constEnd() - 1)->key < key);
+   candles_->add(QCPFinancialData(key, open, high, low, close));
+   volumes_->add(QCPBarsData(key, volume));
+   // points could be inserted in the middle (scroll-back), so indexes are rebuilt on next rescale
+   rangeTreesDirty_ = true;
+   if (isLast) {
+      UpdateLodCandle(candles_->size() - 1);
+   }
+   else {
+      lodDirty_ = true;
+   }
+}
+
+void ChartWidget::ClearDataPoints()
+{
+   candles_->clear();
+   volumes_->clear();
+   rangeTreesDirty_ = true;
+   lodDirty_ = true;
+   // requests in flight are kept to match replies, which are dropped by generation
+   ++dataGeneration_;
+   requestedOhlcStamps_.clear();
+}
+
+// Should be called after data point was modified in place
+void ChartWidget::OnDataPointUpdated(int index)
+{
+   if (index >= 0 && index < candles_->size()) {
+      UpdateLodCandle(index);
+   }
+   if (rangeTreesDirty_ || index < 0) {
+      return;
+   }
+   if (index < candles_->size()) {
+      const auto candle = candles_->at(index);
+      candleRanges_.update(index, { candle->low, candle->high });
+   }
+   if (index < volumes_->size()) {
+      const auto value = volumes_->at(index)->value;
+      volumeRanges_.update(index, { value, value });
+   }
+}
+
+// Picks candles level of detail for current zoom, called before every replot
+void ChartWidget::UpdateLodLevel()
+{
+   if (!candlesticksChart_ || !volumeChart_) {
+      return;
+   }
+   const double baseWidth = IntervalWidth(dateRange_.checkedId()) / 1000;
+   const auto keyRange = ui_->customPlot->xAxis->range();
+   if (candles_->isEmpty() || keyRange.size() <= 0 || baseWidth <= 0) {
+      SetLodLevel(0);
+      return;
+   }
+   if (lodDirty_) {
+      std::vector<bs::CandleLodPyramid::Candle> candles;
+      candles.reserve(candles_->size());
+      auto itVolume = volumes_->constBegin();
+      for (const auto& candle : *candles_) {
+         const double volume = (itVolume != volumes_->constEnd()) ? (itVolume++)->value : 0;
+         candles.push_back({ candle.key, candle.open, candle.high, candle.low, candle.close, volume });
+      }
+      lodPyramid_.build(std::move(candles), baseWidth);
+      lodDirty_ = false;
+      lodLevel_ = -1;
+   }
+   const double pixelsPerCandle = ui_->customPlot->axisRect()->width() * baseWidth / keyRange.size();
+   SetLodLevel(static_cast<int>(lodPyramid_.levelFor(pixelsPerCandle, lodMinCandlePixels)));
+}
+
+// Updates merged candles containing the candle instead of rebuilding all levels
+void ChartWidget::UpdateLodCandle(int index)
 {
-   if (candlesticksChart_) {
-      candlesticksChart_->data()->add(QCPFinancialData(timestamp / 1000, open, high, low, close));
+   if (lodDirty_) {
+      return;
+   }
+   const auto candle = candles_->at(index);
+   const double volume = (index < volumes_->size()) ? volumes_->at(index)->value : 0;
+   if (!lodPyramid_.update({ candle->key, candle->open, candle->high, candle->low, candle->close, volume })) {
+      lodDirty_ = true;
+      return;
+   }
+   if (lodLevel_ <= 0 || !lodCandles_ || !lodVolumes_) {
+      return;   // level 0 shows candles_ directly
+   }
+   const auto merged = lodPyramid_.bucket(lodLevel_, candle->key);
+   if (!merged) {
+      lodLevel_ = -1;
+      return;
+   }
+   const double width = lodPyramid_.width(lodLevel_);
+   const double bucketStart = std::floor(candle->key / width) * width;
+   lodCandles_->remove(bucketStart, bucketStart + width);
+   lodVolumes_->remove(bucketStart, bucketStart + width);
+   lodCandles_->add(QCPFinancialData(merged->key, merged->open, merged->high, merged->low, merged->close));
+   lodVolumes_->add(QCPBarsData(merged->key, merged->volume));
+}
+
+void ChartWidget::SetLodLevel(int level)
+{
+   if (level == lodLevel_) {
+      return;
+   }
+   lodLevel_ = level;
+   const double baseWidth = IntervalWidth(dateRange_.checkedId()) / 1000;
+   if (level == 0) {
+      // exact candles are shown as is
+      candlesticksChart_->setData(candles_);
+      volumeChart_->setData(volumes_);
+      candlesticksChart_->setWidth(0.8 * baseWidth);
+      volumeChart_->setWidth(0.8 * baseWidth);
+      return;
+   }
+
+   QVector<QCPFinancialData> candles;
+   QVector<QCPBarsData> volumes;
+   const auto& merged = lodPyramid_.level(level);
+   candles.reserve(merged.size());
+   volumes.reserve(merged.size());
+   for (const auto& candle : merged) {
+      candles.push_back(QCPFinancialData(candle.key, candle.open, candle.high, candle.low, candle.close));
+      volumes.push_back(QCPBarsData(candle.key, candle.volume));
+   }
+   lodCandles_ = QSharedPointer<QCPFinancialDataContainer>::create();
+   lodCandles_->add(candles, true);
+   lodVolumes_ = QSharedPointer<QCPBarsDataContainer>::create();
+   lodVolumes_->add(volumes, true);
+   candlesticksChart_->setData(lodCandles_);
+   volumeChart_->setData(lodVolumes_);
+   candlesticksChart_->setWidth(0.8 * lodPyramid_.width(level));
+   volumeChart_->setWidth(0.8 * lodPyramid_.width(level));
+}
+
+void ChartWidget::RebuildRangeTrees()
+{
+   if (!rangeTreesDirty_) {
+      return;
+   }
+   std::vector<bs::MinMaxSegmentTree::Range> ranges;
+   ranges.reserve(candles_->size());
+   for (const auto& candle : *candles_) {
+      ranges.push_back({ candle.low, candle.high });
    }
-   if (volumeChart_) {
-      volumeChart_->data()->add(QCPBarsData(timestamp / 1000, volume));
+   candleRanges_.assign(ranges);
+
+   ranges.clear();
+   for (const auto& volume : *volumes_) {
+      ranges.push_back({ volume.value, volume.value });
    }
+   volumeRanges_.assign(ranges);
+   rangeTreesDirty_ = false;
 }
 
 quint64 ChartWidget::IntervalWidth(int interval, int count, const QDateTime& specialDate) const
@@ -716,8 +915,8 @@ QString ChartWidget::GetFormattedStamp(double timestamp)
 
 void ChartWidget::UpdateOHLCInfo(double width, double timestamp)
 {
-   auto ohlcValue = *candlesticksChart_->data()->findBegin(timestamp + width / 2);
-   auto volumeValue = *volumeChart_->data()->findBegin(timestamp + width / 2);
+   auto ohlcValue = *candles_->findBegin(timestamp + width / 2);
+   auto volumeValue = *volumes_->findBegin(timestamp + width / 2);
    //ohlcValue.close >= ohlcValue.open ? c_greenColor : c_redColor
    const auto& color = VOLUME_COLOR.name();
    auto prec = FractionSizeForProduct(productTypesMapper[getCurrentProductName().toStdString()]);
@@ -746,9 +945,9 @@ void ChartWidget::OnPlotMouseMove(QMouseEvent* event)
    double x = event->localPos().x();
    double width = IntervalWidth(dateRange_.checkedId()) / 1000;
    double timestamp = ui_->customPlot->xAxis->pixelToCoord(x);
-   if (!candlesticksChart_->data()->size() ||
-      timestamp > candlesticksChart_->data()->at(candlesticksChart_->data()->size() - 1)->key + width / 2 ||
-      timestamp < candlesticksChart_->data()->at(0)->key - width / 2) {
+   if (!candles_->size() ||
+      timestamp > candles_->at(candles_->size() - 1)->key + width / 2 ||
+      timestamp < candles_->at(0)->key - width / 2) {
       ui_->ohlcLbl->setText({});
    }
    else {
@@ -779,7 +978,7 @@ void ChartWidget::OnPlotMouseMove(QMouseEvent* event)
       lastDragCoord_.setX(currentXPos);
       double tempCoeff = 10.0; //change this to impact on xAxis scale speed, the lower coeff the faster scaling
       lower_bound += diff / tempCoeff * /*scalingCoeff * */ directionCoeff;
-      auto lower_limit = candlesticksChart_->data()->constBegin()->key - (upper_bound - lower_bound) * 0.2;
+      auto lower_limit = candles_->constBegin()->key - (upper_bound - lower_bound) * 0.2;
       if (lower_bound < lower_limit && directionCoeff == -1) {
          return;
       }
@@ -790,8 +989,8 @@ void ChartWidget::OnPlotMouseMove(QMouseEvent* event)
       const double startPixel = dragStartPos_.x();
       const double currentPixel = event->pos().x();
       const double diff = axis->pixelToCoord(startPixel) - axis->pixelToCoord(currentPixel);
-      auto size = candlesticksChart_->data()->size();
-      double upper_bound = size ? candlesticksChart_->data()->at(size - 1)->key : QDateTime::currentSecsSinceEpoch();
+      auto size = candles_->size();
+      double upper_bound = size ? candles_->at(size - 1)->key : QDateTime::currentSecsSinceEpoch();
       upper_bound += IntervalWidth(dateRange_.checkedId()) / 1000 / 2 + CountOffsetFromRightBorder();
       double lower_bound = QDateTime(QDate(2009, 1, 3)).toSecsSinceEpoch();
       if (dragStartRangeX_.upper + diff > upper_bound && diff > 0) {
@@ -830,7 +1029,15 @@ void ChartWidget::rescaleCandlesYAxis()
    auto keyRange = candlesticksChart_->keyAxis()->range();
    keyRange.upper += IntervalWidth(dateRange_.checkedId()) / 1000 / 2;
    keyRange.lower -= IntervalWidth(dateRange_.checkedId()) / 1000 / 2;
-   auto newRange = candlesticksChart_->getValueRange(foundRange, QCP::sdBoth, keyRange);
+   RebuildRangeTrees();
+   const auto data = candles_;
+   bs::MinMaxSegmentTree::Range visible;
+   QCPRange newRange;
+   if (candleRanges_.query(data->findBegin(keyRange.lower, false) - data->constBegin()
+      , data->findEnd(keyRange.upper, false) - data->constBegin(), visible)) {
+      foundRange = true;
+      newRange = QCPRange(visible.min, visible.max);
+   }
    if (foundRange) {
       const double margin = 0.15;
       if (!QCPRange::validRange(newRange)) // likely due to range being zero
@@ -851,18 +1058,20 @@ void ChartWidget::rescaleCandlesYAxis()
    }
 }
 
-void ChartWidget::rescaleVolumesYAxis() const
+void ChartWidget::rescaleVolumesYAxis()
 {
-   if (!volumeChart_->data()->size()) {
+   const auto data = volumes_;
+   if (!data->size()) {
       return;
    }
    auto lower_bound = volumeAxisRect_->axis(QCPAxis::atBottom)->range().lower;
    auto upper_bound = volumeAxisRect_->axis(QCPAxis::atBottom)->range().upper;
-   double maxVolume = volumeChart_->data()->constBegin()->value;
-   for (const auto& it : *volumeChart_->data()) {
-      if (it.key >= lower_bound && it.key <= upper_bound) {
-         maxVolume = qMax(maxVolume, it.value);
-      }
+   double maxVolume = data->constBegin()->value;
+   RebuildRangeTrees();
+   bs::MinMaxSegmentTree::Range visible;
+   if (volumeRanges_.query(data->findBegin(lower_bound, false) - data->constBegin()
+      , data->findEnd(upper_bound, false) - data->constBegin(), visible)) {
+      maxVolume = qMax(maxVolume, visible.max);
    }
    if (!qFuzzyCompare(maxVolume, volumeAxisRect_->axis(QCPAxis::atBottom)->range().upper)) {
       volumeAxisRect_->axis(QCPAxis::atRight)->setRange(0, maxVolume);
@@ -927,7 +1136,7 @@ void ChartWidget::OnWheelScroll(QWheelEvent* event)
    double tempCoeff = 120.0 / qAbs(event->angleDelta().y()) * 10;
    //change this to impact on xAxis scale speed, the lower coeff the faster scaling
    lower_bound += diff / tempCoeff * directionCoeff;
-   auto lower_limit = candlesticksChart_->data()->constBegin()->key - (upper_bound - lower_bound) * 0.2 ;
+   auto lower_limit = candles_->constBegin()->key - (upper_bound - lower_bound) * 0.2 ;
    if (lower_bound < lower_limit && directionCoeff == -1) {
       return;
    }
@@ -946,8 +1155,8 @@ void ChartWidget::OnAutoScaleBtnClick()
 
 void ChartWidget::OnResetBtnClick()
 {
-   if (candlesticksChart_->data()->size()) {
-      auto new_upper = candlesticksChart_->data()->at(candlesticksChart_->data()->size() - 1)->key + IntervalWidth(
+   if (candles_->size()) {
+      auto new_upper = candles_->at(candles_->size() - 1)->key + IntervalWidth(
          dateRange_.checkedId()) / 1000 / 2;
       QCPRange defaultRange(new_upper - IntervalWidth(dateRange_.checkedId(), requestLimit) / 1000, new_upper);
       volumeAxisRect_->axis(QCPAxis::atBottom)->setRange(defaultRange);
@@ -969,61 +1178,7 @@ void ChartWidget::resizeEvent(QResizeEvent* event)
 
 quint64 ChartWidget::GetCandleTimestamp(const uint64_t& timestamp, const Interval& interval) const
 {
-   QDateTime now = QDateTime::fromMSecsSinceEpoch(timestamp).toUTC();
-   QDateTime result = now;
-   switch (interval) {
-   case Interval::OneYear:
-      {
-         result.setTime(QTime(0, 0));
-         result.setDate(QDate(now.date().year(), 1, 1));
-         break;
-      }
-   case Interval::SixMonths:
-      {
-         int month = now.date().month(); // 1 - January, 12 - December
-         int mod = month % 6;
-         result.setTime(QTime(0, 0));
-         result.setDate(QDate(now.date().year(), month - mod + 1, 1));
-         break;
-      }
-   case Interval::OneMonth:
-      {
-         result.setTime(QTime(0, 0));
-         result.setDate(QDate(now.date().year(), now.date().month(), 1));
-         break;
-      }
-   case Interval::OneWeek:
-      {
-         auto date = now.date();
-         auto start = date.addDays(1 - date.dayOfWeek()); //1 - Monday, 7 - Sunday
-         result.setTime(QTime(0, 0));
-         result.setDate(start);
-         break;
-      }
-   case Interval::TwentyFourHours:
-      result.setTime(QTime(0, 0));
-      break;
-   case Interval::TwelveHours:
-      {
-         int hour = now.time().hour();
-         int mod = hour % 12;
-         result.setTime(QTime(hour - mod, 0));
-         break;
-      }
-   case Interval::SixHours:
-      {
-         int hour = now.time().hour();
-         int mod = hour % 6;
-         result.setTime(QTime(hour - mod, 0));
-         break;
-      }
-   case Interval::OneHour:
-      result.setTime(QTime(now.time().hour(), 0));
-      break;
-   default:
-      break;
-   }
-   return result.toMSecsSinceEpoch();
+   return bs::CandleAggregator::candleStart(timestamp, interval);
 }
 
 bool ChartWidget::isBeyondUpperLimit(QCPRange newRange, int interval)
@@ -1135,6 +1290,7 @@ void ChartWidget::InitializeCustomPlot()
    candlesticksChart_->setBrushNegative(c_redColor);
    candlesticksChart_->setPenPositive(QPen(c_greenColor));
    candlesticksChart_->setPenNegative(QPen(c_redColor));
+   candlesticksChart_->setData(candles_);
 
    ui_->customPlot->axisRect()->axis(QCPAxis::atLeft)->setVisible(false);
    ui_->customPlot->axisRect()->axis(QCPAxis::atRight)->setVisible(true);
@@ -1163,6 +1319,7 @@ void ChartWidget::InitializeCustomPlot()
    volumeChart_ = new QCPBars(volumeAxisRect_->axis(QCPAxis::atBottom), volumeAxisRect_->axis(QCPAxis::atRight));
    volumeChart_->setPen(QPen(VOLUME_COLOR));
    volumeChart_->setBrush(VOLUME_COLOR);
+   volumeChart_->setData(volumes_);
 
    volumeAxisRect_->axis(QCPAxis::atLeft)->setVisible(false);
    volumeAxisRect_->axis(QCPAxis::atRight)->setVisible(true);
@@ -1225,6 +1382,7 @@ void ChartWidget::InitializeCustomPlot()
    connect(ui_->customPlot, &QCustomPlot::mousePress, this, &ChartWidget::OnMousePressed);
    connect(ui_->customPlot, &QCustomPlot::mouseRelease, this, &ChartWidget::OnMouseReleased);
    connect(ui_->customPlot, &QCustomPlot::mouseWheel, this, &ChartWidget::OnWheelScroll);
+   connect(ui_->customPlot, &QCustomPlot::beforeReplot, this, &ChartWidget::UpdateLodLevel);
    volumeAxisRect_->axis(QCPAxis::atRight)->setRange(0, 1000);
 }
 
@@ -1253,11 +1411,11 @@ void ChartWidget::OnMDDisconnecting()
    ui_->pushButtonMDConnection->setText(tr("Disconnecting"));
    ui_->pushButtonMDConnection->setEnabled(false);
 
-   if (candlesticksChart_ != nullptr)
-      candlesticksChart_->data()->clear();
+   ClearDataPoints();
 
-   if (volumeChart_ != nullptr)
-      volumeChart_->data()->clear();
+   // trades will be missed while disconnected
+   candleAggregator_.clear();
+   firstTimestampsInDb_.clear();
 
    ui_->ohlcLbl->setText({});
    ui_->customPlot->replot();
@@ -1284,17 +1442,20 @@ void ChartWidget::ChangeMDSubscriptionState()
 
 void ChartWidget::OnNewTrade(const std::string& productName, uint64_t timestamp, double price, double amount)
 {
+   candleAggregator_.addTrade(productName, timestamp, price, amount);
+
    if (productName != getCurrentProductName().toStdString() ||
-      !candlesticksChart_->data()->size() ||
-      !volumeChart_->data()->size()) {
+      !candles_->size() ||
+      !volumes_->size()) {
       return;
    }
 
-   auto lastVolume = volumeChart_->data()->end() - 1;
+   auto lastVolume = volumes_->end() - 1;
    lastVolume->value += amount;
-   auto lastCandle = candlesticksChart_->data()->end() - 1;
+   auto lastCandle = candles_->end() - 1;
    lastCandle->high = qMax(lastCandle->high, price);
    lastCandle->low = qMin(lastCandle->low, price);
+   OnDataPointUpdated(candles_->size() - 1);
    if (!qFuzzyCompare(lastCandle->close, price) || !qFuzzyIsNull(amount)) {
       isHigh_ = price > lastClose_;
       lastClose_ = price;
@@ -13,8 +13,14 @@
 
 #include <QWidget>
 #include <QButtonGroup>
+#include <deque>
+#include <set>
+#include "CandleAggregator.h"
+#include "CandleLodPyramid.h"
 #include "CommonTypes.h"
 #include "CustomControls/qcustomplot.h"
+#include "MinMaxSegmentTree.h"
+#include "OhlcHistoryProcessor.h"
 #include "market_data_history.pb.h"
 
 QT_BEGIN_NAMESPACE
@@ -73,7 +79,7 @@ protected slots:
    void OnPlotMouseMove(QMouseEvent* event);
    void leaveEvent(QEvent* event) override;
    void rescaleCandlesYAxis();
-   void rescaleVolumesYAxis() const;
+   void rescaleVolumesYAxis();
    void rescalePlot();
    void OnMousePressed(QMouseEvent* event);
    void OnMouseReleased(QMouseEvent* event);
@@ -102,13 +108,22 @@ protected slots:
 protected:
    quint64 GetCandleTimestamp(const uint64_t& timestamp,
       const Blocksettle::Communication::MarketDataHistory::Interval& interval) const;
-   void AddDataPoint(const qreal& open, const qreal& high, const qreal& low, const qreal& close, const qreal& timestamp, const qreal& volume) const;
+   void AddDataPoint(const qreal& open, const qreal& high, const qreal& low, const qreal& close, const qreal& timestamp, const qreal& volume);
+   void ClearDataPoints();
+   void OnDataPointUpdated(int index);
+   void RebuildRangeTrees();
+   void UpdateLodLevel();
+   void SetLodLevel(int level);
+   void UpdateLodCandle(int index);
    void UpdateChart(const int& interval);
+   bool ShowCachedCandles(const std::string& product, int interval);
+   quint64 FillUpToCurrentCandle(int interval, quint64 maxTimestamp);
    void InitializeCustomPlot();
    quint64 IntervalWidth(int interval = -1, int count = 1, const QDateTime& specialDate = {}) const;
    static int FractionSizeForProduct(Blocksettle::Communication::TradeHistory::TradeHistoryTradeType type);
    void ProcessProductsListResponse(const std::string& data);
    void ProcessOhlcHistoryResponse(const std::string& data);
+   void ApplyOhlcHistory(const OhlcHistoryProcessor::Result& result);
    void ProcessEodResponse(const std::string& data);
    double CountOffsetFromRightBorder();
 
@@ -122,8 +137,6 @@ protected:
 
    void UpdatePlot(const int& interval, const qint64& timestamp);
 
-   bool needLoadNewData(const QCPRange& range, QSharedPointer<QCPFinancialDataContainer> data) const;
-
    void LoadAdditionalPoints(const QCPRange& range);
 
    void pickTicketDateFormat(const QCPRange& range) const;
@@ -136,6 +149,7 @@ private:
    std::shared_ptr<ApplicationSettings>			appSettings_;
    std::shared_ptr<MarketDataProvider>				mdProvider_;
    std::shared_ptr<MdhsClient>						mdhsClient_;
+   OhlcHistoryProcessor                         *ohlcProcessor_{ nullptr };
    std::shared_ptr<spdlog::logger>					logger_;
 
    bool                                         isProductListInitialized_{ false };
@@ -143,18 +157,17 @@ private:
 
    QSharedPointer<QCPAxisTickerDateTime> dateTimeTicker{ new QCPAxisTickerDateTime };
 
-   const int loadDistance{ 15 };
-
    bool eodUpdated_{ false };
    bool eodRequestSent_{ false };
 
    constexpr static int requestLimit{ 200 };
+   // scroll-back prefetch: candles to have loaded beyond the visible left edge
+   constexpr static int prefetchLookahead{ requestLimit };
+   constexpr static size_t maxPendingOhlcRequests{ 2 };
    constexpr static int candleViewLimit{ 150 };
    constexpr static qint64 candleCountOnScreenLimit{ 1500 };
-
-   Blocksettle::Communication::MarketDataHistory::OhlcCandle lastCandle_;
-
-   double prevRequestStamp{ 0.0 };
+   // candles narrower than this are merged for drawing
+   constexpr static double lodMinCandlePixels{ 3.0 };
 
    double zoomDiff_{ 0.0 };
 
@@ -163,6 +176,21 @@ private:
    QStandardItemModel *cboModel_;
    QCPFinancial *candlesticksChart_;
    QCPBars *volumeChart_;
+   // loaded candles, charts could show merged ones from lodPyramid_ instead
+   QSharedPointer<QCPFinancialDataContainer> candles_{ new QCPFinancialDataContainer };
+   QSharedPointer<QCPBarsDataContainer> volumes_{ new QCPBarsDataContainer };
+   // responses for cleared data are dropped
+   quint64 dataGeneration_{ 0 };
+
+   // scroll-back prefetch
+   struct PendingOhlcRequest
+   {
+      quint64  generation;    // dataGeneration_ when request was sent
+      bool     scrollBack;
+      double   oldestKey;     // predicted oldest key covered by scroll-back request
+   };
+   std::deque<PendingOhlcRequest> pendingOhlcRequests_;   // all OHLC requests in flight, in send order
+   std::set<qint64> requestedOhlcStamps_;
    QCPAxisRect *volumeAxisRect_;
 
    QCPItemText *   lastPrintFlag_{ nullptr };
@@ -199,6 +227,21 @@ private:
    bool authorized_{ false };
 
    std::set<std::string>   pmProducts_;
+
+   bs::CandleAggregator    candleAggregator_{ candleCountOnScreenLimit };
+   std::map<std::pair<std::string, int>, quint64>  firstTimestampsInDb_;
+
+   // low/high of candles and volumes by data index, for axes rescaling
+   bs::MinMaxSegmentTree   candleRanges_;
+   bs::MinMaxSegmentTree   volumeRanges_;
+   bool                    rangeTreesDirty_{ true };
+
+   bs::CandleLodPyramid    lodPyramid_;
+   bool                    lodDirty_{ true };
+   int                     lodLevel_{ -1 };
+   // merged candles shown for lodLevel_ > 0
+   QSharedPointer<QCPFinancialDataContainer> lodCandles_;
+   QSharedPointer<QCPBarsDataContainer>      lodVolumes_;
 };
 
 #endif // CHARTWIDGET_H
@@ -9,6 +9,7 @@
 
 */
 #include "CoinControlModel.h"
+#include <algorithm>
 #include <QColor>
 #include <QList>
 #include <QString>
@@ -21,6 +22,16 @@
 #include "Wallets/SyncWallet.h"
 
 
+// Input is kept as plain data until its address node is expanded
+struct CoinControlInput
+{
+   UTXO  utxo;
+   int   index;     // -1 for unconfirmed inputs
+   bool  selected;
+   bool  cpfp;
+   BTCNumericTypes::balance_type amount;
+};
+
 class TransactionNode;
 class CoinControlNode
 {
@@ -59,10 +70,18 @@ public:
    QString getComment() const { return comment_; }
    virtual int getUtxoCount() const { return 0; }
 
-   bool hasChildren() const { return !children_.empty(); }
-   size_t  nbChildren() const { return (size_t)children_.count(); }
+   bool hasChildren() const { return !children_.empty() || hasUnbuiltChildren(); }
+   size_t  nbChildren()
+   {
+      buildChildren();
+      return (size_t)children_.count();
+   }
    void appendChildNode(CoinControlNode* node) { children_.push_back(node); }
-   CoinControlNode* getChild(const int i) { return (i < children_.size() ? children_[i] : nullptr); }
+   CoinControlNode* getChild(const int i)
+   {
+      buildChildren();
+      return (i < children_.size() ? children_[i] : nullptr);
+   }
 
    CoinControlNode* getParent() const { return parent_; }
    virtual BTCNumericTypes::balance_type getSelectedAmount() const = 0;
@@ -104,6 +123,11 @@ public:
       return true;
    }
 
+protected:
+   // Child nodes could be created on first access
+   virtual void buildChildren() {}
+   virtual bool hasUnbuiltChildren() const { return false; }
+
 private:
    const Type                 type_;
    QString                    name_;
@@ -116,15 +140,13 @@ private:
 class TransactionNode : public CoinControlNode
 {
 public:
-   TransactionNode(bool isSelected, int transactionIndex, const UTXO& transaction, const std::shared_ptr<bs::sync::Wallet> &wallet
-      , CoinControlNode *parent)
-      : CoinControlNode(CoinControlNode::Type::DoesNotMatter, QString::fromStdString(transaction.getTxHash().toHexStr(true))
+   TransactionNode(const CoinControlInput &input, CoinControlNode *parent)
+      : CoinControlNode(CoinControlNode::Type::DoesNotMatter, QString::fromStdString(input.utxo.getTxHash().toHexStr(true))
          , QString(), parent->nbChildren(), parent)
-      , checkedState_(isSelected ? Qt::Checked : Qt::Unchecked)
-      , transactionIndex_(transactionIndex)
-   {
-      amount_ = wallet ? wallet->getTxBalance(transaction.getValue()) : transaction.getValue() / BTCNumericTypes::BalanceDivider;
-   }
+      , amount_(input.amount)
+      , checkedState_(input.selected ? Qt::Checked : Qt::Unchecked)
+      , transactionIndex_(input.index)
+   {}
 
    bool isEnabled() const override
    {
@@ -181,9 +203,8 @@ protected:
 class CPFPTransactionNode : public TransactionNode
 {
 public:
-   CPFPTransactionNode(bool isSelected, int transactionIndex, const UTXO& transaction, const std::shared_ptr<bs::sync::Wallet> &wallet
-      , CoinControlNode *parent)
-      : TransactionNode(isSelected, transactionIndex, transaction, wallet, parent) {}
+   CPFPTransactionNode(const CoinControlInput &input, CoinControlNode *parent)
+      : TransactionNode(input, parent) {}
 
    void ApplySelection(const std::shared_ptr<SelectedTransactionInputs>& selectedInputs) override
    {
@@ -200,13 +221,13 @@ public:
    {}
    ~AddressNode() noexcept override = default;
 
-   void addTransaction(TransactionNode *transaction)
+   // TransactionNode is created when children are requested for the first time
+   void addInput(const CoinControlInput &input)
    {
-      appendChildNode(transaction);
+      inputs_.push_back(input);
       notifyChildAdded();
-      if (transaction->isEnabled()) {
-         addBalance(transaction->getSelectionCount(), transaction->getTotalAmount()
-            , transaction->getTotalAmount());
+      if (isInputEnabled(input)) {
+         addBalance(input.selected, input.amount, input.amount);
       }
       incrementUtxoCount();
    }
@@ -248,6 +269,34 @@ public:
    void setCheckedState(int state) override
    {
       UpdateChildsState(state);
+
+      const bool selected = (state == Qt::Checked);
+      int selectedDiff = 0;
+      BTCNumericTypes::balance_type amountDiff = 0;
+      for (auto &input : inputs_) {
+         if (!isInputEnabled(input) || (input.selected == selected)) {
+            continue;
+         }
+         input.selected = selected;
+         selectedDiff += selected ? 1 : -1;
+         amountDiff += selected ? input.amount : -input.amount;
+      }
+      if (selectedDiff) {
+         updateParentWithSelectionInfo(selectedDiff, amountDiff, 0);
+      }
+   }
+
+   void ApplySelection(const std::shared_ptr<SelectedTransactionInputs>& selectedInputs) override
+   {
+      CoinControlNode::ApplySelection(selectedInputs);
+      for (const auto &input : inputs_) {
+         if (input.cpfp) {
+            selectedInputs->SetCPFPTransactionSelection(input.index, input.selected);
+         }
+         else if (input.index >= 0) {
+            selectedInputs->SetTransactionSelection(input.index, input.selected);
+         }
+      }
    }
 
    int getUtxoCount() const override
@@ -256,6 +305,24 @@ public:
    }
 
 protected:
+   void buildChildren() override
+   {
+      if (inputs_.empty()) {
+         return;
+      }
+      // Node constructor asks for row (and so for children) again
+      std::vector<CoinControlInput> inputs;
+      inputs.swap(inputs_);
+      for (const auto &input : inputs) {
+         appendChildNode(input.cpfp ? new CPFPTransactionNode(input, this) : new TransactionNode(input, this));
+      }
+   }
+
+   bool hasUnbuiltChildren() const override
+   {
+      return !inputs_.empty();
+   }
+
    void updateParentWithSelectionInfo(int totalSelectedDiff, BTCNumericTypes::balance_type selectedAmountDiff
       , BTCNumericTypes::balance_type totalAmountDiff) override
    {
@@ -271,6 +338,11 @@ protected:
    }
 
 private:
+   static bool isInputEnabled(const CoinControlInput &input)
+   {
+      return (input.index >= 0);
+   }
+
    void addBalance(bool selected, BTCNumericTypes::balance_type amount, BTCNumericTypes::balance_type totalInc, int countInc = 1)
    {
       const auto oldTotalSelected = totalSelected_;
@@ -312,6 +384,7 @@ private:
    int totalChildren_ = 0;
    int checkedState_ = Qt::Unchecked;
    int utxoCount_;
+   std::vector<CoinControlInput> inputs_;
 };
 
 
@@ -533,82 +606,91 @@ static int addressWeight(const bs::Address &addr)
 
 void CoinControlModel::loadInputs(const std::shared_ptr<SelectedTransactionInputs>& selectedInputs)
 {
+   const auto wallet = selectedInputs->GetWallet();
+   const auto amount = [&wallet](const UTXO &utxo) -> BTCNumericTypes::balance_type {
+      return wallet ? wallet->getTxBalance(utxo.getValue()) : utxo.getValue() / BTCNumericTypes::BalanceDivider;
+   };
+   const auto comment = [&wallet](const UTXO &utxo) {
+      return wallet ? QString::fromStdString(wallet->getAddressComment(bs::Address::fromHash(utxo.getRecipientScrAddr())))
+         : QString();
+   };
+
+   // Address is decoded once per input, not on every comparison
    struct InputKey {
-      UTXO  utxo;
-      int   index;
+      CoinControlInput  input;
+      bs::Address       address;
+      std::string       addrStr;
+      int               weight;
 
       bool operator<(const InputKey &other) const
       {
-         const auto aw1 = addressWeight(bs::Address::fromUTXO(utxo));
-         const auto aw2 = addressWeight(bs::Address::fromUTXO(other.utxo));
-         if (aw1 != aw2) {
-            return aw1 < aw2;
+         if (weight != other.weight) {
+            return weight < other.weight;
          }
-         if (index != other.index) {
-            return (index < other.index);
+         if (input.index != other.input.index) {
+            return (input.index < other.input.index);
          }
-         return (utxo < other.utxo);
+         return (input.utxo < other.input.utxo);
       }
    };
-   struct UtxoState {
-      bool selected;
-      bool enabled;
+   const auto makeKey = [&amount](const UTXO &utxo, int index, bool selected, bool cpfp) {
+      InputKey key{ { utxo, index, selected, cpfp, amount(utxo) }, bs::Address::fromUTXO(utxo), {}, 0 };
+      key.addrStr = key.address.display();
+      key.weight = addressWeight(key.address);
+      return key;
    };
-   std::map<InputKey, UtxoState> inputs;
+
+   const auto incompleteUtxos = selectedInputs->getIncompleteUTXOs();
+   std::vector<InputKey> inputs;
+   inputs.reserve(selectedInputs->GetTransactionsCount() + incompleteUtxos.size());
    for (int i = 0; i < selectedInputs->GetTransactionsCount(); ++i) {
-      inputs[{selectedInputs->GetTransaction(i), i}] = {
-         selectedInputs->IsTransactionSelected(i), true };
+      inputs.push_back(makeKey(selectedInputs->GetTransaction(i), i, selectedInputs->IsTransactionSelected(i), false));
    }
-
-   for (const auto &utxo : selectedInputs->getIncompleteUTXOs()) {
-      inputs[{utxo, -1}] = { false, false };
+   for (const auto &utxo : incompleteUtxos) {
+      inputs.push_back(makeKey(utxo, -1, false, false));
    }
+   std::sort(inputs.begin(), inputs.end());
+   inputs.erase(std::unique(inputs.begin(), inputs.end(), [](const InputKey &a, const InputKey &b) {
+      return !(a < b) && !(b < a);
+   }), inputs.end());
 
    for (const auto &input : inputs) {
-      const auto address = bs::Address::fromUTXO(input.first.utxo);
-      const auto addrStr = address.display();
-
-      auto addressIt = addressNodes_.find(addrStr);
+      auto addressIt = addressNodes_.find(input.addrStr);
       AddressNode *addressNode = nullptr;
 
       if (addressIt == addressNodes_.end()) {
-         auto wallet = selectedInputs->GetWallet();
-         auto comment = wallet ? wallet->getAddressComment(bs::Address::fromHash(input.first.utxo.getRecipientScrAddr())) : "";
-         addressNode = new AddressNode(CoinControlNode::detectType(address), QString::fromStdString(address.display())
-            , QString::fromStdString(comment), (int)addressNodes_.size(), root_.get());
+         addressNode = new AddressNode(CoinControlNode::detectType(input.address), QString::fromStdString(input.addrStr)
+            , comment(input.input.utxo), (int)addressNodes_.size(), root_.get());
          root_->appendChildNode(addressNode);
-         addressNodes_.emplace(addrStr, addressNode);
+         addressNodes_.emplace(input.addrStr, addressNode);
       } else {
          addressNode = static_cast<AddressNode*>(addressIt->second);
       }
-      addressNode->addTransaction(new TransactionNode(input.second.selected
-         , input.first.index, input.first.utxo, selectedInputs->GetWallet(), addressNode));    //TODO: Add TX comment
+      addressNode->addInput(input.input);    //TODO: Add TX comment
    }
 
    const auto cpfpList = selectedInputs->GetCPFPInputs();
    if (!cpfpList.empty()) {
-      cpfp_ = std::make_shared<AddressNode>(CoinControlNode::Type::CpfpRoot, tr("CPFP Eligible Outputs"), tr("Child-Pays-For-Parent transactions")
+      auto cpfpNode = new AddressNode(CoinControlNode::Type::CpfpRoot, tr("CPFP Eligible Outputs"), tr("Child-Pays-For-Parent transactions")
          , addressNodes_.size(), root_.get());
-      root_->appendChildNode(cpfp_.get());
+      root_->appendChildNode(cpfpNode);
       for (size_t i = 0; i < cpfpList.size(); i++) {
-         const auto &input = cpfpList[i];
-         const auto address = bs::Address::fromUTXO(input);
-         const auto addrStr = address.display();
+         const auto isSel = selectedInputs->IsTransactionSelected(i + selectedInputs->GetTransactionsCount());
+         const auto input = makeKey(cpfpList[i], i, isSel, true);
          AddressNode *addressNode = nullptr;
-         const auto itAddr = cpfpNodes_.find(addrStr);
+         const auto itAddr = cpfpNodes_.find(input.addrStr);
 
          if (itAddr == cpfpNodes_.end()) {
             const int row = cpfpNodes_.size();
-            addressNode = new AddressNode(CoinControlNode::Type::DoesNotMatter, QString::fromStdString(address.display())
-               , QString::fromStdString(selectedInputs->GetWallet()->getAddressComment(bs::Address::fromHash(input.getRecipientScrAddr()))), row, cpfp_.get());
-            cpfp_->appendChildNode(addressNode);
-            cpfpNodes_[addrStr] = addressNode;
+            addressNode = new AddressNode(CoinControlNode::Type::DoesNotMatter, QString::fromStdString(input.addrStr)
+               , comment(input.input.utxo), row, cpfpNode);
+            cpfpNode->appendChildNode(addressNode);
+            cpfpNodes_[input.addrStr] = addressNode;
          }
          else {
             addressNode = static_cast<AddressNode *>(itAddr->second);
          }
-         const auto isSel = selectedInputs->IsTransactionSelected(i + selectedInputs->GetTransactionsCount());
-         addressNode->addTransaction(new CPFPTransactionNode(isSel, i, input, selectedInputs->GetWallet(), addressNode));
+         addressNode->addInput(input.input);
       }
    }
 }
@@ -78,7 +78,7 @@ private:
    void loadInputs(const std::shared_ptr<SelectedTransactionInputs> &selectedInputs);
 
 private:
-   std::shared_ptr<CoinControlNode>    root_, cpfp_;
+   std::shared_ptr<CoinControlNode>    root_;
    std::shared_ptr<bs::sync::Wallet>   wallet_;
    std::unordered_map<std::string, CoinControlNode*> addressNodes_, cpfpNodes_;
 };
@@ -30,6 +30,7 @@
 #include "Address.h"
 #include "ArmoryConnection.h"
 #include "BSMessageBox.h"
+#include "FeeEstimateCache.h"
 #include "OfflineSigner.h"
 #include "SelectedTransactionInputs.h"
 #include "SignContainer.h"
@@ -81,6 +82,9 @@ void CreateTransactionDialog::init()
 {
    if (!transactionData_) {
       transactionData_ = std::make_shared<TransactionData>([this]() {
+         if (txUpdatesSuspended_) {
+            return;
+         }
          QMetaObject::invokeMethod(this, [this] {
             onTransactionUpdated();
          });
@@ -93,6 +97,9 @@ void CreateTransactionDialog::init()
       }
       onTransactionUpdated();
       transactionData_->SetCallback([this] {
+         if (txUpdatesSuspended_) {
+            return;
+         }
          QMetaObject::invokeMethod(this, [this] {
             // Call on main thread because GUI is updated here
             onTransactionUpdated();
@@ -242,7 +249,7 @@ void CreateTransactionDialog::loadFees()
             emit feeLoadingCompleted(result->values);
          }
       };
-      walletsManager_->estimatedFeePerByte(feeLevel.first, cbFee, this);
+      bs::FeeEstimateCache::estimateFeePerByte(walletsManager_, feeLevel.first, cbFee, this);
    }
 }
 
@@ -360,7 +367,7 @@ void CreateTransactionDialog::onMaxPressed()
    QCoreApplication::processEvents();
 
    const auto outputAddr = bs::Address::fromAddressString(lineEditAddress()->text().trimmed().toStdString());
-   const auto maxValue = transactionData_->CalculateMaxAmount(outputAddr);
+   const auto maxValue = maxSpendAmount(outputAddr);
    if (maxValue > 0) {
       lineEditAmount()->setText(UiUtils::displayAmount(maxValue));
    }
@@ -368,6 +375,37 @@ void CreateTransactionDialog::onMaxPressed()
    lineEditAmount()->setEnabled(true);
 }
 
+bs::XBTAmount CreateTransactionDialog::maxSpendAmount(const bs::Address &outputAddr)
+{
+   // RBF/CPFP minimal fees, manual total fee and CC amounts are left to TransactionData
+   const auto wallet = transactionData_->getWallet();
+   const auto selInputs = transactionData_->getSelectedInputs();
+   if (isRBF_ || isCPFP_ || transactionData_->totalFee() || !selInputs
+      || qFuzzyIsNull(transactionData_->feePerByte())
+      || (wallet && (wallet->type() == bs::core::wallet::Type::ColorCoin))) {
+      return transactionData_->CalculateMaxAmount(outputAddr);
+   }
+
+   // Only inputs changed since previous call are processed
+   maxSpend_.setInputs(selInputs->UseAutoSel() ? selInputs->GetAllTransactions()
+      : selInputs->GetSelectedTransactions());
+   maxSpend_.clearOutputs();
+   for (const auto &recipId : transactionData_->allRecipientIds()) {
+      const auto amount = transactionData_->GetRecipientAmount(recipId).GetValue();
+      if (amount) {
+         maxSpend_.addOutput(transactionData_->GetRecipientAddress(recipId), amount);
+      }
+   }
+   if (!maxSpend_.outputsCount() && !outputAddr.isValid()) {
+      return {};
+   }
+   maxSpend_.setFeePerByte(transactionData_->feePerByte());
+
+   // Max is returned for all outputs together, as TransactionData does
+   const auto fee = maxSpend_.fee(outputAddr);
+   return bs::XBTAmount((maxSpend_.inputsSum() > fee) ? maxSpend_.inputsSum() - fee : uint64_t(0));
+}
+
 void CreateTransactionDialog::onTXSigned(unsigned int id, BinaryData signedTX, bs::error::ErrorCode result)
 {
    if (!pendingTXSignId_ || (pendingTXSignId_ != id)) {
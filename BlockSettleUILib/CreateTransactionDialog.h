@@ -11,6 +11,7 @@
 #ifndef __CREATE_TRANSACTION_DIALOG_H__
 #define __CREATE_TRANSACTION_DIALOG_H__
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -24,6 +25,7 @@
 #include "Bip21Types.h"
 #include "BSErrorCodeStrings.h"
 #include "CoreWallet.h"
+#include "MaxSpendAccumulator.h"
 #include "UtxoReservationToken.h"
 #include "ValidityFlag.h"
 
@@ -115,6 +117,10 @@ protected:
 
    void showError(const QString &text, const QString &detailedText);
 
+   // Same as TransactionData::CalculateMaxAmount, but without TX size
+   // estimation over all inputs when fee is set per byte
+   bs::XBTAmount maxSpendAmount(const bs::Address &);
+
 signals:
    void feeLoadingCompleted(const std::map<unsigned int, float> &);
    void walletChanged();
@@ -172,6 +178,10 @@ protected:
    float       advisedTotalFee_ = 0;
    float       addedFee_ = 0;
 
+   bs::MaxSpendAccumulator maxSpend_;
+
+   // Set while many TX data changes are applied at once to update UI only once after
+   std::atomic_bool txUpdatesSuspended_{ false };
 
    ValidityFlag validityFlag_;
 
@@ -17,6 +17,8 @@
 #include "BSMessageBox.h"
 #include "CoinControlDialog.h"
 #include "CreateTransactionDialogSimple.h"
+#include "FeeEstimateCache.h"
+#include "RecipientsImporter.h"
 #include "SelectAddressDialog.h"
 #include "SelectedTransactionInputs.h"
 #include "SignContainer.h"
@@ -31,6 +33,7 @@
 
 #include <QEvent>
 #include <QFile>
+#include <QFileDialog>
 #include <QKeyEvent>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -85,6 +88,7 @@ std::shared_ptr<CreateTransactionDialogAdvanced> CreateTransactionDialogAdvanced
    dlg->ui_->checkBoxRBF->setEnabled(false);
 
    dlg->ui_->pushButtonImport->setEnabled(false);
+   dlg->ui_->pushButtonImportRecipients->setEnabled(false);
    dlg->ui_->pushButtonShowSimple->setEnabled(false);
 
    dlg->setRBFinputs(tx);
@@ -108,6 +112,7 @@ std::shared_ptr<CreateTransactionDialogAdvanced> CreateTransactionDialogAdvanced
 
    dlg->setWindowTitle(tr("Child-Pays-For-Parent"));
    dlg->ui_->pushButtonImport->setEnabled(false);
+   dlg->ui_->pushButtonImportRecipients->setEnabled(false);
    dlg->ui_->pushButtonShowSimple->setEnabled(false);
 
    dlg->setCPFPinputs(tx, wallet);
@@ -129,6 +134,7 @@ std::shared_ptr<CreateTransactionDialog> CreateTransactionDialogAdvanced::Create
       , walletManager, utxoReservationManager, container, false, logger, applicationSettings, nullptr, bs::UtxoReservationToken(), parent);
 
    dlg->ui_->pushButtonImport->setEnabled(false);
+   dlg->ui_->pushButtonImportRecipients->setEnabled(false);
    dlg->ui_->pushButtonShowSimple->setEnabled(CreateTransactionDialog::canUseSimpleMode(paymentInfo));
 
    dlg->paymentInfo_ = paymentInfo;
@@ -174,6 +180,85 @@ std::shared_ptr<CreateTransactionDialog> CreateTransactionDialogAdvanced::Create
    return dlg;
 }
 
+std::shared_ptr<CreateTransactionDialogAdvanced> CreateTransactionDialogAdvanced::CreateForConsolidation(
+        const std::shared_ptr<ArmoryConnection> &armory
+      , const std::shared_ptr<bs::sync::WalletsManager> &walletManager
+      , const std::shared_ptr<bs::UTXOReservationManager> &utxoReservationManager
+      , const std::shared_ptr<SignContainer>& container
+      , const std::shared_ptr<spdlog::logger>& logger
+      , const std::shared_ptr<ApplicationSettings> &applicationSettings
+      , const bs::UtxoConsolidationPlanner::Plan &plan
+      , QWidget* parent)
+{
+   auto dlg = std::make_shared<CreateTransactionDialogAdvanced>(armory
+      , walletManager, utxoReservationManager, container, false, logger, applicationSettings, nullptr
+      , bs::UtxoReservationToken(), parent);
+
+   dlg->setWindowTitle(tr("UTXO Consolidation"));
+   dlg->ui_->pushButtonImport->setEnabled(false);
+   dlg->ui_->pushButtonImportRecipients->setEnabled(false);
+   dlg->ui_->pushButtonShowSimple->setEnabled(false);
+
+   dlg->SetPredefinedFeeRate(plan.feePerByte);
+   dlg->setConsolidationInputs(plan);
+   return dlg;
+}
+
+void CreateTransactionDialogAdvanced::setConsolidationInputs(const bs::UtxoConsolidationPlanner::Plan &plan)
+{
+   const auto leaf = walletsManager_->getWalletById(plan.leafId);
+   const auto hdWallet = walletsManager_->getHDRootForLeaf(plan.leafId);
+   if (!leaf || !hdWallet) {
+      SPDLOG_LOGGER_ERROR(logger_, "unknown leaf {}", plan.leafId);
+      return;
+   }
+   allowAutoSelInputs_ = false;
+
+   SetFixedWallet(plan.leafId, [this, leaf, hdWalletId = hdWallet->walletId(), inputs = plan.inputs] {
+      auto selInputs = transactionData_->getSelectedInputs();
+      selInputs->SetUseAutoSel(false);
+      for (const auto &utxo : inputs) {
+         if (!selInputs->SetUTXOSelection(utxo.getTxHash(), utxo.getTxOutIndex())) {
+            SPDLOG_LOGGER_WARN(logger_, "UTXO {}:{} is not spendable anymore"
+               , utxo.getTxHash().toHexStr(true), utxo.getTxOutIndex());
+         }
+      }
+      const auto selected = selInputs->GetSelectedTransactions();
+
+      // Don't let trading pick the same UTXOs while TX is reviewed, nor take ones
+      // reserved by trading after the plan was made
+      utxoRes_ = utxoReservationManager_->tryReserveXbt(hdWalletId, selected);
+      if (!utxoRes_.isValid()) {
+         BSMessageBox(BSMessageBox::critical, tr("UTXO Consolidation")
+            , tr("Some of UTXOs are used by trading now, please try again later"), this).exec();
+         reject();
+         return;
+      }
+      SetInputs(selected);
+      disableInputSelection();
+
+      // Everything left after fee goes to the single output
+      const auto cbAddr = [dlg = QPointer<CreateTransactionDialogAdvanced>(this)](const bs::Address &addr) {
+         if (!dlg) {
+            return;
+         }
+         QMetaObject::invokeMethod(dlg, [dlg, addr] {
+            if (!dlg) {
+               return;
+            }
+            if (!addr.isValid()) {
+               SPDLOG_LOGGER_ERROR(dlg->logger_, "failed to get consolidation address");
+               return;
+            }
+            const auto maxAmount = dlg->transactionData_->CalculateMaxAmount(addr);
+            dlg->AddRecipient({ addr, maxAmount, true });
+            dlg->disableOutputsEditing();
+         });
+      };
+      leaf->getNewIntAddress(cbAddr);
+   });
+}
+
 void CreateTransactionDialogAdvanced::setCPFPinputs(const Tx &tx, const std::shared_ptr<bs::sync::Wallet> &wallet)
 {
    std::set<BinaryData> txHashSet;
@@ -256,7 +341,7 @@ void CreateTransactionDialogAdvanced::setCPFPinputs(const Tx &tx, const std::sha
          SetMinimumFee(originalFee_ + addedFee_, advisedFeePerByte_);
          onTransactionUpdated();
       };
-      walletsManager_->estimatedFeePerByte(2, cbFee, this);
+      bs::FeeEstimateCache::estimateFeePerByte(walletsManager_, 2, cbFee, this);
    };
 
    SetFixedWallet(wallet->walletId(), [this, txHashSet, cbTXs] {
@@ -568,6 +653,7 @@ void CreateTransactionDialogAdvanced::initUI()
    connect(ui_->pushButtonAddOutput, &QPushButton::clicked, this, &CreateTransactionDialogAdvanced::onAddOutput);
    connect(ui_->pushButtonCreate, &QPushButton::clicked, this, &CreateTransactionDialogAdvanced::onCreatePressed);
    connect(ui_->pushButtonImport, &QPushButton::clicked, this, &CreateTransactionDialogAdvanced::onImportPressed);
+   connect(ui_->pushButtonImportRecipients, &QPushButton::clicked, this, &CreateTransactionDialogAdvanced::onImportRecipientsPressed);
    connect(ui_->pushButtonCancel, &QPushButton::clicked, this, &CreateTransactionDialogAdvanced::reject);
    connect(ui_->pushButtonShowSimple, &QPushButton::clicked, this, &CreateTransactionDialogAdvanced::onSimpleDialogRequested);
 
@@ -971,15 +1057,43 @@ unsigned int CreateTransactionDialogAdvanced::AddRecipient(const Recipient &reci
 
 void CreateTransactionDialogAdvanced::AddRecipients(const std::vector<Recipient> &recipients)
 {
+   if (recipients.empty()) {
+      return;
+   }
    std::vector<std::tuple<unsigned int, QString, bs::XBTAmount>> modelRecips;
+   modelRecips.reserve(recipients.size());
+
+   // Every recipient change revalidates TX, which runs coin selection over all
+   // UTXOs when inputs are auto-selected. Selection is switched off for the
+   // batch and runs once on the last change, as well as UI update.
+   const auto selInputs = transactionData_->getSelectedInputs();
+   const bool autoSel = selInputs && selInputs->UseAutoSel();
+   txUpdatesSuspended_ = true;
+   if (autoSel) {
+      selInputs->SetUseAutoSel(false);
+   }
+   unsigned int lastRecipientId = 0;
    for (const auto &recip : recipients) {
-      const auto recipientId = transactionData_->RegisterNewRecipient();
-      transactionData_->UpdateRecipientAddress(recipientId, recip.address);
-      transactionData_->UpdateRecipientAmount(recipientId, recip.amount, recip.isMax);
-      modelRecips.push_back({recipientId, QString::fromStdString(recip.address.display())
-         , recip.amount});
+      lastRecipientId = transactionData_->RegisterNewRecipient();
+      transactionData_->UpdateRecipientAddress(lastRecipientId, recip.address);
+      if (&recip != &recipients.back()) {
+         transactionData_->UpdateRecipientAmount(lastRecipientId, recip.amount, recip.isMax);
+      }
+      modelRecips.push_back({ lastRecipientId, QString::fromStdString(recip.address.display())
+         , recip.amount });
    }
-   QMetaObject::invokeMethod(outputsModel_, [this, modelRecips] { outputsModel_->AddRecipients(modelRecips); });
+   if (autoSel) {
+      selInputs->SetUseAutoSel(true);
+   }
+   txUpdatesSuspended_ = false;
+   transactionData_->UpdateRecipientAmount(lastRecipientId, recipients.back().amount, recipients.back().isMax);
+
+   QMetaObject::invokeMethod(outputsModel_, [this, modelRecips] {
+      outputsModel_->AddRecipients(modelRecips);
+      // Model reset drops selection, so output being edited is not current anymore
+      outputRow_ = -1;
+      updateOutputButtonTitle();
+   });
 }
 
 void CreateTransactionDialogAdvanced::onMaxPressed()
@@ -987,7 +1101,7 @@ void CreateTransactionDialogAdvanced::onMaxPressed()
    CreateTransactionDialog::onMaxPressed();
 
    if (outputRow_ >= 0) {
-      const auto maxValue = transactionData_->CalculateMaxAmount({});
+      const auto maxValue = maxSpendAmount({});
       if (maxValue.GetValue() > 0) {
          const auto &outputId = outputsModel_->GetOutputId(outputRow_);
          const auto prevValue = transactionData_->GetRecipientAmount(outputId);
@@ -1510,6 +1624,59 @@ void CreateTransactionDialogAdvanced::onImportPressed()
    SetImportedTransactions(transactions);
 }
 
+void CreateTransactionDialogAdvanced::onImportRecipientsPressed()
+{
+   const QString fileName = QFileDialog::getOpenFileName(this, tr("Select recipients file")
+      , {}, tr("CSV files (*.csv);; All files (*)"));
+   if (fileName.isEmpty()) {
+      return;
+   }
+   QFile file(fileName);
+   if (!file.open(QIODevice::ReadOnly)) {
+      showError(tr("Failed to import recipients"), tr("Can't open file %1").arg(fileName));
+      return;
+   }
+   const auto data = file.readAll();
+
+   if (!recipientsImporter_) {
+      recipientsImporter_ = new RecipientsImporter(logger_, this);
+   }
+   ui_->pushButtonImportRecipients->setEnabled(false);
+   recipientsImporter_->process(data, [this, fileName](const RecipientsImporter::Result &result) {
+      ui_->pushButtonImportRecipients->setEnabled(removeOutputEnabled_);
+      if (!removeOutputEnabled_) {
+         return;
+      }
+      if (result.nbErrors) {
+         QStringList errors;
+         for (const auto &error : result.errors) {
+            errors << error;
+         }
+         if (result.nbErrors > result.errors.size()) {
+            errors << tr("...and %1 more").arg(result.nbErrors - result.errors.size());
+         }
+         BSMessageBox(BSMessageBox::critical, tr("Failed to import recipients")
+            , tr("%1 invalid line[s] in %2").arg(result.nbErrors).arg(fileName)
+            , tr("Please fix the file and import it again"), errors.join(QLatin1Char('\n'))
+            , this).exec();
+         return;
+      }
+      if (result.recipients.empty()) {
+         showError(tr("Failed to import recipients"), tr("No recipients found in %1").arg(fileName));
+         return;
+      }
+
+      std::vector<Recipient> recipients;
+      recipients.reserve(result.recipients.size());
+      for (const auto &recip : result.recipients) {
+         recipients.push_back({ recip.address, recip.amount, false });
+      }
+      AddRecipients(recipients);
+      SPDLOG_LOGGER_INFO(logger_, "imported {} recipients with total amount {}"
+         , recipients.size(), result.totalAmount);
+   });
+}
+
 void CreateTransactionDialogAdvanced::onNewAddressSelectedForChange()
 {
    selectedChangeAddress_ = bs::Address{};
@@ -1587,6 +1754,7 @@ void CreateTransactionDialogAdvanced::disableOutputsEditing()
    ui_->lineEditAmount->setEnabled(false);
    ui_->pushButtonMax->setEnabled(false);
    ui_->pushButtonAddOutput->setEnabled(false);
+   ui_->pushButtonImportRecipients->setEnabled(false);
    outputsModel_->enableRows(false);
 
    removeOutputEnabled_ = false;
@@ -13,6 +13,7 @@
 
 #include "CreateTransactionDialog.h"
 #include "CoreWallet.h"
+#include "UtxoConsolidationPlanner.h"
 
 namespace Ui {
     class CreateTransactionDialogAdvanced;
@@ -28,6 +29,7 @@ namespace bs {
 }
 
 class QNetworkAccessManager;
+class RecipientsImporter;
 
 class CreateTransactionDialogAdvanced : public CreateTransactionDialog
 {
@@ -65,6 +67,19 @@ public:
       , const Bip21::PaymentRequestInfo& paymentInfo
       , QWidget* parent = nullptr);
 
+   // Inputs of plan still available after wallet load are reserved while dialog
+   // is open (dialog is rejected if trading took any of them), output goes to
+   // new internal address of the same leaf
+   static std::shared_ptr<CreateTransactionDialogAdvanced> CreateForConsolidation(
+        const std::shared_ptr<ArmoryConnection> &
+      , const std::shared_ptr<bs::sync::WalletsManager> &
+      , const std::shared_ptr<bs::UTXOReservationManager> &
+      , const std::shared_ptr<SignContainer>&
+      , const std::shared_ptr<spdlog::logger>&
+      , const std::shared_ptr<ApplicationSettings> &
+      , const bs::UtxoConsolidationPlanner::Plan &
+      , QWidget* parent = nullptr);
+
 public:
    CreateTransactionDialogAdvanced(const std::shared_ptr<ArmoryConnection> &
       , const std::shared_ptr<bs::sync::WalletsManager> &
@@ -127,6 +142,7 @@ protected slots:
    void onAddOutput();
    void onCreatePressed();
    void onImportPressed();
+   void onImportRecipientsPressed();
    void onMaxPressed() override;
 
    void feeSelectionChanged(int currentIndex) override;
@@ -157,6 +173,7 @@ private:
 
    void setRBFinputs(const Tx &);
    void setCPFPinputs(const Tx &, const std::shared_ptr<bs::sync::Wallet> &);
+   void setConsolidationInputs(const bs::UtxoConsolidationPlanner::Plan &);
 
    bool isCurrentAmountValid() const;
    void validateAddOutputButton();
@@ -211,6 +228,7 @@ private:
 
    UsedInputsModel         *  usedInputsModel_ = nullptr;
    TransactionOutputsModel *  outputsModel_ = nullptr;
+   RecipientsImporter      *  recipientsImporter_ = nullptr;
 
    bool        removeOutputEnabled_ = true;
    QMenu       contextMenu_;
@@ -0,0 +1,166 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "FeeEstimateCache.h"
+
+#include <cmath>
+#include <QPointer>
+#include <spdlog/spdlog.h>
+
+#include "Wallets/SyncWalletsManager.h"
+
+using namespace bs;
+
+namespace {
+   std::shared_ptr<FeeEstimateCache> globalInstance;
+}
+
+FeeEstimateCache::FeeEstimateCache(const std::shared_ptr<spdlog::logger> &logger
+   , const std::shared_ptr<ArmoryConnection> &armory, std::chrono::seconds ttl)
+   : logger_(logger)
+   , armory_(armory)
+   , ttl_(ttl)
+{
+   init(armory_.get());
+}
+
+FeeEstimateCache::~FeeEstimateCache()
+{
+   cleanup();
+}
+
+void FeeEstimateCache::createInstance(const std::shared_ptr<spdlog::logger> &logger
+   , const std::shared_ptr<ArmoryConnection> &armory)
+{
+   globalInstance = std::make_shared<FeeEstimateCache>(logger, armory);
+}
+
+std::shared_ptr<FeeEstimateCache> FeeEstimateCache::instance()
+{
+   return globalInstance;
+}
+
+void FeeEstimateCache::destroyInstance()
+{
+   globalInstance = nullptr;
+}
+
+void FeeEstimateCache::get(unsigned int nbBlocks, const FeeCb &cb)
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   const auto it = cache_.find(nbBlocks);
+   if (it != cache_.end()) {
+      if ((Clock::now() - it->second.time) < ttl_) {
+         const auto fee = it->second.fee;
+         lock.unlock();
+         cb(fee);
+         return;
+      }
+      cache_.erase(it);
+   }
+
+   auto &waiters = pending_[nbBlocks];
+   waiters.push_back(cb);
+   if (waiters.size() > 1) {
+      return;  // estimate is already requested
+   }
+   const auto generation = generation_;
+   lock.unlock();
+
+   const bool sent = armory_->estimateFee(nbBlocks, [weakThis = std::weak_ptr<FeeEstimateCache>(shared_from_this())
+      , nbBlocks, generation](float fee) {
+      const auto cache = weakThis.lock();
+      if (!cache) {
+         return;
+      }
+      cache->onEstimated(nbBlocks, fee, generation);
+   });
+   if (!sent) {
+      // Armory is not connected, callers get nothing as with direct request
+      SPDLOG_LOGGER_WARN(logger_, "fee estimate request for {} blocks failed", nbBlocks);
+      lock.lock();
+      pending_.erase(nbBlocks);
+   }
+}
+
+void FeeEstimateCache::getFeePerByte(unsigned int nbBlocks, const FeeCb &cb, QObject *context)
+{
+   get(nbBlocks, [cb, context = QPointer<QObject>(context)](float fee) {
+      if (!context) {
+         return;
+      }
+      const float feePerByte = std::isfinite(fee) ? ArmoryConnection::toFeePerByte(fee) : fee;
+      QMetaObject::invokeMethod(context, [cb, feePerByte] {
+         cb(feePerByte);
+      });
+   });
+}
+
+void FeeEstimateCache::estimateFee(const std::shared_ptr<ArmoryConnection> &armory
+   , unsigned int nbBlocks, const FeeCb &cb)
+{
+   const auto cache = instance();
+   if (cache) {
+      cache->get(nbBlocks, cb);
+   }
+   else {
+      armory->estimateFee(nbBlocks, cb);
+   }
+}
+
+void FeeEstimateCache::estimateFeePerByte(const std::shared_ptr<bs::sync::WalletsManager> &walletsMgr
+   , unsigned int nbBlocks, const FeeCb &cb, QObject *context)
+{
+   const auto cache = instance();
+   if (cache) {
+      cache->getFeePerByte(nbBlocks, cb, context);
+   }
+   else {
+      walletsMgr->estimatedFeePerByte(nbBlocks, cb, context);
+   }
+}
+
+void FeeEstimateCache::onEstimated(unsigned int nbBlocks, float fee, unsigned int generation)
+{
+   std::vector<FeeCb> cbs;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // Failed estimates (0 or infinity) are passed through but not cached
+      if ((generation == generation_) && std::isfinite(fee) && (fee > 0)) {
+         cache_[nbBlocks] = { fee, Clock::now() };
+      }
+      const auto it = pending_.find(nbBlocks);
+      if (it != pending_.end()) {
+         cbs = std::move(it->second);
+         pending_.erase(it);
+      }
+   }
+   for (const auto &cb : cbs) {
+      cb(fee);
+   }
+}
+
+void FeeEstimateCache::invalidateAll()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   cache_.clear();
+   generation_++;
+}
+
+size_t FeeEstimateCache::cachedCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return cache_.size();
+}
+
+void FeeEstimateCache::onNewBlock(unsigned int, unsigned int)
+{
+   invalidateAll();
+}
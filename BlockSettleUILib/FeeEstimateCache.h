@@ -0,0 +1,98 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef FEE_ESTIMATE_CACHE_H
+#define FEE_ESTIMATE_CACHE_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ArmoryConnection.h"
+
+namespace spdlog {
+   class logger;
+}
+namespace bs {
+   namespace sync {
+      class WalletsManager;
+   }
+}
+class QObject;
+
+namespace bs {
+
+   // Process-wide cache of Armory fee estimates keyed by block target, so
+   // dialogs, RFQ tickets and UTXO selection don't ask ArmoryDB for the same
+   // estimate again and again. Values expire after TTL and are dropped on new
+   // block. Concurrent requests for the same target share one Armory request.
+   // Must be owned by std::shared_ptr: Armory replies hold a weak reference.
+   class FeeEstimateCache : public ArmoryCallbackTarget
+      , public std::enable_shared_from_this<FeeEstimateCache>
+   {
+   public:
+      // Fee is in Armory units (BTC/kB) or sat/byte depending on the call
+      using FeeCb = std::function<void(float)>;
+
+      FeeEstimateCache(const std::shared_ptr<spdlog::logger> &
+         , const std::shared_ptr<ArmoryConnection> &
+         , std::chrono::seconds ttl = std::chrono::minutes(2));
+      ~FeeEstimateCache() override;
+
+      static void createInstance(const std::shared_ptr<spdlog::logger> &
+         , const std::shared_ptr<ArmoryConnection> &);
+      static std::shared_ptr<FeeEstimateCache> instance();
+      static void destroyInstance();
+
+      // Same as ArmoryConnection::estimateFee, cb is called from any thread
+      void get(unsigned int nbBlocks, const FeeCb &);
+      // Fee per byte, cb is called in context's thread (dropped if context is destroyed)
+      void getFeePerByte(unsigned int nbBlocks, const FeeCb &, QObject *context);
+
+      // Use cache if created, fall back to direct request otherwise
+      static void estimateFee(const std::shared_ptr<ArmoryConnection> &
+         , unsigned int nbBlocks, const FeeCb &);
+      static void estimateFeePerByte(const std::shared_ptr<bs::sync::WalletsManager> &
+         , unsigned int nbBlocks, const FeeCb &, QObject *context);
+
+      void invalidateAll();
+      size_t cachedCount() const;
+
+   protected:
+      void onNewBlock(unsigned int height, unsigned int branchHeight) override;
+
+   private:
+      using Clock = std::chrono::steady_clock;
+
+      struct Entry
+      {
+         float             fee;
+         Clock::time_point time;
+      };
+
+      void onEstimated(unsigned int nbBlocks, float fee, unsigned int generation);
+
+   private:
+      std::shared_ptr<spdlog::logger>     logger_;
+      std::shared_ptr<ArmoryConnection>   armory_;
+      const std::chrono::seconds          ttl_;
+
+      mutable std::mutex   mutex_;
+      std::map<unsigned int, Entry>                   cache_;
+      std::map<unsigned int, std::vector<FeeCb>>      pending_;
+      unsigned int   generation_{ 0 };   // bumped on new block, older results are not cached
+   };
+
+}  // namespace bs
+
+#endif // FEE_ESTIMATE_CACHE_H
@@ -0,0 +1,207 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "MaxSpendAccumulator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+using namespace bs;
+
+namespace {
+   const uint64_t kWitnessScale = 4;
+
+   // version + locktime
+   const uint64_t kTxOverheadSize = 8;
+   // segwit marker and flag, not scaled
+   const uint64_t kWitnessFlagWeight = 2;
+
+   // outpoint + script length + sequence
+   const uint64_t kInputBaseSize = 32 + 4 + 1 + 4;
+   // items count + signature + compressed public key
+   const uint64_t kP2WPKHWitnessSize = 1 + (1 + 72) + (1 + 33);
+   const uint64_t kP2SHP2WPKHScriptSize = 23;
+   const uint64_t kP2PKHScriptSigSize = (1 + 72) + (1 + 33);
+
+   // value + script length
+   const uint64_t kOutputBaseSize = 8 + 1;
+
+   uint64_t varIntSize(uint64_t value)
+   {
+      if (value < 0xfd) {
+         return 1;
+      }
+      if (value <= 0xffff) {
+         return 3;
+      }
+      return (value <= 0xffffffff) ? 5 : 9;
+   }
+}
+
+bool MaxSpendAccumulator::addInput(const UTXO &utxo)
+{
+   const auto addr = bs::Address::fromUTXO(utxo);
+   const Input input{ utxo.getValue(), inputWeight(addr), isWitnessInput(addr) };
+   if (!inputs_.emplace(Outpoint{ utxo.getTxHash(), utxo.getTxOutIndex() }, input).second) {
+      return false;
+   }
+   inputsSum_ += input.value;
+   inputsWeight_ += input.weight;
+   if (input.witness) {
+      witnessInputs_++;
+   }
+   return true;
+}
+
+bool MaxSpendAccumulator::removeInput(const BinaryData &txHash, uint32_t txOutIndex)
+{
+   const auto it = inputs_.find({ txHash, txOutIndex });
+   if (it == inputs_.end()) {
+      return false;
+   }
+   inputsSum_ -= it->second.value;
+   inputsWeight_ -= it->second.weight;
+   if (it->second.witness) {
+      witnessInputs_--;
+   }
+   inputs_.erase(it);
+   return true;
+}
+
+void MaxSpendAccumulator::setInputs(const std::vector<UTXO> &utxos)
+{
+   std::set<Outpoint> outpoints;
+   for (const auto &utxo : utxos) {
+      Outpoint outpoint{ utxo.getTxHash(), utxo.getTxOutIndex() };
+      if (inputs_.find(outpoint) == inputs_.end()) {
+         addInput(utxo);
+      }
+      outpoints.insert(std::move(outpoint));
+   }
+   if (outpoints.size() == inputs_.size()) {
+      return;
+   }
+
+   std::vector<Outpoint> removed;
+   for (const auto &input : inputs_) {
+      if (outpoints.find(input.first) == outpoints.end()) {
+         removed.push_back(input.first);
+      }
+   }
+   for (const auto &outpoint : removed) {
+      removeInput(outpoint.first, outpoint.second);
+   }
+}
+
+void MaxSpendAccumulator::clearInputs()
+{
+   inputs_.clear();
+   inputsSum_ = 0;
+   inputsWeight_ = 0;
+   witnessInputs_ = 0;
+}
+
+void MaxSpendAccumulator::addOutput(const bs::Address &addr, uint64_t amount)
+{
+   outputsCount_++;
+   outputsSum_ += amount;
+   outputsWeight_ += outputWeight(addr);
+}
+
+void MaxSpendAccumulator::removeOutput(const bs::Address &addr, uint64_t amount)
+{
+   if (!outputsCount_) {
+      return;
+   }
+   outputsCount_--;
+   outputsSum_ -= std::min(outputsSum_, amount);
+   outputsWeight_ -= std::min(outputsWeight_, outputWeight(addr));
+}
+
+void MaxSpendAccumulator::clearOutputs()
+{
+   outputsCount_ = 0;
+   outputsSum_ = 0;
+   outputsWeight_ = 0;
+}
+
+uint64_t MaxSpendAccumulator::weight(const bs::Address &output) const
+{
+   const uint64_t baseSize = kTxOverheadSize + varIntSize(inputs_.size())
+      + varIntSize(outputsCount_ + 1);
+   uint64_t result = baseSize * kWitnessScale + inputsWeight_ + outputsWeight_
+      + outputWeight(output);
+   if (witnessInputs_) {
+      // Non-witness inputs of segwit TX have empty witness (zero items count)
+      result += kWitnessFlagWeight + (inputs_.size() - witnessInputs_);
+   }
+   return result;
+}
+
+uint64_t MaxSpendAccumulator::virtSize(const bs::Address &output) const
+{
+   return (weight(output) + kWitnessScale - 1) / kWitnessScale;
+}
+
+uint64_t MaxSpendAccumulator::fee(const bs::Address &output) const
+{
+   return static_cast<uint64_t>(std::ceil(virtSize(output) * static_cast<double>(feePerByte_)));
+}
+
+uint64_t MaxSpendAccumulator::maxAmount(const bs::Address &output) const
+{
+   const uint64_t spent = outputsSum_ + fee(output);
+   return (inputsSum_ > spent) ? inputsSum_ - spent : 0;
+}
+
+uint64_t MaxSpendAccumulator::inputWeight(const bs::Address &addr)
+{
+   switch (addr.getType()) {
+   case AddressEntryType_P2WPKH:
+      return kInputBaseSize * kWitnessScale + kP2WPKHWitnessSize;
+   case AddressEntryType_P2PKH:
+      return (kInputBaseSize + kP2PKHScriptSigSize) * kWitnessScale;
+   default:
+      break;
+   }
+   if (addr.getType() & AddressEntryType_P2SH) {
+      // Our wallets have nested P2WPKH only
+      return (kInputBaseSize + kP2SHP2WPKHScriptSize) * kWitnessScale + kP2WPKHWitnessSize;
+   }
+   // Unknown script - assume the largest of supported ones
+   return (kInputBaseSize + kP2PKHScriptSigSize) * kWitnessScale;
+}
+
+uint64_t MaxSpendAccumulator::outputWeight(const bs::Address &addr)
+{
+   uint64_t scriptSize = 34;     // P2WSH, the largest one
+   switch (addr.getType()) {
+   case AddressEntryType_P2WPKH:
+      scriptSize = 22;
+      break;
+   case AddressEntryType_P2PKH:
+      scriptSize = 25;
+      break;
+   case AddressEntryType_P2WSH:
+      break;
+   default:
+      if (addr.isValid() && (addr.getType() & AddressEntryType_P2SH)) {
+         scriptSize = 23;
+      }
+      break;
+   }
+   return (kOutputBaseSize + scriptSize) * kWitnessScale;
+}
+
+bool MaxSpendAccumulator::isWitnessInput(const bs::Address &addr)
+{
+   return (addr.getType() == AddressEntryType_P2WPKH) || (addr.getType() & AddressEntryType_P2SH);
+}
@@ -0,0 +1,85 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef MAX_SPEND_ACCUMULATOR_H
+#define MAX_SPEND_ACCUMULATOR_H
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "Address.h"
+#include "TxClasses.h"
+
+namespace bs {
+
+   // Maximum amount which could be sent to one more output of TX without
+   // change. Value and weight of inputs and outputs are kept as running
+   // totals, so updates cost O(log n) per input and the result is O(1) -
+   // no TX serialization or fee estimation over all inputs is needed.
+   // Weights assume the largest (72 bytes) signatures, so result never
+   // exceeds the amount which can be really spent.
+   class MaxSpendAccumulator
+   {
+   public:
+      // Returns false if input is already there
+      bool addInput(const UTXO &);
+      bool removeInput(const BinaryData &txHash, uint32_t txOutIndex);
+      // Adds and removes the difference with current inputs only
+      void setInputs(const std::vector<UTXO> &);
+      void clearInputs();
+
+      void addOutput(const bs::Address &, uint64_t amount);
+      void removeOutput(const bs::Address &, uint64_t amount);
+      void clearOutputs();
+
+      void setFeePerByte(float feePerByte) { feePerByte_ = feePerByte; }
+      float feePerByte() const { return feePerByte_; }
+
+      size_t inputsCount() const { return inputs_.size(); }
+      uint64_t inputsSum() const { return inputsSum_; }
+      size_t outputsCount() const { return outputsCount_; }
+      uint64_t outputsSum() const { return outputsSum_; }
+
+      // Invalid address means output of unknown type (the largest one is assumed)
+      uint64_t weight(const bs::Address &output = {}) const;
+      uint64_t virtSize(const bs::Address &output = {}) const;
+      uint64_t fee(const bs::Address &output = {}) const;
+      // 0 if inputs don't cover other outputs and fee
+      uint64_t maxAmount(const bs::Address &output = {}) const;
+
+      static uint64_t inputWeight(const bs::Address &);
+      static uint64_t outputWeight(const bs::Address &);
+      static bool isWitnessInput(const bs::Address &);
+
+   private:
+      struct Input
+      {
+         uint64_t value;
+         uint64_t weight;
+         bool     witness;
+      };
+      using Outpoint = std::pair<BinaryData, uint32_t>;
+
+      std::map<Outpoint, Input>  inputs_;
+      uint64_t inputsSum_{ 0 };
+      uint64_t inputsWeight_{ 0 };
+      size_t   witnessInputs_{ 0 };
+
+      size_t   outputsCount_{ 0 };
+      uint64_t outputsSum_{ 0 };
+      uint64_t outputsWeight_{ 0 };
+
+      float    feePerByte_{ 0 };
+   };
+
+}  // namespace bs
+
+#endif // MAX_SPEND_ACCUMULATOR_H
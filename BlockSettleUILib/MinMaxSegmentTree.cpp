@@ -0,0 +1,73 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "MinMaxSegmentTree.h"
+
+#include <algorithm>
+
+using namespace bs;
+
+void MinMaxSegmentTree::assign(const std::vector<Range> &values)
+{
+   size_ = values.size();
+   nodes_.resize(2 * size_);
+   std::copy(values.cbegin(), values.cend(), nodes_.begin() + size_);
+   if (size_ == 0) {
+      return;
+   }
+   for (size_t i = size_ - 1; i > 0; --i) {
+      nodes_[i] = merge(nodes_[2 * i], nodes_[2 * i + 1]);
+   }
+}
+
+void MinMaxSegmentTree::update(size_t index, const Range &value)
+{
+   if (index >= size_) {
+      return;
+   }
+   index += size_;
+   nodes_[index] = value;
+   for (index /= 2; index > 0; index /= 2) {
+      nodes_[index] = merge(nodes_[2 * index], nodes_[2 * index + 1]);
+   }
+}
+
+void MinMaxSegmentTree::clear()
+{
+   size_ = 0;
+   nodes_.clear();
+}
+
+bool MinMaxSegmentTree::query(size_t from, size_t to, Range &result) const
+{
+   to = std::min(to, size_);
+   if (from >= to) {
+      return false;
+   }
+   bool found = false;
+   for (from += size_, to += size_; from < to; from /= 2, to /= 2) {
+      if (from & 1) {
+         result = found ? merge(result, nodes_[from]) : nodes_[from];
+         found = true;
+         ++from;
+      }
+      if (to & 1) {
+         --to;
+         result = found ? merge(result, nodes_[to]) : nodes_[to];
+         found = true;
+      }
+   }
+   return found;
+}
+
+MinMaxSegmentTree::Range MinMaxSegmentTree::merge(const Range &lhs, const Range &rhs)
+{
+   return { std::min(lhs.min, rhs.min), std::max(lhs.max, rhs.max) };
+}
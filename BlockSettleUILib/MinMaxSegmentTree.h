@@ -0,0 +1,51 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef MIN_MAX_SEGMENT_TREE_H
+#define MIN_MAX_SEGMENT_TREE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace bs {
+
+   // Answers min/max queries over index ranges of a series in O(log n).
+   // Used by chart to rescale value axes on every pan/zoom without scanning
+   // all visible points. Rebuild is O(n), point update is O(log n).
+   class MinMaxSegmentTree
+   {
+   public:
+      struct Range
+      {
+         double min;
+         double max;
+      };
+
+      void assign(const std::vector<Range> &);
+      void update(size_t index, const Range &);
+      void clear();
+
+      size_t size() const { return size_; }
+
+      // Half-open range [from, to), returns false if it's empty
+      bool query(size_t from, size_t to, Range &result) const;
+
+   private:
+      static Range merge(const Range &, const Range &);
+
+   private:
+      size_t               size_{};
+      // Leaves are stored at [size_, 2 * size_)
+      std::vector<Range>   nodes_;
+   };
+
+}  // namespace bs
+
+#endif // MIN_MAX_SEGMENT_TREE_H
@@ -0,0 +1,270 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "NativeQuoter.h"
+
+#include <QLibrary>
+#include <spdlog/spdlog.h>
+
+#include "AssetManager.h"
+#include "CurrencyPair.h"
+#include "MDCallbacksQt.h"
+
+namespace {
+   using ApiVersionFunc = int (*)();
+   using CreateFactoryFunc = bs::QuoteStrategyFactory *(*)();
+}
+
+
+NativeQuoter::NativeQuoter(const std::shared_ptr<spdlog::logger> &logger
+   , const std::shared_ptr<AssetManager> &assetManager
+   , const std::shared_ptr<MDCallbacksQt> &mdCallbacks
+   , const ExtConnections &extConns, QObject *parent)
+   : QObject(parent)
+   , logger_(logger)
+   , assetManager_(assetManager)
+   , extConns_(extConns)
+{
+   if (mdCallbacks) {
+      connect(mdCallbacks.get(), &MDCallbacksQt::MDUpdate, this, &NativeQuoter::onMDUpdate
+         , Qt::QueuedConnection);
+   }
+}
+
+NativeQuoter::~NativeQuoter() = default;
+
+bool NativeQuoter::isStrategyLibrary(const QString &filename)
+{
+   return QLibrary::isLibrary(filename);
+}
+
+bool NativeQuoter::load(const QString &filename)
+{
+   auto library = std::make_unique<QLibrary>(filename);
+   if (!library->load()) {
+      logger_->error("[NativeQuoter::load] failed to load {}: {}", filename.toStdString()
+         , library->errorString().toStdString());
+      emit failed(tr("Failed to load strategy %1: %2").arg(filename).arg(library->errorString()));
+      return false;
+   }
+
+   const auto versionFunc = reinterpret_cast<ApiVersionFunc>(
+      library->resolve(BS_QUOTE_STRATEGY_VERSION_FUNC));
+   const auto createFunc = reinterpret_cast<CreateFactoryFunc>(
+      library->resolve(BS_QUOTE_STRATEGY_FACTORY_FUNC));
+   if (!versionFunc || !createFunc) {
+      logger_->error("[NativeQuoter::load] {} is not a quoting strategy", filename.toStdString());
+      emit failed(tr("%1 is not a quoting strategy library").arg(filename));
+      return false;
+   }
+   const int version = versionFunc();
+   if (version != bs::kQuoteStrategyApiVersion) {
+      logger_->error("[NativeQuoter::load] {} API version mismatch: {} (expected {})"
+         , filename.toStdString(), version, bs::kQuoteStrategyApiVersion);
+      emit failed(tr("Strategy %1 is built for another terminal version").arg(filename));
+      return false;
+   }
+
+   std::unique_ptr<bs::QuoteStrategyFactory> factory(createFunc());
+   if (!factory) {
+      emit failed(tr("Strategy %1 failed to create factory").arg(filename));
+      return false;
+   }
+
+   factory_ = std::move(factory);
+   library_ = std::move(library);
+   logger_->info("[NativeQuoter::load] strategy {} loaded", filename.toStdString());
+   emit loaded();
+   return true;
+}
+
+QObject *NativeQuoter::instantiate(const bs::network::QuoteReqNotification &qrn)
+{
+   if (!factory_) {
+      return nullptr;
+   }
+   auto reply = new NativeQuoteReqReply(this, qrn);
+   reply->init(logger_, assetManager_, nullptr);
+
+   auto qr = new BSQuoteRequest(reply);
+   qr->init(QString::fromStdString(qrn.quoteRequestId), QString::fromStdString(qrn.product)
+      , (qrn.side == bs::network::Side::Buy), qrn.quantity, static_cast<int>(qrn.assetType));
+   reply->setQuoteReq(qr);
+   reply->setSecurity(QString::fromStdString(qrn.security));
+
+   std::unique_ptr<bs::QuoteStrategy> strategy;
+   try {
+      strategy = factory_->create(*reply);
+   }
+   catch (const std::exception &e) {
+      logger_->error("[NativeQuoter::instantiate] failed to create strategy for {}: {}"
+         , qrn.quoteRequestId, e.what());
+   }
+   if (!reply->setStrategy(std::move(strategy))) {
+      // a factory may decline a request - skip it, other requests are still quoted
+      logger_->debug("[NativeQuoter::instantiate] no strategy for {}", qrn.quoteRequestId);
+      delete reply;
+      return nullptr;
+   }
+
+   connect(reply, &BSQuoteReqReply::sendingQuoteReply, this, &NativeQuoter::sendingQuoteReply);
+   connect(reply, &BSQuoteReqReply::pullingQuoteReply, this, &NativeQuoter::pullingQuoteReply);
+
+   reply->start();
+   return reply;
+}
+
+bs::QuoteStrategyPrices NativeQuoter::marketData(const std::string &security) const
+{
+   bs::QuoteStrategyPrices result;
+   const auto it = mdInfo_.find(security);
+   if (it != mdInfo_.end()) {
+      result.bid = it->second.bidPrice;
+      result.ask = it->second.askPrice;
+      result.last = it->second.lastPrice;
+   }
+   return result;
+}
+
+double NativeQuoter::accountBalance(const std::string &product) const
+{
+   return assetManager_ ? assetManager_->getBalance(product) : 0;
+}
+
+bool NativeQuoter::sendExtConn(const QString &name, const QString &type, const QString &message)
+{
+   return UserScript::sendExtConn(logger_, extConns_, name, type, message);
+}
+
+void NativeQuoter::onMDUpdate(bs::network::Asset::Type, const QString &security
+   , bs::network::MDFields mdFields)
+{
+   mdInfo_[security.toStdString()].merge(bs::network::MDField::get(mdFields));
+}
+
+
+NativeQuoteReqReply::NativeQuoteReqReply(NativeQuoter *quoter
+   , const bs::network::QuoteReqNotification &qrn)
+   : BSQuoteReqReply(nullptr)
+   , quoter_(quoter)
+{
+   request_.requestId = qrn.quoteRequestId;
+   request_.security = qrn.security;
+   request_.product = qrn.product;
+   request_.isBuy = (qrn.side == bs::network::Side::Buy);
+   request_.quantity = qrn.quantity;
+   request_.assetType = static_cast<int>(qrn.assetType);
+}
+
+NativeQuoteReqReply::~NativeQuoteReqReply()
+{
+   strategy_.reset();
+}
+
+bool NativeQuoteReqReply::setStrategy(std::unique_ptr<bs::QuoteStrategy> strategy)
+{
+   if (!strategy) {
+      return false;
+   }
+   strategy_ = std::move(strategy);
+
+   connect(this, &BSQuoteReqReply::started, this, [this] {
+      callStrategy(&bs::QuoteStrategy::onStarted);
+   });
+   connect(this, &BSQuoteReqReply::expirationInSecChanged, this, [this] {
+      callStrategy(&bs::QuoteStrategy::onExpirationChanged);
+   });
+   connect(this, &BSQuoteReqReply::indicBidChanged, this, [this] {
+      callStrategy(&bs::QuoteStrategy::onIndicBidChanged);
+   });
+   connect(this, &BSQuoteReqReply::indicAskChanged, this, [this] {
+      callStrategy(&bs::QuoteStrategy::onIndicAskChanged);
+   });
+   connect(this, &BSQuoteReqReply::lastPriceChanged, this, [this] {
+      callStrategy(&bs::QuoteStrategy::onLastPriceChanged);
+   });
+   connect(this, &BSQuoteReqReply::bestPriceChanged, this, [this] {
+      callStrategy(&bs::QuoteStrategy::onBestPriceChanged);
+   });
+   connect(this, &BSQuoteReqReply::settled, this, [this] {
+      callStrategy(&bs::QuoteStrategy::onSettled);
+   });
+   connect(this, &BSQuoteReqReply::cancelled, this, [this] {
+      callStrategy(&bs::QuoteStrategy::onCancelled);
+   });
+   connect(this, &BSQuoteReqReply::extDataReceived, this
+      , [this](QString from, QString type, QString msg) {
+      try {
+         strategy_->onExtDataReceived(from.toStdString(), type.toStdString(), msg.toStdString());
+      }
+      catch (const std::exception &e) {
+         log(std::string("strategy failed: ") + e.what());
+      }
+   });
+   return true;
+}
+
+void NativeQuoteReqReply::callStrategy(void (bs::QuoteStrategy::*method)())
+{
+   // Strategy failures shouldn't break processing of other requests
+   try {
+      (strategy_.get()->*method)();
+   }
+   catch (const std::exception &e) {
+      log(std::string("strategy failed: ") + e.what());
+   }
+}
+
+bs::QuoteStrategyPrices NativeQuoteReqReply::marketData(const std::string &security) const
+{
+   if (!quoter_) {
+      return {};
+   }
+   return quoter_->marketData(security);
+}
+
+std::string NativeQuoteReqReply::contraProduct() const
+{
+   CurrencyPair cp(request_.security);
+   return cp.ContraCurrency(request_.product);
+}
+
+double NativeQuoteReqReply::accountBalance(const std::string &product) const
+{
+   if (!quoter_) {
+      return 0;
+   }
+   return quoter_->accountBalance(product);
+}
+
+bool NativeQuoteReqReply::sendQuote(double price)
+{
+   return sendQuoteReply(price);
+}
+
+bool NativeQuoteReqReply::pullQuote()
+{
+   return pullQuoteReply();
+}
+
+bool NativeQuoteReqReply::sendExtConn(const std::string &name, const std::string &type
+   , const std::string &message)
+{
+   if (!quoter_) {
+      return false;
+   }
+   return quoter_->sendExtConn(QString::fromStdString(name), QString::fromStdString(type)
+      , QString::fromStdString(message));
+}
+
+void NativeQuoteReqReply::log(const std::string &message)
+{
+   BSQuoteReqReply::log(QString::fromStdString(message));
+}
@@ -0,0 +1,110 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef NATIVE_QUOTER_H
+#define NATIVE_QUOTER_H
+
+#include <QObject>
+#include <QPointer>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "CommonTypes.h"
+#include "QuoteStrategy.h"
+#include "UserScript.h"
+
+namespace spdlog {
+   class logger;
+}
+class AssetManager;
+class MDCallbacksQt;
+class QLibrary;
+
+
+//! Loads native quoting strategy from shared library. Same role as AutoQuoter
+//! for QML scripts, instantiated objects are BSQuoteReqReply too.
+class NativeQuoter : public QObject
+{
+   Q_OBJECT
+public:
+   NativeQuoter(const std::shared_ptr<spdlog::logger> &
+      , const std::shared_ptr<AssetManager> &
+      , const std::shared_ptr<MDCallbacksQt> &
+      , const ExtConnections &, QObject *parent = nullptr);
+   ~NativeQuoter() override;
+
+   static bool isStrategyLibrary(const QString &filename);
+
+   bool load(const QString &filename);
+   QObject *instantiate(const bs::network::QuoteReqNotification &qrn);
+
+   bs::QuoteStrategyPrices marketData(const std::string &security) const;
+   double accountBalance(const std::string &product) const;
+   bool sendExtConn(const QString &name, const QString &type, const QString &message);
+
+signals:
+   void loaded();
+   void failed(const QString &desc);
+   void sendingQuoteReply(const QString &reqId, double price);
+   void pullingQuoteReply(const QString &reqId);
+
+private slots:
+   void onMDUpdate(bs::network::Asset::Type, const QString &security, bs::network::MDFields);
+
+private:
+   std::shared_ptr<spdlog::logger>  logger_;
+   std::shared_ptr<AssetManager>    assetManager_;
+   ExtConnections                   extConns_;
+
+   // Libraries are never unloaded: strategy objects could outlive the quoter
+   std::unique_ptr<QLibrary>                    library_;
+   std::unique_ptr<bs::QuoteStrategyFactory>    factory_;
+
+   std::unordered_map<std::string, bs::network::MDInfo>  mdInfo_;
+};
+
+
+//! BSQuoteReqReply which forwards its events to native strategy instead of QML
+class NativeQuoteReqReply : public BSQuoteReqReply, public bs::QuoteStrategyReply
+{
+   Q_OBJECT
+public:
+   NativeQuoteReqReply(NativeQuoter *, const bs::network::QuoteReqNotification &);
+   ~NativeQuoteReqReply() override;
+
+   bool setStrategy(std::unique_ptr<bs::QuoteStrategy>);
+
+   const bs::QuoteStrategyRequest &request() const override { return request_; }
+   double expirationInSec() const override { return expiration(); }
+   double indicBid() const override { return BSQuoteReqReply::indicBid(); }
+   double indicAsk() const override { return BSQuoteReqReply::indicAsk(); }
+   double lastPrice() const override { return BSQuoteReqReply::lastPrice(); }
+   double bestPrice() const override { return BSQuoteReqReply::bestPrice(); }
+   bool isOwnBestPrice() const override { return BSQuoteReqReply::isOwnBestPrice(); }
+   bs::QuoteStrategyPrices marketData(const std::string &security) const override;
+   std::string contraProduct() const override;
+   double accountBalance(const std::string &product) const override;
+   bool sendQuote(double price) override;
+   bool pullQuote() override;
+   bool sendExtConn(const std::string &name, const std::string &type
+      , const std::string &message) override;
+   void log(const std::string &) override;
+
+private:
+   void callStrategy(void (bs::QuoteStrategy::*)());
+
+private:
+   QPointer<NativeQuoter>              quoter_;
+   bs::QuoteStrategyRequest            request_;
+   std::unique_ptr<bs::QuoteStrategy>  strategy_;
+};
+
+#endif // NATIVE_QUOTER_H
@@ -0,0 +1,120 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "OhlcHistoryProcessor.h"
+
+#include <algorithm>
+
+#include <QThread>
+#include <spdlog/spdlog.h>
+
+#include "market_data_history.pb.h"
+
+using namespace Blocksettle::Communication::MarketDataHistory;
+
+OhlcHistoryProcessor::OhlcHistoryProcessor(const std::shared_ptr<spdlog::logger> &logger
+   , QObject *parent)
+   : QObject(parent)
+   , logger_(logger)
+   , thread_(new QThread(this))
+   , worker_(new QObject())
+{
+   worker_->moveToThread(thread_);
+   thread_->start();
+}
+
+OhlcHistoryProcessor::~OhlcHistoryProcessor() noexcept
+{
+   thread_->quit();
+   thread_->wait();
+   delete worker_;
+}
+
+void OhlcHistoryProcessor::process(const std::string &data, quint64 loadedFrom, const ResultCb &cb)
+{
+   QMetaObject::invokeMethod(worker_, [this, data, loadedFrom, cb] {
+      auto result = parse(logger_, data, loadedFrom);
+      // dropped if processor is destroyed meanwhile
+      QMetaObject::invokeMethod(this, [cb, result] {
+         cb(result);
+      });
+   });
+}
+
+OhlcHistoryProcessor::Result OhlcHistoryProcessor::parse(const std::shared_ptr<spdlog::logger> &logger
+   , const std::string &data, quint64 loadedFrom)
+{
+   Result result;
+   if (data.empty()) {
+      logger->error("Empty data received from mdhs.");
+      return result;
+   }
+
+   OhlcResponse response;
+   if (!response.ParseFromString(data)) {
+      logger->error("can't parse response from mdhs: {}", data);
+      return result;
+   }
+
+   result.valid = true;
+   result.product = response.product();
+   result.interval = response.interval();
+   result.firstStampInDb = response.first_stamp_in_db();
+
+   result.history.reserve(response.candles_size());
+   for (const auto &candle : response.candles()) {
+      const auto stamp = static_cast<uint64_t>(candle.timestamp());
+      if (loadedFrom && (stamp >= loadedFrom)) {
+         logger->error("Invalid distance between candles from mdhs. The last timestamp: {}  new timestamp: {}"
+            , loadedFrom, stamp);
+         continue;
+      }
+      result.history.push_back({ stamp, candle.open(), candle.high(), candle.low()
+         , candle.close(), candle.volume() });
+   }
+   // mdhs sends newest candles first
+   std::sort(result.history.begin(), result.history.end()
+      , [](const bs::CandleAggregator::Candle &a, const bs::CandleAggregator::Candle &b) {
+         return a.timestamp < b.timestamp;
+   });
+
+   QVector<QCPFinancialData> candles;
+   QVector<QCPBarsData> volumes;
+   candles.reserve(result.history.size());
+   volumes.reserve(result.history.size());
+   const auto addFlatCandles = [&candles, &volumes, interval = result.interval]
+      (const bs::CandleAggregator::Candle &from, uint64_t to)
+   {
+      for (auto stamp = bs::CandleAggregator::nextCandleStart(from.timestamp, interval)
+         ; stamp < to; stamp = bs::CandleAggregator::nextCandleStart(stamp, interval)) {
+         candles.push_back(QCPFinancialData(stamp / 1000.0, from.close, from.close, from.close, from.close));
+         volumes.push_back(QCPBarsData(stamp / 1000.0, 0));
+      }
+   };
+
+   for (size_t i = 0; i < result.history.size(); ++i) {
+      const auto &candle = result.history[i];
+      if (i > 0) {
+         addFlatCandles(result.history[i - 1], candle.timestamp);
+      }
+      candles.push_back(QCPFinancialData(candle.timestamp / 1000.0, candle.open, candle.high
+         , candle.low, candle.close));
+      volumes.push_back(QCPBarsData(candle.timestamp / 1000.0, candle.volume));
+   }
+   if (loadedFrom && !result.history.empty()) {
+      addFlatCandles(result.history.back(), loadedFrom);
+   }
+
+   result.candles = QSharedPointer<QCPFinancialDataContainer>::create();
+   result.candles->add(candles, true);
+   result.volumes = QSharedPointer<QCPBarsDataContainer>::create();
+   result.volumes->add(volumes, true);
+   return result;
+}
@@ -0,0 +1,63 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef OHLC_HISTORY_PROCESSOR_H
+#define OHLC_HISTORY_PROCESSOR_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QObject>
+
+#include "CandleAggregator.h"
+#include "CustomControls/qcustomplot.h"
+
+class QThread;
+namespace spdlog { class logger; }
+
+// Parses MDHS OHLC history responses and fills gaps between candles on the
+// worker thread. Result holds ready to plot containers, so chart only needs
+// to swap (or merge) them on GUI thread.
+class OhlcHistoryProcessor : public QObject
+{
+   Q_OBJECT
+public:
+   struct Result
+   {
+      bool valid{ false };
+      std::string product;
+      int interval{};
+      QSharedPointer<QCPFinancialDataContainer> candles;
+      QSharedPointer<QCPBarsDataContainer> volumes;
+      // Received candles only (no gap fillers), ascending
+      std::vector<bs::CandleAggregator::Candle> history;
+      quint64 firstStampInDb{};
+   };
+   // Called on the thread of OhlcHistoryProcessor's owner
+   using ResultCb = std::function<void(const Result &)>;
+
+   OhlcHistoryProcessor(const std::shared_ptr<spdlog::logger> &, QObject *parent = nullptr);
+   ~OhlcHistoryProcessor() noexcept override;
+
+   // loadedFrom is the timestamp (ms) of the oldest candle already shown or 0
+   void process(const std::string &data, quint64 loadedFrom, const ResultCb &);
+
+   static Result parse(const std::shared_ptr<spdlog::logger> &, const std::string &data
+      , quint64 loadedFrom);
+
+private:
+   std::shared_ptr<spdlog::logger>  logger_;
+   QThread  *thread_;
+   QObject  *worker_;
+};
+
+#endif // OHLC_HISTORY_PROCESSOR_H
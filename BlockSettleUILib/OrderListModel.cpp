@@ -16,6 +16,8 @@
 
 #include "bs_proxy_terminal_pb.pb.h"
 
+#include <unordered_set>
+
 namespace {
 
    const auto kNewOrderColor = QColor{0xFF, 0x7F, 0};
@@ -24,6 +26,19 @@ namespace {
    const auto kSettledColor = QColor{0x22, 0xC0, 0x64};
    const auto kFailedColor = QColor{0xEC, 0x0A, 0x35};
 
+   // Above this number of inserted, moved or removed rows single model reset is cheaper
+   // than separate row notifications
+   const size_t kMaxIncrementalChanges = 64;
+
+   // Proxy doesn't send order ids, so orders are matched by their immutable fields
+   template <class T>
+   std::string orderKey(const T &data)
+   {
+      return std::to_string(data.timestamp_ms()) + '|' + data.product() + '/' + data.product_against()
+         + '|' + std::to_string(static_cast<int>(data.side())) + '|' + std::to_string(data.quantity())
+         + '|' + std::to_string(data.price());
+   }
+
 } // namespace
 
 QString OrderListModel::Header::toString(OrderListModel::Header::Index h)
@@ -366,11 +381,8 @@ void OrderListModel::onDisconnected()
    reset();
 }
 
-void OrderListModel::setOrderStatus(Group *group, int index, const bs::network::Order& order,
-   bool emitUpdate)
+bool OrderListModel::setOrderStatus(Data *rowData, const bs::network::Order& order)
 {
-   assert(index >= 0 && index < group->rows_.size());
-   auto &rowData = group->rows_[static_cast<std::size_t>(index)];
    bool isStatusChanged = false;
 
    auto setNewStatusIfNeeded = [&](QString &&newStatus, QColor newColor) {
@@ -409,27 +421,7 @@ void OrderListModel::setOrderStatus(Group *group, int index, const bs::network::
          break;
    }
 
-   const auto idx = createIndex(index, Header::Status,
-      &group->rows_[static_cast<std::size_t>(index)]->idx_);
-   const auto persistentIdx = QPersistentModelIndex(idx);
-
-   if (isStatusChanged && emitUpdate) {
-      emit dataChanged(idx, idx);
-   }
-
-   if (!latestOrderTimestamp_.isValid() || order.dateTime > latestOrderTimestamp_) {
-      latestOrderTimestamp_ = order.dateTime;
-      emit newOrder(persistentIdx);
-   }
-
-   // We should highlight latest changed if there any
-   // and if not let's highlight the most recent timestamp
-   if (latestChangedTimestamp_.isValid() && order.dateTime == latestChangedTimestamp_) {
-      emit selectRow(persistentIdx);
-   }
-   else if (!latestChangedTimestamp_.isValid() && order.dateTime == latestOrderTimestamp_) {
-      emit selectRow(persistentIdx);
-   }
+   return isStatusChanged;
 }
 
 OrderListModel::StatusGroup::Type OrderListModel::getStatusGroup(const bs::network::Order& order)
@@ -447,114 +439,54 @@ OrderListModel::StatusGroup::Type OrderListModel::getStatusGroup(const bs::netwo
    return StatusGroup::last;
 }
 
-std::pair<OrderListModel::Group*, int> OrderListModel::findItem(const bs::network::Order &order)
+OrderListModel::StatusGroup *OrderListModel::statusGroup(StatusGroup::Type type) const
 {
-   const auto itGroups = groups_.find(order.exchOrderId.toStdString());
-   const auto assetGrpName = tr(bs::network::Asset::toString(order.assetType));
-   StatusGroup *sg = nullptr;
-
-   if (itGroups != groups_.end()) {
-      sg = (itGroups->second == StatusGroup::UnSettled ? unsettled_.get() : settled_.get());
-
-      auto it = std::find_if(sg->rows_.cbegin(), sg->rows_.cend(),
-         [assetGrpName] (const std::unique_ptr<Market> & m) { return (m->name_ == assetGrpName); });
-
-      if (it != sg->rows_.cend()) {
-         auto git = std::find_if((*it)->rows_.cbegin(), (*it)->rows_.cend(),
-            [&order] (const std::unique_ptr<Group> &g)
-               { return (order.security == g->security_.toStdString()); } );
-
-         if (git != (*it)->rows_.cend()) {
-            auto dit = std::find_if((*git)->rows_.cbegin(), (*git)->rows_.cend(),
-               [&order] (const std::unique_ptr<Data> &d) { return (d->id_ == order.exchOrderId); });
-
-            if (dit != (*git)->rows_.cend()) {
-               return std::make_pair(git->get(),
-                  static_cast<int>(std::distance((*git)->rows_.cbegin(), dit)));
-            } else {
-               return std::make_pair(git->get(), -1);
-            }
-         } else {
-            return std::make_pair(nullptr, -1);
-         }
-      } else {
-         return std::make_pair(nullptr, -1);
-      }
-   }
-
-   sg = (getStatusGroup(order) == StatusGroup::UnSettled ? unsettled_.get() : settled_.get());
+   return (type == StatusGroup::UnSettled ? unsettled_.get() : settled_.get());
+}
 
-   auto it = std::find_if(sg->rows_.cbegin(), sg->rows_.cend(),
-      [assetGrpName] (const std::unique_ptr<Market> & g) { return (g->name_ == assetGrpName); });
+OrderListModel::StatusGroup::Type OrderListModel::statusGroupOf(const Data *data) const
+{
+   // Data -> Group -> Market -> StatusGroup
+   const auto sg = static_cast<StatusGroup*>(data->idx_.parent_->parent_->parent_->data_);
+   return static_cast<StatusGroup::Type>(sg->row_);
+}
 
-   if (it != sg->rows_.cend()) {
-      auto git = std::find_if((*it)->rows_.cbegin(), (*it)->rows_.cend(),
-         [&order] (const std::unique_ptr<Group> &g)
-            { return (order.security == g->security_.toStdString()); } );
+int OrderListModel::findRow(Group *group, const Data *data) const
+{
+   const auto row = data->pos_ - group->frontPos_;
+   assert(row >= 0 && row < static_cast<int64_t>(group->rows_.size())
+      && group->rows_[static_cast<size_t>(row)].get() == data);
+   return static_cast<int>(row);
+}
 
-      if (git != (*it)->rows_.cend()) {
-         return std::make_pair(git->get(), -1);
-      } else {
-         return std::make_pair(nullptr, -1);
+void OrderListModel::eraseRow(Group *group, int row)
+{
+   // Keep positions contiguous by shifting whichever side of the erased row is shorter
+   const auto size = static_cast<int>(group->rows_.size());
+   if (row < size - row - 1) {
+      for (int i = 0; i < row; ++i) {
+         ++group->rows_[i]->pos_;
       }
+      ++group->frontPos_;
    } else {
-      return std::make_pair(nullptr, -1);
+      for (int i = row + 1; i < size; ++i) {
+         --group->rows_[i]->pos_;
+      }
    }
+   group->rows_.erase(group->rows_.begin() + row);
 }
 
-void OrderListModel::removeRowIfContainerChanged(const bs::network::Order &order,
-   int &oldOrderRow)
+QModelIndex OrderListModel::orderIndex(Data *data, int column) const
 {
-   // Remove row if container (settled/unsettled) changed.
-   auto git = groups_.find(order.exchOrderId.toStdString());
-
-   if (git != groups_.end() && git->second != getStatusGroup(order) && oldOrderRow >= 0) {
-      StatusGroup *tmpsg = (git->second == StatusGroup::UnSettled ? unsettled_.get() :
-         settled_.get());
-
-      const auto assetGrpName = tr(bs::network::Asset::toString(order.assetType));
-
-      auto mit = std::find_if(tmpsg->rows_.cbegin(), tmpsg->rows_.cend(),
-         [assetGrpName] (const std::unique_ptr<Market> & m) { return (m->name_ == assetGrpName); });
-
-      if (mit != tmpsg->rows_.cend()) {
-         auto git = std::find_if((*mit)->rows_.cbegin(), (*mit)->rows_.cend(),
-            [&order] (const std::unique_ptr<Group> &g)
-               { return (order.security == g->security_.toStdString()); });
-
-         if (git != (*mit)->rows_.cend()) {
-            const auto groupRow = findGroup(mit->get(), git->get());
-            const auto didx = createIndex(groupRow, 0, &(*git)->idx_);
-
-            beginRemoveRows(didx, oldOrderRow, oldOrderRow);
-            (*git)->rows_.erase((*git)->rows_.begin() + oldOrderRow);
-            oldOrderRow = -1;
-            endRemoveRows();
-
-            const auto marketRow = findMarket(tmpsg, mit->get());
-
-            if (!(*git)->rows_.size()) {
-               beginRemoveRows(createIndex(marketRow, 0, &(*mit)->idx_),
-                  groupRow, groupRow);
-               (*mit)->rows_.erase(git);
-               endRemoveRows();
-            }
+   auto group = static_cast<Group*>(data->idx_.parent_->data_);
 
-            if (!(*mit)->rows_.size()) {
-               beginRemoveRows(createIndex(tmpsg->row_, 0, &tmpsg->idx_), marketRow, marketRow);
-               tmpsg->rows_.erase(mit);
-               endRemoveRows();
-            }
-         }
-      }
-   }
+   return createIndex(findRow(group, data), column, &data->idx_);
 }
 
 void OrderListModel::findMarketAndGroup(const bs::network::Order &order, Market *&market,
    Group *&group)
 {
-   StatusGroup *sg = (getStatusGroup(order) == StatusGroup::UnSettled ? unsettled_.get() :
-      settled_.get());
+   StatusGroup *sg = statusGroup(getStatusGroup(order));
 
    const auto assetGrpName = tr(bs::network::Asset::toString(order.assetType));
 
@@ -580,39 +512,136 @@ void OrderListModel::findMarketAndGroup(const bs::network::Order &order, Market
 }
 
 void OrderListModel::createGroupsIfNeeded(const bs::network::Order &order, Market *&marketItem,
-   Group *&groupItem)
+   Group *&groupItem, bool notify)
 {
-   QModelIndex sidx = (getStatusGroup(order) == StatusGroup::UnSettled ?
-      createIndex(0, 0, &unsettled_->idx_) : createIndex(1, 0, &settled_->idx_));
-   StatusGroup *sg = (getStatusGroup(order) == StatusGroup::UnSettled ? unsettled_.get() :
-      settled_.get());
+   StatusGroup *sg = statusGroup(getStatusGroup(order));
+   QModelIndex sidx = createIndex(sg->row_, 0, &sg->idx_);
 
    // Create market if it doesn't exist.
    if (!marketItem) {
-      beginInsertRows(sidx, static_cast<int>(sg->rows_.size()), static_cast<int>(sg->rows_.size()));
+      if (notify) {
+         beginInsertRows(sidx, static_cast<int>(sg->rows_.size()), static_cast<int>(sg->rows_.size()));
+      }
       sg->rows_.push_back(make_unique<Market>(
          tr(bs::network::Asset::toString(order.assetType)), &sg->idx_));
       marketItem = sg->rows_.back().get();
-      endInsertRows();
+      if (notify) {
+         endInsertRows();
+      }
    }
 
    // Create group if it doesn't exist.
    if (!groupItem) {
-      beginInsertRows(createIndex(findMarket(sg, marketItem), 0, &marketItem->idx_),
-         static_cast<int>(marketItem->rows_.size()), static_cast<int>(marketItem->rows_.size()));
+      if (notify) {
+         beginInsertRows(createIndex(findMarket(sg, marketItem), 0, &marketItem->idx_),
+            static_cast<int>(marketItem->rows_.size()), static_cast<int>(marketItem->rows_.size()));
+      }
       marketItem->rows_.push_back(make_unique<Group>(
          QString::fromStdString(order.security), &marketItem->idx_));
       groupItem = marketItem->rows_.back().get();
+      if (notify) {
+         endInsertRows();
+      }
+   }
+}
+
+void OrderListModel::insertOrder(const bs::network::Order &order, bool notify)
+{
+   Group *groupItem = nullptr;
+   Market *marketItem = nullptr;
+
+   findMarketAndGroup(order, marketItem, groupItem);
+
+   createGroupsIfNeeded(order, marketItem, groupItem, notify);
+
+   // As quantity is now could be negative need to invert value
+   double value = - order.quantity * order.price;
+   if (order.security.substr(0, order.security.find('/')) != order.product) {
+      value = order.quantity / order.price;
+   }
+
+   auto rowData = make_unique<Data>(
+      UiUtils::displayTimeMs(order.dateTime),
+      QString::fromStdString(order.product),
+      tr(bs::network::Side::toString(order.side)),
+      UiUtils::displayQty(order.quantity, order.security, order.product, order.assetType),
+      UiUtils::displayPriceForAssetType(order.price, order.assetType),
+      UiUtils::displayValue(value, order.security, order.product, order.assetType),
+      QString(),
+      order.exchOrderId,
+      &groupItem->idx_);
+   setOrderStatus(rowData.get(), order);
+   orders_[order.exchOrderId.toStdString()] = rowData.get();
+
+   if (notify) {
+      beginInsertRows(createIndex(findGroup(marketItem, groupItem), 0, &groupItem->idx_), 0, 0);
+   }
+   rowData->pos_ = --groupItem->frontPos_;
+   groupItem->rows_.push_front(std::move(rowData));
+   if (notify) {
       endInsertRows();
    }
 }
 
+void OrderListModel::removeOrder(Data *data)
+{
+   auto groupItem = static_cast<Group*>(data->idx_.parent_->data_);
+   auto marketItem = static_cast<Market*>(groupItem->idx_.parent_->data_);
+   auto sg = static_cast<StatusGroup*>(marketItem->idx_.parent_->data_);
+
+   const int row = findRow(groupItem, data);
+   const int groupRow = findGroup(marketItem, groupItem);
+   const int marketRow = findMarket(sg, marketItem);
+   assert(row >= 0 && groupRow >= 0 && marketRow >= 0);
+
+   orders_.erase(data->id_.toStdString());
+
+   beginRemoveRows(createIndex(groupRow, 0, &groupItem->idx_), row, row);
+   eraseRow(groupItem, row);
+   endRemoveRows();
+
+   if (groupItem->rows_.empty()) {
+      beginRemoveRows(createIndex(marketRow, 0, &marketItem->idx_), groupRow, groupRow);
+      marketItem->rows_.erase(marketItem->rows_.begin() + groupRow);
+      endRemoveRows();
+   }
+
+   if (marketItem->rows_.empty()) {
+      beginRemoveRows(createIndex(sg->row_, 0, &sg->idx_), marketRow, marketRow);
+      sg->rows_.erase(sg->rows_.begin() + marketRow);
+      endRemoveRows();
+   }
+}
+
+void OrderListModel::updateOrder(Data *data, const bs::network::Order &order)
+{
+   // Move row if container (settled/unsettled) changed.
+   if (statusGroupOf(data) != getStatusGroup(order)) {
+      removeOrder(data);
+      insertOrder(order, true);
+      return;
+   }
+
+   if (setOrderStatus(data, order)) {
+      const auto idx = orderIndex(data, Header::Status);
+      emit dataChanged(idx, idx);
+   }
+}
+
 void OrderListModel::reset()
+{
+   rebuild({});
+}
+
+void OrderListModel::rebuild(const std::vector<bs::network::Order> &orders)
 {
    beginResetModel();
-   groups_.clear();
+   orders_.clear();
    unsettled_ = std::make_unique<StatusGroup>(StatusGroup::toString(StatusGroup::UnSettled), 0);
    settled_ = std::make_unique<StatusGroup>(StatusGroup::toString(StatusGroup::Settled), 1);
+   for (const auto &order : orders) {
+      insertOrder(order, false);
+   }
    endResetModel();
 }
 
@@ -620,12 +649,13 @@ void OrderListModel::processUpdateOrders(const Blocksettle::Communication::Proxy
 {
    // Save latest selected index first
    resetLatestChangedStatus(message);
-   // OrderListModel supposed to work correctly when orders states updated one by one.
-   // We don't use this anymore (server sends all active orders every time) so just clear old caches.
-   // Remove this if old behavior is needed
-   reset();
-   // Use some fake orderId so old code works correctly
-   int orderId = 0;
+
+   // Server sends all active orders every time, so received list is compared with
+   // the shown one and only the difference is applied to the model.
+   std::vector<bs::network::Order> orders;
+   orders.reserve(static_cast<std::size_t>(message.orders_size()));
+   std::unordered_map<std::string, int> keyCount;
+   std::unordered_set<std::string> keys;
 
    for (const auto &data : message.orders()) {
       bs::network::Order order;
@@ -656,8 +686,14 @@ void OrderListModel::processUpdateOrders(const Blocksettle::Communication::Proxy
          order.assetType = bs::network::Asset::SpotFX;
       }
 
-      orderId += 1;
-      order.exchOrderId = QString::number(orderId);
+      // Identical orders are told apart by their position among duplicates
+      auto key = orderKey(data);
+      const int dupIndex = keyCount[key]++;
+      if (dupIndex > 0) {
+         key += "#" + std::to_string(dupIndex);
+      }
+
+      order.exchOrderId = QString::fromStdString(key);
       order.side = bs::network::Side::Type(data.side());
       order.pendingStatus = data.status_text();
       order.dateTime = QDateTime::fromMSecsSinceEpoch(data.timestamp_ms());
@@ -666,7 +702,72 @@ void OrderListModel::processUpdateOrders(const Blocksettle::Communication::Proxy
       order.security = data.product() + "/" + data.product_against();
       order.price = data.price();
 
-      onOrderUpdated(order);
+      keys.insert(std::move(key));
+      orders.push_back(std::move(order));
+   }
+
+   std::vector<Data*> removed;
+   for (const auto &item : orders_) {
+      if (keys.find(item.first) == keys.end()) {
+         removed.push_back(item.second);
+      }
+   }
+
+   std::size_t changes = removed.size();
+   for (const auto &order : orders) {
+      const auto it = orders_.find(order.exchOrderId.toStdString());
+      if ((it == orders_.end()) || (statusGroupOf(it->second) != getStatusGroup(order))) {
+         ++changes;
+      }
+   }
+
+   if (orders_.empty() || (changes > kMaxIncrementalChanges)) {
+      rebuild(orders);
+   } else {
+      for (const auto data : removed) {
+         removeOrder(data);
+      }
+
+      for (const auto &order : orders) {
+         const auto it = orders_.find(order.exchOrderId.toStdString());
+         if (it == orders_.end()) {
+            insertOrder(order, true);
+         } else {
+            updateOrder(it->second, order);
+         }
+      }
+   }
+
+   emitSelection(orders);
+}
+
+void OrderListModel::emitSelection(const std::vector<bs::network::Order> &orders)
+{
+   Data *newest = nullptr;
+   for (const auto &order : orders) {
+      if (!latestOrderTimestamp_.isValid() || order.dateTime > latestOrderTimestamp_) {
+         latestOrderTimestamp_ = order.dateTime;
+         newest = orders_.at(order.exchOrderId.toStdString());
+      }
+   }
+
+   if (newest) {
+      emit newOrder(QPersistentModelIndex(orderIndex(newest, Header::Status)));
+   }
+
+   // We should highlight latest changed if there any
+   // and if not let's highlight the most recent timestamp
+   const auto &selectTimestamp = latestChangedTimestamp_.isValid() ?
+      latestChangedTimestamp_ : latestOrderTimestamp_;
+   Data *selected = nullptr;
+   for (const auto &order : orders) {
+      if (order.dateTime == selectTimestamp) {
+         selected = orders_.at(order.exchOrderId.toStdString());
+      }
+   }
+
+   if (selected) {
+      emit selectRow(QPersistentModelIndex(orderIndex(selected, Header::Status)));
    }
 }
 
@@ -699,49 +800,3 @@ void OrderListModel::resetLatestChangedStatus(const Blocksettle::Communication::
 
    sortedPeviousOrderStatuses_ = std::move(newOrderStatuses);
 }
-
-void OrderListModel::onOrderUpdated(const bs::network::Order& order)
-{
-   auto found = findItem(order);
-
-   Group *groupItem = nullptr;
-   Market *marketItem = nullptr;
-
-   removeRowIfContainerChanged(order, found.second);
-
-   findMarketAndGroup(order, marketItem, groupItem);
-
-   createGroupsIfNeeded(order, marketItem, groupItem);
-
-   groups_[order.exchOrderId.toStdString()] = getStatusGroup(order);
-
-   const auto parentIndex = createIndex(findGroup(marketItem, groupItem), 0, &groupItem->idx_);
-
-   if (found.second < 0) {
-      beginInsertRows(parentIndex, 0, 0);
-
-      // As quantity is now could be negative need to invert value
-      double value = - order.quantity * order.price;
-      if (order.security.substr(0, order.security.find('/')) != order.product) {
-         value = order.quantity / order.price;
-      }
-
-      groupItem->rows_.push_front(make_unique<Data>(
-         UiUtils::displayTimeMs(order.dateTime),
-         QString::fromStdString(order.product),
-         tr(bs::network::Side::toString(order.side)),
-         UiUtils::displayQty(order.quantity, order.security, order.product, order.assetType),
-         UiUtils::displayPriceForAssetType(order.price, order.assetType),
-         UiUtils::displayValue(value, order.security, order.product, order.assetType),
-         QString(),
-         order.exchOrderId,
-         &groupItem->idx_));
-
-      setOrderStatus(groupItem, 0, order);
-
-      endInsertRows();
-   }
-   else {
-      setOrderStatus(groupItem, found.second, order, true);
-   }
-}
@@ -20,6 +20,7 @@
 #include <memory>
 #include <vector>
 #include <deque>
+#include <unordered_map>
 
 namespace Blocksettle {
    namespace Communication {
@@ -101,6 +102,8 @@ private:
       QString id_;
       QColor statusColor_;
       IndexHelper idx_;
+      // Row within the parent group is pos_ - Group::frontPos_
+      int64_t pos_{};
 
       Data(const QString &time, const QString &prod,
          const QString &side, const QString &quantity, const QString &price,
@@ -124,6 +127,8 @@ private:
       std::deque<std::unique_ptr<Data>> rows_;
       QString security_;
       IndexHelper idx_;
+      // Position of rows_.front(), rows are only ever prepended
+      int64_t frontPos_{};
 
       Group(const QString &sec, IndexHelper *parent)
          : security_(sec)
@@ -171,22 +176,31 @@ private:
 
    static StatusGroup::Type getStatusGroup(const bs::network::Order &);
 
-   void onOrderUpdated(const bs::network::Order &);
+   StatusGroup *statusGroup(StatusGroup::Type) const;
+   StatusGroup::Type statusGroupOf(const Data *) const;
    int findGroup(Market *market, Group *group) const;
    int findMarket(StatusGroup *statusGroup, Market *market) const;
-   std::pair<Group*, int> findItem(const bs::network::Order &order);
-   void setOrderStatus(Group *group, int index, const bs::network::Order& order,
-      bool emitUpdate = false);
-   void removeRowIfContainerChanged(const bs::network::Order &order, int &oldOrderRow);
+   int findRow(Group *group, const Data *data) const;
+   void eraseRow(Group *group, int row);
+   QModelIndex orderIndex(Data *, int column) const;
+   bool setOrderStatus(Data *, const bs::network::Order &order);
    void findMarketAndGroup(const bs::network::Order &order, Market *&market, Group *&group);
-   void createGroupsIfNeeded(const bs::network::Order &order, Market *&market, Group *&group);
+   void createGroupsIfNeeded(const bs::network::Order &order, Market *&market, Group *&group
+      , bool notify);
+
+   void insertOrder(const bs::network::Order &, bool notify);
+   void removeOrder(Data *);
+   void updateOrder(Data *, const bs::network::Order &);
 
    void reset();
+   void rebuild(const std::vector<bs::network::Order> &);
    void processUpdateOrders(const Blocksettle::Communication::ProxyTerminalPb::Response_UpdateOrders &msg);
    void resetLatestChangedStatus(const Blocksettle::Communication::ProxyTerminalPb::Response_UpdateOrders &message);
+   void emitSelection(const std::vector<bs::network::Order> &);
 
    std::shared_ptr<AssetManager>    assetManager_;
-   std::unordered_map<std::string, StatusGroup::Type> groups_;
+   // orderId -> row data, row data knows its parents through IndexHelper
+   std::unordered_map<std::string, Data*> orders_;
    std::unique_ptr<StatusGroup> unsettled_;
    std::unique_ptr<StatusGroup> settled_;
    QDateTime latestOrderTimestamp_;
@@ -33,6 +33,7 @@ void OrdersView::initWithModel(OrderListModel *model)
 {
    model_ = model;
    connect(model, &OrderListModel::rowsInserted, this, &OrdersView::onRowsInserted);
+   connect(model, &OrderListModel::modelReset, this, &OrdersView::onModelReset);
    connect(model, &OrderListModel::selectRow, this, &OrdersView::onSelectRow, Qt::QueuedConnection);
 }
 
@@ -91,6 +92,31 @@ void OrdersView::onRowsInserted(const QModelIndex &parent, int first, int)
    }
 }
 
+void OrdersView::onModelReset()
+{
+   // Big updates are applied with model reset, restore expanded state the same way
+   // as for separately inserted rows
+   hasNewItems_.clear();
+   expandChildren(QModelIndex());
+}
+
+void OrdersView::expandChildren(const QModelIndex &parent)
+{
+   for (int row = 0; row < model_->rowCount(parent); ++row) {
+      const auto index = model_->index(row, 0, parent);
+
+      if (!model_->hasChildren(index)) {
+         continue;
+      }
+
+      if (!collapsed_.contains(UiUtils::modelPath(index, model_))) {
+         expand(index);
+      }
+
+      expandChildren(index);
+   }
+}
+
 void OrdersView::onCollapsed(const QModelIndex &index)
 {
    if (index.isValid()) {
@@ -40,11 +40,13 @@ protected:
 private slots:
    void onSelectRow(const QPersistentModelIndex &row);
    void onRowsInserted(const QModelIndex &parent, int, int);
+   void onModelReset();
    void onCollapsed(const QModelIndex &index);
    void onExpanded(const QModelIndex &index);
 
 private:
    void setHasNewItemFlag(const QModelIndex &index, bool value);
+   void expandChildren(const QModelIndex &parent);
 
 private:
    QStringList collapsed_;
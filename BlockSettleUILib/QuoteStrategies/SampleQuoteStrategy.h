@@ -0,0 +1,110 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef SAMPLE_QUOTE_STRATEGY_H
+#define SAMPLE_QUOTE_STRATEGY_H
+
+#include "QuoteStrategy.h"
+
+namespace bs {
+
+   // Native counterpart of Scripts/DealerAutoQuote.qml: follows best price
+   // and replies 1% off indicative price if there is enough balance.
+   class SampleQuoteStrategy : public QuoteStrategy
+   {
+   public:
+      explicit SampleQuoteStrategy(QuoteStrategyReply &reply)
+         : reply_(reply)
+      {}
+
+      void onBestPriceChanged() override
+      {
+         if (isCC() || (reply_.bestPrice() <= 0)) {
+            return;
+         }
+         const auto &req = reply_.request();
+         send(req.isBuy ? reply_.bestPrice() * 0.999 : reply_.bestPrice() * 1.001);
+      }
+
+      void onIndicBidChanged() override
+      {
+         const auto &req = reply_.request();
+         if (isCC() || req.isBuy) {
+            return;
+         }
+         const auto indicBid = reply_.indicBid();
+         if ((prevSendPrice_ > 0) && ((indicBid - prevSendPrice_) >= indicBid * 0.01)) {
+            return;
+         }
+         const auto price = indicBid * 0.99;
+         if ((price > 0) && checkBalance(req.quantity * price, reply_.contraProduct())) {
+            send(price);
+         }
+      }
+
+      void onIndicAskChanged() override
+      {
+         const auto &req = reply_.request();
+         if (isCC() || !req.isBuy) {
+            return;
+         }
+         const auto indicAsk = reply_.indicAsk();
+         if ((prevSendPrice_ > 0) && ((prevSendPrice_ - indicAsk) >= indicAsk * 0.01)) {
+            return;
+         }
+         const auto price = indicAsk * 1.01;
+         if ((price > 0) && checkBalance(req.quantity, req.product)) {
+            send(price);
+         }
+      }
+
+      double prevSendPrice() const { return prevSendPrice_; }
+
+   private:
+      bool isCC() const
+      {
+         return (reply_.request().assetType == 3);   // Don't reply on CC
+      }
+
+      bool checkBalance(double value, const std::string &product)
+      {
+         const auto balance = reply_.accountBalance(product);
+         if (value > balance) {
+            reply_.log("Not enough balance for " + product + ": " + std::to_string(value)
+               + " > " + std::to_string(balance));
+            return false;
+         }
+         return true;
+      }
+
+      void send(double price)
+      {
+         if (reply_.sendQuote(price)) {
+            prevSendPrice_ = price;
+         }
+      }
+
+   private:
+      QuoteStrategyReply   &reply_;
+      double   prevSendPrice_{ 0 };
+   };
+
+   class SampleQuoteStrategyFactory : public QuoteStrategyFactory
+   {
+   public:
+      std::unique_ptr<QuoteStrategy> create(QuoteStrategyReply &reply) override
+      {
+         return std::unique_ptr<QuoteStrategy>(new SampleQuoteStrategy(reply));
+      }
+   };
+
+}  // namespace bs
+
+#endif // SAMPLE_QUOTE_STRATEGY_H
@@ -0,0 +1,13 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "SampleQuoteStrategy.h"
+
+BS_QUOTE_STRATEGY_PLUGIN(bs::SampleQuoteStrategyFactory)
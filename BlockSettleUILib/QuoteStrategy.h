@@ -0,0 +1,125 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef QUOTE_STRATEGY_H
+#define QUOTE_STRATEGY_H
+
+#include <memory>
+#include <string>
+
+// Interface of native (C++) quoting strategies which could be used by
+// autoquoter instead of QML scripts. Strategy is built as a shared library
+// which exports entry points with BS_QUOTE_STRATEGY_PLUGIN macro.
+// Library must be built with the same compiler and C++ runtime as terminal.
+// Header doesn't depend on Qt or other terminal headers on purpose.
+
+namespace bs {
+
+   // Bumped on every incompatible change of the classes below
+   const int kQuoteStrategyApiVersion = 1;
+
+   struct QuoteStrategyRequest
+   {
+      std::string requestId;
+      std::string security;
+      std::string product;
+      bool        isBuy{ false };
+      double      quantity{ 0 };
+      int         assetType{ 0 };  // values of BSQuoteRequest::AssetType
+   };
+
+   struct QuoteStrategyPrices
+   {
+      double bid{ 0 };
+      double ask{ 0 };
+      double last{ 0 };
+   };
+
+   // Provided by terminal, one per quote request. Mirrors BSQuoteReqReply
+   // properties and methods available to QML scripts.
+   class QuoteStrategyReply
+   {
+   public:
+      virtual ~QuoteStrategyReply() = default;
+
+      virtual const QuoteStrategyRequest &request() const = 0;
+      virtual double expirationInSec() const = 0;
+      virtual double indicBid() const = 0;
+      virtual double indicAsk() const = 0;
+      virtual double lastPrice() const = 0;
+      virtual double bestPrice() const = 0;
+      virtual bool isOwnBestPrice() const = 0;
+
+      // Latest market data of any security, zero prices if not received yet
+      virtual QuoteStrategyPrices marketData(const std::string &security) const = 0;
+
+      // Opposite product of the security as compared to request's one
+      virtual std::string contraProduct() const = 0;
+      virtual double accountBalance(const std::string &product) const = 0;
+
+      virtual bool sendQuote(double price) = 0;
+      virtual bool pullQuote() = 0;
+      virtual bool sendExtConn(const std::string &name, const std::string &type
+         , const std::string &message) = 0;
+      virtual void log(const std::string &) = 0;
+   };
+
+   // Implemented by plugin, one instance per quote request (same lifecycle
+   // as BSQuoteReqReply object in QML). All calls come from autoquoter thread.
+   class QuoteStrategy
+   {
+   public:
+      virtual ~QuoteStrategy() = default;
+
+      virtual void onStarted() {}
+      virtual void onExpirationChanged() {}  // ticks every 0.5s until request expiry
+      virtual void onIndicBidChanged() {}
+      virtual void onIndicAskChanged() {}
+      virtual void onLastPriceChanged() {}
+      virtual void onBestPriceChanged() {}
+      virtual void onSettled() {}
+      virtual void onCancelled() {}
+      virtual void onExtDataReceived(const std::string &from, const std::string &type
+         , const std::string &message) {}
+   };
+
+   class QuoteStrategyFactory
+   {
+   public:
+      virtual ~QuoteStrategyFactory() = default;
+
+      // Reply outlives the strategy created for it. Strategies must not keep
+      // references to the factory - it's replaced when strategy is reloaded.
+      virtual std::unique_ptr<QuoteStrategy> create(QuoteStrategyReply &) = 0;
+   };
+
+}  // namespace bs
+
+#if defined(_WIN32)
+#  define BS_QUOTE_STRATEGY_EXPORT extern "C" __declspec(dllexport)
+#else
+#  define BS_QUOTE_STRATEGY_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+#define BS_QUOTE_STRATEGY_VERSION_FUNC "bsQuoteStrategyApiVersion"
+#define BS_QUOTE_STRATEGY_FACTORY_FUNC "bsCreateQuoteStrategyFactory"
+
+// Put once into plugin source with the name of factory class
+#define BS_QUOTE_STRATEGY_PLUGIN(FactoryClass) \
+   BS_QUOTE_STRATEGY_EXPORT int bsQuoteStrategyApiVersion() \
+   { \
+      return bs::kQuoteStrategyApiVersion; \
+   } \
+   BS_QUOTE_STRATEGY_EXPORT bs::QuoteStrategyFactory *bsCreateQuoteStrategyFactory() \
+   { \
+      return new FactoryClass(); \
+   }
+
+#endif // QUOTE_STRATEGY_H
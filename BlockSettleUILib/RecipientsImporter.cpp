@@ -0,0 +1,166 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "RecipientsImporter.h"
+
+#include <QList>
+#include <QThread>
+#include <spdlog/spdlog.h>
+
+namespace {
+   const int kSatoshiDecimals = 8;
+   const uint64_t kSatoshisPerBtc = 100000000;
+   const uint64_t kMaxBtc = 21000000;
+
+   QList<QByteArray> splitLine(const QByteArray &line)
+   {
+      for (const char sep : { ',', ';', '\t' }) {
+         if (line.contains(sep)) {
+            return line.split(sep);
+         }
+      }
+      return { line };
+   }
+
+   QString unquoted(const QByteArray &field)
+   {
+      auto result = QString::fromUtf8(field).trimmed();
+      if ((result.size() >= 2) && result.startsWith(QLatin1Char('"')) && result.endsWith(QLatin1Char('"'))) {
+         result = result.mid(1, result.size() - 2).trimmed();
+      }
+      return result;
+   }
+}
+
+RecipientsImporter::RecipientsImporter(const std::shared_ptr<spdlog::logger> &logger, QObject *parent)
+   : QObject(parent)
+   , logger_(logger)
+   , thread_(new QThread(this))
+   , worker_(new QObject())
+{
+   worker_->moveToThread(thread_);
+   thread_->start();
+}
+
+RecipientsImporter::~RecipientsImporter() noexcept
+{
+   thread_->quit();
+   thread_->wait();
+   delete worker_;
+}
+
+void RecipientsImporter::process(const QByteArray &data, const ResultCb &cb)
+{
+   QMetaObject::invokeMethod(worker_, [this, data, cb] {
+      auto result = parse(data);
+      if (result.nbErrors) {
+         SPDLOG_LOGGER_WARN(logger_, "{} invalid recipients line[s] out of {}"
+            , result.nbErrors, result.nbErrors + result.recipients.size());
+      }
+      // dropped if importer is destroyed meanwhile
+      QMetaObject::invokeMethod(this, [cb, result] {
+         cb(result);
+      });
+   });
+}
+
+RecipientsImporter::Result RecipientsImporter::parse(const QByteArray &data)
+{
+   Result result;
+   const auto lines = data.split('\n');
+   result.recipients.reserve(lines.size());
+
+   const auto addError = [&result](int lineNo, const QString &text) {
+      if (result.errors.size() < kMaxErrors) {
+         result.errors.push_back(tr("line %1: %2").arg(lineNo).arg(text));
+      }
+      result.nbErrors++;
+   };
+
+   bool firstLine = true;
+   for (int i = 0; i < lines.size(); ++i) {
+      const auto line = lines.at(i).trimmed();
+      if (line.isEmpty() || line.startsWith('#')) {
+         continue;
+      }
+      const bool isFirstLine = firstLine;
+      firstLine = false;
+
+      const auto fields = splitLine(line);
+      if (fields.size() != 2) {
+         addError(i + 1, tr("expected address and amount"));
+         continue;
+      }
+      const auto addrStr = unquoted(fields.at(0));
+      const auto amountStr = unquoted(fields.at(1));
+
+      uint64_t amount = 0;
+      const bool amountValid = parseAmount(amountStr, amount);
+
+      bs::Address address;
+      try {
+         address = bs::Address::fromAddressString(addrStr.toStdString());
+      }
+      catch (const std::exception &) {}
+      const bool addressValid = address.isValid() && (address.format() != bs::Address::Format::Hex);
+
+      // Header has neither valid field, recipient with typo in amount is still reported
+      if (isFirstLine && !amountValid && !addressValid) {
+         continue;
+      }
+      if (!amountValid) {
+         addError(i + 1, tr("invalid amount '%1'").arg(amountStr));
+         continue;
+      }
+      if (!addressValid) {
+         addError(i + 1, tr("invalid address '%1'").arg(addrStr));
+         continue;
+      }
+
+      result.totalAmount += amount;
+      result.recipients.push_back({ address, bs::XBTAmount(amount) });
+   }
+   return result;
+}
+
+bool RecipientsImporter::parseAmount(const QString &text, uint64_t &satoshis)
+{
+   const auto str = text.trimmed();
+   const int pointPos = str.indexOf(QLatin1Char('.'));
+   const auto intPart = (pointPos < 0) ? str : str.left(pointPos);
+   const auto fracPart = (pointPos < 0) ? QString{} : str.mid(pointPos + 1);
+   if ((intPart.isEmpty() && fracPart.isEmpty()) || (fracPart.size() > kSatoshiDecimals)
+      || (intPart.size() > 8)) {
+      return false;
+   }
+
+   uint64_t btc = 0;
+   for (const auto &c : intPart) {
+      if (!c.isDigit()) {
+         return false;
+      }
+      btc = btc * 10 + c.digitValue();
+   }
+   uint64_t fraction = 0;
+   for (int i = 0; i < kSatoshiDecimals; ++i) {
+      fraction *= 10;
+      if (i < fracPart.size()) {
+         if (!fracPart.at(i).isDigit()) {
+            return false;
+         }
+         fraction += fracPart.at(i).digitValue();
+      }
+   }
+   if ((btc > kMaxBtc) || (!btc && !fraction)) {
+      return false;
+   }
+   satoshis = btc * kSatoshisPerBtc + fraction;
+   return (satoshis <= kMaxBtc * kSatoshisPerBtc);
+}
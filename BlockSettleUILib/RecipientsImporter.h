@@ -0,0 +1,71 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef RECIPIENTS_IMPORTER_H
+#define RECIPIENTS_IMPORTER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Address.h"
+#include "XBTAmount.h"
+
+namespace spdlog {
+   class logger;
+}
+class QThread;
+
+// Parses and validates batch of payment recipients on a worker thread.
+// CSV has "address,amount" per line with amount in BTC (';' and tab
+// separators are accepted too). Empty lines and lines starting with '#'
+// are skipped, as well as header in the first line (recognized as a line
+// with neither valid address nor valid amount).
+class RecipientsImporter : public QObject
+{
+   Q_OBJECT
+public:
+   struct Recipient
+   {
+      bs::Address    address;
+      bs::XBTAmount  amount;
+   };
+
+   struct Result
+   {
+      std::vector<Recipient>  recipients;
+      std::vector<QString>    errors;        // first kMaxErrors only
+      size_t                  nbErrors{ 0 };
+      uint64_t                totalAmount{ 0 };
+   };
+   using ResultCb = std::function<void(const Result &)>;
+
+   explicit RecipientsImporter(const std::shared_ptr<spdlog::logger> &, QObject *parent = nullptr);
+   ~RecipientsImporter() noexcept override;
+
+   // Callback is called in the thread of importer
+   void process(const QByteArray &data, const ResultCb &);
+
+   static Result parse(const QByteArray &data);
+   // Exact conversion without floating point, false if not a positive amount
+   static bool parseAmount(const QString &, uint64_t &satoshis);
+
+   static const size_t kMaxErrors = 20;
+
+private:
+   std::shared_ptr<spdlog::logger> logger_;
+   QThread  *thread_;
+   QObject  *worker_;
+};
+
+#endif // RECIPIENTS_IMPORTER_H
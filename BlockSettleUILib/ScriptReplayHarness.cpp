@@ -0,0 +1,350 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "ScriptReplayHarness.h"
+
+#include <algorithm>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <spdlog/spdlog.h>
+
+#include "AssetManager.h"
+#include "MDCallbacksQt.h"
+#include "QuoteProvider.h"
+#include "UserScriptRunner.h"
+
+namespace {
+   const int64_t kTickIntervalMs = 500;
+
+   // Don't tick forever if captured expiration times are broken
+   const int64_t kMaxTailMs = 5 * 60 * 1000;
+}
+
+namespace bs {
+
+   // Balances are taken from capture instead of wallets and Celer
+   class ReplayAssetManager : public AssetManager
+   {
+   public:
+      explicit ReplayAssetManager(const std::shared_ptr<spdlog::logger> &logger)
+         : AssetManager(logger, nullptr, nullptr, nullptr)
+      {}
+
+      double getBalance(const std::string &currency
+         , const std::shared_ptr<bs::sync::Wallet> & = nullptr) const override
+      {
+         const auto it = balances_.find(currency);
+         return (it == balances_.end()) ? 0 : it->second;
+      }
+
+      void setBalance(const std::string &currency, double balance)
+      {
+         balances_[currency] = balance;
+      }
+
+      void clear() { balances_.clear(); }
+
+   private:
+      std::map<std::string, double> balances_;
+   };
+
+}  // namespace bs
+
+using namespace bs;
+
+ScriptReplayHarness::ScriptReplayHarness(const std::shared_ptr<spdlog::logger> &logger
+   , QObject *parent)
+   : QObject(parent)
+   , logger_(logger)
+   , mdCallbacks_(std::make_shared<MDCallbacksQt>())
+   , assetManager_(std::make_shared<ReplayAssetManager>(logger))
+   , quoteProvider_(std::make_shared<QuoteProvider>(assetManager_, logger))
+{}
+
+ScriptReplayHarness::~ScriptReplayHarness() = default;
+
+bool ScriptReplayHarness::loadEvents(const QString &captureFile, QString &error)
+{
+   std::vector<ScriptTrafficEvent> events;
+   if (!loadScriptTraffic(captureFile, events, error)) {
+      return false;
+   }
+   setEvents(std::move(events));
+   return true;
+}
+
+void ScriptReplayHarness::setEvents(std::vector<ScriptTrafficEvent> events)
+{
+   events_ = std::move(events);
+   std::stable_sort(events_.begin(), events_.end()
+      , [](const ScriptTrafficEvent &a, const ScriptTrafficEvent &b) {
+      return a.timestamp < b.timestamp;
+   });
+}
+
+void ScriptReplayHarness::reset()
+{
+   requests_.clear();
+   sentRfqs_.clear();
+   mdProcessingUs_ = 0;
+   tickProcessingUs_ = 0;
+   assetManager_->clear();
+   now_ = events_.empty() ? QDateTime::currentMSecsSinceEpoch() : events_.front().timestamp;
+}
+
+bool ScriptReplayHarness::runAQ(const QString &scriptFile, QString &error)
+{
+   reset();
+
+   // Handler is destroyed before the runner (and its idle thread) on exit
+   std::unique_ptr<AQScriptHandler> handler(new AQScriptHandler(quoteProvider_
+      , nullptr, mdCallbacks_, assetManager_, logger_));
+   UserScriptRunner runner(logger_, handler.get(), nullptr);
+   runner.setRunningThread(nullptr);   // keep script objects in this thread
+   handler->setRequireOnlineSigner(false);
+   handler->setSimulatedClock([this] { return QDateTime::fromMSecsSinceEpoch(now_); });
+
+   connect(handler.get(), &AQScriptHandler::sendQuote, this
+      , [this](const bs::network::QuoteReqNotification &qrn, double price) {
+      auto &stats = requests_[qrn.quoteRequestId];
+      stats.quotes.push_back({ now_, price });
+      if (stats.firstReplyDelayMs < 0) {
+         stats.firstReplyDelayMs = now_ - stats.receivedAt;
+      }
+   });
+   connect(handler.get(), &AQScriptHandler::pullQuoteNotif, this
+      , [this](const std::string &, const std::string &reqId, const std::string &) {
+      requests_[reqId].pulls++;
+   });
+
+   if (!loadScript(runner, [&runner, scriptFile] { runner.enable(scriptFile); }, error)) {
+      return false;
+   }
+
+   replay([&handler] { handler->advanceClock(); });
+
+   handler->disconnect(this);   // quotes pulled on unload are not script's decision
+   runner.disable();
+   processEvents();
+   return true;
+}
+
+bool ScriptReplayHarness::runRFQ(const QString &scriptFile, QString &error)
+{
+   reset();
+
+   RFQScriptRunner runner(mdCallbacks_, logger_, nullptr);
+   runner.setRateLimit(0, 0);          // real-time timers are not driven by replay
+   runner.setMDBatchInterval(0);
+   connect(&runner, &RFQScriptRunner::sendRFQ, this
+      , [this](const std::string &id, const QString &symbol, double amount, bool buy) {
+      sentRfqs_.push_back({ now_, id, symbol.toStdString(), amount, buy, false });
+   });
+   connect(&runner, &RFQScriptRunner::cancelRFQ, this, [this](const std::string &id) {
+      for (auto &rfq : sentRfqs_) {
+         if (rfq.id == id) {
+            rfq.cancelled = true;
+         }
+      }
+   });
+
+   if (!loadScript(runner, [&runner, scriptFile] { runner.start(scriptFile); }, error)) {
+      return false;
+   }
+
+   replay({});
+
+   runner.disable();
+   processEvents();
+   return true;
+}
+
+bool ScriptReplayHarness::loadScript(UserScriptRunner &runner
+   , const std::function<void()> &start, QString &error)
+{
+   bool loaded = false;
+   bool failed = false;
+   const auto connLoaded = connect(&runner, &UserScriptRunner::scriptLoaded, this
+      , [&loaded](const QString &) { loaded = true; });
+   const auto connFailed = connect(&runner, &UserScriptRunner::failedToLoad, this
+      , [&failed, &error](const QString &, const QString &err) {
+      failed = true;
+      error = err;
+   });
+
+   start();
+   processEvents();
+
+   disconnect(connLoaded);
+   disconnect(connFailed);
+   if (failed || !loaded) {
+      if (error.isEmpty()) {
+         error = tr("script is not loaded");
+      }
+      return false;
+   }
+   return true;
+}
+
+void ScriptReplayHarness::replay(const std::function<void()> &tick)
+{
+   int64_t nextTick = now_ + kTickIntervalMs;
+   const auto tickUntil = [this, &tick, &nextTick](int64_t timestamp) {
+      if (!tick) {
+         return;
+      }
+      while (nextTick <= timestamp) {
+         now_ = nextTick;
+         tickProcessingUs_ += measure(tick);
+         nextTick += kTickIntervalMs;
+      }
+   };
+
+   int64_t lastExpiration = 0;
+   for (const auto &event : events_) {
+      tickUntil(event.timestamp);
+      now_ = std::max(now_, event.timestamp);
+      if (event.type == ScriptTrafficEvent::Type::QuoteReq) {
+         lastExpiration = std::max(lastExpiration, event.qrn.expirationTime.toMSecsSinceEpoch()
+            + event.qrn.timeSkewMs);
+      }
+      dispatch(event);
+   }
+
+   // Let requests still active at the end of capture expire
+   tickUntil(std::min(lastExpiration + kTickIntervalMs, now_ + kMaxTailMs));
+}
+
+void ScriptReplayHarness::dispatch(const ScriptTrafficEvent &event)
+{
+   const auto reqId = QString::fromStdString(event.reqId);
+   switch (event.type) {
+   case ScriptTrafficEvent::Type::QuoteReq: {
+      auto &stats = requests_[event.qrn.quoteRequestId];
+      if (stats.qrn.quoteRequestId.empty()) {
+         stats.qrn = event.qrn;
+         stats.receivedAt = now_;
+      }
+      stats.processingUs += measure([this, &event] {
+         emit quoteProvider_->quoteReqNotifReceived(event.qrn);
+      });
+      break;
+   }
+
+   case ScriptTrafficEvent::Type::QuoteCancelled:
+      requests_[event.reqId].processingUs += measure([this, &event, &reqId] {
+         emit quoteProvider_->quoteCancelled(reqId, event.flag);
+      });
+      break;
+
+   case ScriptTrafficEvent::Type::QuoteNotifCancelled:
+      requests_[event.reqId].processingUs += measure([this, &reqId] {
+         emit quoteProvider_->quoteNotifCancelled(reqId);
+      });
+      break;
+
+   case ScriptTrafficEvent::Type::QuoteRejected:
+      requests_[event.reqId].processingUs += measure([this, &event, &reqId] {
+         emit quoteProvider_->quoteRejected(reqId, QString::fromStdString(event.text));
+      });
+      break;
+
+   case ScriptTrafficEvent::Type::BestQuotePrice:
+      requests_[event.reqId].processingUs += measure([this, &event, &reqId] {
+         emit quoteProvider_->bestQuotePrice(reqId, event.value, event.flag);
+      });
+      break;
+
+   case ScriptTrafficEvent::Type::MarketData:
+      mdProcessingUs_ += measure([this, &event] {
+         emit mdCallbacks_->MDUpdate(event.assetType, QString::fromStdString(event.text)
+            , event.fields);
+      });
+      break;
+
+   case ScriptTrafficEvent::Type::Balance:
+      assetManager_->setBalance(event.text, event.value);
+      break;
+
+   case ScriptTrafficEvent::Type::Undefined:
+      break;
+   }
+}
+
+int64_t ScriptReplayHarness::measure(const std::function<void()> &cb)
+{
+   QElapsedTimer timer;
+   timer.start();
+   cb();
+   processEvents();
+   return timer.nsecsElapsed() / 1000;
+}
+
+void ScriptReplayHarness::processEvents()
+{
+   // Handlers receive everything through queued connections
+   QCoreApplication::processEvents();
+   QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+QJsonObject ScriptReplayHarness::report() const
+{
+   QJsonArray jsonRequests;
+   int replied = 0;
+   int64_t requestsProcessingUs = 0;
+   for (const auto &req : requests_) {
+      const auto &stats = req.second;
+      QJsonArray jsonQuotes;
+      for (const auto &quote : stats.quotes) {
+         QJsonObject jsonQuote;
+         jsonQuote[QLatin1String("offset_ms")] = static_cast<double>(quote.timestamp - stats.receivedAt);
+         jsonQuote[QLatin1String("price")] = quote.price;
+         jsonQuotes.append(jsonQuote);
+      }
+      QJsonObject jsonReq;
+      jsonReq[QLatin1String("id")] = QString::fromStdString(req.first);
+      jsonReq[QLatin1String("security")] = QString::fromStdString(stats.qrn.security);
+      jsonReq[QLatin1String("product")] = QString::fromStdString(stats.qrn.product);
+      jsonReq[QLatin1String("quantity")] = stats.qrn.quantity;
+      jsonReq[QLatin1String("quotes")] = jsonQuotes;
+      jsonReq[QLatin1String("pulls")] = stats.pulls;
+      jsonReq[QLatin1String("first_reply_ms")] = static_cast<double>(stats.firstReplyDelayMs);
+      jsonReq[QLatin1String("processing_us")] = static_cast<double>(stats.processingUs);
+      jsonRequests.append(jsonReq);
+
+      if (stats.firstReplyDelayMs >= 0) {
+         replied++;
+      }
+      requestsProcessingUs += stats.processingUs;
+   }
+
+   QJsonArray jsonRfqs;
+   for (const auto &rfq : sentRfqs_) {
+      QJsonObject jsonRfq;
+      jsonRfq[QLatin1String("id")] = QString::fromStdString(rfq.id);
+      jsonRfq[QLatin1String("timestamp")] = QString::number(rfq.timestamp);
+      jsonRfq[QLatin1String("security")] = QString::fromStdString(rfq.security);
+      jsonRfq[QLatin1String("amount")] = rfq.amount;
+      jsonRfq[QLatin1String("buy")] = rfq.buy;
+      jsonRfq[QLatin1String("cancelled")] = rfq.cancelled;
+      jsonRfqs.append(jsonRfq);
+   }
+
+   QJsonObject result;
+   result[QLatin1String("requests")] = jsonRequests;
+   result[QLatin1String("requests_replied")] = replied;
+   result[QLatin1String("requests_processing_us")] = static_cast<double>(requestsProcessingUs);
+   result[QLatin1String("md_processing_us")] = static_cast<double>(mdProcessingUs_);
+   result[QLatin1String("tick_processing_us")] = static_cast<double>(tickProcessingUs_);
+   result[QLatin1String("rfqs")] = jsonRfqs;
+   return result;
+}
@@ -0,0 +1,113 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef SCRIPT_REPLAY_HARNESS_H
+#define SCRIPT_REPLAY_HARNESS_H
+
+#include <QJsonObject>
+#include <QObject>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ScriptTraffic.h"
+
+namespace spdlog {
+   class logger;
+}
+class MDCallbacksQt;
+class QuoteProvider;
+class UserScriptRunner;
+
+namespace bs {
+
+   class ReplayAssetManager;
+
+   // Runs AQ or AutoRFQ script over captured traffic without backend connections.
+   // Time is simulated: scripts see timestamps of captured events and AQ
+   // expiration ticks (every 0.5s) happen in between them, so replay runs as
+   // fast as scripts are able to process events. Must be used from the thread
+   // with Qt application (QML engine requirement).
+   class ScriptReplayHarness : public QObject
+   {
+      Q_OBJECT
+   public:
+      struct Quote
+      {
+         int64_t  timestamp;  // simulated, ms since epoch
+         double   price;
+      };
+
+      struct RequestStats
+      {
+         bs::network::QuoteReqNotification   qrn;
+         int64_t              receivedAt{ 0 };
+         std::vector<Quote>   quotes;
+         int                  pulls{ 0 };
+         int64_t              firstReplyDelayMs{ -1 };   // simulated time, -1 if not replied
+         int64_t              processingUs{ 0 };         // wall time of script on request events
+      };
+
+      struct SentRfq
+      {
+         int64_t     timestamp;
+         std::string id;
+         std::string security;
+         double      amount;
+         bool        buy;
+         bool        cancelled;
+      };
+
+      explicit ScriptReplayHarness(const std::shared_ptr<spdlog::logger> &
+         , QObject *parent = nullptr);
+      ~ScriptReplayHarness() override;
+
+      bool loadEvents(const QString &captureFile, QString &error);
+      void setEvents(std::vector<ScriptTrafficEvent>);
+
+      // Both return false if script failed to load
+      bool runAQ(const QString &scriptFile, QString &error);
+      bool runRFQ(const QString &scriptFile, QString &error);
+
+      const std::map<std::string, RequestStats> &requests() const { return requests_; }
+      const std::vector<SentRfq> &sentRfqs() const { return sentRfqs_; }
+      int64_t mdProcessingUs() const { return mdProcessingUs_; }
+      int64_t tickProcessingUs() const { return tickProcessingUs_; }
+
+      QJsonObject report() const;
+
+   private:
+      void reset();
+      bool loadScript(UserScriptRunner &, const std::function<void()> &start, QString &error);
+      void replay(const std::function<void()> &tick);
+      void dispatch(const ScriptTrafficEvent &);
+      int64_t measure(const std::function<void()> &);
+      void processEvents();
+
+   private:
+      std::shared_ptr<spdlog::logger>     logger_;
+      std::shared_ptr<MDCallbacksQt>      mdCallbacks_;
+      std::shared_ptr<ReplayAssetManager> assetManager_;
+      std::shared_ptr<QuoteProvider>      quoteProvider_;
+
+      std::vector<ScriptTrafficEvent>     events_;
+      int64_t  now_{ 0 };
+
+      std::map<std::string, RequestStats> requests_;
+      std::vector<SentRfq>                sentRfqs_;
+      int64_t  mdProcessingUs_{ 0 };
+      int64_t  tickProcessingUs_{ 0 };
+   };
+
+}  // namespace bs
+
+#endif // SCRIPT_REPLAY_HARNESS_H
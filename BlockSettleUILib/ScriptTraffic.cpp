@@ -0,0 +1,369 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "ScriptTraffic.h"
+
+#include <algorithm>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <spdlog/spdlog.h>
+
+#include "AssetManager.h"
+#include "CurrencyPair.h"
+#include "MDCallbacksQt.h"
+#include "QuoteProvider.h"
+
+using namespace bs;
+
+namespace {
+   const std::vector<std::pair<ScriptTrafficEvent::Type, QString>> kTypeNames = {
+      { ScriptTrafficEvent::Type::QuoteReq, QStringLiteral("quote_req") },
+      { ScriptTrafficEvent::Type::QuoteCancelled, QStringLiteral("quote_cancelled") },
+      { ScriptTrafficEvent::Type::QuoteNotifCancelled, QStringLiteral("quote_notif_cancelled") },
+      { ScriptTrafficEvent::Type::QuoteRejected, QStringLiteral("quote_rejected") },
+      { ScriptTrafficEvent::Type::BestQuotePrice, QStringLiteral("best_price") },
+      { ScriptTrafficEvent::Type::MarketData, QStringLiteral("md") },
+      { ScriptTrafficEvent::Type::Balance, QStringLiteral("balance") },
+   };
+
+   QString typeName(ScriptTrafficEvent::Type type)
+   {
+      for (const auto &name : kTypeNames) {
+         if (name.first == type) {
+            return name.second;
+         }
+      }
+      return {};
+   }
+
+   ScriptTrafficEvent::Type typeFromName(const QString &typeName)
+   {
+      for (const auto &name : kTypeNames) {
+         if (name.second == typeName) {
+            return name.first;
+         }
+      }
+      return ScriptTrafficEvent::Type::Undefined;
+   }
+
+   QString str(const std::string &s)
+   {
+      return QString::fromStdString(s);
+   }
+
+   std::string str(const QJsonValue &value)
+   {
+      return value.toString().toStdString();
+   }
+
+   // Timestamps don't fit into double-only JSON numbers precisely enough
+   qint64 int64(const QJsonValue &value)
+   {
+      return value.toString().toLongLong();
+   }
+}
+
+QJsonObject ScriptTrafficEvent::toJson() const
+{
+   QJsonObject result;
+   result[QLatin1String("type")] = typeName(type);
+   result[QLatin1String("ts")] = QString::number(timestamp);
+
+   switch (type) {
+   case Type::QuoteReq:
+      result[QLatin1String("id")] = str(qrn.quoteRequestId);
+      result[QLatin1String("security")] = str(qrn.security);
+      result[QLatin1String("product")] = str(qrn.product);
+      result[QLatin1String("side")] = static_cast<int>(qrn.side);
+      result[QLatin1String("qty")] = qrn.quantity;
+      result[QLatin1String("asset_type")] = static_cast<int>(qrn.assetType);
+      result[QLatin1String("status")] = static_cast<int>(qrn.status);
+      result[QLatin1String("settl_id")] = str(qrn.settlementId);
+      result[QLatin1String("session")] = str(qrn.sessionToken);
+      result[QLatin1String("expiration")] = QString::number(qrn.expirationTime.toMSecsSinceEpoch());
+      result[QLatin1String("time_skew")] = static_cast<int>(qrn.timeSkewMs);
+      break;
+
+   case Type::QuoteCancelled:
+   case Type::QuoteNotifCancelled:
+   case Type::QuoteRejected:
+   case Type::BestQuotePrice:
+      result[QLatin1String("id")] = str(reqId);
+      result[QLatin1String("flag")] = flag;
+      result[QLatin1String("value")] = value;
+      if (!text.empty()) {
+         result[QLatin1String("text")] = str(text);
+      }
+      break;
+
+   case Type::MarketData: {
+      result[QLatin1String("text")] = str(text);
+      result[QLatin1String("asset_type")] = static_cast<int>(assetType);
+      QJsonArray jsonFields;
+      for (const auto &field : fields) {
+         QJsonArray jsonField;
+         jsonField.append(static_cast<int>(field.type));
+         jsonField.append(field.value);
+         jsonFields.append(jsonField);
+      }
+      result[QLatin1String("fields")] = jsonFields;
+      break;
+   }
+
+   case Type::Balance:
+      result[QLatin1String("text")] = str(text);
+      result[QLatin1String("value")] = value;
+      break;
+
+   case Type::Undefined:
+      break;
+   }
+   return result;
+}
+
+ScriptTrafficEvent ScriptTrafficEvent::fromJson(const QJsonObject &obj)
+{
+   ScriptTrafficEvent result;
+   result.type = typeFromName(obj[QLatin1String("type")].toString());
+   result.timestamp = int64(obj[QLatin1String("ts")]);
+   if (result.timestamp <= 0) {
+      result.type = Type::Undefined;
+      return result;
+   }
+
+   switch (result.type) {
+   case Type::QuoteReq: {
+      auto &qrn = result.qrn;
+      qrn.quoteRequestId = str(obj[QLatin1String("id")]);
+      qrn.security = str(obj[QLatin1String("security")]);
+      qrn.product = str(obj[QLatin1String("product")]);
+      qrn.side = static_cast<decltype(qrn.side)>(obj[QLatin1String("side")].toInt());
+      qrn.quantity = obj[QLatin1String("qty")].toDouble();
+      qrn.assetType = static_cast<decltype(qrn.assetType)>(obj[QLatin1String("asset_type")].toInt());
+      qrn.status = static_cast<decltype(qrn.status)>(obj[QLatin1String("status")].toInt());
+      qrn.settlementId = str(obj[QLatin1String("settl_id")]);
+      qrn.sessionToken = str(obj[QLatin1String("session")]);
+      qrn.expirationTime = QDateTime::fromMSecsSinceEpoch(int64(obj[QLatin1String("expiration")]));
+      qrn.timeSkewMs = obj[QLatin1String("time_skew")].toInt();
+      if (qrn.quoteRequestId.empty()) {
+         result.type = Type::Undefined;
+      }
+      break;
+   }
+
+   case Type::QuoteCancelled:
+   case Type::QuoteNotifCancelled:
+   case Type::QuoteRejected:
+   case Type::BestQuotePrice:
+      result.reqId = str(obj[QLatin1String("id")]);
+      result.flag = obj[QLatin1String("flag")].toBool();
+      result.value = obj[QLatin1String("value")].toDouble();
+      result.text = str(obj[QLatin1String("text")]);
+      if (result.reqId.empty()) {
+         result.type = Type::Undefined;
+      }
+      break;
+
+   case Type::MarketData:
+      result.text = str(obj[QLatin1String("text")]);
+      result.assetType = static_cast<bs::network::Asset::Type>(obj[QLatin1String("asset_type")].toInt());
+      for (const auto &jsonField : obj[QLatin1String("fields")].toArray()) {
+         const auto fieldArray = jsonField.toArray();
+         if (fieldArray.size() != 2) {
+            continue;
+         }
+         bs::network::MDField field;
+         field.type = static_cast<decltype(field.type)>(fieldArray.at(0).toInt());
+         field.value = fieldArray.at(1).toDouble();
+         result.fields.push_back(field);
+      }
+      if (result.text.empty()) {
+         result.type = Type::Undefined;
+      }
+      break;
+
+   case Type::Balance:
+      result.text = str(obj[QLatin1String("text")]);
+      result.value = obj[QLatin1String("value")].toDouble();
+      break;
+
+   case Type::Undefined:
+      break;
+   }
+   return result;
+}
+
+bool bs::loadScriptTraffic(const QString &filename, std::vector<ScriptTrafficEvent> &events
+   , QString &error)
+{
+   QFile file(filename);
+   if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+      error = file.errorString();
+      return false;
+   }
+
+   events.clear();
+   int lineNo = 0;
+   while (!file.atEnd()) {
+      const auto line = file.readLine().trimmed();
+      ++lineNo;
+      if (line.isEmpty()) {
+         continue;
+      }
+      QJsonParseError jsonError;
+      const auto doc = QJsonDocument::fromJson(line, &jsonError);
+      if (jsonError.error != QJsonParseError::NoError) {
+         error = QObject::tr("line %1: %2").arg(lineNo).arg(jsonError.errorString());
+         return false;
+      }
+      auto event = ScriptTrafficEvent::fromJson(doc.object());
+      if (event.type == ScriptTrafficEvent::Type::Undefined) {
+         error = QObject::tr("line %1: invalid event").arg(lineNo);
+         return false;
+      }
+      events.push_back(std::move(event));
+   }
+
+   std::stable_sort(events.begin(), events.end()
+      , [](const ScriptTrafficEvent &a, const ScriptTrafficEvent &b) {
+      return a.timestamp < b.timestamp;
+   });
+   return true;
+}
+
+
+ScriptTrafficRecorder::ScriptTrafficRecorder(const std::shared_ptr<spdlog::logger> &logger
+   , const QString &filename
+   , const std::shared_ptr<QuoteProvider> &quoteProvider
+   , const std::shared_ptr<MDCallbacksQt> &mdCallbacks
+   , const std::shared_ptr<AssetManager> &assetManager
+   , QObject *parent)
+   : QObject(parent)
+   , logger_(logger)
+   , assetManager_(assetManager)
+   , file_(filename)
+{
+   if (!file_.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+      logger_->error("[ScriptTrafficRecorder] can't open {}: {}", filename.toStdString()
+         , file_.errorString().toStdString());
+      return;
+   }
+   logger_->info("[ScriptTrafficRecorder] capturing script traffic to {}", filename.toStdString());
+
+   // Queued to keep recording away from the live path, that's what scripts see anyway
+   connect(quoteProvider.get(), &QuoteProvider::quoteReqNotifReceived, this
+      , &ScriptTrafficRecorder::onQuoteReqNotification, Qt::QueuedConnection);
+   connect(quoteProvider.get(), &QuoteProvider::quoteCancelled, this
+      , &ScriptTrafficRecorder::onQuoteCancelled, Qt::QueuedConnection);
+   connect(quoteProvider.get(), &QuoteProvider::quoteNotifCancelled, this
+      , &ScriptTrafficRecorder::onQuoteNotifCancelled, Qt::QueuedConnection);
+   connect(quoteProvider.get(), &QuoteProvider::quoteRejected, this
+      , &ScriptTrafficRecorder::onQuoteRejected, Qt::QueuedConnection);
+   connect(quoteProvider.get(), &QuoteProvider::bestQuotePrice, this
+      , &ScriptTrafficRecorder::onBestQuotePrice, Qt::QueuedConnection);
+   connect(mdCallbacks.get(), &MDCallbacksQt::MDUpdate, this
+      , &ScriptTrafficRecorder::onMDUpdate, Qt::QueuedConnection);
+
+   if (assetManager_) {
+      for (const auto &currency : assetManager_->currencies()) {
+         recordBalance(currency);
+      }
+   }
+}
+
+ScriptTrafficRecorder::~ScriptTrafficRecorder()
+{
+   file_.close();
+}
+
+void ScriptTrafficRecorder::onQuoteReqNotification(const bs::network::QuoteReqNotification &qrn)
+{
+   // Scripts check balances when replying
+   if (assetManager_ && !qrn.security.empty()) {
+      const CurrencyPair cp(qrn.security);
+      recordBalance(cp.NumCurrency());
+      recordBalance(cp.DenomCurrency());
+   }
+
+   ScriptTrafficEvent event;
+   event.type = ScriptTrafficEvent::Type::QuoteReq;
+   event.qrn = qrn;
+   write(event);
+}
+
+void ScriptTrafficRecorder::onQuoteCancelled(const QString &reqId, bool userCancelled)
+{
+   ScriptTrafficEvent event;
+   event.type = ScriptTrafficEvent::Type::QuoteCancelled;
+   event.reqId = reqId.toStdString();
+   event.flag = userCancelled;
+   write(event);
+}
+
+void ScriptTrafficRecorder::onQuoteNotifCancelled(const QString &reqId)
+{
+   ScriptTrafficEvent event;
+   event.type = ScriptTrafficEvent::Type::QuoteNotifCancelled;
+   event.reqId = reqId.toStdString();
+   write(event);
+}
+
+void ScriptTrafficRecorder::onQuoteRejected(const QString &reqId, const QString &reason)
+{
+   ScriptTrafficEvent event;
+   event.type = ScriptTrafficEvent::Type::QuoteRejected;
+   event.reqId = reqId.toStdString();
+   event.text = reason.toStdString();
+   write(event);
+}
+
+void ScriptTrafficRecorder::onBestQuotePrice(const QString reqId, double price, bool own)
+{
+   ScriptTrafficEvent event;
+   event.type = ScriptTrafficEvent::Type::BestQuotePrice;
+   event.reqId = reqId.toStdString();
+   event.value = price;
+   event.flag = own;
+   write(event);
+}
+
+void ScriptTrafficRecorder::onMDUpdate(bs::network::Asset::Type assetType
+   , const QString &security, bs::network::MDFields fields)
+{
+   ScriptTrafficEvent event;
+   event.type = ScriptTrafficEvent::Type::MarketData;
+   event.assetType = assetType;
+   event.text = security.toStdString();
+   event.fields = std::move(fields);
+   write(event);
+}
+
+void ScriptTrafficRecorder::recordBalance(const std::string &currency)
+{
+   if (currency.empty()) {
+      return;
+   }
+   ScriptTrafficEvent event;
+   event.type = ScriptTrafficEvent::Type::Balance;
+   event.text = currency;
+   event.value = assetManager_->getBalance(currency);
+   write(event);
+}
+
+void ScriptTrafficRecorder::write(ScriptTrafficEvent &event)
+{
+   if (!file_.isOpen()) {
+      return;
+   }
+   event.timestamp = QDateTime::currentMSecsSinceEpoch();
+   file_.write(QJsonDocument(event.toJson()).toJson(QJsonDocument::Compact));
+   file_.write("\n");
+}
@@ -0,0 +1,105 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef SCRIPT_TRAFFIC_H
+#define SCRIPT_TRAFFIC_H
+
+#include <QFile>
+#include <QJsonObject>
+#include <QObject>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CommonTypes.h"
+
+namespace spdlog {
+   class logger;
+}
+class AssetManager;
+class MDCallbacksQt;
+class QuoteProvider;
+
+namespace bs {
+
+   // Event delivered to autoquoter/AutoRFQ scripts, one line of JSON in capture file
+   struct ScriptTrafficEvent
+   {
+      enum class Type
+      {
+         Undefined,
+         QuoteReq,
+         QuoteCancelled,
+         QuoteNotifCancelled,
+         QuoteRejected,
+         BestQuotePrice,
+         MarketData,
+         Balance
+      };
+
+      Type     type{ Type::Undefined };
+      int64_t  timestamp{ 0 };   // ms since epoch when terminal received the event
+
+      bs::network::QuoteReqNotification   qrn;  // QuoteReq
+
+      std::string reqId;         // QuoteCancelled, QuoteNotifCancelled, QuoteRejected, BestQuotePrice
+      bool        flag{ false }; // userCancelled for QuoteCancelled, own for BestQuotePrice
+      double      value{ 0 };    // price for BestQuotePrice, amount for Balance
+      std::string text;          // reason for QuoteRejected, security for MD, currency for Balance
+
+      bs::network::Asset::Type   assetType{};   // MarketData
+      bs::network::MDFields      fields;
+
+      QJsonObject toJson() const;
+      static ScriptTrafficEvent fromJson(const QJsonObject &);   // Type::Undefined on error
+   };
+
+   // Reads capture file, events are sorted by timestamp
+   bool loadScriptTraffic(const QString &filename, std::vector<ScriptTrafficEvent> &
+      , QString &error);
+
+
+   // Capture mode of live terminal: writes everything which is delivered to
+   // AQ and RFQ scripts to a file, to be replayed later by ScriptReplayHarness
+   class ScriptTrafficRecorder : public QObject
+   {
+      Q_OBJECT
+   public:
+      ScriptTrafficRecorder(const std::shared_ptr<spdlog::logger> &
+         , const QString &filename
+         , const std::shared_ptr<QuoteProvider> &
+         , const std::shared_ptr<MDCallbacksQt> &
+         , const std::shared_ptr<AssetManager> &
+         , QObject *parent = nullptr);
+      ~ScriptTrafficRecorder() override;
+
+      bool isRecording() const { return file_.isOpen(); }
+
+   private slots:
+      void onQuoteReqNotification(const bs::network::QuoteReqNotification &);
+      void onQuoteCancelled(const QString &reqId, bool userCancelled);
+      void onQuoteNotifCancelled(const QString &reqId);
+      void onQuoteRejected(const QString &reqId, const QString &reason);
+      void onBestQuotePrice(const QString reqId, double price, bool own);
+      void onMDUpdate(bs::network::Asset::Type, const QString &security, bs::network::MDFields);
+
+   private:
+      void recordBalance(const std::string &currency);
+      void write(ScriptTrafficEvent &);
+
+   private:
+      std::shared_ptr<spdlog::logger>  logger_;
+      std::shared_ptr<AssetManager>    assetManager_;
+      QFile    file_;
+   };
+
+}  // namespace bs
+
+#endif // SCRIPT_TRAFFIC_H
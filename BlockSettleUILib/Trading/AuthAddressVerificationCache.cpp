@@ -0,0 +1,214 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "AuthAddressVerificationCache.h"
+
+#include <spdlog/spdlog.h>
+
+using namespace bs;
+
+namespace {
+   const std::string kWatchWalletId = "auth_verification_cache";
+
+   std::shared_ptr<AuthAddressVerificationCache> globalInstance;
+}
+
+AuthAddressVerificationCache::AuthAddressVerificationCache(const std::shared_ptr<spdlog::logger> &logger
+   , const std::shared_ptr<ArmoryConnection> &armory, std::chrono::seconds ttl)
+   : logger_(logger)
+   , armory_(armory)
+   , ttl_(ttl)
+{
+   init(armory_.get());
+}
+
+AuthAddressVerificationCache::~AuthAddressVerificationCache()
+{
+   cleanup();
+   verificator_.reset();
+   if (watchWallet_) {
+      watchWallet_->unregister();
+   }
+}
+
+void AuthAddressVerificationCache::createInstance(const std::shared_ptr<spdlog::logger> &logger
+   , const std::shared_ptr<ArmoryConnection> &armory)
+{
+   globalInstance = std::make_shared<AuthAddressVerificationCache>(logger, armory);
+}
+
+std::shared_ptr<AuthAddressVerificationCache> AuthAddressVerificationCache::instance()
+{
+   return globalInstance;
+}
+
+void AuthAddressVerificationCache::destroyInstance()
+{
+   globalInstance = nullptr;
+}
+
+void AuthAddressVerificationCache::verify(const bs::Address &address
+   , const std::unordered_set<std::string> &bsAddresses, const ResultCb &cb)
+{
+   const auto key = address.display();
+   bool cached = false;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto it = verified_.find(key);
+      if (it != verified_.end()) {
+         if ((Clock::now() - it->second) < ttl_) {
+            cached = true;
+         }
+         else {
+            verified_.erase(it);
+         }
+      }
+   }
+   if (cached) {
+      SPDLOG_LOGGER_DEBUG(logger_, "use cached verification state for {}", key);
+      cb(address, AddressVerificationState::Verified);
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      auto &waiters = pending_[key];
+      waiters.push_back(cb);
+      if (waiters.size() > 1) {
+         return;  // verification is already in progress
+      }
+      pendingGeneration_[key] = generation_;
+
+      if (!verificator_) {
+         verificator_ = std::make_unique<AddressVerificator>(logger_, armory_
+            , [weakThis = std::weak_ptr<AuthAddressVerificationCache>(shared_from_this())]
+            (const bs::Address &address, AddressVerificationState state)
+         {
+            const auto cache = weakThis.lock();
+            if (!cache) {
+               return;
+            }
+            cache->onVerified(address, state);
+         });
+      }
+      if (bsAddresses_ != bsAddresses) {
+         bsAddresses_ = bsAddresses;
+         verificator_->SetBSAddressList(bsAddresses_);
+      }
+   }
+
+   SPDLOG_LOGGER_DEBUG(logger_, "start verification of {}", key);
+   verificator_->addAddress(address);
+   verificator_->startAddressVerification();
+}
+
+std::shared_ptr<AddressVerificator> AuthAddressVerificationCache::verifyAddress(
+   const std::shared_ptr<spdlog::logger> &logger, const std::shared_ptr<ArmoryConnection> &armory
+   , const bs::Address &address, const std::unordered_set<std::string> &bsAddresses, const ResultCb &cb)
+{
+   const auto cache = instance();
+   if (cache) {
+      cache->verify(address, bsAddresses, cb);
+      return nullptr;
+   }
+   auto verificator = std::make_shared<AddressVerificator>(logger, armory, cb);
+   verificator->SetBSAddressList(bsAddresses);
+   verificator->addAddress(address);
+   verificator->startAddressVerification();
+   return verificator;
+}
+
+void AuthAddressVerificationCache::onVerified(const bs::Address &address, AddressVerificationState state)
+{
+   const auto key = address.display();
+   std::vector<ResultCb> cbs;
+   bool isStale = true;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      const auto itGeneration = pendingGeneration_.find(key);
+      isStale = (itGeneration == pendingGeneration_.end())
+         || (itGeneration->second != generation_);
+      if (itGeneration != pendingGeneration_.end()) {
+         pendingGeneration_.erase(itGeneration);
+      }
+      // Result of verification started before invalidation is passed through but not cached
+      if ((state == AddressVerificationState::Verified) && !isStale) {
+         verified_[key] = Clock::now();
+      }
+      const auto it = pending_.find(key);
+      if (it != pending_.end()) {
+         cbs = std::move(it->second);
+         pending_.erase(it);
+      }
+   }
+
+   if ((state == AddressVerificationState::Verified) && !isStale) {
+      watchAddress(address);
+   }
+
+   for (const auto &cb : cbs) {
+      cb(address, state);
+   }
+}
+
+void AuthAddressVerificationCache::watchAddress(const bs::Address &address)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (!watchedAddresses_.insert(address.display()).second) {
+      return;
+   }
+   if (!watchWallet_) {
+      watchWallet_ = armory_->instantiateWallet(kWatchWalletId);
+      if (!watchWallet_) {
+         SPDLOG_LOGGER_WARN(logger_, "can't register watching wallet, revocations will be detected on new block only");
+         return;
+      }
+   }
+   watchWallet_->registerAddresses({ address.prefixed() }, false);
+}
+
+void AuthAddressVerificationCache::invalidate(const bs::Address &address)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   verified_.erase(address.display());
+   generation_++;
+}
+
+void AuthAddressVerificationCache::invalidateAll()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   verified_.clear();
+   generation_++;
+}
+
+size_t AuthAddressVerificationCache::cachedCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return verified_.size();
+}
+
+void AuthAddressVerificationCache::onNewBlock(unsigned int, unsigned int)
+{
+   // Revocation could be mined without being seen as ZC (e.g. while offline)
+   invalidateAll();
+}
+
+void AuthAddressVerificationCache::onZCReceived(const std::string &
+   , const std::vector<bs::TXEntry> &entries)
+{
+   for (const auto &entry : entries) {
+      if (entry.walletIds.find(kWatchWalletId) != entry.walletIds.end()) {
+         SPDLOG_LOGGER_DEBUG(logger_, "ZC on verified auth address, drop cached states");
+         invalidateAll();
+         return;
+      }
+   }
+}
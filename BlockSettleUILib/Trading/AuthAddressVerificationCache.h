@@ -0,0 +1,100 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef AUTH_ADDRESS_VERIFICATION_CACHE_H
+#define AUTH_ADDRESS_VERIFICATION_CACHE_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "AddressVerificator.h"
+#include "ArmoryConnection.h"
+
+namespace spdlog {
+   class logger;
+}
+
+namespace bs {
+
+   // Process-wide cache of counterparty auth address verification results,
+   // shared by settlement containers and OTC client so repeated trades with
+   // the same counterparty do not verify its auth address with Armory again.
+   // Only verified state is cached. Cached results expire after TTL and are
+   // dropped on new block or when ZC touches any of cached addresses (revocation).
+   // Must be owned by std::shared_ptr: verification results hold a weak reference.
+   class AuthAddressVerificationCache : public ArmoryCallbackTarget
+      , public std::enable_shared_from_this<AuthAddressVerificationCache>
+   {
+   public:
+      // Called from any thread
+      using ResultCb = std::function<void(const bs::Address &, AddressVerificationState)>;
+
+      AuthAddressVerificationCache(const std::shared_ptr<spdlog::logger> &
+         , const std::shared_ptr<ArmoryConnection> &
+         , std::chrono::seconds ttl = std::chrono::minutes(30));
+      ~AuthAddressVerificationCache() override;
+
+      static void createInstance(const std::shared_ptr<spdlog::logger> &
+         , const std::shared_ptr<ArmoryConnection> &);
+      static std::shared_ptr<AuthAddressVerificationCache> instance();
+      static void destroyInstance();
+
+      void verify(const bs::Address &, const std::unordered_set<std::string> &bsAddresses
+         , const ResultCb &);
+
+      // Use cache if created, fall back to direct verification otherwise.
+      // Returned verificator (fallback only) must be kept until cb is called.
+      static std::shared_ptr<AddressVerificator> verifyAddress(const std::shared_ptr<spdlog::logger> &
+         , const std::shared_ptr<ArmoryConnection> &, const bs::Address &
+         , const std::unordered_set<std::string> &bsAddresses, const ResultCb &);
+
+      void invalidate(const bs::Address &);
+      void invalidateAll();
+
+      size_t cachedCount() const;
+
+   protected:
+      void onNewBlock(unsigned int height, unsigned int branchHeight) override;
+      void onZCReceived(const std::string &requestId, const std::vector<bs::TXEntry> &) override;
+
+   private:
+      using Clock = std::chrono::steady_clock;
+
+      void onVerified(const bs::Address &, AddressVerificationState);
+      void watchAddress(const bs::Address &);
+
+   private:
+      std::shared_ptr<spdlog::logger>     logger_;
+      std::shared_ptr<ArmoryConnection>   armory_;
+      const std::chrono::seconds          ttl_;
+
+      mutable std::mutex   mutex_;
+      std::unordered_map<std::string, Clock::time_point>       verified_;
+      std::unordered_map<std::string, std::vector<ResultCb>>   pending_;
+      // Generation at which pending verification was started
+      std::unordered_map<std::string, unsigned int>            pendingGeneration_;
+      unsigned int   generation_{ 0 };   // bumped on invalidation, older results are not cached
+      std::unordered_set<std::string>     bsAddresses_;
+      std::unique_ptr<AddressVerificator> verificator_;
+
+      // Cached addresses are registered there to get revocation ZCs
+      std::shared_ptr<AsyncClient::BtcWallet>   watchWallet_;
+      std::unordered_set<std::string>           watchedAddresses_;
+   };
+
+}  // namespace bs
+
+#endif // AUTH_ADDRESS_VERIFICATION_CACHE_H
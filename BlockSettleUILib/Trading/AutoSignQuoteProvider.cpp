@@ -50,6 +50,7 @@ AutoSignScriptProvider::AutoSignScriptProvider(const std::shared_ptr<spdlog::log
 
    connect(scriptRunner_, &UserScriptRunner::scriptLoaded, this, &AutoSignScriptProvider::onScriptLoaded);
    connect(scriptRunner_, &UserScriptRunner::failedToLoad, this, &AutoSignScriptProvider::onScriptFailed);
+   connect(scriptRunner_, &UserScriptRunner::reloadFailed, this, &AutoSignScriptProvider::onScriptReloadFailed);
 
    onSignerStateUpdated();
 
@@ -133,6 +134,11 @@ void AutoSignScriptProvider::init(const QString &filename)
    if (filename.isEmpty()) {
       return;
    }
+   if (scriptLoaded_) {
+      // Swap script in place, running one continues to work if new is broken
+      scriptRunner_->reload(filename);
+      return;
+   }
    scriptLoaded_ = false;
    scriptRunner_->enable(filename);
    emit scriptLoadedChanged();
@@ -174,6 +180,14 @@ void AutoSignScriptProvider::onScriptFailed(const QString &filename, const QStri
    emit scriptHistoryChanged();
 }
 
+void AutoSignScriptProvider::onScriptReloadFailed(const QString &filename, const QString &error)
+{
+   logger_->error("[AutoSignScriptProvider::onScriptReloadFailed] script {} is not reloaded: {}"
+      , filename.toStdString(), error.toStdString());
+   emit scriptReloadFailed(filename, error);
+   emit scriptHistoryChanged();  // restore selection of the running script
+}
+
 void AutoSignScriptProvider::onConnectedToCeler()
 {
    emit autoSignQuoteAvailabilityChanged();
@@ -80,6 +80,7 @@ public slots:
 
    void onScriptLoaded(const QString &filename);
    void onScriptFailed(const QString &filename, const QString &error);
+   void onScriptReloadFailed(const QString &filename, const QString &error);
 
    void onConnectedToCeler();
    void onDisconnectedFromCeler();
@@ -89,6 +90,7 @@ signals:
    void autoSignStateChanged();
    void autoSignQuoteAvailabilityChanged();
    void scriptLoadedChanged();
+   void scriptReloadFailed(const QString &filename, const QString &error);
 
 protected:
    std::shared_ptr<ApplicationSettings>       appSettings_;
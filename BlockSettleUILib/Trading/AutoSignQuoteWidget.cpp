@@ -51,6 +51,8 @@ void AutoSignQuoteWidget::init(const std::shared_ptr<AutoSignScriptProvider> &au
       , this, &AutoSignQuoteWidget::fillScriptHistory);
    connect(autoSignProvider_.get(), &AutoSignScriptProvider::scriptLoadedChanged
       , this, &AutoSignQuoteWidget::validateGUI);
+   connect(autoSignProvider_.get(), &AutoSignScriptProvider::scriptReloadFailed
+      , this, &AutoSignQuoteWidget::onScriptReloadFailed);
 
    ui_->labelAutoSignWalletName->setText(autoSignProvider_->getAutoSignWalletName());
 }
@@ -154,11 +156,18 @@ void AutoSignQuoteWidget::scriptChanged(int curIndex)
       autoSignProvider_->init(scriptFileName);
    } else {
       if (autoSignProvider_->isScriptLoaded()) {
-         autoSignProvider_->deinit();
+         autoSignProvider_->init(ui_->comboBoxAQScript->itemData(curIndex).toString());
       }
    }
 }
 
+void AutoSignQuoteWidget::onScriptReloadFailed(const QString &filename, const QString &error)
+{
+   BSMessageBox(BSMessageBox::warning, tr("Script reload")
+      , tr("Failed to reload %1, previous version continues to run").arg(QFileInfo(filename).fileName())
+      , error, this).exec();
+}
+
 void AutoSignQuoteWidget::onAutoSignToggled()
 {
    if (ui_->checkBoxAutoSign->isChecked()) {
@@ -181,8 +190,19 @@ QString AutoSignQuoteWidget::askForScript()
       lastDir = AutoSignScriptProvider::getDefaultScriptsDir();
    }
 
+   auto filter = tr("QML files (*.qml)");
+   if (qobject_cast<AutoSignAQProvider *>(autoSignProvider_.get())) {
+#if defined(Q_OS_WIN)
+      filter += tr(";;Quoting strategy libraries (*.dll)");
+#elif defined(Q_OS_MACOS)
+      filter += tr(";;Quoting strategy libraries (*.dylib)");
+#else
+      filter += tr(";;Quoting strategy libraries (*.so)");
+#endif
+   }
+
    auto path = QFileDialog::getOpenFileName(this, tr("Open script file")
-      , lastDir, tr("QML files (*.qml)"));
+      , lastDir, filter);
 
    if (!path.isEmpty()) {
       autoSignProvider_->setLastDir(path);
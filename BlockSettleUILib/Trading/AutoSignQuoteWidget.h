@@ -40,6 +40,7 @@ public slots:
 private slots:
    void fillScriptHistory();
    void scriptChanged(int curIndex);
+   void onScriptReloadFailed(const QString &filename, const QString &error);
 
    void onAutoQuoteToggled();
    void onAutoSignToggled();
@@ -14,6 +14,7 @@
 
 #include "BSErrorCodeStrings.h"
 #include "CheckRecipSigner.h"
+#include "SettlementZcRouter.h"
 #include "SignContainer.h"
 #include "SignerDefs.h"
 #include "UiUtils.h"
@@ -35,6 +36,7 @@ DealerCCSettlementContainer::DealerCCSettlementContainer(const std::shared_ptr<s
    , const std::shared_ptr<bs::sync::hd::Wallet> &xbtWallet
    , const std::shared_ptr<SignContainer> &container
    , const std::shared_ptr<ArmoryConnection> &armory
+   , const std::shared_ptr<bs::SettlementZcRouter> &zcRouter
    , const std::shared_ptr<bs::sync::WalletsManager> &walletsMgr
    , std::unique_ptr<bs::hd::Purpose> walletPurpose
    , bs::UtxoReservationToken utxoRes
@@ -47,6 +49,7 @@ DealerCCSettlementContainer::DealerCCSettlementContainer(const std::shared_ptr<s
    , delivery_(order.side == bs::network::Side::Sell)
    , xbtWallet_(xbtWallet)
    , signingContainer_(container)
+   , zcRouter_(zcRouter)
    , walletsMgr_(walletsMgr)
    , ownRecvAddr_(bs::Address::fromAddressString(ownRecvAddr))
    , orderId_(QString::fromStdString(order.clOrderId))
@@ -65,20 +68,24 @@ DealerCCSettlementContainer::DealerCCSettlementContainer(const std::shared_ptr<s
       throw std::invalid_argument("invalid requester transaction");
    }
 
-   init(armory.get());
    settlWallet_ = armory->instantiateWallet(order_.clOrderId);
    if (!settlWallet_) {
       throw std::runtime_error("can't register settlement wallet in armory");
    }
 
+   // Expected TX id is added when own half is signed
+   zcRouteId_ = zcRouter_->addRoute([this](const bs::TXEntry &) {
+      emit completed(id());
+   });
+
    connect(this, &DealerCCSettlementContainer::genAddressVerified, this
       , &DealerCCSettlementContainer::onGenAddressVerified, Qt::QueuedConnection);
 }
 
 DealerCCSettlementContainer::~DealerCCSettlementContainer()
 {
+   zcRouter_->removeRoute(zcRouteId_);
    settlWallet_->unregister();
-   cleanup();
 }
 
 bs::sync::PasswordDialogData DealerCCSettlementContainer::toPasswordDialogData(QDateTime timestamp) const
@@ -118,20 +125,6 @@ bs::sync::PasswordDialogData DealerCCSettlementContainer::toPasswordDialogData(Q
    return dialogData;
 }
 
-void DealerCCSettlementContainer::onZCReceived(const std::string &
-   , const std::vector<bs::TXEntry> &entries)
-{
-   if (expectedTxId_.empty()) {
-      return;
-   }
-   for (const auto &entry : entries) {
-      if (entry.txHash == expectedTxId_) {
-         emit completed(id());
-         break;
-      }
-   }
-}
-
 bool DealerCCSettlementContainer::startSigning(QDateTime timestamp)
 {
    if (!ccWallet_ || !xbtWallet_) {
@@ -159,6 +152,7 @@ bool DealerCCSettlementContainer::startSigning(QDateTime timestamp)
             }
             Signer signer(state);
             expectedTxId_ = signer.getTxId();
+            zcRouter_->watchTx(zcRouteId_, expectedTxId_);
          }
          catch (const std::exception &e) {
             SPDLOG_LOGGER_ERROR(logger, "failed to parse signer state: {}", e.what());
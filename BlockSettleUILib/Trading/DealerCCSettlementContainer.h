@@ -29,13 +29,13 @@ namespace bs {
       class Wallet;
       class WalletsManager;
    }
+   class SettlementZcRouter;
 }
 class ArmoryConnection;
 class SignContainer;
 
 
 class DealerCCSettlementContainer : public bs::SettlementContainer
-   , public ArmoryCallbackTarget
 {
    Q_OBJECT
 public:
@@ -46,6 +46,7 @@ public:
       , const std::shared_ptr<bs::sync::hd::Wallet> &
       , const std::shared_ptr<SignContainer> &
       , const std::shared_ptr<ArmoryConnection> &
+      , const std::shared_ptr<bs::SettlementZcRouter> &
       , const std::shared_ptr<bs::sync::WalletsManager> &walletsMgr
       , std::unique_ptr<bs::hd::Purpose> walletPurpose
       , bs::UtxoReservationToken utxoRes
@@ -85,7 +86,6 @@ private slots:
 private:
    std::string txComment();
    void sendFailed();
-   void onZCReceived(const std::string &, const std::vector<bs::TXEntry> &) override;
 
 private:
    std::shared_ptr<spdlog::logger>     logger_;
@@ -95,6 +95,8 @@ private:
    const bool                 delivery_;
    std::shared_ptr<bs::sync::hd::Wallet>   xbtWallet_;
    std::shared_ptr<SignContainer>      signingContainer_;
+   std::shared_ptr<bs::SettlementZcRouter>   zcRouter_;
+   uint64_t                            zcRouteId_{};
    std::shared_ptr<bs::sync::WalletsManager> walletsMgr_;
    Codec_SignerState::SignerState   txReqData_;
    const bs::Address ownRecvAddr_;
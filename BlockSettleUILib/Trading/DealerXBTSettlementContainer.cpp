@@ -11,9 +11,12 @@
 #include "DealerXBTSettlementContainer.h"
 
 #include "AuthAddressManager.h"
+#include "AuthAddressVerificationCache.h"
 #include "CheckRecipSigner.h"
 #include "CurrencyPair.h"
+#include "PrebuiltPayin.h"
 #include "QuoteProvider.h"
+#include "SettlementZcRouter.h"
 #include "TradesUtils.h"
 #include "TradesVerification.h"
 #include "UiUtils.h"
@@ -37,6 +40,7 @@ DealerXBTSettlementContainer::DealerXBTSettlementContainer(const std::shared_ptr
    , const std::shared_ptr<QuoteProvider> &quoteProvider
    , const std::shared_ptr<WalletSignerContainer> &container
    , const std::shared_ptr<ArmoryConnection> &armory
+   , const std::shared_ptr<bs::SettlementZcRouter> &zcRouter
    , const std::shared_ptr<AuthAddressManager> &authAddrMgr
    , const bs::Address &authAddr
    , const std::vector<UTXO> &utxosPayinFixed
@@ -44,6 +48,7 @@ DealerXBTSettlementContainer::DealerXBTSettlementContainer(const std::shared_ptr
    , const std::shared_ptr<bs::UTXOReservationManager> &utxoReservationManager
    , std::unique_ptr<bs::hd::Purpose> walletPurpose
    , bs::UtxoReservationToken utxoRes
+   , const std::shared_ptr<bs::PrebuiltPayin> &prebuiltPayin
    , bool expandTxDialogInfo
    , uint64_t tier1XbtLimit )
    : bs::SettlementContainer(std::move(utxoRes), std::move(walletPurpose), expandTxDialogInfo)
@@ -52,11 +57,13 @@ DealerXBTSettlementContainer::DealerXBTSettlementContainer(const std::shared_ptr
    , amount_((order.product != bs::network::XbtCurrency) ? order.quantity / order.price : order.quantity)
    , logger_(logger)
    , armory_(armory)
+   , zcRouter_(zcRouter)
    , walletsMgr_(walletsMgr)
    , xbtWallet_(xbtWallet)
    , signContainer_(container)
    , authAddrMgr_(authAddrMgr)
    , utxosPayinFixed_(utxosPayinFixed)
+   , prebuiltPayin_(prebuiltPayin)
    , recvAddr_(recvAddr)
    , authAddr_(authAddr)
    , utxoReservationManager_(utxoReservationManager)
@@ -90,7 +97,6 @@ DealerXBTSettlementContainer::DealerXBTSettlementContainer(const std::shared_ptr
       throw std::runtime_error("missing auth key");
    }
 
-   init(armory_.get());
    settlementIdHex_ = qn.settlementId;
    settlementId_ = BinaryData::CreateFromHex(qn.settlementId);
    settlWallet_ = armory_->instantiateWallet(settlementIdHex_);
@@ -98,6 +104,12 @@ DealerXBTSettlementContainer::DealerXBTSettlementContainer(const std::shared_ptr
       throw std::runtime_error("can't register settlement wallet in armory");
    }
 
+   // Pay-in and pay-out both go through settlement wallet
+   zcRouteId_ = zcRouter_->addRoute([this](const bs::TXEntry &entry) {
+      onZCReceived(entry);
+   });
+   zcRouter_->watchWallet(zcRouteId_, settlementIdHex_);
+
    connect(signContainer_.get(), &SignContainer::TXSigned, this, &DealerXBTSettlementContainer::onTXSigned);
 }
 
@@ -108,6 +120,7 @@ bool DealerXBTSettlementContainer::cancel()
    }
 
    releaseUtxoRes();
+   prebuiltPayin_.reset();
 
    SPDLOG_LOGGER_DEBUG(logger_, "cancel on a trade : {}", settlementIdHex_);
 
@@ -117,8 +130,8 @@ bool DealerXBTSettlementContainer::cancel()
 
 DealerXBTSettlementContainer::~DealerXBTSettlementContainer()
 {
+   zcRouter_->removeRoute(zcRouteId_);
    settlWallet_->unregister();
-   cleanup();
 }
 
 bs::sync::PasswordDialogData DealerXBTSettlementContainer::toPasswordDialogData(QDateTime timestamp) const
@@ -177,36 +190,32 @@ void DealerXBTSettlementContainer::activate()
 {
    startTimer(kWaitTimeoutInSec);
 
-   addrVerificator_ = std::make_shared<AddressVerificator>(logger_, armory_
-      , [this, handle = validityFlag_.handle()](const bs::Address &address, AddressVerificationState state)
-   {
-      QMetaObject::invokeMethod(qApp, [this, handle, address, state] {
-         if (!handle.isValid()) {
-            return;
-         }
-
-         SPDLOG_LOGGER_INFO(logger_, "counterparty's address verification {} for {}"
-            , to_string(state), address.display());
-         requestorAddressState_ = state;
-
-         if (state == AddressVerificationState::Verified) {
-            // we verify only requester's auth address
-            bs::sync::PasswordDialogData dialogData;
-            dialogData.setValue(PasswordDialogData::RequesterAuthAddressVerified, true);
-            dialogData.setValue(PasswordDialogData::SettlementId, settlementId_.toHexStr());
-            dialogData.setValue(PasswordDialogData::SigningAllowed, true);
-
-            signContainer_->updateDialogData(dialogData);
-         }
-      });
-   });
-
-   addrVerificator_->SetBSAddressList(authAddrMgr_->GetBSAddresses());
-
    if (requesterAddressShouldBeVerified_) {
       const auto reqAuthAddrSW = bs::Address::fromPubKey(reqAuthKey_, AddressEntryType_P2WPKH);
-      addrVerificator_->addAddress(reqAuthAddrSW);
-      addrVerificator_->startAddressVerification();
+      addrVerificator_ = bs::AuthAddressVerificationCache::verifyAddress(logger_, armory_
+         , reqAuthAddrSW, authAddrMgr_->GetBSAddresses()
+         , [this, handle = validityFlag_.handle()](const bs::Address &address, AddressVerificationState state)
+      {
+         QMetaObject::invokeMethod(qApp, [this, handle, address, state] {
+            if (!handle.isValid()) {
+               return;
+            }
+
+            SPDLOG_LOGGER_INFO(logger_, "counterparty's address verification {} for {}"
+               , to_string(state), address.display());
+            requestorAddressState_ = state;
+
+            if (state == AddressVerificationState::Verified) {
+               // we verify only requester's auth address
+               bs::sync::PasswordDialogData dialogData;
+               dialogData.setValue(PasswordDialogData::RequesterAuthAddressVerified, true);
+               dialogData.setValue(PasswordDialogData::SettlementId, settlementId_.toHexStr());
+               dialogData.setValue(PasswordDialogData::SigningAllowed, true);
+
+               signContainer_->updateDialogData(dialogData);
+            }
+         });
+      });
    } else {
       requestorAddressState_ = AddressVerificationState::Verified;
    }
@@ -310,8 +319,7 @@ void DealerXBTSettlementContainer::onTXSigned(unsigned int idReq, BinaryData sig
    }
 }
 
-void DealerXBTSettlementContainer::onZCReceived(const std::string &
-   , const std::vector<bs::TXEntry> &entries)
+void DealerXBTSettlementContainer::onZCReceived(const bs::TXEntry &entry)
 {
    const auto &cbTX = [this](const Tx &tx)
    {
@@ -338,15 +346,10 @@ void DealerXBTSettlementContainer::onZCReceived(const std::string &
       }
    };
    
-   for (const auto &entry : entries) {
-      if (entry.walletIds.find(settlementIdHex_) == entry.walletIds.end()) {
-         continue;
-      }
-      if (entry.txHash == expectedPayinHash_) {
-         continue;   // not interested in pay-in
-      }
-      armory_->getTxByHash(entry.txHash, cbTX, true);
+   if (entry.txHash == expectedPayinHash_) {
+      return;   // not interested in pay-in
    }
+   armory_->getTxByHash(entry.txHash, cbTX, true);
 }
 
 void DealerXBTSettlementContainer::onUnsignedPayinRequested(const std::string& settlementId)
@@ -361,6 +364,34 @@ void DealerXBTSettlementContainer::onUnsignedPayinRequested(const std::string& s
       return;
    }
 
+   if (prebuiltPayin_ && prebuiltPayin_->matches(settlementId_, bs::XBTAmount(amount_))) {
+      prebuiltPayin_->getResult([this, settlementId, handle = validityFlag_.handle()]
+         (const bs::tradeutils::PayinResult &result)
+      {
+         if (!handle.isValid()) {
+            return;
+         }
+         if (!result.success) {
+            SPDLOG_LOGGER_WARN(logger_, "prebuilt payin is not usable on {}, create new one", settlementIdHex_);
+            createPayin(settlementId);
+            return;
+         }
+         SPDLOG_LOGGER_DEBUG(logger_, "use prebuilt payin on {}", settlementIdHex_);
+         if (utxosPayinFixed_.empty()) {
+            utxoRes_ = prebuiltPayin_->takeReservation();
+         }
+         onPayinCreated(result);
+      });
+      return;
+   }
+
+   // Trade details were changed since quote was sent (or nothing was prebuilt)
+   prebuiltPayin_.reset();
+   createPayin(settlementId);
+}
+
+void DealerXBTSettlementContainer::createPayin(const std::string &settlementId)
+{
    bs::tradeutils::PayinArgs args;
    initTradesArgs(args, settlementId);
    args.fixedInputs = utxosPayinFixed_;
@@ -393,26 +424,32 @@ void DealerXBTSettlementContainer::onUnsignedPayinRequested(const std::string& s
             return;
          }
 
-         settlAddr_ = result.settlementAddr;
-         settlWallet_->registerAddresses({ settlAddr_.prefixed() }, true);
-
-         unsignedPayinRequest_ = std::move(result.signRequest);
          // Reserve only automatic UTXO selection
          if (utxosPayinFixed_.empty()) {
-            utxoRes_ = utxoReservationManager_->makeNewReservation(unsignedPayinRequest_.getInputs(nullptr), id());
+            utxoRes_ = utxoReservationManager_->makeNewReservation(result.signRequest.getInputs(nullptr), id());
          }
 
-         emit sendUnsignedPayinToPB(settlementIdHex_
-            , bs::network::UnsignedPayinData{ unsignedPayinRequest_.serializeState().SerializeAsString() });
-
-         const auto &authLeaf = walletsMgr_->getAuthWallet();
-         signContainer_->setSettlCP(authLeaf->walletId(), result.payinHash, settlementId_, reqAuthKey_);
+         onPayinCreated(result);
       });
    });
 
    bs::tradeutils::createPayin(std::move(args), std::move(payinCb));
 }
 
+void DealerXBTSettlementContainer::onPayinCreated(const bs::tradeutils::PayinResult &result)
+{
+   settlAddr_ = result.settlementAddr;
+   settlWallet_->registerAddresses({ settlAddr_.prefixed() }, true);
+
+   unsignedPayinRequest_ = result.signRequest;
+
+   emit sendUnsignedPayinToPB(settlementIdHex_
+      , bs::network::UnsignedPayinData{ unsignedPayinRequest_.serializeState().SerializeAsString() });
+
+   const auto &authLeaf = walletsMgr_->getAuthWallet();
+   signContainer_->setSettlCP(authLeaf->walletId(), result.payinHash, settlementId_, reqAuthKey_);
+}
+
 void DealerXBTSettlementContainer::onSignedPayoutRequested(const std::string& settlementId
    , const BinaryData& payinHash, QDateTime timestamp)
 {
@@ -32,7 +32,10 @@ namespace bs {
    }
    namespace tradeutils {
       struct Args;
+      struct PayinResult;
    }
+   class PrebuiltPayin;
+   class SettlementZcRouter;
    class UTXOReservationManager;
 }
 class ArmoryConnection;
@@ -42,7 +45,6 @@ class WalletSignerContainer;
 
 
 class DealerXBTSettlementContainer : public bs::SettlementContainer
-   , public ArmoryCallbackTarget
 {
    Q_OBJECT
 public:
@@ -53,6 +55,7 @@ public:
       , const std::shared_ptr<QuoteProvider> &
       , const std::shared_ptr<WalletSignerContainer> &
       , const std::shared_ptr<ArmoryConnection> &
+      , const std::shared_ptr<bs::SettlementZcRouter> &
       , const std::shared_ptr<AuthAddressManager> &authAddrMgr
       , const bs::Address &authAddr
       , const std::vector<UTXO> &utxosPayinFixed
@@ -60,6 +63,7 @@ public:
       , const std::shared_ptr<bs::UTXOReservationManager> &utxoReservationManager
       , std::unique_ptr<bs::hd::Purpose> walletPurpose
       , bs::UtxoReservationToken utxoRes
+      , const std::shared_ptr<bs::PrebuiltPayin> &prebuiltPayin
       , bool expandTxDialogInfo
       , uint64_t tier1XbtLimit);
    ~DealerXBTSettlementContainer() override;
@@ -101,7 +105,10 @@ private:
 
    void initTradesArgs(bs::tradeutils::Args &args, const std::string &settlementId);
 
-   void onZCReceived(const std::string &, const std::vector<bs::TXEntry> &) override;
+   void createPayin(const std::string &settlementId);
+   void onPayinCreated(const bs::tradeutils::PayinResult &);
+
+   void onZCReceived(const bs::TXEntry &);
 
 private:
    const bs::network::Order   order_;
@@ -112,6 +119,8 @@ private:
 
    std::shared_ptr<spdlog::logger>              logger_;
    std::shared_ptr<ArmoryConnection>            armory_;
+   std::shared_ptr<bs::SettlementZcRouter>      zcRouter_;
+   uint64_t                                     zcRouteId_{};
    std::shared_ptr<bs::sync::WalletsManager>    walletsMgr_;
    std::shared_ptr<bs::sync::hd::Wallet>        xbtWallet_;
    std::shared_ptr<AddressVerificator>          addrVerificator_;
@@ -135,6 +144,7 @@ private:
    BinaryData        expectedPayinHash_;
 
    std::vector<UTXO> utxosPayinFixed_;
+   std::shared_ptr<bs::PrebuiltPayin>  prebuiltPayin_;
    bs::Address       recvAddr_;
    bs::Address       authAddr_;
 
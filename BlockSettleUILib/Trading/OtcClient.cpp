@@ -18,6 +18,7 @@
 
 #include "AddressVerificator.h"
 #include "AuthAddressManager.h"
+#include "AuthAddressVerificationCache.h"
 #include "BtcUtils.h"
 #include "CommonTypes.h"
 #include "EncryptionUtils.h"
@@ -69,7 +70,7 @@ struct OtcClientDeal
    bool success{false};
    std::string errorMsg;
 
-   std::unique_ptr<AddressVerificator> addressVerificator;
+   std::shared_ptr<AddressVerificator> addressVerificator;
 
    bs::network::otc::PeerPtr peer;
    ValidityHandle peerHandle;
@@ -1759,10 +1760,8 @@ void OtcClient::verifyAuthAddresses(OtcClientDeal *deal)
    };
 
    if (authAddressVerificationRequired(deal)) {
-      deal->addressVerificator = std::make_unique<AddressVerificator>(logger_, armory_, verificatorCb);
-      deal->addressVerificator->SetBSAddressList(authAddressManager_->GetBSAddresses());
-      deal->addressVerificator->addAddress(deal->cpAuthAddress());
-      deal->addressVerificator->startAddressVerification();
+      deal->addressVerificator = bs::AuthAddressVerificationCache::verifyAddress(logger_, armory_
+         , deal->cpAuthAddress(), authAddressManager_->GetBSAddresses(), verificatorCb);
    } else {
       verificatorCb(deal->cpAuthAddress(), AddressVerificationState::Verified);
    }
@@ -0,0 +1,106 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "PrebuiltPayin.h"
+
+#include <QApplication>
+
+#include <spdlog/spdlog.h>
+
+#include "UtxoReservationManager.h"
+
+using namespace bs;
+
+std::shared_ptr<PrebuiltPayin> PrebuiltPayin::create(const std::shared_ptr<spdlog::logger> &logger
+   , const std::shared_ptr<UTXOReservationManager> &utxoReservationManager
+   , tradeutils::PayinArgs args, const std::string &reserveId)
+{
+   // Manual inputs should be already reserved
+   const bool reserveInputs = args.fixedInputs.empty();
+   std::shared_ptr<PrebuiltPayin> result(new PrebuiltPayin(logger, utxoReservationManager
+      , args.settlementId, args.amount, reserveId, reserveInputs));
+   result->start(std::move(args));
+   return result;
+}
+
+PrebuiltPayin::PrebuiltPayin(const std::shared_ptr<spdlog::logger> &logger
+   , const std::shared_ptr<UTXOReservationManager> &utxoReservationManager
+   , const BinaryData &settlementId, const bs::XBTAmount &amount
+   , const std::string &reserveId, bool reserveInputs)
+   : logger_(logger)
+   , utxoReservationManager_(utxoReservationManager)
+   , settlementId_(settlementId)
+   , amount_(amount)
+   , reserveId_(reserveId)
+   , reserveInputs_(reserveInputs)
+{}
+
+PrebuiltPayin::~PrebuiltPayin() = default;
+
+void PrebuiltPayin::start(tradeutils::PayinArgs args)
+{
+   SPDLOG_LOGGER_DEBUG(logger_, "prebuild payin for {}", settlementId_.toHexStr());
+
+   auto payinCb = tradeutils::PayinResultCb([weakThis = std::weak_ptr<PrebuiltPayin>(shared_from_this())]
+      (tradeutils::PayinResult result)
+   {
+      QMetaObject::invokeMethod(qApp, [weakThis, result = std::move(result)]() mutable {
+         auto payin = weakThis.lock();
+         if (!payin) {
+            return;
+         }
+         payin->onResult(std::move(result));
+      });
+   });
+
+   tradeutils::createPayin(std::move(args), std::move(payinCb));
+}
+
+void PrebuiltPayin::onResult(tradeutils::PayinResult result)
+{
+   if (result.success) {
+      if (reserveInputs_) {
+         utxoRes_ = utxoReservationManager_->makeNewReservation(
+            result.signRequest.getInputs(nullptr), reserveId_);
+      }
+   }
+   else {
+      SPDLOG_LOGGER_WARN(logger_, "prebuilding payin for {} failed: {}"
+         , settlementId_.toHexStr(), result.errorMsg);
+   }
+
+   result_ = std::move(result);
+   ready_ = true;
+
+   auto cbs = std::move(pendingCbs_);
+   pendingCbs_.clear();
+   for (const auto &cb : cbs) {
+      cb(result_);
+   }
+}
+
+bool PrebuiltPayin::matches(const BinaryData &settlementId, const bs::XBTAmount &amount) const
+{
+   return (settlementId_ == settlementId) && (amount_.GetValue() == amount.GetValue());
+}
+
+void PrebuiltPayin::getResult(ResultCb cb)
+{
+   if (ready_) {
+      cb(result_);
+      return;
+   }
+   pendingCbs_.push_back(std::move(cb));
+}
+
+UtxoReservationToken PrebuiltPayin::takeReservation()
+{
+   return std::move(utxoRes_);
+}
@@ -0,0 +1,82 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef PREBUILT_PAYIN_H
+#define PREBUILT_PAYIN_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TradesUtils.h"
+#include "UtxoReservationToken.h"
+
+namespace spdlog {
+   class logger;
+}
+
+namespace bs {
+   class UTXOReservationManager;
+
+   // Unsigned XBT settlement pay-in which is built in advance (when quote is sent
+   // by dealer or accepted by requester). Settlement container could then answer
+   // PB's unsigned pay-in request without waiting for UTXO selection and TX creation.
+   // Automatically selected inputs are reserved as soon as pay-in is built.
+   // Should be used from the main thread only.
+   class PrebuiltPayin : public std::enable_shared_from_this<PrebuiltPayin>
+   {
+   public:
+      using ResultCb = std::function<void(const tradeutils::PayinResult &)>;
+
+      static std::shared_ptr<PrebuiltPayin> create(const std::shared_ptr<spdlog::logger> &
+         , const std::shared_ptr<UTXOReservationManager> &
+         , tradeutils::PayinArgs args, const std::string &reserveId);
+
+      ~PrebuiltPayin();
+
+      // Pay-in could be used only if trade details were not changed since it was built
+      bool matches(const BinaryData &settlementId, const bs::XBTAmount &amount) const;
+
+      bool isReady() const { return ready_; }
+
+      // Callback is called immediately if pay-in is already built or later from the main thread
+      void getResult(ResultCb);
+
+      // Reservation of automatically selected inputs (empty if fixed inputs were used)
+      UtxoReservationToken takeReservation();
+
+   private:
+      PrebuiltPayin(const std::shared_ptr<spdlog::logger> &
+         , const std::shared_ptr<UTXOReservationManager> &
+         , const BinaryData &settlementId, const bs::XBTAmount &amount
+         , const std::string &reserveId, bool reserveInputs);
+
+      void start(tradeutils::PayinArgs args);
+      void onResult(tradeutils::PayinResult result);
+
+   private:
+      std::shared_ptr<spdlog::logger>           logger_;
+      std::shared_ptr<UTXOReservationManager>   utxoReservationManager_;
+
+      const BinaryData     settlementId_;
+      const bs::XBTAmount  amount_;
+      const std::string    reserveId_;
+      const bool           reserveInputs_;
+
+      bool                       ready_{false};
+      tradeutils::PayinResult    result_;
+      UtxoReservationToken       utxoRes_;
+      std::vector<ResultCb>      pendingCbs_;
+   };
+
+}  // namespace bs
+
+#endif // PREBUILT_PAYIN_H
@@ -0,0 +1,231 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "QuoteLatencyTracer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include <spdlog/spdlog.h>
+
+using namespace bs;
+
+constexpr std::array<std::chrono::microseconds::rep, 12> QuoteLatencyTracer::kBucketBoundsUs;
+constexpr size_t QuoteLatencyTracer::kMaxActiveSpans;
+
+namespace {
+
+   void printHistogram(std::ostringstream &out, const char *name
+      , const QuoteLatencyTracer::Histogram &hist)
+   {
+      out << std::left << std::setw(16) << name << std::right
+         << " count=" << hist.count;
+      if (hist.count == 0) {
+         out << '\n';
+         return;
+      }
+      out << " avg=" << hist.average().count() << "us"
+         << " min=" << hist.min.count() << "us"
+         << " max=" << hist.max.count() << "us |";
+
+      for (size_t i = 0; i < hist.buckets.size(); ++i) {
+         if (hist.buckets[i] == 0) {
+            continue;
+         }
+         if (i < QuoteLatencyTracer::kBucketBoundsUs.size()) {
+            out << " <=" << QuoteLatencyTracer::kBucketBoundsUs[i] << "us:" << hist.buckets[i];
+         }
+         else {
+            out << " >" << QuoteLatencyTracer::kBucketBoundsUs.back() << "us:" << hist.buckets[i];
+         }
+      }
+      out << '\n';
+   }
+
+} // namespace
+
+void QuoteLatencyTracer::Histogram::add(std::chrono::microseconds value)
+{
+   const auto it = std::lower_bound(kBucketBoundsUs.cbegin(), kBucketBoundsUs.cend(), value.count());
+   buckets[static_cast<size_t>(std::distance(kBucketBoundsUs.cbegin(), it))]++;
+   count++;
+   total += value;
+   min = std::min(min, value);
+   max = std::max(max, value);
+}
+
+std::chrono::microseconds QuoteLatencyTracer::Histogram::average() const
+{
+   if (count == 0) {
+      return {};
+   }
+   return std::chrono::microseconds(total.count() / static_cast<std::chrono::microseconds::rep>(count));
+}
+
+QuoteLatencyTracer::QuoteLatencyTracer() = default;
+
+QuoteLatencyTracer::~QuoteLatencyTracer() = default;
+
+QuoteLatencyTracer &QuoteLatencyTracer::instance()
+{
+   static QuoteLatencyTracer tracer;
+   return tracer;
+}
+
+const char *QuoteLatencyTracer::toString(Stage stage)
+{
+   switch (stage) {
+      case Stage::Received:         return "Received";
+      case Stage::ModelInserted:    return "ModelInserted";
+      case Stage::ScriptReceived:   return "ScriptReceived";
+      case Stage::ScriptReplied:    return "ScriptReplied";
+      case Stage::ReplyStarted:     return "ReplyStarted";
+      case Stage::UtxoReserved:     return "UtxoReserved";
+      case Stage::SignerResolved:   return "SignerResolved";
+      case Stage::QuoteSent:        return "QuoteSent";
+      default:                      return "Unknown";
+   }
+}
+
+void QuoteLatencyTracer::setEnabled(bool enabled)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   enabled_ = enabled;
+   if (!enabled_) {
+      spans_.clear();
+      spansOrder_.clear();
+   }
+}
+
+bool QuoteLatencyTracer::isEnabled() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return enabled_;
+}
+
+void QuoteLatencyTracer::mark(const std::string &reqId, Stage stage, Clock::time_point timestamp)
+{
+   if (stage == Stage::Count || reqId.empty()) {
+      return;
+   }
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (!enabled_) {
+      return;
+   }
+
+   auto it = spans_.find(reqId);
+   if (it == spans_.end()) {
+      // Span is started by the first seen stage (AQ thread could get the request first)
+      Span span;
+      span.started = timestamp;
+      span.last = timestamp;
+      it = spans_.emplace(reqId, span).first;
+      spansOrder_.push_back(reqId);
+
+      while (spansOrder_.size() > kMaxActiveSpans) {
+         const auto &oldest = spansOrder_.front();
+         if (oldest != reqId) {
+            spans_.erase(oldest);
+         }
+         spansOrder_.pop_front();
+      }
+   }
+
+   auto &span = it->second;
+   const auto stageIndex = static_cast<size_t>(stage);
+   if (span.marked[stageIndex]) {
+      return;
+   }
+   span.marked[stageIndex] = true;
+
+   const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(timestamp - span.last);
+   histograms_[stageIndex].add(std::max(elapsed, std::chrono::microseconds::zero()));
+   span.last = std::max(span.last, timestamp);
+
+   if (stage == Stage::QuoteSent) {
+      total_.add(std::chrono::duration_cast<std::chrono::microseconds>(timestamp - span.started));
+   }
+}
+
+void QuoteLatencyTracer::finish(const std::string &reqId)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   spans_.erase(reqId);
+}
+
+QuoteLatencyTracer::Histogram QuoteLatencyTracer::histogram(Stage stage) const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (stage == Stage::Count) {
+      return {};
+   }
+   return histograms_[static_cast<size_t>(stage)];
+}
+
+QuoteLatencyTracer::Histogram QuoteLatencyTracer::totalHistogram() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return total_;
+}
+
+size_t QuoteLatencyTracer::activeCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return spans_.size();
+}
+
+void QuoteLatencyTracer::clear()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   spans_.clear();
+   spansOrder_.clear();
+   histograms_ = {};
+   total_ = {};
+}
+
+std::string QuoteLatencyTracer::report() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::ostringstream out;
+   out << "quote request latency (time since previous stage), active requests: "
+      << spans_.size() << '\n';
+   for (int i = 0; i < static_cast<int>(Stage::Count); ++i) {
+      printHistogram(out, toString(static_cast<Stage>(i)), histograms_[static_cast<size_t>(i)]);
+   }
+   printHistogram(out, "Total", total_);
+   return out.str();
+}
+
+void QuoteLatencyTracer::dump(const std::shared_ptr<spdlog::logger> &logger) const
+{
+   if (!logger) {
+      return;
+   }
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (total_.count == 0 && histograms_[static_cast<size_t>(Stage::Received)].count == 0) {
+         return;
+      }
+   }
+   logger->info("[QuoteLatencyTracer] {}", report());
+}
+
+bool QuoteLatencyTracer::dumpToFile(const std::string &path) const
+{
+   std::ofstream file(path, std::ios::out | std::ios::app);
+   if (!file.is_open()) {
+      return false;
+   }
+   file << report() << '\n';
+   return file.good();
+}
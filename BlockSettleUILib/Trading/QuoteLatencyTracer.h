@@ -0,0 +1,118 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef QUOTE_LATENCY_TRACER_H
+#define QUOTE_LATENCY_TRACER_H
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace spdlog {
+   class logger;
+}
+
+namespace bs {
+
+   // Collects timestamps of dealer quote request processing stages (keyed by
+   // quote request id) and aggregates them into per-stage latency histograms.
+   // Could be used from any thread.
+   class QuoteLatencyTracer
+   {
+   public:
+      enum class Stage : int
+      {
+         Received = 0,        // QuoteReqNotification delivered by QuoteProvider
+         ModelInserted,       // added to QuoteRequestsModel
+         ScriptReceived,      // delivered to AQ script thread
+         ScriptReplied,       // AQ script produced the price
+         ReplyStarted,        // RFQDealerReply::submitReply entered
+         UtxoReserved,        // pay-in inputs selected and reserved
+         SignerResolved,      // signer returned resolved spenders (CC only)
+         QuoteSent,           // quote notification passed to QuoteProvider
+
+         Count
+      };
+
+      // Upper bounds of histogram buckets, the last bucket is unbounded
+      static constexpr std::array<std::chrono::microseconds::rep, 12> kBucketBoundsUs = {{
+         100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+      }};
+
+      struct Histogram
+      {
+         std::array<uint64_t, kBucketBoundsUs.size() + 1> buckets{};
+         uint64_t count{};
+         std::chrono::microseconds total{};
+         std::chrono::microseconds min{std::chrono::microseconds::max()};
+         std::chrono::microseconds max{};
+
+         void add(std::chrono::microseconds);
+         std::chrono::microseconds average() const;
+      };
+
+      using Clock = std::chrono::steady_clock;
+
+      QuoteLatencyTracer();
+      ~QuoteLatencyTracer();
+
+      // Process-wide instance used by dealer widgets and AQ script handler
+      static QuoteLatencyTracer &instance();
+
+      static const char *toString(Stage);
+
+      void setEnabled(bool);
+      bool isEnabled() const;
+
+      // Record stage for request. Only first occurrence of every stage is taken
+      // into account, so re-quotes do not skew histograms.
+      // Latency of the stage is the time passed since the previous recorded stage
+      // of the same request, QuoteSent is also added to the total histogram.
+      void mark(const std::string &reqId, Stage, Clock::time_point = Clock::now());
+
+      // Forget request (quote request is finished)
+      void finish(const std::string &reqId);
+
+      Histogram histogram(Stage) const;
+      Histogram totalHistogram() const;
+      size_t activeCount() const;
+
+      void clear();
+
+      std::string report() const;
+      void dump(const std::shared_ptr<spdlog::logger> &) const;
+      bool dumpToFile(const std::string &path) const;
+
+   private:
+      struct Span
+      {
+         Clock::time_point started;
+         Clock::time_point last;
+         std::array<bool, static_cast<size_t>(Stage::Count)> marked{};
+      };
+
+      // Old spans are dropped when requests were never finished (disconnect etc)
+      static constexpr size_t kMaxActiveSpans = 4096;
+
+      mutable std::mutex   mutex_;
+      bool  enabled_{true};
+      std::unordered_map<std::string, Span>  spans_;
+      std::deque<std::string>                spansOrder_;
+      std::array<Histogram, static_cast<size_t>(Stage::Count)>  histograms_;
+      Histogram   total_;
+   };
+
+}  // namespace bs
+
+#endif // QUOTE_LATENCY_TRACER_H
@@ -18,6 +18,7 @@
 #include "CommonTypes.h"
 #include "CurrencyPair.h"
 #include "DealerCCSettlementContainer.h"
+#include "QuoteLatencyTracer.h"
 #include "QuoteRequestsWidget.h"
 #include "SettlementContainer.h"
 #include "UiUtils.h"
@@ -649,6 +650,7 @@ void QuoteRequestsModel::ticker() {
 
    for (auto delRow : deletedRows) {
       notifications_.erase(delRow);
+      bs::QuoteLatencyTracer::instance().finish(delRow);
    }
 
    for (const auto &settlContainer : settlContainers_) {
@@ -15,6 +15,7 @@
 #include "AssetManager.h"
 #include "CurrencyPair.h"
 #include "NotificationCenter.h"
+#include "QuoteLatencyTracer.h"
 #include "QuoteProvider.h"
 #include "SettlementContainer.h"
 #include "UiUtils.h"
@@ -240,6 +241,9 @@ void QuoteRequestsWidget::onSecurityMDUpdated(bs::network::Asset::Type assetType
 
 void QuoteRequestsWidget::onQuoteRequest(const bs::network::QuoteReqNotification &qrn)
 {
+   auto &latencyTracer = bs::QuoteLatencyTracer::instance();
+   latencyTracer.mark(qrn.quoteRequestId, bs::QuoteLatencyTracer::Stage::Received);
+
    if (dropQN_) {
       bool checkResult = true;
       if (qrn.side == bs::network::Side::Buy) {
@@ -255,6 +259,7 @@ void QuoteRequestsWidget::onQuoteRequest(const bs::network::QuoteReqNotification
    }
    if (model_ != nullptr) {
       model_->onQuoteReqNotifReceived(qrn);
+      latencyTracer.mark(qrn.quoteRequestId, bs::QuoteLatencyTracer::Stage::ModelInserted);
    }
 }
 
@@ -29,6 +29,8 @@
 #include "CurrencyPair.h"
 #include "CustomControls/CustomComboBox.h"
 #include "FastLock.h"
+#include "FeeEstimateCache.h"
+#include "QuoteLatencyTracer.h"
 #include "QuoteProvider.h"
 #include "SelectedTransactionInputs.h"
 #include "SignContainer.h"
@@ -617,6 +619,8 @@ void bs::ui::RFQDealerReply::onParentAboutToHide()
 
 void RFQDealerReply::submitReply(const bs::network::QuoteReqNotification &qrn, double price, ReplyType replyType)
 {
+   bs::QuoteLatencyTracer::instance().mark(qrn.quoteRequestId, bs::QuoteLatencyTracer::Stage::ReplyStarted);
+
    if (qFuzzyIsNull(price)) {
       SPDLOG_LOGGER_ERROR(logger_, "invalid price");
       return;
@@ -658,6 +662,7 @@ void RFQDealerReply::submitReply(const bs::network::QuoteReqNotification &qrn, d
             , xbtAmount.GetValue(), minXbtAmount.GetValue());
          return;
       }
+      replyData->xbtAmount = xbtAmount;
    }
 
    auto it = activeQuoteSubmits_.find(replyData->qn.quoteRequestId);
@@ -716,6 +721,8 @@ void RFQDealerReply::submitReply(const bs::network::QuoteReqNotification &qrn, d
                   (const std::map<UTXO, std::string> &inputs)
                {
                   QMetaObject::invokeMethod(this, [this, feePerByte, qrn, replyData, spendVal, spendWallet, isSpendCC, inputs, price] {
+                     bs::QuoteLatencyTracer::instance().mark(qrn.quoteRequestId
+                        , bs::QuoteLatencyTracer::Stage::UtxoReserved);
                      const auto &cbChangeAddr = [this, feePerByte, qrn, replyData, spendVal, spendWallet, inputs, price, isSpendCC]
                         (const bs::Address &changeAddress)
                      {
@@ -745,6 +752,8 @@ void RFQDealerReply::submitReply(const bs::network::QuoteReqNotification &qrn, d
                            signingContainer_->resolvePublicSpenders(txReq, [replyData, this, price, txReq]
                               (bs::error::ErrorCode result, const Codec_SignerState::SignerState &state)
                            {
+                              bs::QuoteLatencyTracer::instance().mark(replyData->qn.quoteRequestId
+                                 , bs::QuoteLatencyTracer::Stage::SignerResolved);
                               if (preparingCCRequest_.count(replyData->qn.quoteRequestId) == 0) {
                                  return;
                               }
@@ -814,7 +823,7 @@ void RFQDealerReply::submitReply(const bs::network::QuoteReqNotification &qrn, d
             if (qrn.side == bs::network::Side::Buy) {
                cbFee(0);
             } else {
-               walletsManager_->estimatedFeePerByte(2, cbFee, this);
+               bs::FeeEstimateCache::estimateFeePerByte(walletsManager_, 2, cbFee, this);
             }
          };
          // recv. address is always set automatically
@@ -1126,11 +1135,14 @@ void bs::ui::RFQDealerReply::reserveBestUtxoSetAndSubmit(double quantity, double
    const std::shared_ptr<SubmitQuoteReplyData>& replyData, ReplyType replyType)
 {
    auto replyRFQWrapper = [rfqReply = QPointer<bs::ui::RFQDealerReply>(this),
-      price, replyData, replyType] (std::vector<UTXO> utxos) {
+      price, replyData, replyType] (std::vector<UTXO> utxos, bs::UtxoReservationToken utxoRes) {
       if (!rfqReply) {
          return;
       }
 
+      bs::QuoteLatencyTracer::instance().mark(replyData->qn.quoteRequestId
+         , bs::QuoteLatencyTracer::Stage::UtxoReserved);
+
       if (utxos.empty()) {
          if (replyType == ReplyType::Manual) {
             replyData->fixedXbtInputs = rfqReply->selectedXbtInputs_;
@@ -1145,7 +1157,7 @@ void bs::ui::RFQDealerReply::reserveBestUtxoSetAndSubmit(double quantity, double
          rfqReply->selectedXbtInputs_ = utxos;
       }
 
-      replyData->utxoRes = rfqReply->utxoReservationManager_->makeNewReservation(utxos);
+      replyData->utxoRes = std::move(utxoRes);
       replyData->fixedXbtInputs = std::move(utxos);
 
       rfqReply->submit(price, replyData);
@@ -1153,21 +1165,21 @@ void bs::ui::RFQDealerReply::reserveBestUtxoSetAndSubmit(double quantity, double
 
    if ((replyData->qn.side == bs::network::Side::Sell && replyData->qn.product != bs::network::XbtCurrency) ||
       (replyData->qn.side == bs::network::Side::Buy && replyData->qn.product == bs::network::XbtCurrency)) {
-      replyRFQWrapper({});
+      replyRFQWrapper({}, {});
       return; // Nothing to reserve
    }
 
    // We shouldn't recalculate better utxo set if that not first quote response
    // otherwise, we should chose best set if that wasn't done by user and this is not auto quoting script
    if (sentNotifs_.count(replyData->qn.quoteRequestId) || (!selectedXbtInputs_.empty() && replyType == ReplyType::Manual)) {
-      replyRFQWrapper({});
+      replyRFQWrapper({}, {});
       return; // already reserved by user
    }
 
    auto security = mdInfo_.find(replyData->qn.security);
    if (security == mdInfo_.end()) {
       // there is no MD data available so we really can't forecast
-      replyRFQWrapper({});
+      replyRFQWrapper({}, {});
       return;
    }
 
@@ -1185,13 +1197,26 @@ void bs::ui::RFQDealerReply::reserveBestUtxoSetAndSubmit(double quantity, double
    }
    xbtQuantity = static_cast<uint64_t>(xbtQuantity * tradeutils::reservationQuantityMultiplier());
 
-   auto cbBestUtxoSet = [rfqReply = QPointer<bs::ui::RFQDealerReply>(this),
-      replyRFQ = std::move(replyRFQWrapper)](std::vector<UTXO>&& utxos) {
+   // Selected set is reserved atomically, so parallel replies never share UTXOs
+   auto cbBestUtxoSet = [rfqReply = QPointer<bs::ui::RFQDealerReply>(this), replyData,
+      replyRFQ = std::move(replyRFQWrapper)](bs::FixedXbtInputs&& fixedXbt) {
       if (!rfqReply) {
          return;
       }
+      if (!fixedXbt.utxoRes.isValid()) {
+         SPDLOG_LOGGER_ERROR(rfqReply->logger_, "quote reply on {} is not sent: UTXO reservation failed"
+            , replyData->qn.quoteRequestId);
+         rfqReply->activeQuoteSubmits_.erase(replyData->qn.quoteRequestId);
+         rfqReply->updateSubmitButton();
+         return;
+      }
 
-      replyRFQ(std::move(utxos));
+      std::vector<UTXO> utxos;
+      utxos.reserve(fixedXbt.inputs.size());
+      for (const auto &input : fixedXbt.inputs) {
+         utxos.push_back(input.first);
+      }
+      replyRFQ(std::move(utxos), std::move(fixedXbt.utxoRes));
    };
 
    // Check amount (required for AQ scripts)
@@ -1199,12 +1224,12 @@ void bs::ui::RFQDealerReply::reserveBestUtxoSetAndSubmit(double quantity, double
 
    if (!replyData->xbtWallet->canMixLeaves()) {
       auto purpose = UiUtils::getSelectedHwPurpose(ui_->comboBoxXbtWallet);
-      utxoReservationManager_->getBestXbtUtxoSet(replyData->xbtWallet->walletId(), purpose,
-         xbtQuantity, cbBestUtxoSet, true, checkAmount);
+      utxoReservationManager_->reserveBestXbtUtxoSet(replyData->xbtWallet->walletId(), purpose,
+         xbtQuantity, false, std::move(cbBestUtxoSet), true, checkAmount);
    }
    else {
-      utxoReservationManager_->getBestXbtUtxoSet(replyData->xbtWallet->walletId(),
-         xbtQuantity, cbBestUtxoSet, true, checkAmount);
+      utxoReservationManager_->reserveBestXbtUtxoSet(replyData->xbtWallet->walletId(),
+         xbtQuantity, false, std::move(cbBestUtxoSet), true, checkAmount);
    }
 
 
@@ -26,6 +26,7 @@
 #include "QWalletInfo.h"
 #include "HDPath.h"
 #include "UtxoReservationToken.h"
+#include "XBTAmount.h"
 #include "CommonTypes.h"
 
 namespace Ui {
@@ -78,6 +79,7 @@ namespace bs {
          bs::UtxoReservationToken utxoRes;
          std::shared_ptr<bs::sync::hd::Wallet> xbtWallet;
          bs::Address authAddr;
+         bs::XBTAmount xbtAmount;   // SpotXBT only
          std::vector<UTXO> fixedXbtInputs;
          std::unique_ptr<bs::hd::Purpose> walletPurpose;
       };
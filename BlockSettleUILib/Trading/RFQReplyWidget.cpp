@@ -24,9 +24,13 @@
 #include "MDCallbacksQt.h"
 #include "OrderListModel.h"
 #include "OrdersView.h"
+#include "PrebuiltPayin.h"
+#include "QuoteLatencyTracer.h"
 #include "QuoteProvider.h"
 #include "RFQBlotterTreeView.h"
 #include "SelectedTransactionInputs.h"
+#include "SettlementZcRouter.h"
+#include "TradesUtils.h"
 #include "WalletSignerContainer.h"
 #include "Wallets/SyncHDWallet.h"
 #include "Wallets/SyncWalletsManager.h"
@@ -39,6 +43,7 @@
 
 #include <QDesktopWidget>
 #include <QPushButton>
+#include <QTimer>
 
 using namespace bs::ui;
 using namespace Blocksettle::Communication;
@@ -49,6 +54,10 @@ enum class DealingPages : int
    DealingPage
 };
 
+namespace {
+   const auto kLatencyReportInterval = std::chrono::minutes(10);
+}
+
 RFQReplyWidget::RFQReplyWidget(QWidget* parent)
    : TabWithShortcut(parent)
    , ui_(new Ui::RFQReplyWidget())
@@ -66,7 +75,10 @@ RFQReplyWidget::RFQReplyWidget(QWidget* parent)
    popShield();
 }
 
-RFQReplyWidget::~RFQReplyWidget() = default;
+RFQReplyWidget::~RFQReplyWidget()
+{
+   bs::QuoteLatencyTracer::instance().dump(logger_);
+}
 
 void RFQReplyWidget::setWalletsManager(const std::shared_ptr<bs::sync::WalletsManager> &walletsManager)
 {
@@ -154,6 +166,7 @@ void RFQReplyWidget::init(const std::shared_ptr<spdlog::logger> &logger
    connectionManager_ = connectionManager;
    autoSignProvider_ = autoSignProvider;
    utxoReservationManager_ = utxoReservationManager;
+   zcRouter_ = std::make_shared<bs::SettlementZcRouter>(logger_, armory_.get());
 
    statsCollector_ = std::make_shared<bs::SecurityStatsCollector>(appSettings
       , ApplicationSettings::Filter_MD_QN_cnt);
@@ -173,6 +186,8 @@ void RFQReplyWidget::init(const std::shared_ptr<spdlog::logger> &logger
    {
       statsCollector_->onQuoteSubmitted(data->qn);
       quoteProvider_->SubmitQuoteNotif(data->qn);
+      bs::QuoteLatencyTracer::instance().mark(data->qn.quoteRequestId
+         , bs::QuoteLatencyTracer::Stage::QuoteSent);
       ui_->widgetQuoteRequests->onQuoteReqNotifReplied(data->qn);
       onReplied(data);
    });
@@ -230,6 +245,13 @@ void RFQReplyWidget::init(const std::shared_ptr<spdlog::logger> &logger
 
    connect(ui_->widgetQuoteRequests->view(), &TreeViewWithEnterKey::enterKeyPressed
       , this, &RFQReplyWidget::onEnterKeyPressed);
+
+   auto latencyReportTimer = new QTimer(this);
+   latencyReportTimer->setInterval(kLatencyReportInterval);
+   connect(latencyReportTimer, &QTimer::timeout, this, [this] {
+      bs::QuoteLatencyTracer::instance().dump(logger_);
+   });
+   latencyReportTimer->start();
 }
 
 void RFQReplyWidget::forceCheckCondition()
@@ -257,6 +279,7 @@ void RFQReplyWidget::onReplied(const std::shared_ptr<bs::ui::SubmitQuoteReplyDat
          reply.utxosPayinFixed = data->fixedXbtInputs;
          reply.utxoRes = std::move(data->utxoRes);
          reply.walletPurpose = std::move(data->walletPurpose);
+         prebuildPayin(*data, reply);
          break;
       }
 
@@ -277,6 +300,51 @@ void RFQReplyWidget::onReplied(const std::shared_ptr<bs::ui::SubmitQuoteReplyDat
    }
 }
 
+void RFQReplyWidget::prebuildPayin(const bs::ui::SubmitQuoteReplyData &data, SentXbtReply &reply)
+{
+   // Pay-in is prepared in advance only for auto-signed trades. Otherwise manual signing
+   // takes much longer than pay-in creation, and building pay-ins for quotes that are
+   // never accepted would only waste change addresses.
+   if (!autoSignProvider_ || (autoSignProvider_->autoSignState() != bs::error::ErrorCode::NoError)
+      || (autoSignProvider_->autoSignWalletId().toStdString() != reply.xbtWallet->walletId())) {
+      return;
+   }
+
+   const bool weSellXbt = (data.qn.side == bs::network::Side::Buy) != (data.qn.product == bs::network::XbtCurrency);
+   if (!weSellXbt || data.qn.reqAuthKey.empty()) {
+      return;
+   }
+
+   bs::tradeutils::PayinArgs args;
+   args.amount = data.xbtAmount;
+   args.settlementId = BinaryData::CreateFromHex(data.qn.settlementId);
+   args.ourAuthAddress = reply.authAddr;
+   args.cpAuthPubKey = BinaryData::CreateFromHex(data.qn.reqAuthKey);
+   args.walletsMgr = walletsManager_;
+   args.armory = armory_;
+   args.signContainer = signingContainer_;
+   args.feeRatePb_ = utxoReservationManager_->feeRatePb();
+   args.fixedInputs = reply.utxosPayinFixed;
+
+   const auto xbtGroup = reply.xbtWallet->getGroup(reply.xbtWallet->getXBTGroupType());
+   if (!reply.xbtWallet->canMixLeaves()) {
+      if (!reply.walletPurpose) {
+         return;
+      }
+      args.inputXbtWallets.push_back(xbtGroup->getLeaf(*reply.walletPurpose));
+   }
+   else {
+      for (const auto &leaf : xbtGroup->getLeaves()) {
+         args.inputXbtWallets.push_back(leaf);
+      }
+   }
+
+   args.utxoReservation = bs::UtxoReservation::instance();
+
+   reply.prebuiltPayin = bs::PrebuiltPayin::create(logger_, utxoReservationManager_
+      , std::move(args), data.qn.settlementId);
+}
+
 void RFQReplyWidget::onPulled(const std::string& settlementId, const std::string& reqId, const std::string& reqSessToken)
 {
    sentXbtReplies_.erase(settlementId);
@@ -342,7 +410,7 @@ void RFQReplyWidget::onOrder(const bs::network::Order &order)
             const auto settlContainer = std::make_shared<DealerCCSettlementContainer>(logger_
                , order, quoteReqId, assetManager_->getCCLotSize(order.product)
                , assetManager_->getCCGenesisAddr(order.product), sr.recipientAddress
-               , sr.xbtWallet, signingContainer_, armory_, walletsManager_
+               , sr.xbtWallet, signingContainer_, armory_, zcRouter_, walletsManager_
                , std::move(sr.walletPurpose), std::move(sr.utxoRes), expandTxInfo);
             connect(settlContainer.get(), &DealerCCSettlementContainer::signTxRequest
                , this, &RFQReplyWidget::saveTxData);
@@ -389,9 +457,9 @@ void RFQReplyWidget::onOrder(const bs::network::Order &order)
 
             const auto settlContainer = std::make_shared<DealerXBTSettlementContainer>(logger_
                , order, walletsManager_, reply.xbtWallet, quoteProvider_, signingContainer_
-               , armory_, authAddressManager_, reply.authAddr, reply.utxosPayinFixed
+               , armory_, zcRouter_, authAddressManager_, reply.authAddr, reply.utxosPayinFixed
                , recvXbtAddr, utxoReservationManager_, std::move(reply.walletPurpose)
-               , std::move(reply.utxoRes), expandTxInfo, tier1XbtLimit);
+               , std::move(reply.utxoRes), reply.prebuiltPayin, expandTxInfo, tier1XbtLimit);
 
             connect(settlContainer.get(), &DealerXBTSettlementContainer::sendUnsignedPayinToPB
                , this, &RFQReplyWidget::sendUnsignedPayinToPB);
@@ -38,7 +38,9 @@ namespace bs {
       }
       class WalletsManager;
    }
+   class PrebuiltPayin;
    class SettlementAddressEntry;
+   class SettlementZcRouter;
    class SecurityStatsCollector;
    class UTXOReservationManager;
 }
@@ -148,6 +150,9 @@ private:
    void showEditableRFQPage();
    void eraseReply(const QString &reqId);
 
+   struct SentXbtReply;
+   void prebuildPayin(const bs::ui::SubmitQuoteReplyData &, SentXbtReply &);
+
 protected:
    void hideEvent(QHideEvent* event) override;
 
@@ -159,6 +164,7 @@ private:
       std::vector<UTXO> utxosPayinFixed;
       bs::UtxoReservationToken utxoRes;
       std::unique_ptr<bs::hd::Purpose> walletPurpose;
+      std::shared_ptr<bs::PrebuiltPayin> prebuiltPayin;
    };
 
    struct SentCCReply
@@ -185,6 +191,7 @@ private:
    std::shared_ptr<ConnectionManager>     connectionManager_;
    std::shared_ptr<AutoSignScriptProvider>      autoSignProvider_;
    std::shared_ptr<bs::UTXOReservationManager>  utxoReservationManager_;
+   std::shared_ptr<bs::SettlementZcRouter>      zcRouter_;
 
    std::unordered_map<std::string, SentXbtReply>   sentXbtReplies_;
    std::unordered_map<std::string, SentCCReply>    sentCCReplies_;
@@ -26,6 +26,7 @@
 #include "CurrencyPair.h"
 #include "EncryptionUtils.h"
 #include "FXAmountValidator.h"
+#include "FeeEstimateCache.h"
 #include "QuoteProvider.h"
 #include "SelectedTransactionInputs.h"
 #include "SignContainer.h"
@@ -1271,17 +1272,15 @@ void RFQTicketXBT::onMaxClicked()
             QMetaObject::invokeMethod(this, [this, fee, utxos = std::move(utxos)]{
                float feePerByteArmory = ArmoryConnection::toFeePerByte(fee);
                auto feePerByte = std::max(feePerByteArmory, utxoReservationManager_->feeRatePb());
-               uint64_t total = 0;
-               for (const auto &utxo : utxos) {
-                  total += utxo.getValue();
-               }
-               const uint64_t fee = bs::tradeutils::estimatePayinFeeWithoutChange(utxos, feePerByte);
-               const double spendableQuantity = std::max(0.0, (total - fee) / BTCNumericTypes::BalanceDivider);
+               // Only UTXOs changed since previous click are processed, pay-in has single (P2WSH) output
+               maxSpend_.setInputs(utxos);
+               maxSpend_.setFeePerByte(feePerByte);
+               const double spendableQuantity = maxSpend_.maxAmount() / BTCNumericTypes::BalanceDivider;
                ui_->lineEditAmount->setText(UiUtils::displayAmount(spendableQuantity));
                updateSubmitButton();
                });
          };
-         armory_->estimateFee(bs::tradeutils::feeTargetBlockCount(), feeCb);
+         bs::FeeEstimateCache::estimateFee(armory_, bs::tradeutils::feeTargetBlockCount(), feeCb);
 
          return;
       }
@@ -1573,6 +1572,10 @@ void RFQTicketXBT::reserveBestUtxoSetAndSubmit(const std::string &id
          if (!rfqTicket) {
             return;
          }
+         if (!fixedXbt.utxoRes.isValid()) {
+            rfqTicket->showHelp(tr("Failed to reserve inputs, please try again"));
+            return;
+         }
          rfqTicket->fixedXbtInputs_ = std::move(fixedXbt);
          submitRFQWrapper();
       };
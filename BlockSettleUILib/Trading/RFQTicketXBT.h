@@ -21,6 +21,7 @@
 
 #include "BSErrorCode.h"
 #include "CommonTypes.h"
+#include "MaxSpendAccumulator.h"
 #include "UtxoReservationToken.h"
 #include "XBTAmount.h"
 #include "UiUtils.h"
@@ -265,6 +266,7 @@ private:
    CancelRFQCb cancelRFQCb_{};
 
    bs::FixedXbtInputs fixedXbtInputs_;
+   bs::MaxSpendAccumulator maxSpend_;
 
    bool  autoRFQenabled_{ false };
    std::vector<std::string>   deferredRFQs_;
@@ -12,6 +12,7 @@
 #include <spdlog/spdlog.h>
 #include "AssetManager.h"
 #include "CheckRecipSigner.h"
+#include "FeeEstimateCache.h"
 #include "SignContainer.h"
 #include "TradesUtils.h"
 #include "TransactionData.h"
@@ -296,7 +297,7 @@ bool ReqCCSettlementContainer::createCCUnsignedTXdata()
             inputsCb(manualXbtInputs_, true);
          }
       };
-      walletsMgr_->estimatedFeePerByte(0, cbFee, this);
+      bs::FeeEstimateCache::estimateFeePerByte(walletsMgr_, 0, cbFee, this);
    }
 
    return true;
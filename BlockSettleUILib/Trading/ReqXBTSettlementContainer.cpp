@@ -16,8 +16,10 @@
 
 #include "AssetManager.h"
 #include "AuthAddressManager.h"
+#include "AuthAddressVerificationCache.h"
 #include "CheckRecipSigner.h"
 #include "CurrencyPair.h"
+#include "PrebuiltPayin.h"
 #include "QuoteProvider.h"
 #include "WalletSignerContainer.h"
 #include "TradesUtils.h"
@@ -104,6 +106,7 @@ bool ReqXBTSettlementContainer::cancel()
    }
 
    SettlementContainer::releaseUtxoRes();
+   prebuiltPayin_.reset();
    emit settlementCancelled();
 
    return true;
@@ -120,19 +123,6 @@ void ReqXBTSettlementContainer::activate()
 
    settlementIdHex_ = quote_.settlementId;
 
-   addrVerificator_ = std::make_shared<AddressVerificator>(logger_, armory_
-      , [this, handle = validityFlag_.handle()](const bs::Address &address, AddressVerificationState state)
-   {
-      QMetaObject::invokeMethod(qApp, [this, handle, address, state] {
-         if (!handle.isValid()) {
-            return;
-         }
-         dealerVerifStateChanged(state);
-      });
-   });
-
-   addrVerificator_->SetBSAddressList(authAddrMgr_->GetBSAddresses());
-
    settlementId_ = BinaryData::CreateFromHex(quote_.settlementId);
    userKey_ = BinaryData::CreateFromHex(quote_.requestorAuthPublicKey);
    dealerAuthKey_ = BinaryData::CreateFromHex(quote_.dealerAuthPublicKey);
@@ -142,6 +132,14 @@ void ReqXBTSettlementContainer::activate()
 
    const auto &authLeaf = walletsMgr_->getAuthWallet();
    signContainer_->setSettlAuthAddr(authLeaf->walletId(), settlementId_, authAddr_);
+
+   // Start building pay-in while PB is processing quote acceptance
+   if (weSellXbt_) {
+      bs::tradeutils::PayinArgs args;
+      initPayinArgs(args, settlementIdHex_);
+      prebuiltPayin_ = bs::PrebuiltPayin::create(logger_, utxoReservationManager_
+         , std::move(args), id());
+   }
 }
 
 void ReqXBTSettlementContainer::deactivate()
@@ -332,26 +330,35 @@ void ReqXBTSettlementContainer::onUnsignedPayinRequested(const std::string& sett
 
    SPDLOG_LOGGER_DEBUG(logger_, "unsigned payin requested: {}", settlementId);
 
-   bs::tradeutils::PayinArgs args;
-   initTradesArgs(args, settlementId);
-   args.fixedInputs.reserve(utxosPayinFixed_.size());
-   for (const auto &input : utxosPayinFixed_) {
-      args.fixedInputs.push_back(input.first);
+   if (prebuiltPayin_ && prebuiltPayin_->matches(settlementId_, bs::XBTAmount(amount_))) {
+      prebuiltPayin_->getResult([this, settlementId, handle = validityFlag_.handle()]
+         (const bs::tradeutils::PayinResult &result)
+      {
+         if (!handle.isValid()) {
+            return;
+         }
+         if (!result.success) {
+            SPDLOG_LOGGER_WARN(logger_, "prebuilt payin is not usable on {}, create new one", settlementIdHex_);
+            createPayin(settlementId);
+            return;
+         }
+         SPDLOG_LOGGER_DEBUG(logger_, "use prebuilt payin on {}", settlementIdHex_);
+         if (utxosPayinFixed_.empty()) {
+            utxoRes_ = prebuiltPayin_->takeReservation();
+         }
+         onPayinCreated(result);
+      });
+      return;
    }
 
-   const auto xbtGroup = xbtWallet_->getGroup(xbtWallet_->getXBTGroupType());
-   if (!xbtWallet_->canMixLeaves()) {
-      assert(walletPurpose_);
-      const auto leaf = xbtGroup->getLeaf(*walletPurpose_);
-      args.inputXbtWallets.push_back(leaf);
-   }
-   else {
-      for (const auto &leaf : xbtGroup->getLeaves()) {
-         args.inputXbtWallets.push_back(leaf);
-      }
-   }
+   prebuiltPayin_.reset();
+   createPayin(settlementId);
+}
 
-   args.utxoReservation = bs::UtxoReservation::instance();
+void ReqXBTSettlementContainer::createPayin(const std::string &settlementId)
+{
+   bs::tradeutils::PayinArgs args;
+   initPayinArgs(args, settlementId);
 
    auto payinCb = bs::tradeutils::PayinResultCb([this, handle = validityFlag_.handle()]
       (bs::tradeutils::PayinResult result)
@@ -367,44 +374,58 @@ void ReqXBTSettlementContainer::onUnsignedPayinRequested(const std::string& sett
             return;
          }
 
-         settlAddr_ = result.settlementAddr;
-
-         const auto list = authAddrMgr_->GetSubmittedAddressList();
-         const auto userAddress = bs::Address::fromPubKey(userKey_, AddressEntryType_P2WPKH);
-         userKeyOk_ = (std::find(list.begin(), list.end(), userAddress) != list.end());
-         if (!userKeyOk_) {
-            SPDLOG_LOGGER_WARN(logger_, "userAddr {} not found in verified addrs list ({})"
-               , userAddress.display(), list.size());
-            return;
-         }
-
-         if (dealerAddressValidationRequired_) {
-            addrVerificator_->addAddress(dealerAuthAddress_);
-            addrVerificator_->startAddressVerification();
-         } else {
-            dealerVerifState_ = AddressVerificationState::Verified;
-         }
-
-         unsignedPayinRequest_ = std::move(result.signRequest);
-
          // Make new reservation only for automatic inputs.
          // Manual inputs should be already reserved.
          if (utxosPayinFixed_.empty()) {
             utxoRes_ = utxoReservationManager_->makeNewReservation(
-               unsignedPayinRequest_.getInputs(nullptr), id());
+               result.signRequest.getInputs(nullptr), id());
          }
 
-         emit sendUnsignedPayinToPB(settlementIdHex_
-            , bs::network::UnsignedPayinData{ unsignedPayinRequest_.serializeState().SerializeAsString() });
-
-         const auto &authLeaf = walletsMgr_->getAuthWallet();
-         signContainer_->setSettlCP(authLeaf->walletId(), result.payinHash, settlementId_, dealerAuthKey_);
+         onPayinCreated(result);
       });
    });
 
    bs::tradeutils::createPayin(std::move(args), std::move(payinCb));
 }
 
+void ReqXBTSettlementContainer::onPayinCreated(const bs::tradeutils::PayinResult &result)
+{
+   settlAddr_ = result.settlementAddr;
+
+   const auto list = authAddrMgr_->GetSubmittedAddressList();
+   const auto userAddress = bs::Address::fromPubKey(userKey_, AddressEntryType_P2WPKH);
+   userKeyOk_ = (std::find(list.begin(), list.end(), userAddress) != list.end());
+   if (!userKeyOk_) {
+      SPDLOG_LOGGER_WARN(logger_, "userAddr {} not found in verified addrs list ({})"
+         , userAddress.display(), list.size());
+      return;
+   }
+
+   if (dealerAddressValidationRequired_) {
+      addrVerificator_ = bs::AuthAddressVerificationCache::verifyAddress(logger_, armory_
+         , dealerAuthAddress_, authAddrMgr_->GetBSAddresses()
+         , [this, handle = validityFlag_.handle()](const bs::Address &, AddressVerificationState state)
+      {
+         QMetaObject::invokeMethod(qApp, [this, handle, state] {
+            if (!handle.isValid()) {
+               return;
+            }
+            dealerVerifStateChanged(state);
+         });
+      });
+   } else {
+      dealerVerifState_ = AddressVerificationState::Verified;
+   }
+
+   unsignedPayinRequest_ = result.signRequest;
+
+   emit sendUnsignedPayinToPB(settlementIdHex_
+      , bs::network::UnsignedPayinData{ unsignedPayinRequest_.serializeState().SerializeAsString() });
+
+   const auto &authLeaf = walletsMgr_->getAuthWallet();
+   signContainer_->setSettlCP(authLeaf->walletId(), result.payinHash, settlementId_, dealerAuthKey_);
+}
+
 void ReqXBTSettlementContainer::onSignedPayoutRequested(const std::string& settlementId, const BinaryData& payinHash, QDateTime timestamp)
 {
    if (settlementIdHex_ != settlementId) {
@@ -517,3 +538,26 @@ void ReqXBTSettlementContainer::initTradesArgs(bs::tradeutils::Args &args, const
    args.signContainer = signContainer_;
    args.feeRatePb_ = utxoReservationManager_->feeRatePb();
 }
+
+void ReqXBTSettlementContainer::initPayinArgs(bs::tradeutils::PayinArgs &args, const std::string &settlementId)
+{
+   initTradesArgs(args, settlementId);
+   args.fixedInputs.reserve(utxosPayinFixed_.size());
+   for (const auto &input : utxosPayinFixed_) {
+      args.fixedInputs.push_back(input.first);
+   }
+
+   const auto xbtGroup = xbtWallet_->getGroup(xbtWallet_->getXBTGroupType());
+   if (!xbtWallet_->canMixLeaves()) {
+      assert(walletPurpose_);
+      const auto leaf = xbtGroup->getLeaf(*walletPurpose_);
+      args.inputXbtWallets.push_back(leaf);
+   }
+   else {
+      for (const auto &leaf : xbtGroup->getLeaves()) {
+         args.inputXbtWallets.push_back(leaf);
+      }
+   }
+
+   args.utxoReservation = bs::UtxoReservation::instance();
+}
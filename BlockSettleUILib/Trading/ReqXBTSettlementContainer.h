@@ -27,7 +27,10 @@ namespace bs {
    }
    namespace tradeutils {
       struct Args;
+      struct PayinArgs;
+      struct PayinResult;
    }
+   class PrebuiltPayin;
    class UTXOReservationManager;
 }
 class AddressVerificator;
@@ -102,6 +105,10 @@ private:
    void cancelWithError(const QString& errorMessage, bs::error::ErrorCode code);
 
    void initTradesArgs(bs::tradeutils::Args &args, const std::string &settlementId);
+   void initPayinArgs(bs::tradeutils::PayinArgs &args, const std::string &settlementId);
+
+   void createPayin(const std::string &settlementId);
+   void onPayinCreated(const bs::tradeutils::PayinResult &);
 
 private:
    std::shared_ptr<spdlog::logger>           logger_;
@@ -140,6 +147,7 @@ private:
    bs::core::wallet::TXSignRequest  unsignedPayinRequest_;
    BinaryData                       expectedPayinHash_;
    std::map<UTXO, std::string>      utxosPayinFixed_;
+   std::shared_ptr<bs::PrebuiltPayin>  prebuiltPayin_;
 
    bool tradeCancelled_ = false;
    bool dealerAddressValidationRequired_ = true;
@@ -0,0 +1,155 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "SettlementZcRouter.h"
+
+#include <spdlog/spdlog.h>
+
+using namespace bs;
+
+SettlementZcRouter::SettlementZcRouter(const std::shared_ptr<spdlog::logger> &logger
+   , ArmoryConnection *armory)
+   : logger_(logger)
+{
+   init(armory);
+}
+
+SettlementZcRouter::~SettlementZcRouter()
+{
+   cleanup();
+}
+
+SettlementZcRouter::RouteId SettlementZcRouter::addRoute(const ZcCb &cb)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   const auto id = nextId_++;
+   routes_[id].cb = cb;
+   return id;
+}
+
+void SettlementZcRouter::removeRoute(RouteId id)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   const auto it = routes_.find(id);
+   if (it == routes_.end()) {
+      return;
+   }
+   for (const auto &txHash : it->second.txHashes) {
+      auto itTx = txRoutes_.find(txHash);
+      if (itTx == txRoutes_.end()) {
+         continue;
+      }
+      itTx->second.erase(id);
+      if (itTx->second.empty()) {
+         txRoutes_.erase(itTx);
+      }
+   }
+   for (const auto &walletId : it->second.walletIds) {
+      auto itWallet = walletRoutes_.find(walletId);
+      if (itWallet == walletRoutes_.end()) {
+         continue;
+      }
+      itWallet->second.erase(id);
+      if (itWallet->second.empty()) {
+         walletRoutes_.erase(itWallet);
+      }
+   }
+   routes_.erase(it);
+}
+
+void SettlementZcRouter::watchTx(RouteId id, const BinaryData &txHash)
+{
+   if (txHash.empty()) {
+      return;
+   }
+   std::lock_guard<std::mutex> lock(mutex_);
+   const auto it = routes_.find(id);
+   if (it == routes_.end()) {
+      return;
+   }
+   it->second.txHashes.insert(txHash);
+   txRoutes_[txHash].insert(id);
+}
+
+void SettlementZcRouter::unwatchTx(RouteId id, const BinaryData &txHash)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   const auto it = routes_.find(id);
+   if (it == routes_.end()) {
+      return;
+   }
+   it->second.txHashes.erase(txHash);
+   auto itTx = txRoutes_.find(txHash);
+   if (itTx != txRoutes_.end()) {
+      itTx->second.erase(id);
+      if (itTx->second.empty()) {
+         txRoutes_.erase(itTx);
+      }
+   }
+}
+
+void SettlementZcRouter::watchWallet(RouteId id, const std::string &walletId)
+{
+   if (walletId.empty()) {
+      return;
+   }
+   std::lock_guard<std::mutex> lock(mutex_);
+   const auto it = routes_.find(id);
+   if (it == routes_.end()) {
+      return;
+   }
+   it->second.walletIds.insert(walletId);
+   walletRoutes_[walletId].insert(id);
+}
+
+size_t SettlementZcRouter::routesCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return routes_.size();
+}
+
+void SettlementZcRouter::onZCReceived(const std::string &
+   , const std::vector<bs::TXEntry> &entries)
+{
+   // Callbacks are called under the lock so removed routes are never called
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (routes_.empty()) {
+      return;
+   }
+
+   std::set<RouteId> targets;
+   for (const auto &entry : entries) {
+      targets.clear();
+
+      const auto itTx = txRoutes_.find(entry.txHash);
+      if (itTx != txRoutes_.end()) {
+         targets.insert(itTx->second.cbegin(), itTx->second.cend());
+      }
+      for (const auto &walletId : entry.walletIds) {
+         const auto itWallet = walletRoutes_.find(walletId);
+         if (itWallet != walletRoutes_.end()) {
+            targets.insert(itWallet->second.cbegin(), itWallet->second.cend());
+         }
+      }
+
+      for (const auto &id : targets) {
+         const auto itRoute = routes_.find(id);
+         if ((itRoute == routes_.end()) || !itRoute->second.cb) {
+            continue;
+         }
+         try {
+            itRoute->second.cb(entry);
+         }
+         catch (const std::exception &e) {
+            SPDLOG_LOGGER_ERROR(logger_, "ZC callback failed: {}", e.what());
+         }
+      }
+   }
+}
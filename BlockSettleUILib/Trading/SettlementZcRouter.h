@@ -0,0 +1,76 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef SETTLEMENT_ZC_ROUTER_H
+#define SETTLEMENT_ZC_ROUTER_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "ArmoryConnection.h"
+
+namespace spdlog {
+   class logger;
+}
+
+namespace bs {
+
+   // Single ZC subscriber for all settlement containers. Containers register
+   // expected TX hashes and settlement wallet ids, and every ZC entry is delivered
+   // only to the containers it belongs to (instead of every container walking
+   // every ZC notification).
+   class SettlementZcRouter : public ArmoryCallbackTarget
+   {
+   public:
+      using RouteId = uint64_t;
+      // Called from Armory callback thread. Must not call back into the router.
+      using ZcCb = std::function<void(const bs::TXEntry &)>;
+
+      SettlementZcRouter(const std::shared_ptr<spdlog::logger> &, ArmoryConnection *);
+      ~SettlementZcRouter() override;
+
+      RouteId addRoute(const ZcCb &);
+      // Removing route waits for callback which could be in progress
+      void removeRoute(RouteId);
+
+      void watchTx(RouteId, const BinaryData &txHash);
+      void unwatchTx(RouteId, const BinaryData &txHash);
+      void watchWallet(RouteId, const std::string &walletId);
+
+      size_t routesCount() const;
+
+   protected:
+      void onZCReceived(const std::string &requestId, const std::vector<bs::TXEntry> &) override;
+
+   private:
+      struct Route
+      {
+         ZcCb cb;
+         std::set<BinaryData>    txHashes;
+         std::set<std::string>   walletIds;
+      };
+
+      std::shared_ptr<spdlog::logger>  logger_;
+
+      mutable std::mutex   mutex_;
+      RouteId              nextId_{1};
+      std::unordered_map<RouteId, Route>              routes_;
+      std::map<BinaryData, std::set<RouteId>>         txRoutes_;
+      std::unordered_map<std::string, std::set<RouteId>> walletRoutes_;
+   };
+
+}  // namespace bs
+
+#endif // SETTLEMENT_ZC_ROUTER_H
@@ -74,11 +74,16 @@ void TransactionOutputsModel::AddRecipient(unsigned int recipientId, const QStri
 void TransactionOutputsModel::AddRecipients(const std::vector<std::tuple<unsigned int
    , QString, bs::XBTAmount>> &recipients)
 {
-   beginInsertRows(QModelIndex{}, (int)outputs_.size(), (int)outputs_.size());
+   if (recipients.empty()) {
+      return;
+   }
+   // Single reset is much cheaper for views than thousands of row insertions
+   beginResetModel();
+   outputs_.reserve(outputs_.size() + recipients.size());
    for (const auto &recip : recipients) {
       outputs_.emplace_back(OutputRow{ std::get<0>(recip), std::get<1>(recip), std::get<2>(recip) });
    }
-   endInsertRows();
+   endResetModel();
 }
 
 void TransactionOutputsModel::UpdateRecipientAmount(unsigned int recipientId, const bs::XBTAmount &amount)
@@ -12,11 +12,13 @@
 #include <spdlog/logger.h>
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <QFile>
 #include <QQmlComponent>
 #include <QQmlContext>
 #include "AssetManager.h"
 #include "CurrencyPair.h"
 #include "DataConnection.h"
+#include "FeeEstimateCache.h"
 #include "MDCallbacksQt.h"
 #include "UiUtils.h"
 #include "Wallets/SyncWalletsManager.h"
@@ -61,6 +63,7 @@ bool UserScript::load(const QString &filename)
    }
 
    if (component_->isReady()) {
+      version_++;
       emit loaded();
       return true;
    }
@@ -72,6 +75,67 @@ bool UserScript::load(const QString &filename)
    return false;
 }
 
+bool UserScript::prepareReload(const QString &filename, QString &error)
+{
+   rollbackReload();
+
+   QFile file(filename);
+   if (!file.open(QIODevice::ReadOnly)) {
+      error = tr("Failed to read script %1: %2").arg(filename).arg(file.errorString());
+      return false;
+   }
+
+   // Engine caches compiled types by URL, so each version gets its own one.
+   // Objects of the current version keep working until they are destroyed.
+   auto url = QUrl::fromLocalFile(filename);
+   url.setQuery(QStringLiteral("v=%1").arg(version_ + 1));
+   auto component = new QQmlComponent(engine_, this);
+   component->setData(file.readAll(), url);
+   if (!component->isReady()) {
+      error = component->isError() ? component->errorString()
+         : tr("Script %1 is not ready").arg(filename);
+      component->deleteLater();
+      return false;
+   }
+
+   auto probe = component->create();
+   if (!probe) {
+      error = tr("Failed to instantiate: %1").arg(component->errorString());
+      component->deleteLater();
+      return false;
+   }
+   const bool valid = validate(probe, error);
+   delete probe;
+   if (!valid) {
+      component->deleteLater();
+      return false;
+   }
+
+   pendingComponent_ = component;
+   return true;
+}
+
+void UserScript::commitReload()
+{
+   if (!pendingComponent_) {
+      return;
+   }
+   if (component_) {
+      component_->deleteLater();
+   }
+   component_ = pendingComponent_;
+   pendingComponent_ = nullptr;
+   version_++;
+}
+
+void UserScript::rollbackReload()
+{
+   if (pendingComponent_) {
+      pendingComponent_->deleteLater();
+      pendingComponent_ = nullptr;
+   }
+}
+
 QObject *UserScript::instantiate()
 {
    auto rv = component_->create();
@@ -88,14 +152,21 @@ void UserScript::setWalletsManager(std::shared_ptr<bs::sync::WalletsManager> wal
 
 bool UserScript::sendExtConn(const QString &name, const QString &type, const QString &message)
 {
-   const auto &itConn = extConns_.find(name.toStdString());
-   if (itConn == extConns_.end()) {
-      logger_->error("[UserScript::sendExtConn] can't find external connector {}"
+   return sendExtConn(logger_, extConns_, name, type, message);
+}
+
+bool UserScript::sendExtConn(const std::shared_ptr<spdlog::logger> &logger
+   , const ExtConnections &extConns, const QString &name, const QString &type
+   , const QString &message)
+{
+   const auto &itConn = extConns.find(name.toStdString());
+   if (itConn == extConns.end()) {
+      logger->error("[UserScript::sendExtConn] can't find external connector {}"
          , name.toStdString());
       return false;
    }
    if (!itConn->second->isActive()) {
-      logger_->error("[UserScript::sendExtConn] external connector {} is not "
+      logger->error("[UserScript::sendExtConn] external connector {} is not "
          "active", name.toStdString());
       return false;
    }
@@ -103,7 +174,7 @@ bool UserScript::sendExtConn(const QString &name, const QString &type, const QSt
    auto jsonDoc = QJsonDocument::fromJson(QByteArray::fromStdString(message.toStdString())
       , &jsonError);
    if (jsonError.error != QJsonParseError::NoError) {
-      logger_->error("[UserScript::sendExtConn] invalid JSON message: {}\n{}"
+      logger->error("[UserScript::sendExtConn] invalid JSON message: {}\n{}"
          , jsonError.errorString().toUtf8().toStdString(), message.toStdString());
       return false;
    }
@@ -231,7 +302,7 @@ int Constants::payOutTxSize() const
 float Constants::feePerByte()
 {
    if (walletsManager_) {
-      walletsManager_->estimatedFeePerByte(2, [this](float fee) { feePerByte_ = fee; }, this);
+      bs::FeeEstimateCache::estimateFeePerByte(walletsManager_, 2, [this](float fee) { feePerByte_ = fee; }, this);
    }
    return feePerByte_;  //NB: sometimes returns previous value if previous call needs to wait for result from Armory
 }
@@ -244,7 +315,7 @@ QString Constants::xbtProductName() const
 void Constants::setWalletsManager(std::shared_ptr<bs::sync::WalletsManager> walletsManager)
 {
    walletsManager_ = walletsManager;
-   walletsManager_->estimatedFeePerByte(2, [this](float fee) { feePerByte_ = fee; }, this);
+   bs::FeeEstimateCache::estimateFeePerByte(walletsManager_, 2, [this](float fee) { feePerByte_ = fee; }, this);
 }
 
 
@@ -263,26 +334,68 @@ QObject *AutoQuoter::instantiate(const bs::network::QuoteReqNotification &qrn)
 {
    QObject *rv = UserScript::instantiate();
    if (rv) {
-      BSQuoteReqReply *qrr = qobject_cast<BSQuoteReqReply *>(rv);
-      qrr->init(logger_, assetManager_, this);
+      auto qrr = create(rv, qrn);
+      if (!qrr) {
+         logger_->error("[AutoQuoter::instantiate] script object is not BSQuoteReqReply");
+         delete rv;
+         return nullptr;
+      }
+      qrr->start();
+   }
+   return rv;
+}
+
+BSQuoteReqReply *AutoQuoter::instantiatePending(const bs::network::QuoteReqNotification &qrn
+   , QString &error)
+{
+   if (!pendingComponent_) {
+      error = tr("No script version is prepared");
+      return nullptr;
+   }
+   auto obj = pendingComponent_->create();
+   if (!obj) {
+      error = tr("Failed to instantiate: %1").arg(pendingComponent_->errorString());
+      return nullptr;
+   }
+   auto qrr = create(obj, qrn);
+   if (!qrr) {
+      delete obj;
+      error = tr("Script object is not BSQuoteReqReply");
+   }
+   return qrr;
+}
 
-      BSQuoteRequest *qr = new BSQuoteRequest(rv);
-      qr->init(QString::fromStdString(qrn.quoteRequestId), QString::fromStdString(qrn.product)
-         , (qrn.side == bs::network::Side::Buy), qrn.quantity, static_cast<int>(qrn.assetType));
+BSQuoteReqReply *AutoQuoter::create(QObject *obj, const bs::network::QuoteReqNotification &qrn)
+{
+   BSQuoteReqReply *qrr = qobject_cast<BSQuoteReqReply *>(obj);
+   if (!qrr) {
+      return nullptr;
+   }
+   qrr->init(logger_, assetManager_, this);
 
-      qrr->setQuoteReq(qr);
-      qrr->setSecurity(QString::fromStdString(qrn.security));
+   BSQuoteRequest *qr = new BSQuoteRequest(obj);
+   qr->init(QString::fromStdString(qrn.quoteRequestId), QString::fromStdString(qrn.product)
+      , (qrn.side == bs::network::Side::Buy), qrn.quantity, static_cast<int>(qrn.assetType));
 
-      connect(qrr, &BSQuoteReqReply::sendingQuoteReply, [this](const QString &reqId, double price) {
-         emit sendingQuoteReply(reqId, price);
-      });
-      connect(qrr, &BSQuoteReqReply::pullingQuoteReply, [this](const QString &reqId) {
-         emit pullingQuoteReply(reqId);
-      });
+   qrr->setQuoteReq(qr);
+   qrr->setSecurity(QString::fromStdString(qrn.security));
 
-      qrr->start();
+   connect(qrr, &BSQuoteReqReply::sendingQuoteReply, [this](const QString &reqId, double price) {
+      emit sendingQuoteReply(reqId, price);
+   });
+   connect(qrr, &BSQuoteReqReply::pullingQuoteReply, [this](const QString &reqId) {
+      emit pullingQuoteReply(reqId);
+   });
+   return qrr;
+}
+
+bool AutoQuoter::validate(QObject *obj, QString &error) const
+{
+   if (!qobject_cast<BSQuoteReqReply *>(obj)) {
+      error = tr("Script object is not BSQuoteReqReply");
+      return false;
    }
-   return rv;
+   return true;
 }
 
 
@@ -312,6 +425,7 @@ bool BSQuoteReqReply::sendQuoteReply(double price)
 {
    QString reqId = quoteReq()->requestId();
    if (reqId.isEmpty())  return false;
+   sentPrice_ = price;
    emit sendingQuoteReply(reqId, price);
    return true;
 }
@@ -365,6 +479,13 @@ SubmitRFQ *RFQScript::sendRFQ(const QString &symbol, bool buy, double amount)
    submitRFQ->setAmount(amount);
    submitRFQ->setBuy(buy);
 
+   const auto itMD = mdInfo_.find(symbol.toStdString());
+   if (itMD != mdInfo_.end()) {
+      submitRFQ->setIndicBid(itMD->second.bidPrice);
+      submitRFQ->setIndicAsk(itMD->second.askPrice);
+      submitRFQ->setLastPrice(itMD->second.lastPrice);
+   }
+
    activeRFQs_[id] = submitRFQ;
    emit sendingRFQ(submitRFQ);
    return submitRFQ;
@@ -391,16 +512,13 @@ void RFQScript::cancelAll()
    activeRFQs_.clear();
 }
 
-void RFQScript::onMDUpdate(bs::network::Asset::Type, const QString &security,
-   bs::network::MDFields mdFields)
+void RFQScript::onMarketData(const QString &security, const bs::network::MDInfo &mdInfo)
 {
+   mdInfo_[security.toStdString()] = mdInfo;
    if (!started_) {
       return;
    }
 
-   auto &mdInfo = mdInfo_[security.toStdString()];
-   mdInfo.merge(bs::network::MDField::get(mdFields));
-
    for (const auto &rfq : activeRFQs_) {
       const auto &sec = rfq.second->security();
       if (sec.isEmpty() || (security != sec)) {
@@ -26,6 +26,7 @@ namespace bs {
    }
 }
 class AssetManager;
+class BSQuoteReqReply;
 class DataConnection;
 class MDCallbacksQt;
 class QQmlComponent;
@@ -125,7 +126,17 @@ public:
    void setWalletsManager(std::shared_ptr<bs::sync::WalletsManager> walletsManager);
    bool load(const QString &filename);
 
+   // Hot reload: new version is compiled and validated aside while current one
+   // keeps serving. After prepareReload() succeeded, caller either commits it
+   // or rolls back to current version.
+   bool prepareReload(const QString &filename, QString &error);
+   void commitReload();
+   void rollbackReload();
+   int version() const { return version_; }
+
    bool sendExtConn(const QString &name, const QString &type, const QString &message);
+   static bool sendExtConn(const std::shared_ptr<spdlog::logger> &, const ExtConnections &
+      , const QString &name, const QString &type, const QString &message);
 
 signals:
    void loaded();
@@ -133,11 +144,14 @@ signals:
 
 protected:
    QObject *instantiate();
+   virtual bool validate(QObject *, QString &error) const { return true; }
 
 protected:
    std::shared_ptr<spdlog::logger> logger_;
    QQmlEngine *engine_;
    QQmlComponent *component_;
+   QQmlComponent *pendingComponent_{ nullptr };
+   int version_{ 0 };
    MarketData *md_;
    ExtConnections extConns_;
    Constants *const_;
@@ -156,11 +170,20 @@ public:
    ~AutoQuoter() override = default;
 
    QObject *instantiate(const bs::network::QuoteReqNotification &qrn);
+   // Creates not yet started reply from version prepared for reload
+   BSQuoteReqReply *instantiatePending(const bs::network::QuoteReqNotification &qrn
+      , QString &error);
 
 signals:
    void sendingQuoteReply(const QString &reqId, double price);
    void pullingQuoteReply(const QString &reqId);
 
+protected:
+   bool validate(QObject *, QString &error) const override;
+
+private:
+   BSQuoteReqReply *create(QObject *, const bs::network::QuoteReqNotification &);
+
 private:
    std::shared_ptr<AssetManager> assetManager_;
 };
@@ -213,6 +236,7 @@ class BSQuoteReqReply : public QObject
    Q_PROPERTY(double lastPrice READ lastPrice NOTIFY lastPriceChanged)
    Q_PROPERTY(double bestPrice READ bestPrice NOTIFY bestPriceChanged)
    Q_PROPERTY(double isOwnBestPrice READ isOwnBestPrice)
+   Q_PROPERTY(double sentPrice READ sentPrice)
 
 public:
    explicit BSQuoteReqReply(QObject *parent = nullptr) : QObject(parent) {}   //TODO: add dedicated AQ bs::Wallet
@@ -259,6 +283,37 @@ public:
          }
       }
    }
+   // Applies batched market data at once: all prices are updated before any
+   // notification is sent, so scripts never see half-updated bid/ask pair.
+   // Non-positive prices are ignored. Scripts should reprice on pricesChanged()
+   // only: per-price signals are kept for bindings and older scripts.
+   void setMarketPrices(double bid, double ask, double last) {
+      const bool bidChanged = (bid > 0) && (indicBid_ != bid);
+      const bool askChanged = (ask > 0) && (indicAsk_ != ask);
+      const bool lastChanged = (last > 0) && (lastPrice_ != last);
+      if (bidChanged) {
+         indicBid_ = bid;
+      }
+      if (askChanged) {
+         indicAsk_ = ask;
+      }
+      if (lastChanged) {
+         lastPrice_ = last;
+      }
+      if (!started_ || !(bidChanged || askChanged || lastChanged)) {
+         return;
+      }
+      if (bidChanged) {
+         emit indicBidChanged();
+      }
+      if (askChanged) {
+         emit indicAskChanged();
+      }
+      if (lastChanged) {
+         emit lastPriceChanged();
+      }
+      emit pricesChanged();
+   }
    void setBestPrice(double prc, bool own) {
       isOwnBestPrice_ = own;
       if (bestPrice_ != prc) {
@@ -271,6 +326,20 @@ public:
    double lastPrice() const { return lastPrice_; }
    double bestPrice() const { return bestPrice_; }
    bool   isOwnBestPrice() const { return isOwnBestPrice_; }
+   // Last price sent by script, kept when script is hot-reloaded
+   double sentPrice() const { return sentPrice_; }
+
+   // Takes over request state from reply of previous script version,
+   // without notifications as reply is not started yet
+   void restoreState(const BSQuoteReqReply &other) {
+      expirationInSec_ = other.expirationInSec_;
+      indicBid_ = other.indicBid_;
+      indicAsk_ = other.indicAsk_;
+      lastPrice_ = other.lastPrice_;
+      bestPrice_ = other.bestPrice_;
+      isOwnBestPrice_ = other.isOwnBestPrice_;
+      sentPrice_ = other.sentPrice_;
+   }
 
    void init(const std::shared_ptr<spdlog::logger> &logger
       , const std::shared_ptr<AssetManager> &assetManager, UserScript *parent);
@@ -295,6 +364,7 @@ signals:
    void indicAskChanged();
    void lastPriceChanged();
    void bestPriceChanged();
+   void pricesChanged();   // once per market data batch, after all *Changed above
    void sendingQuoteReply(const QString &reqId, double price);
    void pullingQuoteReply(const QString &reqId);
    void settled();
@@ -303,14 +373,15 @@ signals:
    void extDataReceived(QString from, QString type, QString msg);
 
 private:
-   BSQuoteRequest *quoteReq_;
-   double   expirationInSec_;
+   BSQuoteRequest *quoteReq_ = nullptr;
+   double   expirationInSec_ = 0;
    QString  security_;
    double   indicBid_ = 0;
    double   indicAsk_ = 0;
    double   lastPrice_ = 0;
    double   bestPrice_ = 0;
    bool     isOwnBestPrice_ = false;
+   double   sentPrice_ = 0;
    bool     started_ = false;
    std::shared_ptr<spdlog::logger> logger_;
    std::shared_ptr<AssetManager> assetManager_;
@@ -436,8 +507,8 @@ public:
    Q_INVOKABLE SubmitRFQ *activeRFQ(const QString &id);
    void cancelAll();
 
-   void onMDUpdate(bs::network::Asset::Type, const QString &security,
-      bs::network::MDFields mdFields);
+   // Merged market data snapshot of security, batched by RFQScriptHandler
+   void onMarketData(const QString &security, const bs::network::MDInfo &);
 
    void onAccepted(const std::string &id);
    void onExpired(const std::string &id);
@@ -10,6 +10,7 @@
 */
 
 #include "UserScriptRunner.h"
+#include <algorithm>
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QThread>
@@ -17,10 +18,19 @@
 #include <spdlog/spdlog.h>
 #include "DataConnectionListener.h"
 #include "MDCallbacksQt.h"
+#include "NativeQuoter.h"
+#include "QuoteLatencyTracer.h"
 #include "SignContainer.h"
 #include "UserScript.h"
 #include "Wallets/SyncWalletsManager.h"
 
+namespace {
+   const int kAQTickIntervalMs = 500;
+
+   const int kRFQMDBatchIntervalMs = 500;
+   const int kAutoRFQMaxPerSec = 5;
+   const int kAutoRFQBurst = 10;
+}
 
 //
 // UserScriptHandler
@@ -58,9 +68,17 @@ AQScriptHandler::AQScriptHandler(const std::shared_ptr<QuoteProvider> &quoteProv
    , assetManager_(assetManager)
    , aqEnabled_(false)
    , aqTimer_(new QTimer(this))
+   , mdBatchTimer_(new QTimer(this))
 {
    connect(quoteProvider.get(), &QuoteProvider::quoteReqNotifReceived,
-      this, &AQScriptHandler::onQuoteReqNotification, Qt::QueuedConnection);
+      this, &AQScriptHandler::onQuoteReqReceived, Qt::QueuedConnection);
+   // Called in QuoteProvider thread to count requests waiting in handler's queue
+   connect(quoteProvider.get(), &QuoteProvider::quoteReqNotifReceived, this
+      , [this](const bs::network::QuoteReqNotification &qrn) {
+      if (isOwnRequest(qrn)) {
+         ++queueDepth_;
+      }
+   }, Qt::DirectConnection);
    connect(quoteProvider.get(), &QuoteProvider::quoteNotifCancelled,
       this, &AQScriptHandler::onQuoteNotifCancelled, Qt::QueuedConnection);
    connect(quoteProvider.get(), &QuoteProvider::quoteCancelled,
@@ -73,9 +91,14 @@ AQScriptHandler::AQScriptHandler(const std::shared_ptr<QuoteProvider> &quoteProv
    connect(quoteProvider.get(), &QuoteProvider::bestQuotePrice,
       this, &AQScriptHandler::onBestQuotePrice, Qt::QueuedConnection);
 
-   aqTimer_->setInterval(500);
+   aqTimer_->setInterval(kAQTickIntervalMs);
    connect(aqTimer_, &QTimer::timeout, this, &AQScriptHandler::aqTick);
    aqTimer_->start();
+
+   // Started by the first update after flush, so doesn't fire on idle market
+   mdBatchTimer_->setSingleShot(true);
+   mdBatchTimer_->setInterval(kAQTickIntervalMs);
+   connect(mdBatchTimer_, &QTimer::timeout, this, &AQScriptHandler::flushMD);
 }
 
 AQScriptHandler::~AQScriptHandler() noexcept
@@ -86,6 +109,7 @@ AQScriptHandler::~AQScriptHandler() noexcept
 void AQScriptHandler::onThreadStopped()
 {
    aqTimer_->stop();
+   mdBatchTimer_->stop();
    UserScriptHandler::onThreadStopped();
 }
 
@@ -110,23 +134,147 @@ void AQScriptHandler::setExtConnections(const ExtConnections &conns)
 
 void AQScriptHandler::reload(const QString &filename)
 {
+   if (!aq_ || NativeQuoter::isStrategyLibrary(filename)) {
+      // Strategy libraries are not swapped in place
+      if (aq_ || nativeAq_) {
+         deinit();
+      }
+      init(filename);
+      return;
+   }
+
+   QString error;
+   if (!hotReload(filename, error)) {
+      logger_->error("[AQScriptHandler::reload] {} is not applied: {}"
+         , filename.toStdString(), error.toStdString());
+      emit reloadFailed(filename, error);
+      return;
+   }
+   logger_->info("[AQScriptHandler::reload] {} version {} is active, {} requests migrated"
+      , filename.toStdString(), aq_->version(), aqObjs_.size());
+   emit scriptLoaded(filename);
+}
+
+bool AQScriptHandler::hotReload(const QString &filename, QString &error)
+{
+   if (!prepareHotReload(filename, error)) {
+      return false;
+   }
+   commitHotReload();
+   return true;
+}
+
+bool AQScriptHandler::canHotReload(const QString &filename) const
+{
+   return aq_ && !NativeQuoter::isStrategyLibrary(filename);
+}
+
+bool AQScriptHandler::prepareHotReload(const QString &filename, QString &error)
+{
+   rollbackHotReload();
+   if (!aq_->prepareReload(filename, error)) {
+      return false;
+   }
+
+   for (const auto &aqObj : aqObjs_) {
+      const auto itQRN = aqQuoteReqs_.find(aqObj.first);
+      const auto oldReply = qobject_cast<BSQuoteReqReply *>(aqObj.second);
+      if ((itQRN == aqQuoteReqs_.end()) || !oldReply) {
+         continue;
+      }
+      auto reply = aq_->instantiatePending(itQRN->second, error);
+      if (!reply) {
+         rollbackHotReload();
+         return false;
+      }
+      reply->restoreState(*oldReply);
+      pendingReplies_[aqObj.first] = reply;
+   }
+   return true;
+}
+
+void AQScriptHandler::commitHotReload()
+{
+   if (!aq_) {
+      return;
+   }
+   aq_->commitReload();
+
+   for (const auto &created : pendingReplies_) {
+      auto &obj = aqObjs_[created.first];
+      // Old reply is not asked to pull - its quote stays until new one replaces it
+      if (obj) {
+         obj->disconnect();
+         obj->deleteLater();
+      }
+      obj = created.second;
+      if (thread_) {
+         obj->moveToThread(thread_);
+      }
+      created.second->start();
+   }
+   pendingReplies_.clear();
+}
+
+void AQScriptHandler::rollbackHotReload()
+{
+   for (const auto &created : pendingReplies_) {
+      delete created.second;
+   }
+   pendingReplies_.clear();
    if (aq_) {
-      aq_->load(filename);
+      aq_->rollbackReload();
+   }
+}
+
+void AQScriptHandler::setShard(size_t index, size_t count, ShardKey key)
+{
+   shardCount_ = std::max(count, size_t(1));
+   shardIndex_ = index % shardCount_;
+   shardKey_ = key;
+}
+
+size_t AQScriptHandler::shardIndex(const bs::network::QuoteReqNotification &qrn
+   , size_t count, ShardKey key)
+{
+   if (count <= 1) {
+      return 0;
    }
+   const auto &value = (key == ShardKey::Product) ? qrn.product : qrn.security;
+   return std::hash<std::string>{}(value) % count;
+}
+
+bool AQScriptHandler::isOwnRequest(const bs::network::QuoteReqNotification &qrn) const
+{
+   return (shardCount_ <= 1) || (shardIndex(qrn, shardCount_, shardKey_) == shardIndex_);
+}
+
+void AQScriptHandler::onQuoteReqReceived(const bs::network::QuoteReqNotification &qrn)
+{
+   if (!isOwnRequest(qrn)) {
+      return;
+   }
+   --queueDepth_;
+   onQuoteReqNotification(qrn);
 }
 
 void AQScriptHandler::onQuoteReqNotification(const bs::network::QuoteReqNotification &qrn)
 {
    const auto &itAQObj = aqObjs_.find(qrn.quoteRequestId);
    if ((qrn.status == bs::network::QuoteReqNotification::PendingAck) || (qrn.status == bs::network::QuoteReqNotification::Replied)) {
+      bs::QuoteLatencyTracer::instance().mark(qrn.quoteRequestId, bs::QuoteLatencyTracer::Stage::ScriptReceived);
       aqQuoteReqs_[qrn.quoteRequestId] = qrn;
-      if ((qrn.assetType != bs::network::Asset::SpotFX) && (!signingContainer_ || signingContainer_->isOffline())) {
+      if (requireOnlineSigner_ && (qrn.assetType != bs::network::Asset::SpotFX)
+         && (!signingContainer_ || signingContainer_->isOffline())) {
          logger_->error("[AQScriptHandler::onQuoteReqNotification] can't handle"
             " non-FX quote without online signer");
          return;
       }
-      if (aqEnabled_ && aq_ && (itAQObj == aqObjs_.end())) {
-         QObject *obj = aq_->instantiate(qrn);
+      if (aqEnabled_ && (itAQObj == aqObjs_.end())) {
+         QObject *obj = instantiate(qrn);
+         if (!obj) {
+            return;
+         }
          aqObjs_[qrn.quoteRequestId] = obj;
          if (thread_) {
             obj->moveToThread(thread_);
@@ -205,26 +353,49 @@ void AQScriptHandler::init(const QString &fileName)
    }
    aqEnabled_ = false;
 
+   if (NativeQuoter::isStrategyLibrary(fileName)) {
+      nativeAq_ = new NativeQuoter(logger_, assetManager_, mdCallbacks_, extConns_, this);
+      initQuoter(nativeAq_, fileName);
+      return;
+   }
+
    aq_ = new AutoQuoter(logger_, assetManager_, mdCallbacks_, extConns_, this);
    if (walletsManager_) {
       aq_->setWalletsManager(walletsManager_);
    }
-   connect(aq_, &AutoQuoter::loaded, [this, fileName] {
+   initQuoter(aq_, fileName);
+}
+
+template <class Quoter>
+void AQScriptHandler::initQuoter(Quoter *&quoter, const QString &fileName)
+{
+   connect(quoter, &Quoter::loaded, [this, fileName] {
       emit scriptLoaded(fileName);
       aqEnabled_ = true;
    });
-   connect(aq_, &AutoQuoter::failed, [this, fileName](const QString &err) {
+   connect(quoter, &Quoter::failed, [this, &quoter, fileName](const QString &err) {
       logger_->error("Script loading failed: {}", err.toStdString());
 
-      aq_->deleteLater();
-      aq_ = nullptr;
+      quoter->deleteLater();
+      quoter = nullptr;
 
       emit failedToLoad(fileName, err);
    });
-   connect(aq_, &AutoQuoter::sendingQuoteReply, this, &AQScriptHandler::onAQReply);
-   connect(aq_, &AutoQuoter::pullingQuoteReply, this, &AQScriptHandler::onAQPull);
+   connect(quoter, &Quoter::sendingQuoteReply, this, &AQScriptHandler::onAQReply);
+   connect(quoter, &Quoter::pullingQuoteReply, this, &AQScriptHandler::onAQPull);
 
-   aq_->load(fileName);
+   quoter->load(fileName);
+}
+
+QObject *AQScriptHandler::instantiate(const bs::network::QuoteReqNotification &qrn)
+{
+   if (aq_) {
+      return aq_->instantiate(qrn);
+   }
+   if (nativeAq_) {
+      return nativeAq_->instantiate(qrn);
+   }
+   return nullptr;
 }
 
 void AQScriptHandler::deinit()
@@ -235,13 +406,18 @@ void AQScriptHandler::deinit()
       aq_->deleteLater();
       aq_ = nullptr;
    }
+   if (nativeAq_) {
+      nativeAq_->deleteLater();
+      nativeAq_ = nullptr;
+   }
 }
 
 void AQScriptHandler::clear()
 {
-   if (!aq_) {
+   if (!aq_ && !nativeAq_) {
       return;
    }
+   rollbackHotReload();
 
    for (auto aqObj : aqObjs_) {
       aqObj.second->deleteLater();
@@ -275,25 +451,46 @@ void AQScriptHandler::clear()
 void AQScriptHandler::onMDUpdate(bs::network::Asset::Type, const QString &security,
    bs::network::MDFields mdFields)
 {
-   auto &mdInfo = mdInfo_[security.toStdString()];
-   mdInfo.merge(bs::network::MDField::get(mdFields));
+   const auto sec = security.toStdString();
+   mdInfo_[sec].merge(bs::network::MDField::get(mdFields));
+   mdUpdated_.insert(sec);
 
-   for (auto aqObj : aqObjs_) {
-      QString sec = aqObj.second->property("security").toString();
-      if (sec.isEmpty() || (security != sec)) {
-         continue;
-      }
+   if (mdBatchTimer_->interval() <= 0) {
+      flushMD();
+   }
+   else if (!clock_ && !mdBatchTimer_->isActive()) {
+      mdBatchTimer_->start();
+   }
+}
+
+void AQScriptHandler::flushMD()
+{
+   if (mdUpdated_.empty()) {
+      return;
+   }
+   const auto updated = std::move(mdUpdated_);
+   mdUpdated_.clear();
 
+   for (auto aqObj : aqObjs_) {
       auto *reqReply = qobject_cast<BSQuoteReqReply *>(aqObj.second);
-      if (mdInfo.bidPrice > 0) {
-         reqReply->setIndicBid(mdInfo.bidPrice);
-      }
-      if (mdInfo.askPrice > 0) {
-         reqReply->setIndicAsk(mdInfo.askPrice);
+      if (!reqReply) {
+         continue;
       }
-      if (mdInfo.lastPrice > 0) {
-         reqReply->setLastPrice(mdInfo.lastPrice);
+      const auto sec = reqReply->security().toStdString();
+      if (updated.find(sec) == updated.end()) {
+         continue;
       }
+      const auto &mdInfo = mdInfo_[sec];
+      reqReply->setMarketPrices(mdInfo.bidPrice, mdInfo.askPrice, mdInfo.lastPrice);
+   }
+}
+
+void AQScriptHandler::setMDBatchInterval(int msec)
+{
+   mdBatchTimer_->setInterval(std::max(msec, 0));
+   if (msec <= 0) {
+      mdBatchTimer_->stop();
+      flushMD();
    }
 }
 
@@ -313,6 +510,7 @@ void AQScriptHandler::onAQReply(const QString &reqId, double price)
       return;
    }
 
+   bs::QuoteLatencyTracer::instance().mark(itQRN->first, bs::QuoteLatencyTracer::Stage::ScriptReplied);
    emit sendQuote(itQRN->second, price);
 }
 
@@ -332,7 +530,7 @@ void AQScriptHandler::aqTick()
       return;
    }
    QStringList expiredEntries;
-   const auto timeNow = QDateTime::currentDateTime();
+   const auto timeNow = clock_ ? clock_() : QDateTime::currentDateTime();
 
    for (auto aqObj : aqObjs_) {
       BSQuoteRequest *qr = qobject_cast<BSQuoteReqReply *>(aqObj.second)->quoteReq();
@@ -352,6 +550,23 @@ void AQScriptHandler::aqTick()
    }
 }
 
+void AQScriptHandler::setSimulatedClock(const std::function<QDateTime()> &clock)
+{
+   clock_ = clock;
+   if (clock_) {
+      aqTimer_->stop();
+   }
+   else {
+      aqTimer_->start();
+   }
+}
+
+void AQScriptHandler::advanceClock()
+{
+   flushMD();
+   aqTick();
+}
+
 void AQScriptHandler::performOnReplyAndStop(const std::string &quoteReqId
    , const std::function<void(BSQuoteReqReply *)> &cb)
 {
@@ -362,7 +577,7 @@ void AQScriptHandler::performOnReplyAndStop(const std::string &quoteReqId
          cb(replyObj);
       }
    }
-   QTimer::singleShot(1000, [this, quoteReqId] { stop(quoteReqId); });
+   QTimer::singleShot(1000, this, [this, quoteReqId] { stop(quoteReqId); });
 }
 
 void AQScriptHandler::cancelled(const std::string &quoteReqId)
@@ -425,6 +640,7 @@ UserScriptRunner::UserScriptRunner(const std::shared_ptr<spdlog::logger> &logger
 
    connect(script_, &UserScriptHandler::scriptLoaded, this, &UserScriptRunner::scriptLoaded);
    connect(script_, &UserScriptHandler::failedToLoad, this, &UserScriptRunner::failedToLoad);
+   connect(script_, &UserScriptHandler::reloadFailed, this, &UserScriptRunner::reloadFailed);
 
    thread_->start();
 }
@@ -458,40 +674,200 @@ AQScriptRunner::AQScriptRunner(const std::shared_ptr<QuoteProvider> &quoteProvid
    , const std::shared_ptr<MDCallbacksQt> &mdCallbacks
    , const std::shared_ptr<AssetManager> &assetManager
    , const std::shared_ptr<spdlog::logger> &logger
+   , size_t shardCount, AQScriptHandler::ShardKey shardKey
    , QObject *parent)
    : UserScriptRunner(logger, new AQScriptHandler(quoteProvider, signingContainer,
       mdCallbacks, assetManager, logger), parent)
 {
    thread_->setObjectName(QStringLiteral("AQScriptRunner"));
+   shardCount = std::max(shardCount, size_t(1));
+
+   const auto addShard = [this](AQScriptHandler *handler) {
+      connect(handler, &AQScriptHandler::pullQuoteNotif, this
+         , &AQScriptRunner::pullQuoteNotif);
+      connect(handler, &AQScriptHandler::sendQuote, this
+         , &AQScriptRunner::sendQuote);
+      shards_.push_back(handler);
+   };
+   addShard(static_cast<AQScriptHandler *>(script_));
+
+   if (shardCount == 1) {
+      return;  // handler stays in the caller's thread as before
+   }
 
-   connect((AQScriptHandler *)script_, &AQScriptHandler::pullQuoteNotif, this
-      , &AQScriptRunner::pullQuoteNotif);
-   connect((AQScriptHandler *)script_, &AQScriptHandler::sendQuote, this
-      , &AQScriptRunner::sendQuote);
+   logger_->info("[AQScriptRunner] running {} AQ engines", shardCount);
+   shards_.front()->setShard(0, shardCount, shardKey);
+   // Handler is deleted in its own thread on stop, queued call won't be processed there
+   disconnect(thread_, &QThread::finished, script_, nullptr);
+   connect(thread_, &QThread::finished, script_, &UserScriptHandler::onThreadStopped
+      , Qt::DirectConnection);
+   script_->moveToThread(thread_);
+
+   for (size_t i = 1; i < shardCount; ++i) {
+      auto handler = new AQScriptHandler(quoteProvider, signingContainer
+         , mdCallbacks, assetManager, logger);
+      handler->setShard(i, shardCount, shardKey);
+      handler->setParent(this);
+      // Hot reload results are reported for all shards at once, see reload()
+      connect(handler, &UserScriptHandler::failedToLoad, this, &UserScriptRunner::failedToLoad);
+      addShard(handler);
+
+      auto thread = new QThread(this);
+      thread->setObjectName(QStringLiteral("AQScriptRunner%1").arg(i));
+      handler->setRunningThread(thread);
+      connect(thread, &QThread::finished, handler, &UserScriptHandler::onThreadStopped
+         , Qt::DirectConnection);
+      handler->moveToThread(thread);
+      shardThreads_.push_back(thread);
+      thread->start();
+   }
+
+   depthTimer_ = new QTimer(this);
+   depthTimer_->setInterval(5000);
+   connect(depthTimer_, &QTimer::timeout, this, &AQScriptRunner::reportQueueDepths);
+   depthTimer_->start();
 }
 
 AQScriptRunner::~AQScriptRunner()
 {
-   const auto aqHandler = qobject_cast<AQScriptHandler *>(script_);
-   if (aqHandler) {
-      aqHandler->setExtConnections({});
+   if (shardThreads_.empty()) {
+      const auto aqHandler = qobject_cast<AQScriptHandler *>(script_);
+      if (aqHandler) {
+         aqHandler->setExtConnections({});
+      }
+      return;
+   }
+   for (const auto &thread : shardThreads_) {
+      thread->quit();
+   }
+   for (const auto &thread : shardThreads_) {
+      thread->wait();
    }
 }
 
-void AQScriptRunner::cancelled(const std::string &quoteReqId)
+void AQScriptRunner::forEachShard(const std::function<void(AQScriptHandler *)> &cb)
 {
-   const auto aqHandler = qobject_cast<AQScriptHandler *>(script_);
-   if (aqHandler) {
-      aqHandler->cancelled(quoteReqId);
+   for (const auto &handler : shards_) {
+      // Direct call for unsharded handler living in the caller's thread
+      QMetaObject::invokeMethod(handler, [handler, cb] { cb(handler); });
    }
 }
 
+void AQScriptRunner::setWalletsManager(const std::shared_ptr<bs::sync::WalletsManager> &walletsManager)
+{
+   forEachShard([walletsManager](AQScriptHandler *handler) {
+      handler->setWalletsManager(walletsManager);
+   });
+}
+
+void AQScriptRunner::reload(const QString &filename)
+{
+   if ((shards_.size() == 1) || NativeQuoter::isStrategyLibrary(filename)) {
+      forEachShard([filename](AQScriptHandler *handler) {
+         handler->reload(filename);
+      });
+      return;
+   }
+
+   // All shards switch to the new version or none of them does
+   const auto generation = ++reload_.generation;
+   reload_.pending = shards_.size();
+   reload_.reinit = false;
+   reload_.error.clear();
+   forEachShard([this, filename, generation](AQScriptHandler *handler) {
+      QString error;
+      bool prepared = true;
+      const bool reinit = !handler->canHotReload(filename);
+      if (reinit) {
+         handler->reload(filename);    // no script is running yet
+      }
+      else {
+         prepared = handler->prepareHotReload(filename, error);
+      }
+      QMetaObject::invokeMethod(this, [this, filename, generation, prepared, reinit, error] {
+         onShardReloadPrepared(filename, generation, prepared, reinit, error);
+      });
+   });
+}
+
+void AQScriptRunner::onShardReloadPrepared(const QString &filename, unsigned int generation
+   , bool prepared, bool reinit, const QString &error)
+{
+   if (generation != reload_.generation) {
+      return;  // superseded by newer reload, its prepare dropped this one
+   }
+   reload_.reinit |= reinit;
+   if (!prepared && reload_.error.isEmpty()) {
+      reload_.error = error;
+   }
+   if (--reload_.pending > 0) {
+      return;
+   }
+
+   if (!reload_.error.isEmpty()) {
+      forEachShard([](AQScriptHandler *handler) {
+         handler->rollbackHotReload();
+      });
+      logger_->error("[AQScriptRunner::reload] {} is not applied: {}"
+         , filename.toStdString(), reload_.error.toStdString());
+      emit reloadFailed(filename, reload_.error);
+      return;
+   }
+   forEachShard([](AQScriptHandler *handler) {
+      handler->commitHotReload();
+   });
+   logger_->info("[AQScriptRunner::reload] {} is active on {} shards", filename.toStdString()
+      , shards_.size());
+   if (!reload_.reinit) {  // re-created quoters report it themselves
+      emit scriptLoaded(filename);
+   }
+}
+
+void AQScriptRunner::cancelled(const std::string &quoteReqId)
+{
+   forEachShard([quoteReqId](AQScriptHandler *handler) {
+      handler->cancelled(quoteReqId);
+   });
+}
+
 void AQScriptRunner::settled(const std::string &quoteReqId)
 {
-   const auto aqHandler = qobject_cast<AQScriptHandler *>(script_);
-   if (aqHandler) {
-      aqHandler->settled(quoteReqId);
+   forEachShard([quoteReqId](AQScriptHandler *handler) {
+      handler->settled(quoteReqId);
+   });
+}
+
+void AQScriptRunner::setMDBatchInterval(int msec)
+{
+   forEachShard([msec](AQScriptHandler *handler) {
+      handler->setMDBatchInterval(msec);
+   });
+}
+
+std::vector<int> AQScriptRunner::shardQueueDepths() const
+{
+   std::vector<int> result;
+   result.reserve(shards_.size());
+   for (const auto &handler : shards_) {
+      result.push_back(handler->queueDepth());
    }
+   return result;
+}
+
+void AQScriptRunner::reportQueueDepths()
+{
+   const auto depths = shardQueueDepths();
+   if (std::all_of(depths.cbegin(), depths.cend(), [](int depth) { return depth == 0; })) {
+      return;
+   }
+   std::string report;
+   for (const auto depth : depths) {
+      if (!report.empty()) {
+         report += ", ";
+      }
+      report += std::to_string(depth);
+   }
+   logger_->debug("[AQScriptRunner] shard queue depths: {}", report);
 }
 
 class ExtConnListener : public DataConnectionListener
@@ -517,10 +893,9 @@ private:
 
 void AQScriptRunner::setExtConnections(const ExtConnections &conns)
 {
-   const auto aqHandler = qobject_cast<AQScriptHandler *>(script_);
-   if (aqHandler) {
-      aqHandler->setExtConnections(conns);
-   }
+   forEachShard([conns](AQScriptHandler *handler) {
+      handler->setExtConnections(conns);
+   });
 }
 
 std::shared_ptr<DataConnectionListener> AQScriptRunner::getExtConnListener()
@@ -533,10 +908,9 @@ std::shared_ptr<DataConnectionListener> AQScriptRunner::getExtConnListener()
 
 void AQScriptRunner::onExtDataReceived(const std::string &data)
 {
-   const auto aqHandler = qobject_cast<AQScriptHandler *>(script_);
-   if (aqHandler) {
-      aqHandler->extMsgReceived(data);
-   }
+   forEachShard([data](AQScriptHandler *handler) {
+      handler->extMsgReceived(data);
+   });
 }
 
 
@@ -544,9 +918,18 @@ RFQScriptHandler::RFQScriptHandler(const std::shared_ptr<spdlog::logger> &logger
    , const std::shared_ptr<MDCallbacksQt> &mdCallbacks)
    : UserScriptHandler(logger)
    , mdCallbacks_(mdCallbacks)
+   , scheduler_(new AutoRFQScheduler(logger, this))
+   , mdBatchTimer_(new QTimer(this))
 {
    connect(mdCallbacks_.get(), &MDCallbacksQt::MDUpdate, this, &RFQScriptHandler::onMDUpdate,
       Qt::QueuedConnection);
+
+   scheduler_->setRateLimit(kAutoRFQMaxPerSec, kAutoRFQBurst);
+   connect(scheduler_, &AutoRFQScheduler::sendRFQ, this, &RFQScriptHandler::sendRFQ);
+
+   mdBatchTimer_->setSingleShot(true);
+   mdBatchTimer_->setInterval(kRFQMDBatchIntervalMs);
+   connect(mdBatchTimer_, &QTimer::timeout, this, &RFQScriptHandler::flushMD);
 }
 
 RFQScriptHandler::~RFQScriptHandler() noexcept
@@ -598,8 +981,8 @@ void RFQScriptHandler::init(const QString &fileName)
       emit failedToLoad(fileName, err);
    });
 
-   connect(rfq_, &AutoRFQ::sendRFQ, this, &RFQScriptHandler::sendRFQ);
-   connect(rfq_, &AutoRFQ::cancelRFQ, this, &RFQScriptHandler::cancelRFQ);
+   connect(rfq_, &AutoRFQ::sendRFQ, scheduler_, &AutoRFQScheduler::submit);
+   connect(rfq_, &AutoRFQ::cancelRFQ, this, &RFQScriptHandler::onCancelRFQ);
    connect(rfq_, &AutoRFQ::stopRFQ, this, &RFQScriptHandler::onStopRFQ);
 
    if (!rfq_->load(fileName)) {
@@ -628,15 +1011,68 @@ void RFQScriptHandler::clear()
       rfqObj_->deleteLater();
       rfqObj_ = nullptr;
    }
+   scheduler_->clear();
 }
 
-void RFQScriptHandler::onMDUpdate(bs::network::Asset::Type at, const QString &security,
+void RFQScriptHandler::onMDUpdate(bs::network::Asset::Type, const QString &security,
    bs::network::MDFields mdFields)
 {
-   if (!rfqObj_) {
+   const auto sec = security.toStdString();
+   mdInfo_[sec].merge(bs::network::MDField::get(mdFields));
+   mdUpdated_.insert(sec);
+   if (mdBatchTimer_->interval() <= 0) {
+      flushMD();
+   }
+   else if (rfqObj_ && !mdBatchTimer_->isActive()) {
+      mdBatchTimer_->start();
+   }
+}
+
+void RFQScriptHandler::flushMD()
+{
+   if (!rfqObj_ || mdUpdated_.empty()) {
       return;
    }
-   rfqObj_->onMDUpdate(at, security, mdFields);
+   std::vector<std::pair<QString, bs::network::MDInfo>> updates;
+   updates.reserve(mdUpdated_.size());
+   for (const auto &sec : mdUpdated_) {
+      updates.push_back({ QString::fromStdString(sec), mdInfo_[sec] });
+   }
+   mdUpdated_.clear();
+
+   auto rfqObj = rfqObj_;
+   QMetaObject::invokeMethod(rfqObj, [rfqObj, updates] {
+      for (const auto &update : updates) {
+         rfqObj->onMarketData(update.first, update.second);
+      }
+   });
+}
+
+void RFQScriptHandler::onCancelRFQ(const std::string &id)
+{
+   // Throttled RFQ is dropped before it reaches RFQ ticket
+   if (!scheduler_->cancel(id)) {
+      emit cancelRFQ(id);
+   }
+}
+
+void RFQScriptHandler::setRateLimit(int maxPerSec, int burst)
+{
+   scheduler_->setRateLimit(maxPerSec, burst);
+}
+
+AutoRFQScheduler::Stats RFQScriptHandler::stats() const
+{
+   return scheduler_->stats();
+}
+
+void RFQScriptHandler::setMDBatchInterval(int msec)
+{
+   mdBatchTimer_->setInterval(std::max(msec, 0));
+   if (msec <= 0) {
+      mdBatchTimer_->stop();
+      flushMD();
+   }
 }
 
 void RFQScriptHandler::start()
@@ -660,6 +1096,12 @@ void RFQScriptHandler::start()
    logger_->debug("[RFQScriptHandler::start]");
    rfqObj_->moveToThread(thread_);
    rfqObj_->start();
+
+   // Script gets the whole snapshot collected so far
+   for (const auto &mdInfo : mdInfo_) {
+      mdUpdated_.insert(mdInfo.first);
+   }
+   flushMD();
 }
 
 void RFQScriptHandler::suspend()
@@ -671,6 +1113,7 @@ void RFQScriptHandler::suspend()
 
 void RFQScriptHandler::rfqAccepted(const std::string &id)
 {
+   scheduler_->finished(id);
    if (rfqObj_) {
       rfqObj_->onAccepted(id);
    }
@@ -678,6 +1121,7 @@ void RFQScriptHandler::rfqAccepted(const std::string &id)
 
 void RFQScriptHandler::rfqCancelled(const std::string &id)
 {
+   scheduler_->finished(id);
    if (rfqObj_) {
       rfqObj_->onCancelled(id);
    }
@@ -685,6 +1129,7 @@ void RFQScriptHandler::rfqCancelled(const std::string &id)
 
 void RFQScriptHandler::rfqExpired(const std::string &id)
 {
+   scheduler_->finished(id);
    if (rfqObj_) {
       rfqObj_->onExpired(id);
    }
@@ -692,6 +1137,7 @@ void RFQScriptHandler::rfqExpired(const std::string &id)
 
 void RFQScriptHandler::onStopRFQ(const std::string &id)
 {
+   scheduler_->finished(id);
    if (rfqObj_) {
       rfqObj_->onCancelled(id);
    }
@@ -737,3 +1183,18 @@ void RFQScriptRunner::rfqExpired(const std::string &id)
 {
    ((RFQScriptHandler *)script_)->rfqExpired(id);
 }
+
+void RFQScriptRunner::setRateLimit(int maxPerSec, int burst)
+{
+   ((RFQScriptHandler *)script_)->setRateLimit(maxPerSec, burst);
+}
+
+AutoRFQScheduler::Stats RFQScriptRunner::stats() const
+{
+   return ((RFQScriptHandler *)script_)->stats();
+}
+
+void RFQScriptRunner::setMDBatchInterval(int msec)
+{
+   ((RFQScriptHandler *)script_)->setMDBatchInterval(msec);
+}
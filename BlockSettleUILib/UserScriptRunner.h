@@ -12,15 +12,21 @@
 #ifndef USERSCRIPTRUNNER_H_INCLUDED
 #define USERSCRIPTRUNNER_H_INCLUDED
 
+#include <QDateTime>
 #include <QObject>
 #include <QTimer>
 
+#include <atomic>
 #include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
+#include "AutoRFQScheduler.h"
 #include "UserScript.h"
 #include "QuoteProvider.h"
 #include "CommonTypes.h"
@@ -36,6 +42,7 @@ namespace bs {
 }
 class DataConnectionListener;
 class MDCallbacksQt;
+class NativeQuoter;
 class RFQScript;
 class SignContainer;
 class UserScriptRunner;
@@ -55,12 +62,15 @@ public:
 
    virtual void setWalletsManager(const std::shared_ptr<bs::sync::WalletsManager> &);
    void setParent(UserScriptRunner *);
+   QThread *runningThread() const { return thread_; }
    void setRunningThread(QThread *thread) { thread_ = thread; }
    virtual void reload(const QString &filename) = 0;
 
 signals:
    void scriptLoaded(const QString &fileName);
    void failedToLoad(const QString &fileName, const QString &error);
+   // Script wasn't replaced, previous version continues to run
+   void reloadFailed(const QString &fileName, const QString &error);
 
 public slots:
    virtual void onThreadStopped()
@@ -83,6 +93,13 @@ class AQScriptHandler : public UserScriptHandler
 {
    Q_OBJECT
 public:
+   // Key used to spread quote requests between engines when AQ is sharded
+   enum class ShardKey
+   {
+      Security,   // e.g. XBT/EUR
+      Product     // all securities of the same product go to one engine
+   };
+
    explicit AQScriptHandler(const std::shared_ptr<QuoteProvider> &
       , const std::shared_ptr<SignContainer> &
       , const std::shared_ptr<MDCallbacksQt> &
@@ -92,12 +109,45 @@ public:
 
    void setWalletsManager(const std::shared_ptr<bs::sync::WalletsManager> &) override;
    void setExtConnections(const ExtConnections &conns);
+   // QML script is replaced in place: replies for active requests are
+   // re-created from the new version with their state, quotes already sent
+   // stay. Version which fails to compile or instantiate is not applied.
    void reload(const QString &filename) override;
 
+   // Two-phase reload used by sharded runner: new version is prepared by
+   // every shard and committed only if all of them succeeded, otherwise
+   // prepared version is dropped. Strategy libraries (or no running
+   // script) are not hot-reloadable, reload() re-creates quoter for them.
+   bool canHotReload(const QString &filename) const;
+   bool prepareHotReload(const QString &filename, QString &error);
+   void commitHotReload();
+   void rollbackHotReload();
+
    void cancelled(const std::string &quoteReqId);
    void settled(const std::string &quoteReqId);
    void extMsgReceived(const std::string &data);
 
+   // Should be set before handler is moved to its thread.
+   // Handler ignores quote requests that belong to other shards.
+   void setShard(size_t index, size_t count, ShardKey);
+   static size_t shardIndex(const bs::network::QuoteReqNotification &
+      , size_t count, ShardKey);
+   bool isOwnRequest(const bs::network::QuoteReqNotification &) const;
+
+   // Number of own quote requests received but not yet handled (any thread)
+   int queueDepth() const { return queueDepth_; }
+
+   // For offline replay: requests are expired by the given clock instead of
+   // wall clock, expiration ticks are driven by caller with advanceClock().
+   void setSimulatedClock(const std::function<QDateTime()> &);
+   void advanceClock();
+   // Non-FX requests are not handled without online signer by default
+   void setRequireOnlineSigner(bool require) { requireOnlineSigner_ = require; }
+
+   // Market data is accumulated per security and applied to script objects
+   // once per interval (AQ tick by default), 0 applies every update at once
+   void setMDBatchInterval(int msec);
+
 signals:
    void pullQuoteNotif(const std::string& settlementId, const std::string& reqId, const std::string& reqSessToken);
    void sendQuote(const bs::network::QuoteReqNotification &qrn, double price);
@@ -110,6 +160,7 @@ protected slots:
    void deinit() override;
 
 private slots:
+   void onQuoteReqReceived(const bs::network::QuoteReqNotification &qrn);
    void onQuoteReqNotification(const bs::network::QuoteReqNotification &qrn);
    void onQuoteReqCancelled(const QString &reqId, bool userCancelled);
    void onQuoteNotifCancelled(const QString &reqId);
@@ -120,8 +171,12 @@ private slots:
    void onAQReply(const QString &reqId, double price);
    void onAQPull(const QString &reqId);
    void aqTick();
+   void flushMD();
 
 private:
+   template <class Quoter> void initQuoter(Quoter *&, const QString &fileName);
+   QObject *instantiate(const bs::network::QuoteReqNotification &);
+   bool hotReload(const QString &filename, QString &error);
    void clear();
    void stop(const std::string &quoteReqId);
    void performOnReplyAndStop(const std::string &quoteReqId
@@ -129,19 +184,31 @@ private:
 
 private:
    AutoQuoter *aq_ = nullptr;
+   NativeQuoter *nativeAq_ = nullptr;   // used instead of aq_ for strategy libraries
    std::shared_ptr<SignContainer>            signingContainer_;
    std::shared_ptr<MDCallbacksQt>            mdCallbacks_;
    std::shared_ptr<AssetManager> assetManager_;
    ExtConnections                extConns_;
 
    std::unordered_map<std::string, QObject*> aqObjs_;
+   std::unordered_map<std::string, BSQuoteReqReply *> pendingReplies_;  // prepared for hot reload
    std::unordered_map<std::string, bs::network::QuoteReqNotification> aqQuoteReqs_;
    std::unordered_map<std::string, double>   bestQPrices_;
 
    std::unordered_map<std::string, bs::network::MDInfo>  mdInfo_;
+   std::unordered_set<std::string>  mdUpdated_;   // securities not yet applied to aqObjs_
 
    bool aqEnabled_;
    QTimer *aqTimer_;
+   QTimer *mdBatchTimer_;
+
+   std::function<QDateTime()> clock_;
+   bool requireOnlineSigner_{ true };
+
+   size_t   shardIndex_{ 0 };
+   size_t   shardCount_{ 1 };
+   ShardKey shardKey_{ ShardKey::Security };
+   std::atomic<int>  queueDepth_{ 0 };
 }; // class UserScriptHandler
 
 
@@ -161,6 +228,10 @@ public:
    void rfqCancelled(const std::string &id);
    void rfqExpired(const std::string &id);
 
+   void setRateLimit(int maxPerSec, int burst);
+   AutoRFQScheduler::Stats stats() const;
+   void setMDBatchInterval(int msec);
+
 signals:
    void sendRFQ(const std::string &id, const QString &symbol, double amount, bool buy);
    void cancelRFQ(const std::string &id);
@@ -172,7 +243,9 @@ protected slots:
 private slots:
    void onMDUpdate(bs::network::Asset::Type, const QString &security,
       bs::network::MDFields mdFields);
+   void onCancelRFQ(const std::string &id);
    void onStopRFQ(const std::string &id);
+   void flushMD();
 
 private:
    void clear();
@@ -182,6 +255,12 @@ private:
    AutoRFQ *rfq_{ nullptr };
    std::shared_ptr<MDCallbacksQt>            mdCallbacks_;
    RFQScript * rfqObj_{ nullptr };
+   AutoRFQScheduler  *scheduler_;
+
+   // One snapshot for all RFQs of the script, pushed to it once per batch
+   std::unordered_map<std::string, bs::network::MDInfo>  mdInfo_;
+   std::unordered_set<std::string>  mdUpdated_;
+   QTimer   *mdBatchTimer_;
 };
 
 
@@ -193,9 +272,9 @@ public:
       , UserScriptHandler *, QObject *parent);
    ~UserScriptRunner() noexcept override;
 
-   void setWalletsManager(const std::shared_ptr<bs::sync::WalletsManager> &);
+   virtual void setWalletsManager(const std::shared_ptr<bs::sync::WalletsManager> &);
    void setRunningThread(QThread *thread) { script_->setRunningThread(thread); }
-   void reload(const QString &filename) { script_->reload(filename); }
+   virtual void reload(const QString &filename) { script_->reload(filename); }
 
 signals:
    void init(const QString &fileName);
@@ -203,6 +282,7 @@ signals:
    void stateChanged(bool enabled);
    void scriptLoaded(const QString &fileName);
    void failedToLoad(const QString &fileName, const QString &error);
+   void reloadFailed(const QString &fileName, const QString &error);
 
 public slots:
    void enable(const QString &fileName);
@@ -214,6 +294,10 @@ protected:
    std::shared_ptr<spdlog::logger> logger_;
 }; // class UserScriptRunner
 
+// With shardCount > 1 every shard runs its own script engine on its own thread.
+// Quote requests are spread between shards by ShardKey, market data and best
+// quote prices are delivered to all of them. Shards don't share script state
+// (e.g. DataStorage), so scripts relying on it should run unsharded.
 class AQScriptRunner : public UserScriptRunner
 {
    Q_OBJECT
@@ -222,9 +306,15 @@ public:
       , const std::shared_ptr<SignContainer> &
       , const std::shared_ptr<MDCallbacksQt> &
       , const std::shared_ptr<AssetManager> &
-      , const std::shared_ptr<spdlog::logger> &, QObject *parent = nullptr);
+      , const std::shared_ptr<spdlog::logger> &
+      , size_t shardCount = 1
+      , AQScriptHandler::ShardKey shardKey = AQScriptHandler::ShardKey::Security
+      , QObject *parent = nullptr);
    ~AQScriptRunner() noexcept override;
 
+   void setWalletsManager(const std::shared_ptr<bs::sync::WalletsManager> &) override;
+   void reload(const QString &filename) override;
+
    void cancelled(const std::string &quoteReqId);
    void settled(const std::string &quoteReqId);
 
@@ -232,12 +322,37 @@ public:
    std::shared_ptr<DataConnectionListener> getExtConnListener();
    void onExtDataReceived(const std::string &data);
 
+   size_t shardCount() const { return shards_.size(); }
+   std::vector<int> shardQueueDepths() const;
+
+   void setMDBatchInterval(int msec);
+
 signals:
    void pullQuoteNotif(const std::string& settlementId, const std::string& reqId, const std::string& reqSessToken);
    void sendQuote(const bs::network::QuoteReqNotification &qrn, double price);
 
+private slots:
+   void reportQueueDepths();
+
+private:
+   void forEachShard(const std::function<void(AQScriptHandler *)> &);
+   void onShardReloadPrepared(const QString &filename, unsigned int generation
+      , bool prepared, bool reinit, const QString &error);
+
 private:
+   // Hot reload round of sharded runner
+   struct Reload {
+      unsigned int   generation{ 0 };
+      size_t         pending{ 0 };
+      bool           reinit{ false };
+      QString        error;  // of the first failed shard
+   };
+
    std::shared_ptr<DataConnectionListener>   extConnListener_;
+   std::vector<AQScriptHandler *>   shards_;
+   std::vector<QThread *>           shardThreads_;  // except shard #0 which runs on thread_
+   QTimer                           *depthTimer_{ nullptr };
+   Reload                           reload_;
 };
 
 class RFQScriptRunner : public UserScriptRunner
@@ -255,6 +370,12 @@ public:
    void rfqCancelled(const std::string &id);
    void rfqExpired(const std::string &id);
 
+   // Limit of RFQs sent to RFQ ticket by script, maxPerSec <= 0 - unlimited
+   void setRateLimit(int maxPerSec, int burst);
+   AutoRFQScheduler::Stats stats() const;
+   // Market data is pushed to script once per interval, 0 - on every update
+   void setMDBatchInterval(int msec);
+
 signals:
    void sendRFQ(const std::string &id, const QString &symbol, double amount, bool buy);
    void cancelRFQ(const std::string &id);
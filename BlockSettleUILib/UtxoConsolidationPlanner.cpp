@@ -0,0 +1,115 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "UtxoConsolidationPlanner.h"
+
+#include <algorithm>
+#include <map>
+
+#include "TradesUtils.h"
+
+using namespace bs;
+
+UtxoConsolidationPlanner::UtxoConsolidationPlanner(const Params &params, const FeeEstimator &estimator)
+   : params_(params)
+   , estimator_(estimator)
+{
+   if (!estimator_) {
+      estimator_ = [](const std::vector<UTXO> &utxos, float feePerByte) {
+         return bs::tradeutils::estimatePayinFeeWithoutChange(utxos, feePerByte);
+      };
+   }
+}
+
+UtxoConsolidationPlanner::Result UtxoConsolidationPlanner::plan(const UtxoIndex &index
+   , float feePerByte) const
+{
+   Result result;
+   result.feePerByte = feePerByte;
+
+   // Visited from smallest to largest, so each leaf list is sorted by value too
+   std::map<std::string, std::vector<UTXO>> leaves;
+   index.forEachAvailable([this, &result, &leaves](const UtxoIndex::Entry &entry) {
+      result.count++;
+      result.sum += entry.utxo.getValue();
+      if (!params_.smallValue || (entry.utxo.getValue() < params_.smallValue)) {
+         leaves[entry.leafId].push_back(entry.utxo);
+      }
+      return true;
+   });
+
+   if ((params_.maxFeePerByte > 0) && (feePerByte > params_.maxFeePerByte)) {
+      result.feeTooHigh = true;
+   }
+
+   for (const auto &leaf : leaves) {
+      planLeaf(leaf.first, leaf.second, feePerByte, result);
+   }
+   if (result.feeTooHigh) {
+      result.plans.clear();
+      result.totalFee = 0;
+      result.inputsMerged = 0;
+   }
+   return result;
+}
+
+void UtxoConsolidationPlanner::planLeaf(const std::string &leafId, const std::vector<UTXO> &utxos
+   , float feePerByte, Result &result) const
+{
+   if (utxos.empty()) {
+      return;
+   }
+
+   // All UTXOs of one leaf have the same script type and so the same input size
+   const std::vector<UTXO> one{ utxos.front() };
+   const std::vector<UTXO> two{ utxos.front(), utxos.front() };
+   const uint64_t feeOne = estimator_(one, feePerByte);
+   const uint64_t feeTwo = estimator_(two, feePerByte);
+   const uint64_t inputFee = (feeTwo > feeOne) ? feeTwo - feeOne : 0;
+
+   std::vector<UTXO> candidates;
+   candidates.reserve(utxos.size());
+   for (const auto &utxo : utxos) {
+      if (utxo.getValue() <= inputFee) {
+         result.uneconomicCount++;
+         result.uneconomicSum += utxo.getValue();
+      }
+      else {
+         candidates.push_back(utxo);
+      }
+   }
+
+   const size_t minInputs = std::max<size_t>(params_.minInputs, 2);
+   const size_t maxInputs = std::max(params_.maxInputs, minInputs);
+   auto it = candidates.cbegin();
+   while (static_cast<size_t>(candidates.cend() - it) >= minInputs) {
+      const size_t nbInputs = std::min(maxInputs, static_cast<size_t>(candidates.cend() - it));
+      Plan plan;
+      plan.leafId = leafId;
+      plan.feePerByte = feePerByte;
+      plan.inputs.assign(it, it + nbInputs);
+      it += nbInputs;
+
+      for (const auto &utxo : plan.inputs) {
+         plan.inputSum += utxo.getValue();
+      }
+      plan.fee = estimator_(plan.inputs, feePerByte);
+      if (plan.fee >= plan.inputSum) {
+         continue;
+      }
+      if (params_.maxTotalFee && (result.totalFee + plan.fee > params_.maxTotalFee)) {
+         break;
+      }
+
+      result.totalFee += plan.fee;
+      result.inputsMerged += plan.inputs.size();
+      result.plans.push_back(std::move(plan));
+   }
+}
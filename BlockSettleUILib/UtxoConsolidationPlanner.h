@@ -0,0 +1,92 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef UTXO_CONSOLIDATION_PLANNER_H
+#define UTXO_CONSOLIDATION_PLANNER_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "UtxoIndex.h"
+
+namespace bs {
+
+   // Proposes TXs which merge small UTXOs of one HD wallet into a single
+   // output per TX. Every TX spends UTXOs of one leaf only, smallest first.
+   // Reserved UTXOs are never used, as well as UTXOs which cost more to spend
+   // than they are worth at the given fee rate.
+   class UtxoConsolidationPlanner
+   {
+   public:
+      // Fee of TX spending given inputs to single output
+      using FeeEstimator = std::function<uint64_t(const std::vector<UTXO> &, float feePerByte)>;
+
+      struct Params
+      {
+         float    maxFeePerByte{ 0 };  // nothing is proposed above it, 0 - no ceiling
+         uint64_t maxTotalFee{ 0 };    // of all proposed TXs, 0 - no limit
+         uint64_t smallValue{ 0 };     // only UTXOs below it are merged, 0 - any value
+         size_t   minInputs{ 10 };     // leaves with fewer candidates are left as is
+         size_t   maxInputs{ 200 };    // per TX, keeps signing time of one TX reasonable
+      };
+
+      struct Plan
+      {
+         std::string       leafId;
+         std::vector<UTXO> inputs;
+         float    feePerByte{ 0 };
+         uint64_t inputSum{ 0 };
+         uint64_t fee{ 0 };
+
+         uint64_t outputValue() const { return inputSum - fee; }
+      };
+
+      // Reported by UTXOReservationManager, plan() itself always succeeds
+      enum class Error {
+         None,
+         UnknownWallet,
+         FeeUnavailable,
+      };
+
+      struct Result
+      {
+         Error    error{ Error::None };
+         float    feePerByte{ 0 };
+         bool     feeTooHigh{ false };
+
+         // Distribution of available UTXOs
+         size_t   count{ 0 };
+         uint64_t sum{ 0 };
+         size_t   uneconomicCount{ 0 };   // cost more to spend than their value
+         uint64_t uneconomicSum{ 0 };
+
+         std::vector<Plan> plans;
+         uint64_t totalFee{ 0 };
+         size_t   inputsMerged{ 0 };
+      };
+
+      // Default estimator is bs::tradeutils::estimatePayinFeeWithoutChange
+      explicit UtxoConsolidationPlanner(const Params &, const FeeEstimator & = {});
+
+      Result plan(const UtxoIndex &, float feePerByte) const;
+
+   private:
+      void planLeaf(const std::string &leafId, const std::vector<UTXO> &utxos
+         , float feePerByte, Result &) const;
+
+   private:
+      const Params   params_;
+      FeeEstimator   estimator_;
+   };
+
+}  // namespace bs
+
+#endif // UTXO_CONSOLIDATION_PLANNER_H
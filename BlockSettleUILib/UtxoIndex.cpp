@@ -0,0 +1,355 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#include "UtxoIndex.h"
+
+#include <algorithm>
+#include <mutex>
+
+using namespace bs;
+
+bool UtxoIndex::add(const UTXO &utxo, const std::string &leafId, bool reserved)
+{
+   Outpoint outpoint{ utxo.getTxHash(), utxo.getTxOutIndex() };
+   if (values_.find(outpoint) != values_.end()) {
+      return false;
+   }
+   values_[outpoint] = utxo.getValue();
+   auto &entry = entries_[{ utxo.getValue(), std::move(outpoint) }];
+   entry.utxo = utxo;
+   entry.leafId = leafId;
+   entry.reserved = reserved;
+   account(entry, true);
+   version_++;
+   return true;
+}
+
+bool UtxoIndex::remove(const BinaryData &txHash, uint32_t txOutIndex)
+{
+   const auto itValue = values_.find({ txHash, txOutIndex });
+   if (itValue == values_.end()) {
+      return false;
+   }
+   const auto it = entries_.find({ itValue->second, itValue->first });
+   if (it != entries_.end()) {
+      account(it->second, false);
+      entries_.erase(it);
+   }
+   values_.erase(itValue);
+   version_++;
+   return true;
+}
+
+void UtxoIndex::clear()
+{
+   entries_.clear();
+   values_.clear();
+   total_ = {};
+   leafTotals_.clear();
+   version_++;
+}
+
+void UtxoIndex::replace(UtxoIndex &&other)
+{
+   const auto version = std::max(version_, other.version_) + 1;
+   *this = std::move(other);
+   version_ = version;
+}
+
+const UtxoIndex::Entry *UtxoIndex::find(const BinaryData &txHash, uint32_t txOutIndex) const
+{
+   const auto itValue = values_.find({ txHash, txOutIndex });
+   if (itValue == values_.end()) {
+      return nullptr;
+   }
+   const auto it = entries_.find({ itValue->second, itValue->first });
+   return (it == entries_.end()) ? nullptr : &it->second;
+}
+
+bool UtxoIndex::setReserved(const BinaryData &txHash, uint32_t txOutIndex, bool reserved)
+{
+   const auto itValue = values_.find({ txHash, txOutIndex });
+   if (itValue == values_.end()) {
+      return false;
+   }
+   const auto it = entries_.find({ itValue->second, itValue->first });
+   if ((it == entries_.end()) || (it->second.reserved == reserved)) {
+      return false;
+   }
+   account(it->second, false);
+   it->second.reserved = reserved;
+   account(it->second, true);
+   version_++;
+   return true;
+}
+
+bool UtxoIndex::sameOutpoints(const UtxoIndex &other) const
+{
+   if (values_.size() != other.values_.size()) {
+      return false;
+   }
+   return std::equal(values_.begin(), values_.end(), other.values_.begin()
+      , [](const std::pair<const Outpoint, uint64_t> &a, const std::pair<const Outpoint, uint64_t> &b) {
+         return a.first == b.first;
+      });
+}
+
+bool UtxoIndex::isAvailable(const std::vector<UTXO> &utxos) const
+{
+   for (const auto &utxo : utxos) {
+      const auto entry = find(utxo.getTxHash(), utxo.getTxOutIndex());
+      if (!entry || entry->reserved) {
+         return false;
+      }
+   }
+   return true;
+}
+
+uint64_t UtxoIndex::availableSum(const std::string &leafId) const
+{
+   if (leafId.empty()) {
+      return total_.sum;
+   }
+   const auto it = leafTotals_.find(leafId);
+   return (it == leafTotals_.end()) ? 0 : it->second.sum;
+}
+
+size_t UtxoIndex::availableCount(const std::string &leafId) const
+{
+   if (leafId.empty()) {
+      return total_.count;
+   }
+   const auto it = leafTotals_.find(leafId);
+   return (it == leafTotals_.end()) ? 0 : it->second.count;
+}
+
+void UtxoIndex::forEachAvailable(const std::function<bool(const Entry &)> &cb
+   , const std::string &leafId) const
+{
+   for (const auto &entry : entries_) {
+      if (isAvailable(entry.second, leafId) && !cb(entry.second)) {
+         break;
+      }
+   }
+}
+
+std::vector<UTXO> UtxoIndex::available(const std::string &leafId) const
+{
+   std::vector<UTXO> result;
+   result.reserve(availableCount(leafId));
+   forEachAvailable([&result](const Entry &entry) {
+      result.push_back(entry.utxo);
+      return true;
+   }, leafId);
+   return result;
+}
+
+std::vector<UTXO> UtxoIndex::all() const
+{
+   std::vector<UTXO> result;
+   result.reserve(entries_.size());
+   for (const auto &entry : entries_) {
+      result.push_back(entry.second.utxo);
+   }
+   return result;
+}
+
+std::vector<UTXO> UtxoIndex::select(uint64_t amount, const std::string &leafId) const
+{
+   std::vector<UTXO> result;
+   // Largest UTXOs are taken from the top, so everything starting from top is used
+   auto top = entries_.end();
+   uint64_t remaining = amount;
+   while (remaining > 0) {
+      auto it = entries_.lower_bound({ remaining, {} });
+      if ((top != entries_.end()) && ((it == entries_.end()) || !(it->first < top->first))) {
+         it = top;   // only used UTXOs cover the rest
+      }
+      for (; it != top; ++it) {
+         if (isAvailable(it->second, leafId)) {
+            result.push_back(it->second.utxo);
+            return result;
+         }
+      }
+
+      auto itLargest = top;
+      while (itLargest != entries_.begin()) {
+         --itLargest;
+         if (isAvailable(itLargest->second, leafId)) {
+            break;
+         }
+      }
+      if ((itLargest == top) || !isAvailable(itLargest->second, leafId)) {
+         break;   // nothing left
+      }
+      result.push_back(itLargest->second.utxo);
+      remaining -= itLargest->first.first;
+      top = itLargest;
+   }
+   return result;
+}
+
+void UtxoIndex::account(const Entry &entry, bool add)
+{
+   if (entry.reserved) {
+      return;
+   }
+   auto &leafTotals = leafTotals_[entry.leafId];
+   if (add) {
+      total_.sum += entry.utxo.getValue();
+      total_.count++;
+      leafTotals.sum += entry.utxo.getValue();
+      leafTotals.count++;
+   }
+   else {
+      total_.sum -= entry.utxo.getValue();
+      total_.count--;
+      leafTotals.sum -= entry.utxo.getValue();
+      leafTotals.count--;
+      if (leafTotals.count == 0) {
+         leafTotals_.erase(entry.leafId);
+      }
+   }
+}
+
+bool UtxoIndex::isAvailable(const Entry &entry, const std::string &leafId) const
+{
+   return !entry.reserved && (leafId.empty() || (entry.leafId == leafId));
+}
+
+
+ConcurrentUtxoIndex::ConcurrentUtxoIndex(UtxoIndex &&index)
+   : index_(std::move(index))
+{}
+
+void ConcurrentUtxoIndex::read(const std::function<void(const UtxoIndex &)> &cb) const
+{
+   std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+   cb(index_);
+}
+
+void ConcurrentUtxoIndex::modify(const std::function<void(UtxoIndex &)> &cb)
+{
+   std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+   cb(index_);
+}
+
+uint64_t ConcurrentUtxoIndex::version() const
+{
+   std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+   return index_.version();
+}
+
+bool ConcurrentUtxoIndex::tryReserve(const std::vector<UTXO> &utxos)
+{
+   std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+   if (!index_.isAvailable(utxos)) {
+      return false;
+   }
+   reserveLocked(utxos);
+   return true;
+}
+
+void ConcurrentUtxoIndex::release(const std::vector<UTXO> &utxos)
+{
+   std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+   for (const auto &utxo : utxos) {
+      index_.setReserved(utxo.getTxHash(), utxo.getTxOutIndex(), false);
+   }
+}
+
+void ConcurrentUtxoIndex::reserveLocked(const std::vector<UTXO> &utxos)
+{
+   for (const auto &utxo : utxos) {
+      index_.setReserved(utxo.getTxHash(), utxo.getTxOutIndex(), true);
+   }
+}
+
+
+void UtxoDeltaTracker::reloadStarted(const std::string &walletId)
+{
+   reloads_[walletId]++;
+}
+
+void UtxoDeltaTracker::reloadFinished(const std::string &walletId, UtxoIndex &loaded)
+{
+   const auto itMined = minedDuringReload_.find(walletId);
+   if (itMined != minedDuringReload_.end()) {
+      for (const auto &output : itMined->second) {
+         loaded.add(output.second.utxo, output.second.leafId);
+      }
+   }
+   for (const auto &spent : spentDuringReload_) {
+      loaded.remove(spent.first.first, spent.first.second);
+   }
+   for (const auto &zc : zcSpent_) {
+      for (const auto &outpoint : zc.second) {
+         loaded.remove(outpoint.first, outpoint.second);
+      }
+   }
+
+   const auto itReloads = reloads_.find(walletId);
+   if ((itReloads == reloads_.end()) || (--itReloads->second > 0)) {
+      return;
+   }
+   reloads_.erase(itReloads);
+   if (itMined != minedDuringReload_.end()) {
+      minedDuringReload_.erase(itMined);
+   }
+   if (reloads_.empty()) {
+      spentDuringReload_.clear();
+   }
+}
+
+void UtxoDeltaTracker::zcSpent(const BinaryData &zcHash, const BinaryData &txHash, uint32_t txOutIndex)
+{
+   Outpoint outpoint{ txHash, txOutIndex };
+   for (auto &mined : minedDuringReload_) {
+      mined.second.erase(outpoint);
+   }
+   zcSpent_[zcHash].insert(std::move(outpoint));
+}
+
+void UtxoDeltaTracker::zcMined(const BinaryData &zcHash)
+{
+   const auto it = zcSpent_.find(zcHash);
+   if (it == zcSpent_.end()) {
+      return;
+   }
+   if (isReloading()) {
+      // Snapshot in flight could be taken before the TX was mined
+      for (const auto &outpoint : it->second) {
+         spentDuringReload_[outpoint] = zcHash;
+      }
+   }
+   zcSpent_.erase(it);
+}
+
+void UtxoDeltaTracker::zcInvalidated(const BinaryData &zcHash)
+{
+   zcSpent_.erase(zcHash);
+   for (auto it = spentDuringReload_.begin(); it != spentDuringReload_.end(); ) {
+      if (it->second == zcHash) {
+         it = spentDuringReload_.erase(it);
+      }
+      else {
+         ++it;
+      }
+   }
+}
+
+void UtxoDeltaTracker::outputMined(const std::string &walletId, const UTXO &utxo
+   , const std::string &leafId)
+{
+   if (reloads_.find(walletId) == reloads_.end()) {
+      return;
+   }
+   minedDuringReload_[walletId][{ utxo.getTxHash(), utxo.getTxOutIndex() }] = { utxo, leafId };
+}
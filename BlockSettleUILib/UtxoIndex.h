@@ -0,0 +1,168 @@
+/*
+
+***********************************************************************************
+* Copyright (C) 2020, BlockSettle AB
+* Distributed under the GNU Affero General Public License (AGPL v3)
+* See LICENSE or http://www.gnu.org/licenses/agpl.html
+*
+**********************************************************************************
+
+*/
+#ifndef UTXO_INDEX_H
+#define UTXO_INDEX_H
+
+#include <functional>
+#include <map>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TxClasses.h"
+
+namespace bs {
+
+   // UTXOs of one HD wallet sorted by value, with reservation flags and
+   // running totals of available (not reserved) amount per wallet and per leaf.
+   // Sums are O(1) (O(log leaves) for one leaf), add/remove/reserve are O(log n).
+   // Not thread-safe.
+   class UtxoIndex
+   {
+   public:
+      struct Entry
+      {
+         UTXO        utxo;
+         std::string leafId;
+         bool        reserved{ false };
+      };
+
+      // Returns false if UTXO is already there
+      bool add(const UTXO &, const std::string &leafId, bool reserved = false);
+      bool remove(const BinaryData &txHash, uint32_t txOutIndex);
+      void clear();
+      // Takes content (with reservation flags) of other index, version keeps growing
+      void replace(UtxoIndex &&);
+
+      const Entry *find(const BinaryData &txHash, uint32_t txOutIndex) const;
+      // Returns true if flag was changed
+      bool setReserved(const BinaryData &txHash, uint32_t txOutIndex, bool reserved);
+
+      size_t size() const { return entries_.size(); }
+      bool sameOutpoints(const UtxoIndex &) const;
+      // Changes on every add, remove and reservation flag change
+      uint64_t version() const { return version_; }
+      // True if all UTXOs are present and not reserved
+      bool isAvailable(const std::vector<UTXO> &) const;
+
+      // Empty leafId means all leaves
+      uint64_t availableSum(const std::string &leafId = {}) const;
+      size_t availableCount(const std::string &leafId = {}) const;
+
+      // Visits available UTXOs from smallest to largest while cb returns true
+      void forEachAvailable(const std::function<bool(const Entry &)> &
+         , const std::string &leafId = {}) const;
+      std::vector<UTXO> available(const std::string &leafId = {}) const;
+      std::vector<UTXO> all() const;
+
+      // Same strategy as bs::selectUtxoForAmount, but without copying and
+      // sorting candidates: take the smallest available UTXO which covers the
+      // rest of amount, otherwise the largest one and repeat. Returns all
+      // available UTXOs if amount can't be covered.
+      std::vector<UTXO> select(uint64_t amount, const std::string &leafId = {}) const;
+
+   private:
+      using Outpoint = std::pair<BinaryData, uint32_t>;
+      using Key = std::pair<uint64_t, Outpoint>;   // value goes first to keep entries sorted by it
+
+      struct Totals
+      {
+         uint64_t sum{ 0 };
+         size_t   count{ 0 };
+      };
+
+      void account(const Entry &, bool add);
+      bool isAvailable(const Entry &, const std::string &leafId) const;
+
+   private:
+      std::map<Key, Entry>             entries_;
+      std::map<Outpoint, uint64_t>     values_;
+      Totals                           total_;
+      std::map<std::string, Totals>    leafTotals_;
+      uint64_t                         version_{ 0 };
+   };
+
+
+   // Thread-safe UtxoIndex. Selection runs on shared lock (read), so concurrent
+   // callers don't wait for each other while selecting. Reservation takes
+   // exclusive lock and checks (optimistically) that selected UTXOs are still
+   // available: if another caller reserved some of them meanwhile, caller
+   // repeats selection on the new state.
+   class ConcurrentUtxoIndex
+   {
+   public:
+      ConcurrentUtxoIndex() = default;
+      explicit ConcurrentUtxoIndex(UtxoIndex &&);
+
+      void read(const std::function<void(const UtxoIndex &)> &) const;
+      void modify(const std::function<void(UtxoIndex &)> &);
+      uint64_t version() const;
+
+      // Reserves all UTXOs or none if some of them are already reserved or gone
+      bool tryReserve(const std::vector<UTXO> &);
+      void release(const std::vector<UTXO> &);
+
+      // Selection attempts before caller gives up on conflicts
+      static const unsigned int kMaxOptimisticAttempts = 8;
+
+   private:
+      void reserveLocked(const std::vector<UTXO> &);
+
+   private:
+      mutable std::shared_timed_mutex  mutex_;
+      UtxoIndex   index_;
+   };
+
+
+   // Full reload of UtxoIndex runs asynchronously, so loaded snapshot could be
+   // taken before ZC and new block deltas applied to current index meanwhile.
+   // Tracker keeps inputs spent by not yet mined ZCs, and new block deltas
+   // applied while reloads are in flight, to re-apply them to loaded snapshot.
+   // Not thread-safe.
+   class UtxoDeltaTracker
+   {
+   public:
+      void reloadStarted(const std::string &walletId);
+      // Brings loaded snapshot of the wallet up to date
+      void reloadFinished(const std::string &walletId, UtxoIndex &loaded);
+
+      void zcSpent(const BinaryData &zcHash, const BinaryData &txHash, uint32_t txOutIndex);
+      // Spends of mined ZC stay tracked until reloads in flight are finished
+      void zcMined(const BinaryData &zcHash);
+      // Inputs of invalidated ZC are spendable again
+      void zcInvalidated(const BinaryData &zcHash);
+      void outputMined(const std::string &walletId, const UTXO &, const std::string &leafId);
+
+      bool isReloading() const { return !reloads_.empty(); }
+      size_t zcCount() const { return zcSpent_.size(); }
+
+   private:
+      using Outpoint = std::pair<BinaryData, uint32_t>;
+
+      struct MinedOutput
+      {
+         UTXO        utxo;
+         std::string leafId;
+      };
+
+   private:
+      std::map<std::string, unsigned int>       reloads_;      // in flight per wallet
+      std::map<BinaryData, std::set<Outpoint>>  zcSpent_;      // by not yet mined ZC
+      // Spent by ZCs mined while reloads are in flight
+      std::map<Outpoint, BinaryData>            spentDuringReload_;   // by ZC hash
+      std::map<std::string, std::map<Outpoint, MinedOutput>>   minedDuringReload_;
+   };
+
+}  // namespace bs
+
+#endif // UTXO_INDEX_H
@@ -11,6 +11,9 @@
 #include "UtxoReservationManager.h"
 
 #include <cassert>
+#include <cmath>
+#include <QThread>
+#include <QTimer>
 #include <spdlog/spdlog.h>
 
 #include "UtxoReservation.h"
@@ -20,16 +23,36 @@
 #include "Wallets/SyncHDLeaf.h"
 #include "TradesUtils.h"
 #include "ArmoryObject.h"
+#include "FeeEstimateCache.h"
 #include "WalletUtils.h"
 
 using namespace bs;
 
+namespace {
+   // Consistency check of delta-maintained UTXO sets
+   const int kFullResyncIntervalMs = 5 * 60 * 1000;
+
+   // Consolidation is not urgent and could wait for cheaper blocks
+   const unsigned int kConsolidationFeeTargetBlocks = 24;
+
+   bool isTradingLeaf(bs::hd::Purpose purpose)
+   {
+      // Non-segwit leaves of HW wallets are not used in trading
+      return (purpose == bs::hd::Purpose::Native) || (purpose == bs::hd::Purpose::Nested);
+   }
+}
+
 UTXOReservationManager::UTXOReservationManager(const std::shared_ptr<bs::sync::WalletsManager>& walletsManager,
    const std::shared_ptr<ArmoryObject>& armory, const std::shared_ptr<spdlog::logger>& logger, QObject* parent /*= nullptr*/)
    : walletsManager_(walletsManager)
    , armory_(armory)
    , logger_(logger)
+   , planThread_(new QThread(this))
+   , planWorker_(new QObject())
 {
+   planWorker_->moveToThread(planThread_);
+   planThread_->start();
+
    connect(walletsManager_.get(), &bs::sync::WalletsManager::walletsSynchronized,
       this, &UTXOReservationManager::refreshAvailableUTXO, Qt::QueuedConnection);
    connect(walletsManager_.get(), &bs::sync::WalletsManager::walletAdded,
@@ -38,20 +61,38 @@ UTXOReservationManager::UTXOReservationManager(const std::shared_ptr<bs::sync::W
       this, &UTXOReservationManager::onWalletsDeleted);
    connect(walletsManager_.get(), &bs::sync::WalletsManager::walletBalanceUpdated,
       this, &UTXOReservationManager::onWalletsBalanceChanged);
+
+   resyncTimer_ = new QTimer(this);
+   resyncTimer_->setInterval(kFullResyncIntervalMs);
+   connect(resyncTimer_, &QTimer::timeout, this, &UTXOReservationManager::onFullResync);
+   resyncTimer_->start();
+
+   init(armory_.get());
 }
 
-UTXOReservationManager::~UTXOReservationManager() = default;
+UTXOReservationManager::~UTXOReservationManager()
+{
+   cleanup();
+   planThread_->quit();
+   planThread_->wait();
+   delete planWorker_;
+}
 
 bs::UtxoReservationToken UTXOReservationManager::makeNewReservation(const std::vector<UTXO> &utxos, const std::string &reserveId)
 {
-   auto onReleaseCb = [mngr = QPointer<UTXOReservationManager>(this)]() {
-      if (!mngr) {
-         return;
-      }
-      mngr->availableUtxoChanged({});
+   auto onReleaseCb = [mngr = QPointer<UTXOReservationManager>(this), utxos]() {
+      // Token could be released from any thread
+      QMetaObject::invokeMethod(mngr, [mngr, utxos] {
+         if (!mngr) {
+            return;
+         }
+         mngr->updateReserved(utxos);
+         mngr->availableUtxoChanged({});
+      });
    };
 
    auto reservation = bs::UtxoReservationToken::makeNewReservation(logger_, utxos, reserveId, onReleaseCb);
+   updateReserved(utxos);
    // #ReservationMngr: could be optimized by updating only needed wallet
    availableUtxoChanged({});
    return reservation;
@@ -66,100 +107,142 @@ bs::UtxoReservationToken bs::UTXOReservationManager::makeNewReservation(const st
 void UTXOReservationManager::reserveBestXbtUtxoSet(const HDWalletId& walletId, BTCNumericTypes::satoshi_type quantity, bool partial,
    std::function<void(FixedXbtInputs&&)>&& cb, bool checkPbFeeFloor, CheckAmount checkAmount)
 {
-   auto bestUtxoSetCb = getReservationCb(walletId, partial, std::move(cb));
-   getBestXbtUtxoSet(walletId, quantity, std::move(bestUtxoSetCb), checkPbFeeFloor, checkAmount);
+   reserveBestXbtFromIndex(walletId, {}, quantity, partial, std::move(cb), checkPbFeeFloor, checkAmount, 0);
 }
 
 void bs::UTXOReservationManager::reserveBestXbtUtxoSet(const HDWalletId& walletId, bs::hd::Purpose purpose, BTCNumericTypes::satoshi_type quantity
    , bool partial, std::function<void(FixedXbtInputs&&)>&& cb, bool checkPbFeeFloor, CheckAmount checkAmount)
 {
-   auto bestUtxoSetCb = getReservationCb(walletId, partial, std::move(cb));
-   getBestXbtUtxoSet(walletId, purpose, quantity, std::move(bestUtxoSetCb), checkPbFeeFloor, checkAmount);
+   const auto leafId = xbtLeafId(walletId, purpose);
+   // Wallet without such leaf has no UTXOs
+   reserveBestXbtFromIndex(leafId.empty() ? HDWalletId{} : walletId, leafId, quantity, partial
+      , std::move(cb), checkPbFeeFloor, checkAmount, 0);
 }
 
 BTCNumericTypes::satoshi_type bs::UTXOReservationManager::getAvailableXbtUtxoSum(const HDWalletId& walletId) const
 {
+   const auto utxoIndex = xbtIndex(walletId);
    BTCNumericTypes::satoshi_type sum = 0;
-   auto const availableUtxos = getAvailableXbtUTXOs(walletId);
-   for (const auto &utxo : availableUtxos) {
-      sum += utxo.getValue();
+   if (utxoIndex) {
+      utxoIndex->read([&sum](const UtxoIndex &index) { sum = index.availableSum(); });
    }
-
    return sum;
 }
 
 BTCNumericTypes::satoshi_type bs::UTXOReservationManager::getAvailableXbtUtxoSum(const HDWalletId& walletId, bs::hd::Purpose purpose) const
 {
+   const auto leafId = xbtLeafId(walletId, purpose);
+   const auto utxoIndex = xbtIndex(walletId);
    BTCNumericTypes::satoshi_type sum = 0;
-   auto const availableUtxos = getAvailableXbtUTXOs(walletId, purpose);
-   for (const auto &utxo : availableUtxos) {
-      sum += utxo.getValue();
+   if (!leafId.empty() && utxoIndex) {
+      utxoIndex->read([&sum, &leafId](const UtxoIndex &index) { sum = index.availableSum(leafId); });
    }
-
    return sum;
 }
 
 std::vector<UTXO> bs::UTXOReservationManager::getAvailableXbtUTXOs(const HDWalletId& walletId) const
 {
-   auto const availableUtxos = availableXbtUTXOs_.find(walletId);
-   if (availableUtxos == availableXbtUTXOs_.end()) {
-      return {};
-   }
-
+   const auto utxoIndex = xbtIndex(walletId);
    std::vector<UTXO> utxos;
-   utxos = availableUtxos->second.availableUtxo_;
-   std::vector<UTXO> filtered;
-   UtxoReservation::instance()->filter(utxos, filtered);
+   if (utxoIndex) {
+      utxoIndex->read([&utxos](const UtxoIndex &index) { utxos = index.available(); });
+   }
    return utxos;
 }
 
 std::vector<UTXO> bs::UTXOReservationManager::getAvailableXbtUTXOs(const HDWalletId& walletId
    , bs::hd::Purpose purpose) const
 {
-   auto hdWallet = walletsManager_->getHDWalletById(walletId);
-   auto xbtGroup = hdWallet->getGroup(hdWallet->getXBTGroupType());
-   if (xbtGroup == nullptr) {
-      return {};
+   const auto leafId = xbtLeafId(walletId, purpose);
+   const auto utxoIndex = xbtIndex(walletId);
+   std::vector<UTXO> utxos;
+   if (!leafId.empty() && utxoIndex) {
+      utxoIndex->read([&utxos, &leafId](const UtxoIndex &index) { utxos = index.available(leafId); });
    }
+   return utxos;
+}
 
-   auto leaf = xbtGroup->getLeaf(purpose);
-
-   if (!leaf) {
-      return {};
+void bs::UTXOReservationManager::planXbtConsolidation(const HDWalletId& walletId
+   , const UtxoConsolidationPlanner::Params &params
+   , std::function<void(UtxoConsolidationPlanner::Result&&)>&& cb)
+{
+   const auto utxoIndex = xbtIndex(walletId);
+   if (!utxoIndex) {
+      SPDLOG_LOGGER_ERROR(logger_, "unknown wallet {}", walletId);
+      QMetaObject::invokeMethod(this, [cb = std::move(cb)] {
+         UtxoConsolidationPlanner::Result result;
+         result.error = UtxoConsolidationPlanner::Error::UnknownWallet;
+         cb(std::move(result));
+      }, Qt::QueuedConnection);
+      return;
    }
 
-   const auto& leafId = leaf->walletId();
-   std::vector<UTXO> utxos = getAvailableXbtUTXOs(walletId);
-   if (utxos.empty()) {
-      return utxos;
-   }
+   // Snapshot is taken here, so reservations made after the call are not proposed
+   auto snapshot = std::make_shared<UtxoIndex>();
+   utxoIndex->read([&snapshot](const UtxoIndex &index) { *snapshot = index; });
+
+   auto feeCb = [mgr = QPointer<bs::UTXOReservationManager>(this), walletId, params
+      , snapshot, cbCopy = std::move(cb)](float fee) mutable {
+      if (!mgr) {
+         return;
+      }
+      // Fee could be returned right away from cache, so callback is never called in place
+      QMetaObject::invokeMethod(mgr, [mgr, walletId, params, snapshot, fee, cb = std::move(cbCopy)]() mutable {
+         if (!mgr) {
+            return;
+         }
+         // Failed estimates are passed as 0 or infinity
+         if (!std::isfinite(fee) || (fee <= 0)) {
+            SPDLOG_LOGGER_ERROR(mgr->logger_, "fee estimate is not available ({}), {} is not planned"
+               , fee, walletId);
+            UtxoConsolidationPlanner::Result result;
+            result.error = UtxoConsolidationPlanner::Error::FeeUnavailable;
+            cb(std::move(result));
+            return;
+         }
+         const float feePerByte = std::max(mgr->feeRatePb(), ArmoryConnection::toFeePerByte(fee));
+
+         QMetaObject::invokeMethod(mgr->planWorker_, [mgr, logger = mgr->logger_, walletId, params
+            , snapshot, feePerByte, cb = std::move(cb)]() mutable {
+            auto result = UtxoConsolidationPlanner(params).plan(*snapshot, feePerByte);
+            SPDLOG_LOGGER_DEBUG(logger, "wallet {}: {} UTXOs ({} uneconomic), {} TX(s) merging {} inputs for {} sat at {} s/b"
+               , walletId, result.count, result.uneconomicCount, result.plans.size(), result.inputsMerged
+               , result.totalFee, feePerByte);
+
+            // Manager waits for planning thread on destruction, so it's still alive here
+            QMetaObject::invokeMethod(mgr, [result = std::move(result), cb = std::move(cb)]() mutable {
+               cb(std::move(result));
+            });
+         });
+      }, Qt::QueuedConnection);
+   };
+   bs::FeeEstimateCache::estimateFee(armory_, kConsolidationFeeTargetBlocks, feeCb);
+}
 
-   auto const availableUtxos = availableXbtUTXOs_.find(walletId);
-   if (availableUtxos == availableXbtUTXOs_.end()) {
+bs::UtxoReservationToken bs::UTXOReservationManager::tryReserveXbt(const HDWalletId& walletId
+   , const std::vector<UTXO> &utxos)
+{
+   const auto utxoIndex = xbtIndex(walletId);
+   if (utxoIndex && !utxoIndex->tryReserve(utxos)) {
+      SPDLOG_LOGGER_ERROR(logger_, "can't reserve UTXOs in {}: some of them are reserved already", walletId);
       return {};
    }
-
-   auto& leafLookup = availableUtxos->second.utxosLookup_;
-   auto i = std::remove_if(utxos.begin(), utxos.end(), [&leafLookup, &leafId](const UTXO& utxo) -> bool {
-      return leafId != leafLookup.at(utxo);
-   });
-   utxos.erase(i, utxos.end());
-
-   return utxos;
+   return makeNewReservation(utxos);
 }
 
 void bs::UTXOReservationManager::getBestXbtUtxoSet(const HDWalletId& walletId,
    BTCNumericTypes::satoshi_type quantity, std::function<void(std::vector<UTXO>&&)>&& cb, bool checkPbFeeFloor, CheckAmount checkAmount)
 {
-   auto walletUtxos = getAvailableXbtUTXOs(walletId);
-   getBestXbtFromUtxos(walletUtxos, quantity, std::move(cb), checkPbFeeFloor, checkAmount);
+   getBestXbtFromIndex(walletId, {}, quantity, std::move(cb), checkPbFeeFloor, checkAmount);
 }
 
 void bs::UTXOReservationManager::getBestXbtUtxoSet(const HDWalletId& walletId, bs::hd::Purpose purpose,
    BTCNumericTypes::satoshi_type quantity, std::function<void(std::vector<UTXO>&&)>&& cb, bool checkPbFeeFloor, CheckAmount checkAmount)
 {
-   auto walletUtxos = getAvailableXbtUTXOs(walletId, purpose);
-   getBestXbtFromUtxos(walletUtxos, quantity, std::move(cb), checkPbFeeFloor, checkAmount);
+   const auto leafId = xbtLeafId(walletId, purpose);
+   // Wallet without such leaf has no UTXOs
+   getBestXbtFromIndex(leafId.empty() ? HDWalletId{} : walletId, leafId, quantity
+      , std::move(cb), checkPbFeeFloor, checkAmount);
 }
 
 BTCNumericTypes::balance_type bs::UTXOReservationManager::getAvailableCCUtxoSum(const CCProductName& CCProduct) const
@@ -203,16 +286,23 @@ bs::FixedXbtInputs UTXOReservationManager::convertUtxoToFixedInput(const HDWalle
 
 bs::FixedXbtInputs bs::UTXOReservationManager::convertUtxoToPartialFixedInput(const HDWalletId& walletId, const std::vector<UTXO>& utxos)
 {
-   auto const availableUtxos = availableXbtUTXOs_.find(walletId);
-   if (availableUtxos == availableXbtUTXOs_.end()) {
+   const auto utxoIndex = xbtIndex(walletId);
+   if (!utxoIndex) {
       return {};
    }
 
-   const auto &utxoLookup = availableUtxos->second.utxosLookup_;
    FixedXbtInputs fixedXbtInputs;
-   for (auto utxo : utxos) {
-      fixedXbtInputs.inputs.insert({ utxo, utxoLookup.at(utxo) });
-   }
+   utxoIndex->read([this, &walletId, &utxos, &fixedXbtInputs](const UtxoIndex &index) {
+      for (auto utxo : utxos) {
+         const auto entry = index.find(utxo.getTxHash(), utxo.getTxOutIndex());
+         if (!entry) {
+            SPDLOG_LOGGER_ERROR(logger_, "UTXO {}:{} is not found in wallet {}"
+               , utxo.getTxHash().toHexStr(true), utxo.getTxOutIndex(), walletId);
+            continue;
+         }
+         fixedXbtInputs.inputs.insert({ utxo, entry->leafId });
+      }
+   });
    return fixedXbtInputs;
 }
 
@@ -228,7 +318,10 @@ float UTXOReservationManager::feeRatePb() const
 
 void bs::UTXOReservationManager::refreshAvailableUTXO()
 {
-   availableXbtUTXOs_.clear();
+   {
+      std::lock_guard<std::mutex> lock(xbtIndexesMutex_);
+      availableXbtUTXOs_.clear();
+   }
    for (auto &wallet : walletsManager_->hdWallets()) {
       resetHdWallet(wallet->walletId());
    }
@@ -236,7 +329,10 @@ void bs::UTXOReservationManager::refreshAvailableUTXO()
 
 void bs::UTXOReservationManager::onWalletsDeleted(const std::string& walledId)
 {
-   availableXbtUTXOs_.erase(walledId);
+   {
+      std::lock_guard<std::mutex> lock(xbtIndexesMutex_);
+      availableXbtUTXOs_.erase(walledId);
+   }
    availableCCUTXOs_.erase(walledId);
    if (!walletsManager_->hasPrimaryWallet()) {
       availableCCUTXOs_.clear();
@@ -275,10 +371,236 @@ void bs::UTXOReservationManager::onWalletsAdded(const std::string& walledId)
 
 void bs::UTXOReservationManager::onWalletsBalanceChanged(const std::string& walledId)
 {
+   // UTXOs of already loaded wallets are maintained from ZC and new block notifications
+   const auto wallet = walletsManager_->getWalletById(walledId);
+   if (wallet && (wallet->type() == bs::core::wallet::Type::ColorCoin)) {
+      if (availableCCUTXOs_.find(walledId) != availableCCUTXOs_.end()) {
+         return;
+      }
+   }
+   else {
+      const auto hdWallet = walletsManager_->getHDRootForLeaf(walledId);
+      const auto hdWalletId = hdWallet ? hdWallet->walletId() : walledId;
+      if (xbtIndex(hdWalletId)) {
+         return;
+      }
+   }
+
    onWalletsDeleted(walledId);
    onWalletsAdded(walledId);
 }
 
+void bs::UTXOReservationManager::onFullResync()
+{
+   for (const auto &wallet : walletsManager_->hdWallets()) {
+      resetHdWallet(wallet->walletId());
+   }
+}
+
+void bs::UTXOReservationManager::onZCReceived(const std::string&, const std::vector<bs::TXEntry>& entries)
+{
+   std::set<BinaryData> txHashes;
+   for (const auto &entry : entries) {
+      if (!entry.walletIds.empty()) {
+         txHashes.insert(entry.txHash);
+      }
+   }
+   QMetaObject::invokeMethod(this, [this, txHashes] {
+      requestTXs(txHashes, &UTXOReservationManager::applyZC);
+   });
+}
+
+void bs::UTXOReservationManager::onZCInvalidated(const std::set<BinaryData>& ids)
+{
+   QMetaObject::invokeMethod(this, [this, ids] {
+      // Inputs removed by invalidated ZC are back, reload affected wallets
+      std::set<std::string> walletIds;
+      for (const auto &txHash : ids) {
+         xbtDeltas_.zcInvalidated(txHash);
+         const auto it = zcWallets_.find(txHash);
+         if (it == zcWallets_.end()) {
+            continue;
+         }
+         walletIds.insert(it->second.begin(), it->second.end());
+         zcWallets_.erase(it);
+         pendingOutputs_.erase(txHash);
+      }
+
+      for (const auto &walletId : walletIds) {
+         if (xbtIndex(walletId)) {
+            const auto hdWallet = walletsManager_->getHDWalletById(walletId);
+            if (hdWallet) {
+               resetSpendableXbt(hdWallet);
+            }
+            continue;
+         }
+         const auto ccWallet = walletsManager_->getWalletById(walletId);
+         if (ccWallet && (ccWallet->type() == bs::core::wallet::Type::ColorCoin)) {
+            resetSpendableCC(ccWallet);
+         }
+      }
+   });
+}
+
+void bs::UTXOReservationManager::onNewBlock(unsigned int, unsigned int)
+{
+   QMetaObject::invokeMethod(this, [this] {
+      // Received CC outputs need tracker validation, so CC leaves are reloaded
+      for (const auto &walletId : ccReceived_) {
+         const auto ccWallet = walletsManager_->getWalletById(walletId);
+         if (ccWallet) {
+            resetSpendableCC(ccWallet);
+         }
+      }
+      ccReceived_.clear();
+
+      std::set<BinaryData> txHashes;
+      for (const auto &zc : zcWallets_) {
+         txHashes.insert(zc.first);
+      }
+      requestTXs(txHashes, &UTXOReservationManager::applyMined);
+   });
+}
+
+void bs::UTXOReservationManager::requestTXs(const std::set<BinaryData> &hashes
+   , void (UTXOReservationManager::*apply)(const AsyncClient::TxBatchResult &))
+{
+   if (hashes.empty()) {
+      return;
+   }
+
+   const auto cbTXs = [mgr = QPointer<bs::UTXOReservationManager>(this), logger = logger_, apply]
+      (const AsyncClient::TxBatchResult &txs, std::exception_ptr eptr)
+   {
+      if (eptr) {
+         // Periodic full reload will fix the state
+         SPDLOG_LOGGER_ERROR(logger, "getTXsByHash failed");
+         return;
+      }
+      if (!mgr) {
+         return; // manager thread die, nothing to do
+      }
+      QMetaObject::invokeMethod(mgr, [mgr, txs, apply] {
+         (mgr.data()->*apply)(txs);
+      });
+   };
+   if (!armory_->getTXsByHash(hashes, cbTXs, true)) {
+      SPDLOG_LOGGER_ERROR(logger_, "getTXsByHash failed");
+   }
+}
+
+void bs::UTXOReservationManager::applyZC(const AsyncClient::TxBatchResult &txs)
+{
+   std::set<std::string> changedWallets;
+   for (const auto &txPair : txs) {
+      const auto &txHash = txPair.first;
+      const auto &tx = txPair.second;
+      if (!tx || !tx->isInitialized() || (zcWallets_.find(txHash) != zcWallets_.end())) {
+         continue;
+      }
+
+      std::set<std::string> walletIds;
+      std::vector<OutPoint> inputs;
+      for (size_t i = 0; i < tx->getNumTxIn(); ++i) {
+         const OutPoint op = tx->getTxInCopy(i).getOutPoint();
+         inputs.push_back(op);
+         for (const auto &xbtUtxos : xbtIndexes()) {
+            bool removed = false;
+            xbtUtxos.second->modify([&op, &removed](UtxoIndex &index) {
+               removed = index.remove(op.getTxHash(), op.getTxOutIndex());
+            });
+            if (removed) {
+               walletIds.insert(xbtUtxos.first);
+            }
+         }
+         for (auto &ccUtxos : availableCCUTXOs_) {
+            auto &utxos = ccUtxos.second;
+            const auto it = std::remove_if(utxos.begin(), utxos.end(), [&op](const UTXO &utxo) {
+               return (utxo.getTxOutIndex() == op.getTxOutIndex()) && (utxo.getTxHash() == op.getTxHash());
+            });
+            if (it != utxos.end()) {
+               utxos.erase(it, utxos.end());
+               walletIds.insert(ccUtxos.first);
+            }
+         }
+      }
+
+      for (size_t i = 0; i < tx->getNumTxOut(); ++i) {
+         const auto addr = bs::Address::fromTxOut(tx->getTxOutCopy(i));
+         const auto wallet = walletsManager_->getWalletByAddress(addr);
+         if (!wallet) {
+            continue;
+         }
+         if (wallet->type() == bs::core::wallet::Type::ColorCoin) {
+            ccReceived_.insert(wallet->walletId());
+            continue;
+         }
+         const auto leaf = std::dynamic_pointer_cast<bs::sync::hd::Leaf>(wallet);
+         if (!leaf || (wallet->type() != bs::core::wallet::Type::Bitcoin) || !isTradingLeaf(leaf->purpose())) {
+            continue;
+         }
+         const auto hdWallet = walletsManager_->getHDRootForLeaf(leaf->walletId());
+         if (!hdWallet) {
+            continue;
+         }
+         pendingOutputs_[txHash].push_back({ hdWallet->walletId(), leaf->walletId()
+            , static_cast<uint32_t>(i) });
+         walletIds.insert(hdWallet->walletId());
+      }
+
+      // Snapshot which is being loaded could still have inputs of this ZC
+      if (!walletIds.empty() || xbtDeltas_.isReloading()) {
+         for (const auto &op : inputs) {
+            xbtDeltas_.zcSpent(txHash, op.getTxHash(), op.getTxOutIndex());
+         }
+         changedWallets.insert(walletIds.begin(), walletIds.end());
+         zcWallets_[txHash] = std::move(walletIds);
+      }
+   }
+
+   for (const auto &walletId : changedWallets) {
+      emit availableUtxoChanged(walletId);
+   }
+}
+
+void bs::UTXOReservationManager::applyMined(const AsyncClient::TxBatchResult &txs)
+{
+   std::set<std::string> changedWallets;
+   for (const auto &txPair : txs) {
+      const auto &txHash = txPair.first;
+      const auto &tx = txPair.second;
+      if (!tx || !tx->isInitialized() || (tx->getTxHeight() == UINT32_MAX)) {
+         continue;
+      }
+
+      const auto itPending = pendingOutputs_.find(txHash);
+      if (itPending != pendingOutputs_.end()) {
+         for (const auto &output : itPending->second) {
+            const auto utxoIndex = xbtIndex(output.walletId);
+            if (!utxoIndex || (output.txOutIndex >= tx->getNumTxOut())) {
+               continue;
+            }
+            const auto txOut = tx->getTxOutCopy(output.txOutIndex);
+            const UTXO utxo(txOut.getValue(), tx->getTxHeight(), tx->getTxIndex()
+               , output.txOutIndex, txHash, txOut.getScript());
+            utxoIndex->modify([&utxo, &output](UtxoIndex &index) {
+               index.add(utxo, output.leafId);
+            });
+            xbtDeltas_.outputMined(output.walletId, utxo, output.leafId);
+            changedWallets.insert(output.walletId);
+            updateReserved({ utxo });
+         }
+         pendingOutputs_.erase(itPending);
+      }
+      xbtDeltas_.zcMined(txHash);
+      zcWallets_.erase(txHash);
+   }
+
+   for (const auto &walletId : changedWallets) {
+      emit availableUtxoChanged(walletId);
+   }
+}
+
 bool bs::UTXOReservationManager::resetHdWallet(const std::string& hdWalledId)
 {
    auto hdWallet = walletsManager_->getHDWalletById(hdWalledId);
@@ -314,6 +636,7 @@ void bs::UTXOReservationManager::resetSpendableXbt(const std::shared_ptr<bs::syn
       }
    }
 
+   xbtDeltas_.reloadStarted(hdWallet->walletId());
    bs::tradeutils::getSpendableTxOutList(wallets, [mgr = QPointer<bs::UTXOReservationManager>(this)
       , walletId = hdWallet->walletId(), leaves]
          (const std::map<UTXO, std::string> &utxos) {
@@ -321,14 +644,40 @@ void bs::UTXOReservationManager::resetSpendableXbt(const std::shared_ptr<bs::syn
          return; // manager thread die, nothing to do
       }
 
-      XBTUtxoContainer utxosContainer;
-      utxosContainer.utxosLookup_ = utxos;
+      UtxoIndex utxoIndex;
       for (const auto &utxo : utxos) {
-         utxosContainer.availableUtxo_.push_back(utxo.first);
+         utxoIndex.add(utxo.first, utxo.second);
       }
-      QMetaObject::invokeMethod(mgr, [mgr, container = std::move(utxosContainer), id = walletId]{
-         mgr->availableXbtUTXOs_[id] = std::move(container);
-         emit mgr->availableUtxoChanged(id);
+      QMetaObject::invokeMethod(mgr, [mgr, utxoIndex = std::move(utxoIndex), id = walletId]() mutable {
+         // Deltas applied after the snapshot was taken would be lost otherwise
+         mgr->xbtDeltas_.reloadFinished(id, utxoIndex);
+         auto current = mgr->xbtIndex(id);
+         if (!current) {
+            current = std::make_shared<ConcurrentUtxoIndex>();
+            std::lock_guard<std::mutex> lock(mgr->xbtIndexesMutex_);
+            mgr->availableXbtUTXOs_[id] = current;
+         }
+         bool same = false;
+         current->modify([mgr, &id, &same, &utxoIndex](UtxoIndex &index) {
+            // Flags follow global reservations rather than flags of replaced set
+            if (UtxoReservation::instance()) {
+               std::vector<UTXO> available = utxoIndex.all();
+               std::vector<UTXO> reserved;
+               UtxoReservation::instance()->filter(available, reserved);
+               for (const auto &utxo : reserved) {
+                  utxoIndex.setReserved(utxo.getTxHash(), utxo.getTxOutIndex(), true);
+               }
+            }
+            same = index.sameOutpoints(utxoIndex);
+            if (!same && (index.size() != 0)) {
+               SPDLOG_LOGGER_DEBUG(mgr->logger_, "UTXO set of {} is out of sync: {} loaded, {} maintained"
+                  , id, utxoIndex.size(), index.size());
+            }
+            index.replace(std::move(utxoIndex));
+         });
+         if (!same) {
+            emit mgr->availableUtxoChanged(id);
+         }
          });
    }, false);
 }
@@ -371,10 +720,18 @@ void bs::UTXOReservationManager::resetAllSpendableCC(const std::shared_ptr<bs::s
    }
 }
 
-void bs::UTXOReservationManager::getBestXbtFromUtxos(const std::vector<UTXO> &inputUtxo,
+void bs::UTXOReservationManager::getBestXbtFromIndex(const HDWalletId& walletId, const std::string &leafId,
    BTCNumericTypes::satoshi_type quantity, std::function<void(std::vector<UTXO>&&)>&& cb, bool checkPbFeeFloor, CheckAmount checkAmount)
 {
-   std::vector<UTXO> selectedUtxos = bs::selectUtxoForAmount(inputUtxo, quantity);
+   std::vector<UTXO> selectedUtxos;
+   size_t availableCount = 0;
+   const auto utxoIndex = xbtIndex(walletId);
+   if (utxoIndex) {
+      utxoIndex->read([quantity, &leafId, &selectedUtxos, &availableCount](const UtxoIndex &index) {
+         selectedUtxos = index.select(quantity, leafId);
+         availableCount = index.availableCount(leafId);
+      });
+   }
 
    if (checkAmount == CheckAmount::Enabled) {
       uint64_t selectedAmount = 0;
@@ -390,18 +747,18 @@ void bs::UTXOReservationManager::getBestXbtFromUtxos(const std::vector<UTXO> &in
 
    // Here we calculating fee based on chosen utxos, if total price with fee will cover by all utxo sum - then we good and could continue
    // otherwise let's try to find better set of utxo again till the moment we will cover the difference or use all available utxos from wallet
-   if (selectedUtxos.size() == inputUtxo.size()) {
+   if (selectedUtxos.size() == availableCount) {
       cb(std::move(selectedUtxos));
       return;
    }
 
-   auto feeCb = [mgr = QPointer<bs::UTXOReservationManager>(this), inputUtxo, quantity
+   auto feeCb = [mgr = QPointer<bs::UTXOReservationManager>(this), walletId, leafId, quantity
       , utxos = std::move(selectedUtxos), cbCopy = std::move(cb), checkPbFeeFloor, checkAmount](float fee) mutable {
       if (!mgr) {
          return; // main thread die, nothing to do
       }
 
-      QMetaObject::invokeMethod(mgr, [mgr, quantity, inputUtxo
+      QMetaObject::invokeMethod(mgr, [mgr, walletId, leafId, quantity
          , fee, utxos = std::move(utxos), cb = std::move(cbCopy), checkPbFeeFloor, checkAmount]() mutable
       {
          float feePerByte = ArmoryConnection::toFeePerByte(fee);
@@ -416,34 +773,113 @@ void bs::UTXOReservationManager::getBestXbtFromUtxos(const std::vector<UTXO> &in
 
          const BTCNumericTypes::satoshi_type spendableQuantity = quantity + fee;
          if (spendableQuantity > total) {
-            mgr->getBestXbtFromUtxos(inputUtxo, spendableQuantity, std::move(cb), checkPbFeeFloor, checkAmount);
+            mgr->getBestXbtFromIndex(walletId, leafId, spendableQuantity, std::move(cb), checkPbFeeFloor, checkAmount);
          }
          else {
             cb(std::move(utxos));
          }
       });
    };
-   armory_->estimateFee(bs::tradeutils::feeTargetBlockCount(), feeCb);
+   bs::FeeEstimateCache::estimateFee(armory_, bs::tradeutils::feeTargetBlockCount(), feeCb);
+}
+
+std::string bs::UTXOReservationManager::xbtLeafId(const HDWalletId& walletId, bs::hd::Purpose purpose) const
+{
+   const auto hdWallet = walletsManager_->getHDWalletById(walletId);
+   if (!hdWallet) {
+      return {};
+   }
+   const auto xbtGroup = hdWallet->getGroup(hdWallet->getXBTGroupType());
+   if (!xbtGroup) {
+      return {};
+   }
+   const auto leaf = xbtGroup->getLeaf(purpose);
+   return leaf ? leaf->walletId() : std::string{};
+}
+
+void bs::UTXOReservationManager::updateReserved(const std::vector<UTXO> &utxos)
+{
+   if (!UtxoReservation::instance() || utxos.empty()) {
+      return;
+   }
+   // Flags follow global reservation state, so overlapping reservations are counted right
+   std::vector<UTXO> available = utxos;
+   std::vector<UTXO> reserved;
+   UtxoReservation::instance()->filter(available, reserved);
+   for (const auto &utxoIndex : xbtIndexes()) {
+      utxoIndex.second->modify([&reserved, &available](UtxoIndex &index) {
+         for (const auto &utxo : reserved) {
+            index.setReserved(utxo.getTxHash(), utxo.getTxOutIndex(), true);
+         }
+         for (const auto &utxo : available) {
+            index.setReserved(utxo.getTxHash(), utxo.getTxOutIndex(), false);
+         }
+      });
+   }
+}
+
+std::shared_ptr<bs::ConcurrentUtxoIndex> bs::UTXOReservationManager::xbtIndex(const HDWalletId& walletId) const
+{
+   std::lock_guard<std::mutex> lock(xbtIndexesMutex_);
+   const auto it = availableXbtUTXOs_.find(walletId);
+   return (it == availableXbtUTXOs_.end()) ? nullptr : it->second;
+}
+
+std::vector<std::pair<bs::UTXOReservationManager::HDWalletId, std::shared_ptr<bs::ConcurrentUtxoIndex>>>
+   bs::UTXOReservationManager::xbtIndexes() const
+{
+   std::lock_guard<std::mutex> lock(xbtIndexesMutex_);
+   return { availableXbtUTXOs_.begin(), availableXbtUTXOs_.end() };
 }
 
-std::function<void(std::vector<UTXO>&&)> bs::UTXOReservationManager::getReservationCb(const HDWalletId& walletId,
-   bool partial, std::function<void(FixedXbtInputs&&)>&& cb)
+void bs::UTXOReservationManager::reserveBestXbtFromIndex(const HDWalletId& walletId, const std::string &leafId
+   , BTCNumericTypes::satoshi_type quantity, bool partial, std::function<void(FixedXbtInputs&&)>&& cb
+   , bool checkPbFeeFloor, CheckAmount checkAmount, unsigned int attempt)
 {
-   return   [mgr = QPointer<bs::UTXOReservationManager>(this), walletId, partial
-      , cbFixedXBT = std::move(cb)](std::vector<UTXO>&& utxos) {
+   // Selection (with fee estimation) runs on a snapshot, so it is checked on reservation
+   auto bestUtxoSetCb = [mgr = QPointer<bs::UTXOReservationManager>(this), walletId, leafId, quantity, partial
+      , cbFixedXBT = std::move(cb), checkPbFeeFloor, checkAmount, attempt](std::vector<UTXO>&& utxos) mutable {
       if (!mgr) {
          return;
       }
 
-      FixedXbtInputs fixedXbtInputs;
-      if (partial) {
-         fixedXbtInputs = std::move(mgr->convertUtxoToPartialFixedInput(walletId, utxos));
+      const auto utxoIndex = mgr->xbtIndex(walletId);
+      FixedXbtInputs result;
+      if (!utxoIndex || utxoIndex->tryReserve(utxos)) {
+         result = mgr->finishReservation(walletId, partial, utxos);
       }
-      else {
-         fixedXbtInputs = std::move(mgr->convertUtxoToFixedInput(walletId, utxos));
+      if (result.utxoRes.isValid()) {
+         cbFixedXBT(std::move(result));
+         return;
       }
-      fixedXbtInputs.utxoRes = mgr->makeNewReservation(utxos);
 
-      cbFixedXBT(std::move(fixedXbtInputs));
+      if (attempt + 1 >= ConcurrentUtxoIndex::kMaxOptimisticAttempts) {
+         SPDLOG_LOGGER_ERROR(mgr->logger_, "can't reserve UTXOs in {}: selected UTXOs are reserved by other requests"
+            , walletId);
+         cbFixedXBT({});
+         return;
+      }
+      SPDLOG_LOGGER_DEBUG(mgr->logger_, "selected UTXOs in {} were reserved concurrently, select again", walletId);
+      mgr->reserveBestXbtFromIndex(walletId, leafId, quantity, partial, std::move(cbFixedXBT)
+         , checkPbFeeFloor, checkAmount, attempt + 1);
    };
+   getBestXbtFromIndex(walletId, leafId, quantity, std::move(bestUtxoSetCb), checkPbFeeFloor, checkAmount);
+}
+
+bs::FixedXbtInputs bs::UTXOReservationManager::finishReservation(const HDWalletId& walletId, bool partial
+   , const std::vector<UTXO> &utxos)
+{
+   FixedXbtInputs fixedXbtInputs;
+   if (partial) {
+      fixedXbtInputs = convertUtxoToPartialFixedInput(walletId, utxos);
+   }
+   else {
+      fixedXbtInputs = convertUtxoToFixedInput(walletId, utxos);
+   }
+   fixedXbtInputs.utxoRes = makeNewReservation(utxos);
+   if (!fixedXbtInputs.utxoRes.isValid()) {
+      // Reserved elsewhere (not through the index) after selection
+      return {};
+   }
+   return fixedXbtInputs;
 }
@@ -12,9 +12,15 @@
 #define UTXO_RESERVATION_MANAGER_H
 
 #include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
 #include <QObject>
+#include "ArmoryConnection.h"
 #include "CommonTypes.h"
 #include "UiUtils.h"
+#include "UtxoConsolidationPlanner.h"
+#include "UtxoIndex.h"
 #include "UtxoReservationToken.h"
 
 namespace spdlog {
@@ -31,10 +37,22 @@ namespace bs {
    }
 }
 class ArmoryObject;
+class QThread;
+class QTimer;
 
 namespace bs {
 
-   class UTXOReservationManager : public QObject
+   // Keeps spendable XBT and CC UTXOs of all wallets. Sets are loaded in full
+   // on wallet sync and then maintained from ZC and new block notifications:
+   // ZC inputs are removed right away, outputs to our XBT leaves become
+   // available once their TX is mined. Full reload runs periodically to catch
+   // anything deltas can't see (reorgs, TXs mined while offline), deltas which
+   // the reloaded set may predate are re-applied to it (UtxoDeltaTracker).
+   // XBT UTXOs are kept in value-sorted UtxoIndex per HD wallet, reservation
+   // flags there follow reservations made with makeNewReservation. Selection
+   // with reservation is checked against concurrent reservations and repeated
+   // on conflict.
+   class UTXOReservationManager : public QObject, public ArmoryCallbackTarget
    {
       Q_OBJECT
    public:
@@ -63,6 +81,9 @@ namespace bs {
 
       // Xbt specific implementation, each function defined two times
       // 1 - for hd wallet, and 2 - for hd leaf(wallet_id + purpose) which is needed for hw wallet
+      // Selected set is reserved only if none of its UTXOs was reserved meanwhile, otherwise
+      // selection is repeated. If it still fails, cb gets empty inputs with invalid reservation.
+      // If checkAmount is enabled but there are not enough UTXOs then callback will not be called
       void reserveBestXbtUtxoSet(const HDWalletId& walletId, BTCNumericTypes::satoshi_type quantity, bool partial,
          std::function<void(FixedXbtInputs&&)>&& cb, bool checkPbFeeFloor, CheckAmount checkAmount);
       void reserveBestXbtUtxoSet(const HDWalletId& walletId, bs::hd::Purpose purpose,
@@ -75,6 +96,17 @@ namespace bs {
       std::vector<UTXO> getAvailableXbtUTXOs(const HDWalletId& walletId) const;
       std::vector<UTXO> getAvailableXbtUTXOs(const HDWalletId& walletId, bs::hd::Purpose purpose) const;
 
+      // Reserves exactly given XBT UTXOs of HD wallet, token is invalid if any of them
+      // is reserved already
+      UtxoReservationToken tryReserveXbt(const HDWalletId& walletId, const std::vector<UTXO> &utxos);
+
+      // Proposes merging of available (not reserved) XBT UTXOs of HD wallet
+      // at current network fee rate. Must be called in manager thread, planning
+      // runs in a worker thread. Callback is always called in manager thread,
+      // result has error set for unknown wallet or unavailable fee estimate.
+      void planXbtConsolidation(const HDWalletId& walletId, const UtxoConsolidationPlanner::Params &
+         , std::function<void(UtxoConsolidationPlanner::Result&&)>&& cb);
+
       // If checkAmount is enabled but there are not enough UTXOs then callback will not be called
       void getBestXbtUtxoSet(const HDWalletId& walletId, BTCNumericTypes::satoshi_type quantity,
          std::function<void(std::vector<UTXO>&&)>&& cb, bool checkPbFeeFloor, CheckAmount checkAmount);
@@ -95,33 +127,64 @@ namespace bs {
    signals:
       void availableUtxoChanged(const std::string& walledId);
 
+   protected:
+      void onZCReceived(const std::string& requestId, const std::vector<bs::TXEntry>&) override;
+      void onZCInvalidated(const std::set<BinaryData>& ids) override;
+      void onNewBlock(unsigned int height, unsigned int branchHeight) override;
+
    private slots:
       void refreshAvailableUTXO();
       void onWalletsDeleted(const std::string& walledId);
       void onWalletsAdded(const std::string& walledId);
       void onWalletsBalanceChanged(const std::string& walledId);
+      void onFullResync();
 
    private:
       bool resetHdWallet(const std::string& hdWalledId);
       void resetSpendableXbt(const std::shared_ptr<bs::sync::hd::Wallet>& hdWallet);
       void resetSpendableCC(const std::shared_ptr<bs::sync::Wallet>& leaf);
       void resetAllSpendableCC(const std::shared_ptr<bs::sync::hd::Wallet>& hdWallet);
-      void getBestXbtFromUtxos(const std::vector<UTXO> &selectedUtxo
+      void getBestXbtFromIndex(const HDWalletId& walletId, const std::string &leafId
          , BTCNumericTypes::satoshi_type quantity
          , std::function<void(std::vector<UTXO>&&)>&& cb, bool checkPbFeeFloor, CheckAmount checkAmount);
+      // Empty if wallet has no such leaf
+      std::string xbtLeafId(const HDWalletId& walletId, bs::hd::Purpose purpose) const;
+      void updateReserved(const std::vector<UTXO> &utxos);
 
-      std::function<void(std::vector<UTXO>&&)> getReservationCb(const HDWalletId& walletId, bool partial,
-         std::function<void(FixedXbtInputs&&)>&& cb);
+      void reserveBestXbtFromIndex(const HDWalletId& walletId, const std::string &leafId
+         , BTCNumericTypes::satoshi_type quantity, bool partial, std::function<void(FixedXbtInputs&&)>&& cb
+         , bool checkPbFeeFloor, CheckAmount checkAmount, unsigned int attempt);
+      FixedXbtInputs finishReservation(const HDWalletId& walletId, bool partial, const std::vector<UTXO> &utxos);
+
+      std::shared_ptr<ConcurrentUtxoIndex> xbtIndex(const HDWalletId& walletId) const;
+      std::vector<std::pair<HDWalletId, std::shared_ptr<ConcurrentUtxoIndex>>> xbtIndexes() const;
+
+      void applyZC(const AsyncClient::TxBatchResult &);
+      void applyMined(const AsyncClient::TxBatchResult &);
+      void requestTXs(const std::set<BinaryData> &hashes
+         , void (UTXOReservationManager::*apply)(const AsyncClient::TxBatchResult &));
 
    private:
-      struct XBTUtxoContainer {
-         std::vector<UTXO> availableUtxo_;
-         std::map<UTXO, std::string> utxosLookup_;
+      // Output of our ZC which becomes spendable when mined
+      struct PendingOutput {
+         HDWalletId  walletId;
+         std::string leafId;
+         uint32_t    txOutIndex;
       };
 
-      std::unordered_map<HDWalletId, XBTUtxoContainer> availableXbtUTXOs_;
+      // Map itself is changed in manager thread only, indexes could be used from any thread
+      mutable std::mutex xbtIndexesMutex_;
+      std::unordered_map<HDWalletId, std::shared_ptr<ConcurrentUtxoIndex>> availableXbtUTXOs_;
       std::unordered_map<CCWalletId, std::vector<UTXO>> availableCCUTXOs_;
 
+      std::map<BinaryData, std::vector<PendingOutput>>   pendingOutputs_;
+      std::map<BinaryData, std::set<std::string>>        zcWallets_;    // HD or CC wallet ids changed by ZC
+      std::set<CCWalletId>                               ccReceived_;   // reloaded on new block
+      UtxoDeltaTracker                                   xbtDeltas_;    // re-applied to reloaded XBT sets
+      QTimer *resyncTimer_{};
+      QThread *planThread_{};    // consolidation planning
+      QObject *planWorker_{};
+
       std::shared_ptr<bs::sync::WalletsManager> walletsManager_;
       std::shared_ptr<ArmoryObject> armory_;
       std::shared_ptr<spdlog::logger> logger_;
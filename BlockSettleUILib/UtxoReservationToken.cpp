@@ -60,7 +60,13 @@ UtxoReservationToken UtxoReservationToken::makeNewReservation(const std::shared_
    }
 
    UtxoReservationToken result;
-   UtxoReservation::instance()->reserve(reserveId, utxos);
+   if (!UtxoReservation::instance()->reserve(reserveId, utxos)) {
+      if (logger) {
+         SPDLOG_LOGGER_ERROR(logger, "UTXO reservation {} failed: some of UTXOs are already reserved"
+            , reserveId);
+      }
+      return result;
+   }
    result.logger_ = logger;
    result.reserveId_ = reserveId;
    result.onReleasedCb_ = std::move(onReleasedCb);
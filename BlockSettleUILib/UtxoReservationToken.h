@@ -46,6 +46,7 @@ namespace bs {
       // Make new reservation (uses global UtxoReservationToken instance).
       // reserveId and walletId must be non-empty
       // logger could be nullptr
+      // Returns invalid token if some of UTXOs are already reserved
       static UtxoReservationToken makeNewReservation(const std::shared_ptr<spdlog::logger> &logger
          , const std::vector<UTXO> &utxos, const std::string &reserveId, std::function<void()>&& onReleasedCb);
 
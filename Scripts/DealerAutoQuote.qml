@@ -26,6 +26,9 @@ BSQuoteReqReply {		// Class name for Dealer replies. Don't change it!
     property real   indicAsk
     property real   lastPrice
     property real   bestPrice
+    READONLY property real sentPrice    // Last price sent, kept when script is reloaded
+
+    signal pricesChanged()      // After indicBid/indicAsk/lastPrice batch (every 0.5s at most)
 */
 
 //  accountBalance(product) // Call this method to obtain balance for the product
@@ -44,6 +47,10 @@ BSQuoteReqReply {		// Class name for Dealer replies. Don't change it!
         return true
     }
 
+    onStarted: {
+        prevSendPrice = sentPrice   // Non-zero if script was reloaded after quoting
+    }
+
     onExpirationInSecChanged: {		// Ticks every 0.5s until QuoteReq expiry
         if ((prevSendPrice == 0) && (expirationInSec < 7)) {
             prevSendPrice = (Math.random().toPrecision(3) * 10.0).toPrecision(2)
@@ -63,29 +70,26 @@ BSQuoteReqReply {		// Class name for Dealer replies. Don't change it!
         prevSendPrice = price
     }
 
-    onIndicBidChanged: {
-        if (quoteReq.assetType == 3)    return  // Don't reply on CC
-        if (quoteReq.isBuy)  return
-        var price = 0
-        if ((prevSendPrice == 0) || ((indicBid - prevSendPrice) < indicBid * 0.01)) {
-            price = indicBid * 0.99
-        }
-        if ((price > 0) && checkBalance(quoteReq.quantity * price, product())) {
-            sendQuoteReply(price)
-            prevSendPrice = price
-        }
-    }
-
-    onIndicAskChanged: {
+    onPricesChanged: {     // Once per market data batch, with all prices already updated
         if (quoteReq.assetType == 3)    return  // Don't reply on CC
-        if (!quoteReq.isBuy)  return
         var price = 0
-        if ((prevSendPrice == 0) || ((prevSendPrice - indicAsk) < indicAsk * 0.01)) {
-            price = indicAsk * 1.01
+        if (quoteReq.isBuy) {
+            if ((indicAsk > 0) && ((prevSendPrice == 0) || ((prevSendPrice - indicAsk) < indicAsk * 0.01))) {
+                price = indicAsk * 1.01
+            }
+            if ((price > 0) && (price != prevSendPrice) && checkBalance(quoteReq.quantity, quoteReq.product)) {
+                sendQuoteReply(price)
+                prevSendPrice = price
+            }
         }
-        if ((price > 0) && checkBalance(quoteReq.quantity, quoteReq.product)) {
-            sendQuoteReply(price)
-            prevSendPrice = price
+        else {
+            if ((indicBid > 0) && ((prevSendPrice == 0) || ((indicBid - prevSendPrice) < indicBid * 0.01))) {
+                price = indicBid * 0.99
+            }
+            if ((price > 0) && (price != prevSendPrice) && checkBalance(quoteReq.quantity * price, product())) {
+                sendQuoteReply(price)
+                prevSendPrice = price
+            }
         }
     }
 
@@ -16,22 +16,53 @@
 #include <botan/ec_group.h>
 #include <botan/pubkey.h>
 #include <botan/hex.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#ifdef __linux__
+#include <unistd.h>
+#endif
 #include <QApplication>
+#include <QDateTime>
 #include <QDebug>
 #include <QFile>
 #include <QLocale>
 #include <QString>
+#include <QTemporaryDir>
 #include <spdlog/spdlog.h>
 
 #include "Address.h"
 #include "AssetManager.h"
+#include "AutoRFQScheduler.h"
 #include "CacheFile.h"
+#include "CandleAggregator.h"
+#include "CandleLodPyramid.h"
 #include "CurrencyPair.h"
 #include "EasyCoDec.h"
+#include "FeeEstimateCache.h"
 #include "InprocSigner.h"
 #include "MarketDataProvider.h"
+#include "MaxSpendAccumulator.h"
 #include "MDCallbacksQt.h"
+#include "MinMaxSegmentTree.h"
+#include "OhlcHistoryProcessor.h"
+#include "QuoteStrategies/SampleQuoteStrategy.h"
+#include "RecipientsImporter.h"
+#include "ScriptReplayHarness.h"
+#include "ScriptTraffic.h"
 #include "TestEnv.h"
+#include "market_data_history.pb.h"
+#include "Trading/QuoteLatencyTracer.h"
+#include "UserScriptRunner.h"
+#include "UtxoConsolidationPlanner.h"
+#include "UtxoIndex.h"
 #include "WalletUtils.h"
 #include "Wallets/SyncWalletsManager.h"
 
@@ -386,6 +417,441 @@ TEST(TestCommon, SelectUtxoForAmount)
    test({1, 1, 1}, 3, 3, 3);
 }
 
+TEST(TestCommon, UtxoIndex)
+{
+   const auto makeUtxo = [](uint64_t value, uint32_t index) {
+      UTXO utxo;
+      utxo.value_ = value;
+      utxo.txOutIndex_ = index;
+      return utxo;
+   };
+
+   bs::UtxoIndex utxoIndex;
+   EXPECT_TRUE(utxoIndex.add(makeUtxo(30, 0), "leaf1"));
+   EXPECT_TRUE(utxoIndex.add(makeUtxo(10, 1), "leaf1"));
+   EXPECT_TRUE(utxoIndex.add(makeUtxo(20, 2), "leaf2"));
+   EXPECT_FALSE(utxoIndex.add(makeUtxo(20, 2), "leaf2"));
+   EXPECT_EQ(utxoIndex.availableSum(), 60);
+   EXPECT_EQ(utxoIndex.availableSum("leaf1"), 40);
+   EXPECT_EQ(utxoIndex.availableCount("leaf2"), 1);
+
+   EXPECT_TRUE(utxoIndex.setReserved({}, 0, true));
+   EXPECT_FALSE(utxoIndex.setReserved({}, 0, true));
+   EXPECT_EQ(utxoIndex.availableSum(), 30);
+   EXPECT_EQ(utxoIndex.availableSum("leaf1"), 10);
+   const auto available = utxoIndex.available();
+   ASSERT_EQ(available.size(), 2);
+   EXPECT_EQ(available[0].getValue(), 10);
+   EXPECT_EQ(available[1].getValue(), 20);
+
+   EXPECT_TRUE(utxoIndex.remove({}, 2));
+   EXPECT_FALSE(utxoIndex.remove({}, 2));
+   EXPECT_EQ(utxoIndex.availableSum(), 10);
+   EXPECT_EQ(utxoIndex.availableSum("leaf2"), 0);
+   ASSERT_NE(utxoIndex.find({}, 1), nullptr);
+   EXPECT_EQ(utxoIndex.find({}, 1)->leafId, "leaf1");
+
+   // Rest of amount is covered by already selected UTXOs only
+   bs::UtxoIndex smallIndex;
+   smallIndex.add(makeUtxo(10, 0), "leaf");
+   smallIndex.add(makeUtxo(4, 1), "leaf");
+   smallIndex.add(makeUtxo(4, 2), "leaf");
+   smallIndex.add(makeUtxo(4, 3), "leaf");
+   EXPECT_EQ(smallIndex.select(12).size(), 2);
+   EXPECT_EQ(smallIndex.select(22).size(), 4);
+   EXPECT_EQ(smallIndex.select(30).size(), 4);
+
+   // Selection from index should be the same as bs::selectUtxoForAmount
+   std::mt19937 gen(1);
+   std::uniform_int_distribution<uint64_t> valueDist(1, 100000);
+   for (int iter = 0; iter < 50; ++iter) {
+      bs::UtxoIndex index;
+      std::vector<UTXO> utxos;
+      uint64_t total = 0;
+      for (uint32_t i = 0; i < 200; ++i) {
+         const auto utxo = makeUtxo(valueDist(gen), i);
+         index.add(utxo, "leaf");
+         utxos.push_back(utxo);
+         total += utxo.getValue();
+      }
+      for (const uint64_t amount : { uint64_t(1), total / 10, total / 2, total, total + 1 }) {
+         const auto expected = bs::selectUtxoForAmount(utxos, amount);
+         const auto selected = index.select(amount);
+         uint64_t expectedSum = 0;
+         uint64_t selectedSum = 0;
+         for (const auto &utxo : expected) {
+            expectedSum += utxo.getValue();
+         }
+         for (const auto &utxo : selected) {
+            selectedSum += utxo.getValue();
+         }
+         EXPECT_EQ(selected.size(), expected.size());
+         EXPECT_EQ(selectedSum, expectedSum);
+      }
+   }
+}
+
+TEST(TestCommon, UtxoDeltaTracker)
+{
+   const auto makeUtxo = [](uint64_t value, uint32_t index) {
+      UTXO utxo;
+      utxo.value_ = value;
+      utxo.txOutIndex_ = index;
+      return utxo;
+   };
+   const auto loadSnapshot = [&makeUtxo](const std::vector<uint32_t> &indices) {
+      bs::UtxoIndex snapshot;
+      for (const auto index : indices) {
+         snapshot.add(makeUtxo(10 * (index + 1), index), "leaf");
+      }
+      return snapshot;
+   };
+   const auto zc1 = BinaryData::CreateFromHex("01");
+   const auto zc2 = BinaryData::CreateFromHex("02");
+   const auto zc3 = BinaryData::CreateFromHex("03");
+   bs::UtxoDeltaTracker tracker;
+
+   // Snapshot requested before ZC spending #0 was applied doesn't bring it back
+   tracker.reloadStarted("wallet");
+   tracker.zcSpent(zc1, {}, 0);
+   auto snapshot = loadSnapshot({ 0, 1 });
+   tracker.reloadFinished("wallet", snapshot);
+   EXPECT_EQ(snapshot.find({}, 0), nullptr);
+   EXPECT_NE(snapshot.find({}, 1), nullptr);
+   EXPECT_FALSE(tracker.isReloading());
+
+   // Unmined ZC spends are applied to any later snapshot too
+   snapshot = loadSnapshot({ 0, 1 });
+   tracker.reloadStarted("wallet");
+   tracker.reloadFinished("wallet", snapshot);
+   EXPECT_EQ(snapshot.find({}, 0), nullptr);
+
+   // Output mined while reload is in flight is kept, ZC mined meanwhile still spends
+   tracker.reloadStarted("wallet");
+   tracker.reloadStarted("other");
+   tracker.outputMined("wallet", makeUtxo(50, 4), "leaf");
+   tracker.outputMined("idle", makeUtxo(60, 5), "leaf");    // no reload - not tracked
+   tracker.zcMined(zc1);
+   EXPECT_EQ(tracker.zcCount(), 0);
+   snapshot = loadSnapshot({ 0, 1 });
+   tracker.reloadFinished("wallet", snapshot);
+   EXPECT_EQ(snapshot.find({}, 0), nullptr);
+   ASSERT_NE(snapshot.find({}, 4), nullptr);
+   EXPECT_EQ(snapshot.find({}, 4)->leafId, "leaf");
+   EXPECT_EQ(snapshot.availableSum(), 20 + 50);
+
+   // Spends of mined ZC are dropped once no reload is in flight
+   snapshot = loadSnapshot({ 0 });
+   tracker.reloadFinished("other", snapshot);
+   EXPECT_EQ(snapshot.find({}, 0), nullptr);
+   EXPECT_FALSE(tracker.isReloading());
+   snapshot = loadSnapshot({ 0, 1 });
+   tracker.reloadStarted("wallet");
+   tracker.reloadFinished("wallet", snapshot);
+   EXPECT_EQ(snapshot.size(), 2);
+   snapshot = loadSnapshot({ 5 });
+   tracker.reloadStarted("idle");
+   tracker.reloadFinished("idle", snapshot);
+   EXPECT_EQ(snapshot.size(), 1);
+
+   // Mined output spent by ZC before reload returns is not re-added
+   tracker.reloadStarted("wallet");
+   tracker.outputMined("wallet", makeUtxo(70, 6), "leaf");
+   tracker.zcSpent(zc2, {}, 6);
+   snapshot = loadSnapshot({ 1 });
+   tracker.reloadFinished("wallet", snapshot);
+   EXPECT_EQ(snapshot.find({}, 6), nullptr);
+   EXPECT_EQ(snapshot.size(), 1);
+
+   // Inputs of invalidated ZC are spendable again
+   tracker.zcSpent(zc3, {}, 1);
+   tracker.reloadStarted("wallet");
+   tracker.zcInvalidated(zc3);
+   snapshot = loadSnapshot({ 1 });
+   tracker.reloadFinished("wallet", snapshot);
+   EXPECT_NE(snapshot.find({}, 1), nullptr);
+   EXPECT_EQ(tracker.zcCount(), 1);
+}
+
+// Same select-then-tryReserve sequence as UTXOReservationManager runs, without
+// manager (see TestSettlement.ConcurrentUtxoReservation for the manager itself)
+TEST(TestCommon, ConcurrentUtxoTryReserve)
+{
+   const uint32_t kUtxoCount = 2000;
+   const int kThreads = 8;
+   const int kIterations = 300;
+
+   bs::UtxoIndex utxoIndex;
+   uint64_t total = 0;
+   for (uint32_t i = 0; i < kUtxoCount; ++i) {
+      UTXO utxo;
+      utxo.value_ = 1000 + (i * 7919) % 100000;
+      utxo.txOutIndex_ = i;
+      utxoIndex.add(utxo, "leaf");
+      total += utxo.getValue();
+   }
+   bs::ConcurrentUtxoIndex concurrentIndex(std::move(utxoIndex));
+
+   std::mutex mutex;
+   std::map<uint32_t, uint64_t> owned;   // txOutIndex -> value
+   std::atomic<int> doubleBooked{ 0 };
+   std::atomic<unsigned int> conflicts{ 0 };
+
+   const auto worker = [&](int seed) {
+      std::mt19937 gen(seed);
+      std::uniform_int_distribution<uint64_t> amountDist(1, 300000);
+      std::vector<std::vector<UTXO>> reservations;
+      for (int i = 0; i < kIterations; ++i) {
+         const auto amount = amountDist(gen);
+         std::vector<UTXO> utxos;
+         for (unsigned int attempt = 0; attempt < bs::ConcurrentUtxoIndex::kMaxOptimisticAttempts; ++attempt) {
+            concurrentIndex.read([amount, &utxos](const bs::UtxoIndex &index) {
+               utxos = index.select(amount);
+            });
+            if (concurrentIndex.tryReserve(utxos)) {
+               break;
+            }
+            utxos.clear();
+            conflicts++;
+         }
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &utxo : utxos) {
+               if (!owned.emplace(utxo.getTxOutIndex(), utxo.getValue()).second) {
+                  doubleBooked++;
+               }
+            }
+         }
+         reservations.push_back(std::move(utxos));
+
+         // Release older reservations so selection keeps racing for the same UTXOs
+         if (reservations.size() > 3) {
+            const auto released = std::move(reservations.front());
+            reservations.erase(reservations.begin());
+            {
+               std::lock_guard<std::mutex> lock(mutex);
+               for (const auto &utxo : released) {
+                  owned.erase(utxo.getTxOutIndex());
+               }
+            }
+            concurrentIndex.release(released);
+         }
+      }
+   };
+
+   std::vector<std::thread> threads;
+   for (int i = 0; i < kThreads; ++i) {
+      threads.emplace_back(worker, i + 1);
+   }
+   for (auto &thread : threads) {
+      thread.join();
+   }
+
+   EXPECT_EQ(doubleBooked, 0);
+   uint64_t ownedSum = 0;
+   for (const auto &utxo : owned) {
+      ownedSum += utxo.second;
+   }
+   concurrentIndex.read([&](const bs::UtxoIndex &index) {
+      EXPECT_EQ(index.availableCount(), kUtxoCount - owned.size());
+      EXPECT_EQ(index.availableSum(), total - ownedSum);
+   });
+   StaticLogger::loggerPtr->debug("[ConcurrentUtxoTryReserve] {} selection conflicts"
+      , conflicts.load());
+}
+
+TEST(TestCommon, UtxoConsolidationPlanner)
+{
+   // 100 s/input + 50 s/TX at 1 s/b
+   const auto linearFee = [](const std::vector<UTXO> &utxos, float feePerByte) {
+      return static_cast<uint64_t>((50 + 100 * utxos.size()) * feePerByte);
+   };
+
+   bs::UtxoIndex utxoIndex;
+   uint32_t outIndex = 0;
+   const auto add = [&utxoIndex, &outIndex](uint64_t value, const std::string &leafId) {
+      UTXO utxo;
+      utxo.value_ = value;
+      utxo.txOutIndex_ = outIndex++;
+      utxoIndex.add(utxo, leafId);
+   };
+   for (int i = 0; i < 25; ++i) {
+      add(1000 + i, "leaf1");
+   }
+   add(150, "leaf1");            // dust at 2 s/b
+   add(5000000, "leaf1");        // not small
+   for (int i = 0; i < 5; ++i) {
+      add(2000, "leaf2");        // too few to merge
+   }
+   add(1010, "leaf1");
+   utxoIndex.setReserved({}, outIndex - 1, true);
+
+   bs::UtxoConsolidationPlanner::Params params;
+   params.maxFeePerByte = 10;
+   params.smallValue = 100000;
+   params.minInputs = 5;
+   params.maxInputs = 10;
+   bs::UtxoConsolidationPlanner planner(params, linearFee);
+
+   auto result = planner.plan(utxoIndex, 2);
+   EXPECT_FALSE(result.feeTooHigh);
+   EXPECT_EQ(result.count, 32);
+   EXPECT_EQ(result.uneconomicCount, 1);
+   EXPECT_EQ(result.uneconomicSum, 150);
+   ASSERT_EQ(result.plans.size(), 4);   // 10 + 10 + 5 from leaf1, 5 from leaf2
+   EXPECT_EQ(result.inputsMerged, 30);
+   uint64_t totalFee = 0;
+   for (const auto &plan : result.plans) {
+      EXPECT_EQ(plan.fee, linearFee(plan.inputs, 2));
+      EXPECT_EQ(plan.outputValue() + plan.fee, plan.inputSum);
+      totalFee += plan.fee;
+      for (const auto &utxo : plan.inputs) {
+         EXPECT_NE(utxo.getTxOutIndex(), outIndex - 1);
+         EXPECT_LT(utxo.getValue(), params.smallValue);
+         ASSERT_NE(utxoIndex.find({}, utxo.getTxOutIndex()), nullptr);
+         EXPECT_EQ(utxoIndex.find({}, utxo.getTxOutIndex())->leafId, plan.leafId);
+      }
+   }
+   EXPECT_EQ(result.totalFee, totalFee);
+   EXPECT_EQ(result.plans[0].inputs.front().getValue(), 1000);   // smallest first
+
+   // Fee budget stops planning before it's exceeded
+   params.maxTotalFee = 2 * linearFee(result.plans[0].inputs, 2);
+   result = bs::UtxoConsolidationPlanner(params, linearFee).plan(utxoIndex, 2);
+   EXPECT_EQ(result.plans.size(), 2);
+   EXPECT_LE(result.totalFee, params.maxTotalFee);
+
+   result = planner.plan(utxoIndex, 11);
+   EXPECT_TRUE(result.feeTooHigh);
+   EXPECT_TRUE(result.plans.empty());
+   EXPECT_EQ(result.count, 32);
+}
+
+TEST(TestCommon, MaxSpendAccumulator)
+{
+   const auto pubKey = BinaryData::CreateFromHex("0279BE667EF9DCBBAC55A06295CE870B07029BFCDB2DCE28D959F2815B16F81798");
+   const auto address = bs::Address::fromPubKey(pubKey, AddressEntryType_P2WPKH);
+   const auto script = BtcUtils::getP2WPKHOutputScript(BtcUtils::getHash160(pubKey));
+   const auto txHash = CryptoPRNG::generateRandom(32);
+   const auto makeUtxo = [&script, &txHash](uint64_t value, uint32_t index) {
+      return UTXO(value, UINT32_MAX, 0, index, txHash, script);
+   };
+   EXPECT_EQ(bs::MaxSpendAccumulator::inputWeight(bs::Address::fromUTXO(makeUtxo(1, 0))), 272);
+   EXPECT_EQ(bs::MaxSpendAccumulator::outputWeight(address), 124);
+
+   bs::MaxSpendAccumulator maxSpend;
+   maxSpend.setFeePerByte(1);
+   EXPECT_TRUE(maxSpend.addInput(makeUtxo(10000, 0)));
+   EXPECT_TRUE(maxSpend.addInput(makeUtxo(10000, 1)));
+   EXPECT_TRUE(maxSpend.addInput(makeUtxo(10000, 2)));
+   EXPECT_FALSE(maxSpend.addInput(makeUtxo(10000, 2)));
+
+   // 10 bytes overhead, 3 inputs of 68.5 vbytes, 31 bytes output and segwit flag
+   EXPECT_EQ(maxSpend.weight(address), 40 + 3 * 272 + 124 + 2);
+   EXPECT_EQ(maxSpend.virtSize(address), 246);
+   EXPECT_EQ(maxSpend.maxAmount(address), 30000 - 246);
+
+   maxSpend.addOutput(address, 5000);
+   EXPECT_EQ(maxSpend.virtSize(address), 277);
+   EXPECT_EQ(maxSpend.maxAmount(address), 30000 - 5000 - 277);
+   maxSpend.setFeePerByte(2.5);
+   EXPECT_EQ(maxSpend.fee(address), 693);
+   maxSpend.removeOutput(address, 5000);
+   maxSpend.setFeePerByte(1);
+   EXPECT_EQ(maxSpend.maxAmount(address), 30000 - 246);
+
+   EXPECT_FALSE(maxSpend.removeInput(txHash, 5));
+   maxSpend.setInputs({ makeUtxo(10000, 1), makeUtxo(10000, 2), makeUtxo(7000, 3) });
+   EXPECT_EQ(maxSpend.inputsCount(), 3);
+   EXPECT_EQ(maxSpend.inputsSum(), 27000);
+   EXPECT_EQ(maxSpend.maxAmount(address), 27000 - 246);
+
+   // Incremental updates give the same result as accumulator built from scratch
+   std::mt19937 gen(1);
+   std::uniform_int_distribution<uint64_t> valueDist(1000, 1000000);
+   std::vector<UTXO> utxos;
+   for (uint32_t i = 0; i < 1000; ++i) {
+      utxos.push_back(makeUtxo(valueDist(gen), i));
+   }
+   for (int iter = 0; iter < 5; ++iter) {
+      std::shuffle(utxos.begin(), utxos.end(), gen);
+      const std::vector<UTXO> selected(utxos.cbegin(), utxos.cbegin() + 300 + iter * 100);
+      maxSpend.setInputs(selected);
+
+      bs::MaxSpendAccumulator fresh;
+      fresh.setFeePerByte(1);
+      for (const auto &utxo : selected) {
+         fresh.addInput(utxo);
+      }
+      EXPECT_EQ(maxSpend.inputsCount(), selected.size());
+      EXPECT_EQ(maxSpend.inputsSum(), fresh.inputsSum());
+      EXPECT_EQ(maxSpend.weight(address), fresh.weight(address));
+      EXPECT_EQ(maxSpend.maxAmount(address), fresh.maxAmount(address));
+   }
+
+   maxSpend.setInputs({ makeUtxo(100, 5000) });
+   EXPECT_EQ(maxSpend.maxAmount(address), 0);
+}
+
+TEST(TestCommon, RecipientsImport)
+{
+   uint64_t amount = 0;
+   EXPECT_TRUE(RecipientsImporter::parseAmount(QLatin1String("0.1"), amount));
+   EXPECT_EQ(amount, 10000000);
+   EXPECT_TRUE(RecipientsImporter::parseAmount(QLatin1String(" 12.00000001 "), amount));
+   EXPECT_EQ(amount, 1200000001);
+   EXPECT_TRUE(RecipientsImporter::parseAmount(QLatin1String(".5"), amount));
+   EXPECT_EQ(amount, 50000000);
+   EXPECT_FALSE(RecipientsImporter::parseAmount(QLatin1String("0"), amount));
+   EXPECT_FALSE(RecipientsImporter::parseAmount(QLatin1String("-1"), amount));
+   EXPECT_FALSE(RecipientsImporter::parseAmount(QLatin1String("0.000000001"), amount));
+   EXPECT_FALSE(RecipientsImporter::parseAmount(QLatin1String("1e3"), amount));
+   EXPECT_FALSE(RecipientsImporter::parseAmount(QLatin1String("21000001"), amount));
+   EXPECT_FALSE(RecipientsImporter::parseAmount(QLatin1String("."), amount));
+
+   const QByteArray valid = "address,amount\r\n"
+      "# comment\r\n"
+      "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx,0.5\r\n"
+      "\r\n"
+      "\"2NBoXxTwt1ruSkuCv5iJaSmZUccHNB2yPjB\";0.00001\n"
+      "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx\t1\n";
+   const auto result = RecipientsImporter::parse(valid);
+   EXPECT_EQ(result.nbErrors, 0);
+   ASSERT_EQ(result.recipients.size(), 3);
+   EXPECT_EQ(result.recipients[0].address.display(), "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx");
+   EXPECT_EQ(result.recipients[0].amount.GetValue(), 50000000);
+   EXPECT_EQ(result.recipients[1].address.getType(), AddressEntryType_P2SH);
+   EXPECT_EQ(result.recipients[1].amount.GetValue(), 1000);
+   EXPECT_EQ(result.totalAmount, 150001000);
+
+   const QByteArray invalid = "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx,0.5\n"
+      "not_an_address,1\n"
+      "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx,abc\n"
+      "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx\n";
+   const auto resultInvalid = RecipientsImporter::parse(invalid);
+   EXPECT_EQ(resultInvalid.recipients.size(), 1);
+   EXPECT_EQ(resultInvalid.nbErrors, 3);
+   ASSERT_EQ(resultInvalid.errors.size(), 3);
+   EXPECT_TRUE(resultInvalid.errors[0].startsWith(QLatin1String("line 2")));
+
+   // First line with valid address is a recipient with bad amount, not a header
+   const QByteArray badFirst = "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx,0.5x\n"
+      "tb1qw508d6qejxtdg4y5r3zarvary0c5xw7kxpjzsx,0.5\n";
+   const auto resultBadFirst = RecipientsImporter::parse(badFirst);
+   EXPECT_EQ(resultBadFirst.recipients.size(), 1);
+   EXPECT_EQ(resultBadFirst.nbErrors, 1);
+   ASSERT_EQ(resultBadFirst.errors.size(), 1);
+   EXPECT_TRUE(resultBadFirst.errors[0].startsWith(QLatin1String("line 1")));
+
+   QByteArray many;
+   for (int i = 0; i < 100; ++i) {
+      many += "bad,1\n";
+   }
+   const auto resultMany = RecipientsImporter::parse(many);
+   EXPECT_EQ(resultMany.nbErrors, 100);
+   EXPECT_EQ(resultMany.errors.size(), RecipientsImporter::kMaxErrors);
+}
+
 TEST(TestCommon, XBTAmount)
 {
    auto xbt1 = bs::XBTAmount(double(21*1000*1000));
@@ -394,3 +860,1047 @@ TEST(TestCommon, XBTAmount)
    auto diff1 = bs::XBTAmount((xbt1 + bs::XBTAmount(uint64_t(1))).GetValueBitcoin()) - xbt1;
    EXPECT_EQ(diff1, 1);
 }
+
+TEST(TestCommon, QuoteLatencyTracer)
+{
+   using Stage = bs::QuoteLatencyTracer::Stage;
+   bs::QuoteLatencyTracer tracer;
+   const auto start = bs::QuoteLatencyTracer::Clock::now();
+
+   tracer.mark("req1", Stage::Received, start);
+   tracer.mark("req1", Stage::ReplyStarted, start + std::chrono::milliseconds(3));
+   tracer.mark("req1", Stage::UtxoReserved, start + std::chrono::milliseconds(5));
+   tracer.mark("req1", Stage::QuoteSent, start + std::chrono::milliseconds(10));
+   // Re-quotes are not counted
+   tracer.mark("req1", Stage::QuoteSent, start + std::chrono::milliseconds(50));
+   EXPECT_EQ(tracer.activeCount(), 1);
+
+   EXPECT_EQ(tracer.histogram(Stage::Received).count, 1);
+   EXPECT_EQ(tracer.histogram(Stage::Received).max.count(), 0);
+   EXPECT_EQ(tracer.histogram(Stage::ReplyStarted).max, std::chrono::milliseconds(3));
+   EXPECT_EQ(tracer.histogram(Stage::UtxoReserved).max, std::chrono::milliseconds(2));
+   EXPECT_EQ(tracer.histogram(Stage::QuoteSent).count, 1);
+   EXPECT_EQ(tracer.histogram(Stage::QuoteSent).max, std::chrono::milliseconds(5));
+   EXPECT_EQ(tracer.histogram(Stage::SignerResolved).count, 0);
+
+   const auto total = tracer.totalHistogram();
+   EXPECT_EQ(total.count, 1);
+   EXPECT_EQ(total.average(), std::chrono::milliseconds(10));
+   // 10ms falls into <= 10000us bucket
+   EXPECT_EQ(total.buckets[6], 1);
+
+   tracer.finish("req1");
+   EXPECT_EQ(tracer.activeCount(), 0);
+   EXPECT_FALSE(tracer.report().empty());
+
+   tracer.setEnabled(false);
+   tracer.mark("req2", Stage::Received, start);
+   EXPECT_EQ(tracer.activeCount(), 0);
+   EXPECT_EQ(tracer.histogram(Stage::Received).count, 1);
+}
+
+TEST(TestCommon, CandleAggregator)
+{
+   using namespace Blocksettle::Communication::MarketDataHistory;
+   const uint64_t hour = 3600000;
+   // Wednesday, 2020-07-15 10:30:00 UTC
+   const uint64_t stamp = 1594809000000;
+
+   EXPECT_EQ(bs::CandleAggregator::candleStart(stamp, Interval::OneHour), stamp - hour / 2);
+   EXPECT_EQ(bs::CandleAggregator::candleStart(stamp, Interval::SixHours), stamp - hour * 9 / 2);
+   EXPECT_EQ(bs::CandleAggregator::candleStart(stamp, Interval::TwentyFourHours), stamp - hour * 21 / 2);
+   // Monday, 2020-07-13
+   EXPECT_EQ(bs::CandleAggregator::candleStart(stamp, Interval::OneWeek), 1594598400000);
+   // 2020-07-01, 2020-01-01
+   EXPECT_EQ(bs::CandleAggregator::candleStart(stamp, Interval::OneMonth), 1593561600000);
+   EXPECT_EQ(bs::CandleAggregator::candleStart(stamp, Interval::SixMonths), 1593561600000);
+   EXPECT_EQ(bs::CandleAggregator::candleStart(stamp, Interval::OneYear), 1577836800000);
+   // 2020-07-01 -> 2020-08-01
+   EXPECT_EQ(bs::CandleAggregator::nextCandleStart(1593561600000, Interval::OneMonth), 1596240000000);
+
+   bs::CandleAggregator aggregator(5);
+   aggregator.addTrade("XBT/EUR", stamp, 100, 1);
+   aggregator.addTrade("XBT/EUR", stamp + hour, 110, 2);
+   aggregator.addTrade("XBT/EUR", stamp + hour + 1, 90, 1);
+   aggregator.addTrade("XBT/EUR", stamp + hour * 3, 95, 1);
+
+   // Not usable before history is loaded
+   EXPECT_FALSE(aggregator.isSeeded("XBT/EUR", Interval::OneHour));
+
+   auto candles = aggregator.candles("XBT/EUR", Interval::OneHour);
+   ASSERT_EQ(candles.size(), 4);
+   EXPECT_EQ(candles[1].open, 110);
+   EXPECT_EQ(candles[1].high, 110);
+   EXPECT_EQ(candles[1].low, 90);
+   EXPECT_EQ(candles[1].close, 90);
+   EXPECT_EQ(candles[1].volume, 3);
+   // Gap is filled with flat candle
+   EXPECT_EQ(candles[2].timestamp, candles[1].timestamp + hour);
+   EXPECT_EQ(candles[2].open, 90);
+   EXPECT_EQ(candles[2].volume, 0);
+
+   candles = aggregator.candles("XBT/EUR", Interval::TwentyFourHours);
+   ASSERT_EQ(candles.size(), 1);
+   EXPECT_EQ(candles[0].open, 100);
+   EXPECT_EQ(candles[0].high, 110);
+   EXPECT_EQ(candles[0].low, 90);
+   EXPECT_EQ(candles[0].close, 95);
+   EXPECT_EQ(candles[0].volume, 5);
+
+   // Server history replaces closed candles and is merged into open one
+   const uint64_t dayStart = bs::CandleAggregator::candleStart(stamp, Interval::TwentyFourHours);
+   const uint64_t prevDay = dayStart - hour * 24;
+   aggregator.addHistory("XBT/EUR", Interval::TwentyFourHours, {
+      { dayStart, 80, 120, 85, 100, 10 },
+      { prevDay, 70, 81, 69, 80, 7 } });
+   EXPECT_TRUE(aggregator.isSeeded("XBT/EUR", Interval::TwentyFourHours));
+   candles = aggregator.candles("XBT/EUR", Interval::TwentyFourHours);
+   ASSERT_EQ(candles.size(), 2);
+   EXPECT_EQ(candles[0].timestamp, prevDay);
+   EXPECT_EQ(candles[0].close, 80);
+   EXPECT_EQ(candles[1].open, 80);
+   EXPECT_EQ(candles[1].high, 120);
+   EXPECT_EQ(candles[1].low, 85);
+   EXPECT_EQ(candles[1].close, 95);
+   EXPECT_EQ(candles[1].volume, 10);
+
+   aggregator.addTrade("XBT/EUR", stamp + hour * 4, 130, 1);
+   candles = aggregator.candles("XBT/EUR", Interval::TwentyFourHours);
+   EXPECT_EQ(candles.back().high, 130);
+   EXPECT_EQ(candles.back().close, 130);
+
+   // Only the newest candles are kept
+   for (int i = 0; i < 10; ++i) {
+      aggregator.addTrade("XBT/EUR", stamp + hour * (10 + i), 100 + i, 1);
+   }
+   candles = aggregator.candles("XBT/EUR", Interval::OneHour);
+   ASSERT_EQ(candles.size(), 5);
+   EXPECT_EQ(candles.back().close, 109);
+
+   EXPECT_TRUE(aggregator.candles("XBT/USD", Interval::OneHour).empty());
+   aggregator.clear();
+   EXPECT_FALSE(aggregator.isSeeded("XBT/EUR", Interval::TwentyFourHours));
+}
+
+TEST(TestCommon, MinMaxSegmentTree)
+{
+   bs::MinMaxSegmentTree tree;
+   bs::MinMaxSegmentTree::Range range{};
+   EXPECT_FALSE(tree.query(0, 1, range));
+
+   std::vector<bs::MinMaxSegmentTree::Range> values;
+   for (int i = 0; i < 1000; ++i) {
+      const double value = (i * 7919) % 1000;
+      values.push_back({ value - 1, value + 1 });
+   }
+   tree.assign(values);
+   ASSERT_EQ(tree.size(), values.size());
+
+   const auto check = [&values, &tree](size_t from, size_t to) {
+      bs::MinMaxSegmentTree::Range expected = values[from];
+      for (size_t i = from; i < to; ++i) {
+         expected.min = std::min(expected.min, values[i].min);
+         expected.max = std::max(expected.max, values[i].max);
+      }
+      bs::MinMaxSegmentTree::Range result{};
+      ASSERT_TRUE(tree.query(from, to, result));
+      EXPECT_EQ(result.min, expected.min);
+      EXPECT_EQ(result.max, expected.max);
+   };
+
+   for (size_t from = 0; from < values.size(); from += 37) {
+      for (size_t to = from + 1; to <= values.size(); to += 53) {
+         check(from, to);
+      }
+   }
+   check(999, 1000);
+   EXPECT_FALSE(tree.query(10, 10, range));
+
+   // Out of bounds end is clamped
+   ASSERT_TRUE(tree.query(990, 2000, range));
+
+   values[500] = { -100, 5000 };
+   tree.update(500, values[500]);
+   check(0, 1000);
+   check(400, 501);
+   check(501, 700);
+
+   tree.clear();
+   EXPECT_EQ(tree.size(), 0);
+   EXPECT_FALSE(tree.query(0, 1, range));
+
+   tree.assign({ { 3, 4 } });
+   ASSERT_TRUE(tree.query(0, 1, range));
+   EXPECT_EQ(range.min, 3);
+   EXPECT_EQ(range.max, 4);
+}
+
+TEST(TestCommon, CandleLodPyramid)
+{
+   const double width = 3600;
+   std::vector<bs::CandleLodPyramid::Candle> candles;
+   for (int i = 0; i < 100; ++i) {
+      const double price = 100 + (i % 7);
+      candles.push_back({ width * (1000 + i), price, price + 2, price - 1, price + 1, 1 });
+   }
+
+   bs::CandleLodPyramid pyramid(5);
+   pyramid.build(std::vector<bs::CandleLodPyramid::Candle>(candles), width);
+   ASSERT_EQ(pyramid.levels(), 5);
+   EXPECT_EQ(pyramid.level(0).size(), 100);
+   EXPECT_EQ(pyramid.level(1).size(), 50);
+   EXPECT_EQ(pyramid.level(2).size(), 25);
+   EXPECT_EQ(pyramid.width(2), width * 4);
+   EXPECT_TRUE(pyramid.level(5).empty());
+
+   // Buckets are aligned to key: first bucket of level 2 holds candles 0..3
+   const auto &merged = pyramid.level(2).front();
+   EXPECT_EQ(merged.open, candles[0].open);
+   EXPECT_EQ(merged.close, candles[3].close);
+   EXPECT_EQ(merged.high, 105);
+   EXPECT_EQ(merged.low, 99);
+   EXPECT_EQ(merged.volume, 4);
+   EXPECT_EQ(merged.key, (candles[0].key + candles[3].key) / 2);
+
+   double volume = 0;
+   for (const auto &candle : pyramid.level(4)) {
+      volume += candle.volume;
+   }
+   EXPECT_EQ(volume, 100);
+
+   EXPECT_EQ(pyramid.levelFor(10, 3), 0);
+   EXPECT_EQ(pyramid.levelFor(1, 3), 2);
+   EXPECT_EQ(pyramid.levelFor(0.001, 3), 4);
+
+   // Gaps in data don't break bucket alignment
+   candles.erase(candles.begin() + 10, candles.begin() + 50);
+   pyramid.build(std::move(candles), width);
+   EXPECT_EQ(pyramid.level(1).size(), 30);
+
+   pyramid.clear();
+   EXPECT_EQ(pyramid.levels(), 0);
+   EXPECT_EQ(pyramid.levelFor(0.001, 3), 0);
+
+   // Live candles updated in place give the same levels as full build
+   bs::CandleLodPyramid incremental(8);
+   EXPECT_FALSE(incremental.update({ width * 2000, 100, 101, 99, 100, 1 }));
+   incremental.build({}, width);
+   std::vector<bs::CandleLodPyramid::Candle> live;
+   for (int i = 0; i < 37; ++i) {
+      bs::CandleLodPyramid::Candle candle{ width * (2000 + i), 100, 101, 99, 100, 1 };
+      EXPECT_TRUE(incremental.update(candle));
+      candle.high = 110 + i;
+      candle.close = 105;
+      candle.volume = 3;
+      EXPECT_TRUE(incremental.update(candle));
+      live.push_back(candle);
+   }
+   live[10].low = 50;
+   EXPECT_TRUE(incremental.update(live[10]));
+   // New candle in the middle needs full build
+   EXPECT_FALSE(incremental.update({ width * 2010.5, 100, 101, 99, 100, 1 }));
+
+   bs::CandleLodPyramid full(8);
+   full.build(std::move(live), width);
+   ASSERT_EQ(incremental.levels(), full.levels());
+   for (size_t level = 0; level < full.levels(); ++level) {
+      ASSERT_EQ(incremental.level(level).size(), full.level(level).size());
+      for (size_t i = 0; i < full.level(level).size(); ++i) {
+         const auto &lhs = incremental.level(level)[i];
+         const auto &rhs = full.level(level)[i];
+         EXPECT_EQ(lhs.key, rhs.key);
+         EXPECT_EQ(lhs.open, rhs.open);
+         EXPECT_EQ(lhs.high, rhs.high);
+         EXPECT_EQ(lhs.low, rhs.low);
+         EXPECT_EQ(lhs.close, rhs.close);
+         EXPECT_EQ(lhs.volume, rhs.volume);
+      }
+   }
+   const auto bucket = incremental.bucket(2, width * 2005);
+   ASSERT_NE(bucket, nullptr);
+   EXPECT_EQ(bucket->key, full.level(2)[1].key);
+   EXPECT_EQ(bucket->low, 99);
+}
+
+TEST(TestCommon, OhlcHistoryProcessor)
+{
+   using namespace Blocksettle::Communication::MarketDataHistory;
+   const auto logger = StaticLogger::loggerPtr;
+   const int64_t hour = 3600000;
+   const int64_t start = 1594771200000;   // 2020-07-15 00:00:00 UTC
+
+   OhlcResponse response;
+   response.set_product("XBT/EUR");
+   response.set_interval(Interval::OneHour);
+   response.set_first_stamp_in_db(start - hour * 100);
+   // newest first, two hours are missing before the newest one
+   for (const auto i : { 5, 2, 1, 0 }) {
+      auto candle = response.add_candles();
+      candle->set_timestamp(start + hour * i);
+      candle->set_open(100 + i);
+      candle->set_high(110 + i);
+      candle->set_low(90 + i);
+      candle->set_close(105 + i);
+      candle->set_volume(i + 1);
+   }
+
+   auto result = OhlcHistoryProcessor::parse(logger, response.SerializeAsString(), 0);
+   ASSERT_TRUE(result.valid);
+   EXPECT_EQ(result.product, "XBT/EUR");
+   EXPECT_EQ(result.interval, Interval::OneHour);
+   ASSERT_EQ(result.history.size(), 4);
+   EXPECT_EQ(result.history.front().timestamp, start);
+   EXPECT_EQ(result.history.back().timestamp, start + hour * 5);
+
+   ASSERT_EQ(result.candles->size(), 6);
+   ASSERT_EQ(result.volumes->size(), 6);
+   // Gap is filled with close of the previous candle
+   EXPECT_EQ(result.candles->at(3)->key, (start + hour * 3) / 1000);
+   EXPECT_EQ(result.candles->at(3)->open, 107);
+   EXPECT_EQ(result.candles->at(4)->close, 107);
+   EXPECT_EQ(result.volumes->at(4)->value, 0);
+   EXPECT_EQ(result.volumes->at(5)->value, 6);
+
+   // Older portion: candles up to already loaded one are filled, overlapping are dropped
+   result = OhlcHistoryProcessor::parse(logger, response.SerializeAsString(), start + hour * 4);
+   ASSERT_TRUE(result.valid);
+   ASSERT_EQ(result.history.size(), 3);
+   ASSERT_EQ(result.candles->size(), 4);
+   EXPECT_EQ(result.candles->at(3)->key, (start + hour * 3) / 1000);
+
+   EXPECT_FALSE(OhlcHistoryProcessor::parse(logger, {}, 0).valid);
+}
+
+TEST(TestCommon, AQScriptShardIndex)
+{
+   bs::network::QuoteReqNotification qrn;
+   qrn.security = "XBT/EUR";
+   qrn.product = "XBT";
+   EXPECT_EQ(AQScriptHandler::shardIndex(qrn, 1, AQScriptHandler::ShardKey::Security), 0);
+   EXPECT_EQ(AQScriptHandler::shardIndex(qrn, 0, AQScriptHandler::ShardKey::Product), 0);
+
+   const size_t count = 4;
+   const auto bySecurity = AQScriptHandler::shardIndex(qrn, count, AQScriptHandler::ShardKey::Security);
+   const auto byProduct = AQScriptHandler::shardIndex(qrn, count, AQScriptHandler::ShardKey::Product);
+   EXPECT_LT(bySecurity, count);
+   EXPECT_LT(byProduct, count);
+
+   // All securities of the same product go to the same shard
+   auto other = qrn;
+   other.security = "XBT/GBP";
+   EXPECT_EQ(AQScriptHandler::shardIndex(other, count, AQScriptHandler::ShardKey::Product), byProduct);
+   // and the same security always goes to the same shard
+   other = qrn;
+   other.product = "EUR";
+   EXPECT_EQ(AQScriptHandler::shardIndex(other, count, AQScriptHandler::ShardKey::Security), bySecurity);
+}
+
+TEST(TestCommon, ScriptTrafficEvent)
+{
+   bs::ScriptTrafficEvent quoteReq;
+   quoteReq.type = bs::ScriptTrafficEvent::Type::QuoteReq;
+   quoteReq.timestamp = 1580000000123;
+   quoteReq.qrn.quoteRequestId = "req1";
+   quoteReq.qrn.security = "XBT/EUR";
+   quoteReq.qrn.product = "XBT";
+   quoteReq.qrn.side = bs::network::Side::Sell;
+   quoteReq.qrn.quantity = 0.5;
+   quoteReq.qrn.assetType = bs::network::Asset::SpotXBT;
+   quoteReq.qrn.expirationTime = QDateTime::fromMSecsSinceEpoch(1580000030000);
+   quoteReq.qrn.timeSkewMs = 15;
+
+   auto event = bs::ScriptTrafficEvent::fromJson(quoteReq.toJson());
+   ASSERT_EQ(event.type, bs::ScriptTrafficEvent::Type::QuoteReq);
+   EXPECT_EQ(event.timestamp, quoteReq.timestamp);
+   EXPECT_EQ(event.qrn.quoteRequestId, "req1");
+   EXPECT_EQ(event.qrn.security, "XBT/EUR");
+   EXPECT_EQ(event.qrn.product, "XBT");
+   EXPECT_EQ(event.qrn.side, bs::network::Side::Sell);
+   EXPECT_DOUBLE_EQ(event.qrn.quantity, 0.5);
+   EXPECT_EQ(event.qrn.assetType, bs::network::Asset::SpotXBT);
+   EXPECT_EQ(event.qrn.expirationTime, quoteReq.qrn.expirationTime);
+   EXPECT_EQ(event.qrn.timeSkewMs, 15);
+
+   bs::ScriptTrafficEvent bestPrice;
+   bestPrice.type = bs::ScriptTrafficEvent::Type::BestQuotePrice;
+   bestPrice.timestamp = quoteReq.timestamp + 100;
+   bestPrice.reqId = "req1";
+   bestPrice.value = 9123.5;
+   bestPrice.flag = true;
+   event = bs::ScriptTrafficEvent::fromJson(bestPrice.toJson());
+   ASSERT_EQ(event.type, bs::ScriptTrafficEvent::Type::BestQuotePrice);
+   EXPECT_EQ(event.reqId, "req1");
+   EXPECT_DOUBLE_EQ(event.value, 9123.5);
+   EXPECT_TRUE(event.flag);
+
+   bs::ScriptTrafficEvent md;
+   md.type = bs::ScriptTrafficEvent::Type::MarketData;
+   md.timestamp = quoteReq.timestamp - 100;
+   md.assetType = bs::network::Asset::SpotXBT;
+   md.text = "XBT/EUR";
+   md.fields = { { bs::network::MDField::PriceBid, 9100 }, { bs::network::MDField::PriceOffer, 9150 } };
+   event = bs::ScriptTrafficEvent::fromJson(md.toJson());
+   ASSERT_EQ(event.type, bs::ScriptTrafficEvent::Type::MarketData);
+   EXPECT_EQ(event.text, "XBT/EUR");
+   EXPECT_EQ(event.assetType, bs::network::Asset::SpotXBT);
+   ASSERT_EQ(event.fields.size(), 2);
+   EXPECT_EQ(event.fields[0].type, bs::network::MDField::PriceBid);
+   EXPECT_DOUBLE_EQ(event.fields[1].value, 9150);
+
+   EXPECT_EQ(bs::ScriptTrafficEvent::fromJson(QJsonObject{}).type
+      , bs::ScriptTrafficEvent::Type::Undefined);
+}
+
+TEST(TestCommon, AQMarketDataBatch)
+{
+   // Quotes sum of all prices on each batch, legacy signals are counted in log
+   const char *script = R"(import bs.terminal 1.0
+BSQuoteReqReply {
+    property int bidChanges: 0
+    onIndicBidChanged: bidChanges++
+    onPricesChanged: sendQuoteReply(indicBid + indicAsk + lastPrice + bidChanges * 1000)
+})";
+   QTemporaryDir dir;
+   ASSERT_TRUE(dir.isValid());
+   const auto scriptFile = dir.filePath(QLatin1String("BatchTest.qml"));
+   QFile file(scriptFile);
+   ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+   file.write(script);
+   file.close();
+
+   const int64_t start = 1580000000000;
+   std::vector<bs::ScriptTrafficEvent> events;
+   bs::ScriptTrafficEvent quoteReq;
+   quoteReq.type = bs::ScriptTrafficEvent::Type::QuoteReq;
+   quoteReq.timestamp = start;
+   quoteReq.qrn.quoteRequestId = "req1";
+   quoteReq.qrn.security = "EUR/GBP";
+   quoteReq.qrn.product = "EUR";
+   quoteReq.qrn.side = bs::network::Side::Buy;
+   quoteReq.qrn.quantity = 1;
+   quoteReq.qrn.assetType = bs::network::Asset::SpotFX;
+   quoteReq.qrn.status = bs::network::QuoteReqNotification::PendingAck;
+   quoteReq.qrn.expirationTime = QDateTime::fromMSecsSinceEpoch(start + 2000);
+   events.push_back(quoteReq);
+
+   const auto mdEvent = [start](int64_t offset, bs::network::MDField::Type type, double value) {
+      bs::ScriptTrafficEvent md;
+      md.type = bs::ScriptTrafficEvent::Type::MarketData;
+      md.timestamp = start + offset;
+      md.assetType = bs::network::Asset::SpotFX;
+      md.text = "EUR/GBP";
+      md.fields = { { type, value } };
+      return md;
+   };
+   // All three prices change within the first batch (0.5s), only bid in the second
+   events.push_back(mdEvent(100, bs::network::MDField::PriceBid, 1));
+   events.push_back(mdEvent(200, bs::network::MDField::PriceOffer, 2));
+   events.push_back(mdEvent(300, bs::network::MDField::PriceLast, 4));
+   events.push_back(mdEvent(350, bs::network::MDField::PriceBid, 8));
+   events.push_back(mdEvent(700, bs::network::MDField::PriceBid, 16));
+
+   bs::ScriptReplayHarness harness(StaticLogger::loggerPtr);
+   harness.setEvents(std::move(events));
+   QString error;
+   ASSERT_TRUE(harness.runAQ(scriptFile, error)) << error.toStdString();
+
+   const auto it = harness.requests().find("req1");
+   ASSERT_NE(it, harness.requests().end());
+   const auto &quotes = it->second.quotes;
+   // One pricesChanged per flush, emitted after all prices and indicBidChanged
+   ASSERT_EQ(quotes.size(), 2);
+   EXPECT_EQ(quotes[0].timestamp, start + 500);
+   EXPECT_DOUBLE_EQ(quotes[0].price, 8 + 2 + 4 + 1000);
+   EXPECT_EQ(quotes[1].timestamp, start + 1000);
+   EXPECT_DOUBLE_EQ(quotes[1].price, 16 + 2 + 4 + 2000);
+}
+
+TEST(TestCommon, AQScriptHotReload)
+{
+   const auto logger = StaticLogger::loggerPtr;
+   QTemporaryDir dir;
+   ASSERT_TRUE(dir.isValid());
+   const auto writeScript = [&dir](const QString &name, const QByteArray &data) {
+      const auto filename = dir.filePath(name);
+      QFile file(filename);
+      if (file.open(QIODevice::WriteOnly)) {
+         file.write(data);
+      }
+      return filename;
+   };
+   const auto scriptV1 = writeScript(QLatin1String("v1.qml"), "import bs.terminal 1.0\n"
+      "BSQuoteReqReply {\n"
+      "    property int scriptVersion: 1\n"
+      "    onBestPriceChanged: sendQuoteReply(bestPrice + 1)\n"
+      "}\n");
+   // Replies relative to the price sent by previous version, restored on reload
+   const auto scriptV2 = writeScript(QLatin1String("v2.qml"), "import bs.terminal 1.0\n"
+      "BSQuoteReqReply {\n"
+      "    property int scriptVersion: 2\n"
+      "    onBestPriceChanged: sendQuoteReply(sentPrice + 1000)\n"
+      "}\n");
+   const auto broken = writeScript(QLatin1String("broken.qml"), "import bs.terminal 1.0\n"
+      "BSQuoteReqReply {\n"
+      "    onBestPriceChanged: \n");
+   const auto processEvents = [] {
+      QCoreApplication::processEvents();
+      QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+   };
+
+   bs::network::QuoteReqNotification qrn;
+   qrn.quoteRequestId = "req1";
+   qrn.security = "EUR/GBP";
+   qrn.product = "EUR";
+   qrn.side = bs::network::Side::Buy;
+   qrn.quantity = 1;
+   qrn.assetType = bs::network::Asset::SpotFX;
+   qrn.status = bs::network::QuoteReqNotification::PendingAck;
+   qrn.expirationTime = QDateTime::currentDateTime().addSecs(60);
+
+   const auto mdCallbacks = std::make_shared<MDCallbacksQt>();
+   const auto assetManager = std::make_shared<AssetManager>(logger, nullptr, nullptr, nullptr);
+
+   // Prepared version is used only after commit, rollback keeps current one
+   {
+      AutoQuoter aq(logger, assetManager, mdCallbacks, ExtConnections{});
+      ASSERT_TRUE(aq.load(scriptV1));
+      EXPECT_EQ(aq.version(), 1);
+
+      QString error;
+      ASSERT_TRUE(aq.prepareReload(scriptV2, error)) << error.toStdString();
+      auto pending = aq.instantiatePending(qrn, error);
+      ASSERT_NE(pending, nullptr);
+      EXPECT_EQ(pending->property("scriptVersion").toInt(), 2);
+      delete pending;
+
+      aq.rollbackReload();
+      EXPECT_EQ(aq.version(), 1);
+      EXPECT_EQ(aq.instantiatePending(qrn, error), nullptr);
+      std::unique_ptr<QObject> current(aq.instantiate(qrn));
+      ASSERT_NE(current, nullptr);
+      EXPECT_EQ(current->property("scriptVersion").toInt(), 1);
+
+      error.clear();
+      EXPECT_FALSE(aq.prepareReload(broken, error));
+      EXPECT_FALSE(error.isEmpty());
+      EXPECT_EQ(aq.version(), 1);
+
+      ASSERT_TRUE(aq.prepareReload(scriptV2, error));
+      aq.commitReload();
+      EXPECT_EQ(aq.version(), 2);
+      current.reset(aq.instantiate(qrn));
+      ASSERT_NE(current, nullptr);
+      EXPECT_EQ(current->property("scriptVersion").toInt(), 2);
+      processEvents();
+   }
+
+   // Failed reload leaves active request on the old version, good one migrates it
+   const auto quoteProvider = std::make_shared<QuoteProvider>(assetManager, logger);
+   std::unique_ptr<AQScriptHandler> handler(new AQScriptHandler(quoteProvider
+      , nullptr, mdCallbacks, assetManager, logger));
+   UserScriptRunner runner(logger, handler.get(), nullptr);
+   runner.setRunningThread(nullptr);
+   handler->setRequireOnlineSigner(false);
+
+   std::vector<double> quotes;
+   QObject::connect(handler.get(), &AQScriptHandler::sendQuote
+      , [&quotes](const bs::network::QuoteReqNotification &, double price) {
+      quotes.push_back(price);
+   });
+   int loaded = 0;
+   int reloadFailed = 0;
+   QObject::connect(&runner, &UserScriptRunner::scriptLoaded, [&loaded](const QString &) {
+      loaded++;
+   });
+   QObject::connect(&runner, &UserScriptRunner::reloadFailed, [&reloadFailed]
+      (const QString &, const QString &) {
+      reloadFailed++;
+   });
+
+   runner.enable(scriptV1);
+   processEvents();
+   ASSERT_EQ(loaded, 1);
+   emit quoteProvider->quoteReqNotifReceived(qrn);
+   processEvents();
+   emit quoteProvider->bestQuotePrice(QLatin1String("req1"), 100, false);
+   processEvents();
+   ASSERT_EQ(quotes.size(), 1);
+   EXPECT_DOUBLE_EQ(quotes.back(), 101);
+
+   runner.reload(broken);
+   processEvents();
+   EXPECT_EQ(reloadFailed, 1);
+   EXPECT_EQ(loaded, 1);
+   emit quoteProvider->bestQuotePrice(QLatin1String("req1"), 200, false);
+   processEvents();
+   ASSERT_EQ(quotes.size(), 2);
+   EXPECT_DOUBLE_EQ(quotes.back(), 201);
+
+   runner.reload(scriptV2);
+   processEvents();
+   EXPECT_EQ(loaded, 2);
+   EXPECT_EQ(quotes.size(), 2);     // migration doesn't send anything by itself
+   emit quoteProvider->bestQuotePrice(QLatin1String("req1"), 300, false);
+   processEvents();
+   ASSERT_EQ(quotes.size(), 3);
+   EXPECT_DOUBLE_EQ(quotes.back(), 1201);
+
+   handler->disconnect();
+   runner.disable();
+   processEvents();
+
+   // Sharded runner reports reload once and switches all shards or none
+   {
+      AQScriptRunner shardedRunner(quoteProvider, nullptr, mdCallbacks, assetManager, logger, 3);
+      int shardedLoaded = 0;
+      int shardedFailed = 0;
+      QObject::connect(&shardedRunner, &UserScriptRunner::scriptLoaded, [&shardedLoaded](const QString &) {
+         shardedLoaded++;
+      });
+      QObject::connect(&shardedRunner, &UserScriptRunner::reloadFailed, [&shardedFailed]
+         (const QString &, const QString &) {
+         shardedFailed++;
+      });
+      const auto waitFor = [&processEvents](const std::function<bool()> &cond) {
+         const auto start = std::chrono::steady_clock::now();
+         while (!cond() && (std::chrono::steady_clock::now() - start < std::chrono::seconds(5))) {
+            processEvents();
+         }
+         processEvents();
+         return cond();
+      };
+
+      shardedRunner.enable(scriptV1);
+      ASSERT_TRUE(waitFor([&shardedLoaded] { return shardedLoaded > 0; }));
+      const int loadedBefore = shardedLoaded;
+
+      shardedRunner.reload(broken);
+      EXPECT_TRUE(waitFor([&shardedFailed] { return shardedFailed > 0; }));
+      EXPECT_EQ(shardedFailed, 1);
+      EXPECT_EQ(shardedLoaded, loadedBefore);
+
+      shardedRunner.reload(scriptV2);
+      EXPECT_TRUE(waitFor([&] { return shardedLoaded > loadedBefore; }));
+      EXPECT_EQ(shardedLoaded, loadedBefore + 1);
+      EXPECT_EQ(shardedFailed, 1);
+      shardedRunner.disable();
+      processEvents();
+   }
+}
+
+TEST(TestCommon, AutoRFQScheduler)
+{
+   AutoRFQScheduler scheduler(StaticLogger::loggerPtr);
+   scheduler.setRateLimit(20, 2);
+
+   std::vector<std::string> sent;
+   QObject::connect(&scheduler, &AutoRFQScheduler::sendRFQ
+      , [&sent](const std::string &id, const QString &, double, bool) {
+      sent.push_back(id);
+   });
+
+   for (int i = 0; i < 5; ++i) {
+      scheduler.submit(std::to_string(i), QStringLiteral("XBT/EUR"), 0.1, true);
+   }
+   // Burst goes out at once, the rest waits
+   EXPECT_EQ(sent, std::vector<std::string>({ "0", "1" }));
+   auto stats = scheduler.stats();
+   EXPECT_EQ(stats.active, 2);
+   EXPECT_EQ(stats.pending, 3);
+   EXPECT_EQ(stats.throttled, 3);
+
+   EXPECT_TRUE(scheduler.cancel("3"));
+   EXPECT_FALSE(scheduler.cancel("0"));
+   EXPECT_EQ(scheduler.stats().active, 1);
+   EXPECT_EQ(scheduler.stats().pending, 2);
+
+   const auto start = std::chrono::steady_clock::now();
+   while ((scheduler.stats().pending > 0)
+      && (std::chrono::steady_clock::now() - start < std::chrono::seconds(5))) {
+      QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+   }
+   EXPECT_EQ(sent, std::vector<std::string>({ "0", "1", "2", "4" }));
+   stats = scheduler.stats();
+   EXPECT_EQ(stats.active, 3);
+   EXPECT_EQ(stats.pending, 0);
+
+   scheduler.finished("1");
+   EXPECT_EQ(scheduler.stats().active, 2);
+
+   scheduler.setRateLimit(0, 0);
+   for (int i = 5; i < 10; ++i) {
+      scheduler.submit(std::to_string(i), QStringLiteral("XBT/EUR"), 0.1, false);
+   }
+   EXPECT_EQ(sent.size(), 9);
+   EXPECT_EQ(scheduler.stats().pending, 0);
+}
+
+namespace {
+   class TestQuoteStrategyReply : public bs::QuoteStrategyReply
+   {
+   public:
+      const bs::QuoteStrategyRequest &request() const override { return request_; }
+      double expirationInSec() const override { return 10; }
+      double indicBid() const override { return indicBid_; }
+      double indicAsk() const override { return indicAsk_; }
+      double lastPrice() const override { return 0; }
+      double bestPrice() const override { return bestPrice_; }
+      bool isOwnBestPrice() const override { return false; }
+      bs::QuoteStrategyPrices marketData(const std::string &) const override { return {}; }
+      std::string contraProduct() const override { return "EUR"; }
+      double accountBalance(const std::string &product) const override
+      {
+         const auto it = balances_.find(product);
+         return (it == balances_.end()) ? 0 : it->second;
+      }
+      bool sendQuote(double price) override
+      {
+         quotes_.push_back(price);
+         return true;
+      }
+      bool pullQuote() override { return true; }
+      bool sendExtConn(const std::string &, const std::string &, const std::string &) override
+      {
+         return false;
+      }
+      void log(const std::string &) override {}
+
+      bs::QuoteStrategyRequest   request_;
+      double   indicBid_{ 0 };
+      double   indicAsk_{ 0 };
+      double   bestPrice_{ 0 };
+      std::map<std::string, double> balances_;
+      std::vector<double>  quotes_;
+   };
+}
+
+TEST(TestCommon, FeeEstimateCache)
+{
+   TestEnv env(StaticLogger::loggerPtr);
+   env.requireArmory();
+
+   const auto cache = std::make_shared<bs::FeeEstimateCache>(StaticLogger::loggerPtr
+      , env.armoryConnection());
+   const float expected = TestArmoryConnection::testFeePerByte();
+
+   // Both requests are served by one estimate
+   std::promise<float> prom1, prom2;
+   cache->get(2, [&prom1](float fee) { prom1.set_value(fee); });
+   cache->get(2, [&prom2](float fee) { prom2.set_value(fee); });
+   auto fut1 = prom1.get_future();
+   auto fut2 = prom2.get_future();
+   ASSERT_EQ(fut1.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+   ASSERT_EQ(fut2.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+   EXPECT_FLOAT_EQ(ArmoryConnection::toFeePerByte(fut1.get()), expected);
+   EXPECT_FLOAT_EQ(ArmoryConnection::toFeePerByte(fut2.get()), expected);
+   EXPECT_EQ(cache->cachedCount(), 1);
+
+   // Cached value is returned synchronously
+   float cached = 0;
+   cache->get(2, [&cached](float fee) { cached = fee; });
+   EXPECT_FLOAT_EQ(ArmoryConnection::toFeePerByte(cached), expected);
+
+   cache->invalidateAll();
+   EXPECT_EQ(cache->cachedCount(), 0);
+}
+
+TEST(TestCommon, SampleQuoteStrategy)
+{
+   TestQuoteStrategyReply reply;
+   reply.request_.security = "XBT/EUR";
+   reply.request_.product = "XBT";
+   reply.request_.isBuy = true;
+   reply.request_.quantity = 2;
+   reply.request_.assetType = 2;
+   reply.balances_["XBT"] = 1;
+
+   bs::SampleQuoteStrategyFactory factory;
+   auto strategy = factory.create(reply);
+   ASSERT_NE(strategy, nullptr);
+
+   // Not enough balance to reply on ask
+   reply.indicAsk_ = 100;
+   strategy->onIndicAskChanged();
+   EXPECT_TRUE(reply.quotes_.empty());
+
+   reply.balances_["XBT"] = 5;
+   strategy->onIndicAskChanged();
+   ASSERT_EQ(reply.quotes_.size(), 1);
+   EXPECT_DOUBLE_EQ(reply.quotes_.back(), 101);
+
+   // Bid changes are ignored for buy requests
+   reply.indicBid_ = 99;
+   strategy->onIndicBidChanged();
+   EXPECT_EQ(reply.quotes_.size(), 1);
+
+   reply.bestPrice_ = 102;
+   strategy->onBestPriceChanged();
+   ASSERT_EQ(reply.quotes_.size(), 2);
+   EXPECT_DOUBLE_EQ(reply.quotes_.back(), 102 * 0.999);
+
+   // Never replies on CC requests
+   TestQuoteStrategyReply ccReply;
+   ccReply.request_.assetType = 3;
+   ccReply.bestPrice_ = 1;
+   auto ccStrategy = factory.create(ccReply);
+   ccStrategy->onBestPriceChanged();
+   EXPECT_TRUE(ccReply.quotes_.empty());
+}
+
+namespace {
+   struct CoinSelectionStats
+   {
+      size_t   runs{ 0 };
+      size_t   failed{ 0 };
+      double   totalUs{ 0 };
+      double   maxUs{ 0 };
+      size_t   inputs{ 0 };
+      uint64_t change{ 0 };
+      uint64_t fee{ 0 };
+      uint64_t overpay{ 0 };
+      int64_t  minOverpay{ 0 };
+   };
+
+   // Resident memory of the process, 0 if not supported on the platform
+   size_t residentMemory()
+   {
+#ifdef __linux__
+      std::ifstream statm("/proc/self/statm");
+      size_t pages = 0, resident = 0;
+      statm >> pages >> resident;
+      return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+      return 0;
+#endif
+   }
+
+   enum class UtxoDistribution {
+      Uniform,
+      DustHeavy,
+      WhaleHeavy
+   };
+
+   const char *distributionName(UtxoDistribution distribution)
+   {
+      switch (distribution) {
+      case UtxoDistribution::Uniform:     return "uniform";
+      case UtxoDistribution::DustHeavy:   return "dust-heavy";
+      case UtxoDistribution::WhaleHeavy:  return "whale-heavy";
+      }
+      return "";
+   }
+
+   std::vector<UTXO> makeUtxoDistribution(UtxoDistribution distribution, size_t count
+      , const BinaryData &script, std::mt19937_64 &gen)
+   {
+      std::uniform_real_distribution<double> share(0, 1);
+      const auto valueIn = [&gen](uint64_t from, uint64_t to) {
+         return std::uniform_int_distribution<uint64_t>(from, to)(gen);
+      };
+      const auto txHash = CryptoPRNG::generateRandom(32);
+
+      std::vector<UTXO> result;
+      result.reserve(count);
+      for (size_t i = 0; i < count; ++i) {
+         uint64_t value = 0;
+         switch (distribution) {
+         case UtxoDistribution::Uniform:
+            value = valueIn(10000, 10000000);
+            break;
+         case UtxoDistribution::DustHeavy:
+            value = (share(gen) < 0.9) ? valueIn(546, 5000) : valueIn(100000, 10000000);
+            break;
+         case UtxoDistribution::WhaleHeavy:
+            value = (share(gen) < 0.95) ? valueIn(10000, 1000000) : valueIn(100000000, 5000000000);
+            break;
+         }
+         result.emplace_back(UTXO(value, UINT32_MAX, 0, static_cast<uint32_t>(i), txHash, script));
+      }
+      return result;
+   }
+
+   // Fee of TX with the smallest possible number of inputs without change -
+   // the lower bound for any selection as all inputs have the same type
+   uint64_t optimalFee(const std::vector<UTXO> &sortedDesc, uint64_t amount
+      , const bs::Address &recipient, float feePerByte)
+   {
+      bs::MaxSpendAccumulator acc;
+      acc.setFeePerByte(feePerByte);
+      for (const auto &utxo : sortedDesc) {
+         acc.addInput(utxo);
+         if (acc.inputsSum() >= amount + acc.fee(recipient)) {
+            return acc.fee(recipient);
+         }
+      }
+      return 0;
+   }
+
+   using CoinSelector = std::function<std::vector<UTXO>(uint64_t)>;
+
+   // Selects for amount + fee, repeating while fee of selected inputs isn't covered
+   void runCoinSelection(const CoinSelector &selector, uint64_t amount, uint64_t optFee
+      , const bs::Address &recipient, const bs::Address &changeAddr, float feePerByte
+      , CoinSelectionStats &stats)
+   {
+      const uint64_t kDust = 546;
+      uint64_t target = amount;
+      std::vector<UTXO> selected;
+      bs::MaxSpendAccumulator acc;
+      acc.setFeePerByte(feePerByte);
+
+      const auto start = std::chrono::steady_clock::now();
+      for (int attempt = 0; attempt < 5; ++attempt) {
+         selected = selector(target);
+         acc.setInputs(selected);
+         if (acc.inputsSum() >= amount + acc.fee(recipient)) {
+            break;
+         }
+         acc.addOutput(recipient, amount);
+         target = amount + acc.fee(changeAddr);
+         acc.clearOutputs();
+      }
+      const double us = std::chrono::duration<double, std::micro>(
+         std::chrono::steady_clock::now() - start).count();
+
+      stats.runs++;
+      stats.totalUs += us;
+      stats.maxUs = std::max(stats.maxUs, us);
+      const uint64_t feeNoChange = acc.fee(recipient);
+      if (acc.inputsSum() < amount + feeNoChange) {
+         stats.failed++;
+         return;
+      }
+
+      uint64_t fee = acc.inputsSum() - amount;
+      uint64_t change = 0;
+      acc.addOutput(recipient, amount);
+      const uint64_t feeWithChange = acc.fee(changeAddr);
+      if (acc.inputsSum() >= amount + feeWithChange + kDust) {
+         fee = feeWithChange;
+         change = acc.inputsSum() - amount - feeWithChange;
+      }
+      stats.inputs += selected.size();
+      stats.change += change;
+      stats.fee += fee;
+      stats.overpay += fee - std::min(fee, optFee);
+      stats.minOverpay = std::min(stats.minOverpay, static_cast<int64_t>(fee) - static_cast<int64_t>(optFee));
+   }
+
+   // Runs bs::selectUtxoForAmount, UtxoIndex::select and index-level selection with
+   // reservation (select under read lock, then tryReserve) over the same UTXOs, returns
+   // stats per selector. UTXOReservationManager itself (fee requests, reselection on
+   // conflict, global reservation) needs Armory and is not measured here.
+   std::map<std::string, CoinSelectionStats> benchmarkCoinSelection(UtxoDistribution distribution
+      , size_t count, int runs, const std::shared_ptr<spdlog::logger> &logger)
+   {
+      const float kFeePerByte = 10;
+      const auto pubKey = BinaryData::CreateFromHex("0279BE667EF9DCBBAC55A06295CE870B07029BFCDB2DCE28D959F2815B16F81798");
+      const auto address = bs::Address::fromPubKey(pubKey, AddressEntryType_P2WPKH);
+      const auto script = BtcUtils::getP2WPKHOutputScript(BtcUtils::getHash160(pubKey));
+      std::mt19937_64 gen(count + static_cast<int>(distribution));
+
+      const auto memBase = residentMemory();
+      const auto utxos = makeUtxoDistribution(distribution, count, script, gen);
+      const auto memVector = residentMemory();
+      size_t memCopy = 0;
+      {  // selectUtxoForAmount copies candidates on every call, cost of one such copy
+         const auto copy = utxos;
+         const auto memAfterCopy = residentMemory();
+         memCopy = memAfterCopy - std::min(memAfterCopy, memVector);
+      }
+
+      const auto memIndexStart = residentMemory();
+      bs::UtxoIndex index;
+      for (const auto &utxo : utxos) {
+         index.add(utxo, "leaf");
+      }
+      const auto memIndexEnd = residentMemory();
+      const auto memIndex = memIndexEnd - std::min(memIndexEnd, memIndexStart);
+      bs::ConcurrentUtxoIndex concurrentIndex(bs::UtxoIndex{ index });
+
+      auto sortedDesc = utxos;
+      std::sort(sortedDesc.begin(), sortedDesc.end(), [](const UTXO &a, const UTXO &b) {
+         return a.getValue() > b.getValue();
+      });
+      const uint64_t total = index.availableSum();
+
+      const std::map<std::string, CoinSelector> selectors = {
+         { "selectUtxoForAmount", [&utxos](uint64_t amount) {
+            return bs::selectUtxoForAmount(utxos, amount);
+         } },
+         { "UtxoIndex::select", [&index](uint64_t amount) {
+            return index.select(amount);
+         } },
+         { "index select+tryReserve", [&concurrentIndex](uint64_t amount) {
+            std::vector<UTXO> result;
+            concurrentIndex.read([amount, &result](const bs::UtxoIndex &idx) {
+               result = idx.select(amount);
+            });
+            if (!concurrentIndex.tryReserve(result)) {
+               return std::vector<UTXO>{};
+            }
+            concurrentIndex.release(result);
+            return result;
+         } }
+      };
+
+      std::map<std::string, CoinSelectionStats> result;
+      for (const double fraction : { 0.0001, 0.01, 0.1 }) {
+         for (int run = 0; run < runs; ++run) {
+            const uint64_t amount = std::max<uint64_t>(10000
+               , static_cast<uint64_t>(total * fraction * (0.5 + 0.5 * (run + 1) / runs)));
+            const auto optFee = optimalFee(sortedDesc, amount, address, kFeePerByte);
+            for (const auto &selector : selectors) {
+               runCoinSelection(selector.second, amount, optFee, address, address
+                  , kFeePerByte, result[selector.first]);
+            }
+         }
+      }
+
+      for (const auto &stats : result) {
+         const auto &s = stats.second;
+         const size_t ok = std::max<size_t>(1, s.runs - s.failed);
+         const bool isVectorCopy = (stats.first == "selectUtxoForAmount");
+         logger->info("[CoinSelection] {} {} UTXOs, {}: {:.1f} us avg, {:.1f} us max, {} KiB {}"
+            ", {:.1f} inputs, {} change, {} fee, {} overpay (avg), {} failed"
+            , distributionName(distribution), count, stats.first, s.totalUs / s.runs, s.maxUs
+            , (isVectorCopy ? memCopy : memIndex) / 1024
+            , isVectorCopy ? "per input vector copy" : "index", static_cast<double>(s.inputs) / ok, s.change / ok, s.fee / ok
+            , s.overpay / ok, s.failed);
+      }
+      logger->info("[CoinSelection] {} {} UTXOs: {} KiB UTXO vector; memory is RSS delta"
+         ", UTXOReservationManager path is not measured", distributionName(distribution)
+         , count, (memVector - std::min(memVector, memBase)) / 1024);
+      return result;
+   }
+}
+
+TEST(TestCommon, CoinSelectionQuality)
+{
+   for (const auto distribution : { UtxoDistribution::Uniform, UtxoDistribution::DustHeavy
+      , UtxoDistribution::WhaleHeavy }) {
+      const auto result = benchmarkCoinSelection(distribution, 1000, 3, StaticLogger::loggerPtr);
+      ASSERT_EQ(result.size(), 3);
+      for (const auto &stats : result) {
+         EXPECT_EQ(stats.second.runs, 9) << stats.first;
+         EXPECT_EQ(stats.second.failed, 0) << stats.first;
+         // Optimal fee is the lower bound
+         EXPECT_GE(stats.second.minOverpay, 0) << stats.first;
+      }
+      // Index selection follows the same strategy as selectUtxoForAmount
+      EXPECT_EQ(result.at("UtxoIndex::select").inputs, result.at("selectUtxoForAmount").inputs);
+      EXPECT_EQ(result.at("UtxoIndex::select").fee, result.at("index select+tryReserve").fee);
+   }
+}
+
+// Run with --gtest_also_run_disabled_tests, takes a few minutes and several GB for 1M UTXOs
+TEST(TestCommon, DISABLED_CoinSelectionBenchmark)
+{
+   for (const size_t count : { 1000, 10000, 100000, 1000000 }) {
+      for (const auto distribution : { UtxoDistribution::Uniform, UtxoDistribution::DustHeavy
+         , UtxoDistribution::WhaleHeavy }) {
+         benchmarkCoinSelection(distribution, count, (count < 1000000) ? 5 : 2
+            , StaticLogger::loggerPtr);
+      }
+   }
+}
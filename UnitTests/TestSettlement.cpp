@@ -21,6 +21,8 @@
 #include "InprocSigner.h"
 #include "TestEnv.h"
 #include "TransactionData.h"
+#include "UtxoReservation.h"
+#include "UtxoReservationManager.h"
 #include "Wallets/SyncWalletsManager.h"
 #include "Wallets/SyncHDWallet.h"
 #include "Wallets/SyncPlainWallet.h"
@@ -223,6 +225,74 @@ TEST_F(TestSettlement, Initial_balances)
    //EXPECT_GE(fut.get(), 5);
 }
 
+// Parallel requests select from the same UTXO set, so reservation conflicts
+// force reselection; every UTXO must end up in one token at most
+TEST_F(TestSettlement, ConcurrentUtxoReservation)
+{
+   const size_t kUtxoCount = 20;
+   const size_t kRequests = 40;
+   const auto logger = envPtr_->logger();
+   if (!bs::UtxoReservation::instance()) {
+      bs::UtxoReservation::init(logger);
+   }
+
+   mineBlocks(kUtxoCount);    // mature coinbases to fund from
+   for (size_t i = 0; i < kUtxoCount; ++i) {
+      sendTo(COIN / 100 * (i + 1), fundAddrs_[0]);
+   }
+   mineBlocks(6);
+
+   const auto hdWalletId = hdWallet_[0]->walletId();
+   auto utxoReservationMgr = std::make_shared<bs::UTXOReservationManager>(syncMgr_
+      , envPtr_->armoryConnection(), logger);
+   emit syncMgr_->walletsSynchronized();
+
+   const auto waitFor = [](const std::function<bool()> &cond) {
+      const auto start = std::chrono::steady_clock::now();
+      while (!cond() && (std::chrono::steady_clock::now() - start < 10s)) {
+         QApplication::processEvents();
+      }
+      return cond();
+   };
+   ASSERT_TRUE(waitFor([&] {
+      return utxoReservationMgr->getAvailableXbtUTXOs(hdWalletId).size() > kUtxoCount;
+   }));
+   const auto availableBefore = utxoReservationMgr->getAvailableXbtUTXOs(hdWalletId).size();
+
+   std::vector<bs::FixedXbtInputs> results;
+   for (size_t i = 0; i < kRequests; ++i) {
+      const uint64_t quantity = COIN / 100 * (i % 5 + 1);
+      utxoReservationMgr->reserveBestXbtUtxoSet(hdWalletId, quantity, false
+         , [&results](bs::FixedXbtInputs &&fixedXbt) {
+         results.push_back(std::move(fixedXbt));
+      }, false, bs::UTXOReservationManager::CheckAmount::Disabled);
+   }
+   ASSERT_TRUE(waitFor([&] { return results.size() == kRequests; }));
+
+   std::set<std::pair<BinaryData, uint32_t>> reserved;
+   int succeeded = 0;
+   for (const auto &result : results) {
+      if (!result.utxoRes.isValid()) {
+         EXPECT_TRUE(result.inputs.empty());
+         continue;
+      }
+      succeeded++;
+      for (const auto &input : result.inputs) {
+         EXPECT_TRUE(reserved.emplace(input.first.getTxHash(), input.first.getTxOutIndex()).second)
+            << "UTXO reserved twice";
+      }
+   }
+   EXPECT_GT(succeeded, 0);
+   EXPECT_EQ(utxoReservationMgr->getAvailableXbtUTXOs(hdWalletId).size()
+      , availableBefore - reserved.size());
+
+   // Released UTXOs are available again
+   results.clear();
+   EXPECT_TRUE(waitFor([&] {
+      return utxoReservationMgr->getAvailableXbtUTXOs(hdWalletId).size() == availableBefore;
+   }));
+}
+
 #if 0    //temporarily disabled
 TEST_F(TestSettlement, SpotXBT_sell)
 {